@@ -0,0 +1,510 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <stdlib.h>
+
+#include <CL/cl.h>
+
+/** @struct clusterServer_st
+ * Part of a cluster context placed in a server platform, i.e. the
+ * context created for the cluster devices of the platform.
+ */
+struct clusterServer_st
+{
+    /// Server socket
+    int *socket;
+    /// Server platform
+    cl_platform_id platform;
+    /// Server context
+    cl_context context;
+    /// Number of devices of the context
+    cl_uint num_devices;
+    /// Devices of the context
+    cl_device_id *devices;
+    /// Command queue used to send buffers to other servers, created on demand
+    cl_command_queue queue;
+};
+
+/** @struct clusterContext_st
+ * Context of the virtual cluster platform, which can hold devices of
+ * several servers.
+ */
+struct clusterContext_st
+{
+    /// Number of server contexts
+    cl_uint num_servers;
+    /// Server contexts
+    struct clusterServer_st *servers;
+    /// Number of devices, sorted by server
+    cl_uint num_devices;
+    /// Devices, sorted by server
+    cl_device_id *devices;
+    /// Number of cluster objects using the context (plus 1 for the context itself)
+    cl_uint rcount;
+};
+
+/// clusterContext_st structure abstraction
+typedef struct clusterContext_st* clusterContext;
+
+/** @struct clusterMem_st
+ * Cluster buffer. The buffer is lazily replicated in the servers where
+ * it is used, keeping track of the replicas whose data is up to date.
+ */
+struct clusterMem_st
+{
+    /// Cluster context
+    clusterContext context;
+    /// Memory flags
+    cl_mem_flags flags;
+    /// Size of the buffer
+    size_t size;
+    /// Data to be copied in the first replica (CL_MEM_COPY_HOST_PTR), NULL otherwise
+    void *host_data;
+    /// Replica in each server, NULL if it has not been created yet
+    cl_mem *replicas;
+    /// CL_TRUE for the replicas whose data is up to date
+    cl_bool *valid;
+    /// CL_TRUE for the replicas whose data is being copied
+    cl_bool *migrating;
+    /// Last command queue where the buffer has been written
+    cl_command_queue queue;
+};
+
+/// clusterMem_st structure abstraction
+typedef struct clusterMem_st* clusterMem;
+
+/** @struct clusterProgram_st
+ * Cluster program, built in each server.
+ */
+struct clusterProgram_st
+{
+    /// Cluster context
+    clusterContext context;
+    /// Program in each server
+    cl_program *programs;
+    /// Number of cluster objects using the program (plus 1 for the program itself)
+    cl_uint rcount;
+};
+
+/// clusterProgram_st structure abstraction
+typedef struct clusterProgram_st* clusterProgram;
+
+/** @struct clusterArg_st
+ * Kernel argument, set in each server when the kernel is enqueued.
+ */
+struct clusterArg_st
+{
+    /// Size of the argument
+    size_t size;
+    /// Value of the argument, NULL for local memory arguments
+    void *value;
+    /// Cluster buffer, NULL if the argument is not a buffer
+    clusterMem mem;
+    /// CL_TRUE for the servers where the argument has been already set
+    cl_bool *applied;
+    /// Bytes of the buffer written by each work item along the outermost
+    /// dimension in split launches, 0 if the buffer is not partitioned
+    size_t partition;
+};
+
+/** @struct clusterKernel_st
+ * Cluster kernel, created in each server where the program has been
+ * built.
+ */
+struct clusterKernel_st
+{
+    /// Cluster program
+    clusterProgram program;
+    /// Kernel in each server, NULL if the program is not built there
+    cl_kernel *kernels;
+    /// Number of arguments
+    cl_uint num_args;
+    /// Arguments
+    struct clusterArg_st *args;
+};
+
+/// clusterKernel_st structure abstraction
+typedef struct clusterKernel_st* clusterKernel;
+
+/** @struct clusterSplit_st
+ * Command queue of the split device, which splits the kernels along the
+ * outermost dimension between all the devices of a cluster context.
+ */
+struct clusterSplit_st
+{
+    /// Cluster context
+    clusterContext context;
+    /// Number of devices, i.e. number of server command queues
+    cl_uint num_queues;
+    /// Server command queue of each device. The first one is the primary
+    /// queue, where the rest of commands are enqueued
+    cl_command_queue *queues;
+    /// Index of the server context of each command queue
+    cl_uint *servers;
+    /// Work items per second computed by each device in the previous
+    /// launches, 0 until the first launch
+    double *throughput;
+};
+
+/// clusterSplit_st structure abstraction
+typedef struct clusterSplit_st* clusterSplit;
+
+/** Test if the virtual cluster platform, which holds the devices of
+ * all the servers, should be reported. The platform is enabled setting
+ * the OCLAND_CLUSTER environment variable to a non zero value.
+ * @return CL_TRUE if the cluster platform is enabled, CL_FALSE otherwise.
+ */
+cl_bool isClusterEnabled();
+
+/** Answer an info query with a value known by the client.
+ * @param value Value to return.
+ * @param value_size Size of the value.
+ * @param param_value_size Size of the memory pointed by param_value.
+ * @param param_value Returned value. Can be NULL.
+ * @param param_value_size_ret Returned size of the value. Can be NULL.
+ * @return CL_SUCCESS, or CL_INVALID_VALUE if param_value_size is too
+ * small.
+ */
+cl_int clusterSetInfo(const void *value,
+                      size_t      value_size,
+                      size_t      param_value_size,
+                      void *      param_value,
+                      size_t *    param_value_size_ret);
+
+/** clGetPlatformInfo for the cluster platform.
+ */
+cl_int clusterGetPlatformInfo(cl_platform_info param_name,
+                              size_t           param_value_size,
+                              void *           param_value,
+                              size_t *         param_value_size_ret);
+
+/** Create a cluster context, i.e. a context in each server platform
+ * of the devices.
+ * @param num_devices Number of devices.
+ * @param devices Server devices.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Cluster context, NULL if errors happened.
+ */
+clusterContext clusterCreateContext(cl_uint              num_devices,
+                                    const cl_device_id * devices,
+                                    cl_int *             errcode_ret);
+
+/** Release a cluster context. The server contexts are released once
+ * all the cluster objects using them are released as well.
+ * @param context Cluster context.
+ * @return CL_SUCCESS if the context is released, an error code otherwise.
+ */
+cl_int clusterReleaseContext(clusterContext context);
+
+/** clGetContextInfo for the cluster contexts. The devices are returned
+ * as server devices, and the platform property as a NULL platform.
+ */
+cl_int clusterGetContextInfo(clusterContext     context,
+                             cl_context_info    param_name,
+                             size_t             param_value_size,
+                             void *             param_value,
+                             size_t *           param_value_size_ret);
+
+/** Get the server context where a device is placed.
+ * @param context Cluster context.
+ * @param device Server device.
+ * @return Index of the server context, context->num_servers if the
+ * device doesn't belong to the cluster context.
+ */
+cl_uint clusterGetServer(clusterContext context, cl_device_id device);
+
+/** Create a command queue in the server context of a device.
+ * @param context Cluster context.
+ * @param device Server device.
+ * @param properties Command queue properties.
+ * @param server Returned index of the server context.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Server command queue, NULL if errors happened.
+ */
+cl_command_queue clusterCreateCommandQueue(clusterContext              context,
+                                           cl_device_id                device,
+                                           cl_command_queue_properties properties,
+                                           cl_uint *                   server,
+                                           cl_int *                    errcode_ret);
+
+/** Create a cluster buffer. The replicas are created later, when the
+ * buffer is used in each server.
+ * @param context Cluster context.
+ * @param flags Memory flags. CL_MEM_USE_HOST_PTR and
+ * CL_MEM_ALLOC_HOST_PTR are not supported.
+ * @param size Size of the buffer.
+ * @param host_ptr Data to copy if CL_MEM_COPY_HOST_PTR is set.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Cluster buffer, NULL if errors happened.
+ */
+clusterMem clusterCreateBuffer(clusterContext context,
+                               cl_mem_flags   flags,
+                               size_t         size,
+                               void *         host_ptr,
+                               cl_int *       errcode_ret);
+
+/** Release a cluster buffer, and all its replicas.
+ * @param mem Cluster buffer.
+ * @return CL_SUCCESS if the buffer is released, an error code otherwise.
+ */
+cl_int clusterReleaseMem(clusterMem mem);
+
+/** clGetMemObjectInfo for the cluster buffers. The context and the
+ * reference count are not known by this module.
+ */
+cl_int clusterGetMemObjectInfo(clusterMem    mem,
+                               cl_mem_info   param_name,
+                               size_t        param_value_size,
+                               void *        param_value,
+                               size_t *      param_value_size_ret);
+
+/** Get the replica of a cluster buffer in a server, creating it if
+ * it doesn't exist yet. If the data of the replica is outdated it is
+ * copied from a server which holds it, server to server.
+ * @param mem Cluster buffer.
+ * @param server Index of the server context.
+ * @param command_queue Server command queue which will use the replica.
+ * @param access How the replica will be accessed. CL_MEM_READ_ONLY if
+ * the buffer will be just read, CL_MEM_WRITE_ONLY if the whole buffer
+ * will be overwritten (so the outdated data is not copied), and
+ * CL_MEM_READ_WRITE otherwise. The replicas of the other servers are
+ * outdated if the buffer is written.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Server buffer, NULL if errors happened.
+ */
+cl_mem clusterMemOn(clusterMem       mem,
+                    cl_uint          server,
+                    cl_command_queue command_queue,
+                    cl_mem_flags     access,
+                    cl_int *         errcode_ret);
+
+/** Create a cluster program, i.e. a program in each server context.
+ * @param context Cluster context.
+ * @param count Number of source strings.
+ * @param strings Source strings.
+ * @param lengths Length of each source string. Can be NULL.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Cluster program, NULL if errors happened.
+ */
+clusterProgram clusterCreateProgramWithSource(clusterContext context,
+                                              cl_uint        count,
+                                              const char **  strings,
+                                              const size_t * lengths,
+                                              cl_int *       errcode_ret);
+
+/** Release a cluster program. The server programs are released once
+ * all the cluster kernels using them are released as well.
+ * @param program Cluster program.
+ * @return CL_SUCCESS if the program is released, an error code otherwise.
+ */
+cl_int clusterReleaseProgram(clusterProgram program);
+
+/** Build a cluster program in the servers of the devices.
+ * @param program Cluster program.
+ * @param num_devices Number of devices, 0 to build for all of them.
+ * @param device_list Server devices.
+ * @param options Build options.
+ * @return CL_SUCCESS if the program is built, an error code otherwise.
+ */
+cl_int clusterBuildProgram(clusterProgram       program,
+                           cl_uint              num_devices,
+                           const cl_device_id * device_list,
+                           const char *         options);
+
+/** Get the server program of a device.
+ * @param program Cluster program.
+ * @param device Server device, NULL to get the first server program.
+ * @return Server program, NULL if the device doesn't belong to the context.
+ */
+cl_program clusterGetProgram(clusterProgram program, cl_device_id device);
+
+/** clGetProgramInfo for the cluster programs. The devices related data
+ * is collected from all the servers, while the rest of data is asked to
+ * the first one.
+ */
+cl_int clusterGetProgramInfo(clusterProgram   program,
+                             cl_program_info  param_name,
+                             size_t           param_value_size,
+                             void *           param_value,
+                             size_t *         param_value_size_ret);
+
+/** Create a cluster kernel, i.e. a kernel in each server where the
+ * program has been built.
+ * @param program Cluster program.
+ * @param kernel_name Kernel function name.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Cluster kernel, NULL if errors happened.
+ */
+clusterKernel clusterCreateKernel(clusterProgram program,
+                                  const char *   kernel_name,
+                                  cl_int *       errcode_ret);
+
+/** Create a cluster kernel for each kernel function of a program.
+ * @param program Cluster program.
+ * @param num_kernels Size of the kernels array.
+ * @param kernels Returned cluster kernels. Can be NULL.
+ * @param num_kernels_ret Returned number of kernel functions. Can be NULL.
+ * @return CL_SUCCESS if the kernels are created, an error code otherwise.
+ */
+cl_int clusterCreateKernelsInProgram(clusterProgram  program,
+                                     cl_uint         num_kernels,
+                                     clusterKernel * kernels,
+                                     cl_uint *       num_kernels_ret);
+
+/** Release a cluster kernel.
+ * @param kernel Cluster kernel.
+ * @return CL_SUCCESS if the kernel is released, an error code otherwise.
+ */
+cl_int clusterReleaseKernel(clusterKernel kernel);
+
+/** Set a cluster kernel argument. The argument is set in each server
+ * when the kernel is enqueued there.
+ * @param kernel Cluster kernel.
+ * @param arg_index Argument index.
+ * @param arg_size Argument size.
+ * @param arg_value Argument value, NULL for local memory.
+ * @param mem Cluster buffer, NULL if the argument is not a buffer.
+ * @return CL_SUCCESS if the argument is stored, an error code otherwise.
+ */
+cl_int clusterSetKernelArg(clusterKernel kernel,
+                           cl_uint       arg_index,
+                           size_t        arg_size,
+                           const void *  arg_value,
+                           clusterMem    mem);
+
+/** Declare the partition of a buffer argument in split launches, where
+ * the work items [a, b) of the outermost dimension just write the bytes
+ * [a*partition_size, b*partition_size) of the buffer.
+ * @param kernel Cluster kernel.
+ * @param arg_index Argument index.
+ * @param partition_size Bytes per work item, 0 to remove the partition.
+ * @return CL_SUCCESS if the partition is stored, an error code otherwise.
+ */
+cl_int clusterSetKernelArgPartition(clusterKernel kernel,
+                                    cl_uint       arg_index,
+                                    size_t        partition_size);
+
+/** Get the server kernel of a device.
+ * @param kernel Cluster kernel.
+ * @param device Server device, NULL to get the first server kernel.
+ * @return Server kernel, NULL if not available.
+ */
+cl_kernel clusterGetKernel(clusterKernel kernel, cl_device_id device);
+
+/** Get the server kernel to be enqueued in a server, setting there the
+ * arguments and getting the buffers replicas up to date.
+ * @param kernel Cluster kernel.
+ * @param server Index of the server context.
+ * @param command_queue Server command queue where the kernel will be
+ * enqueued.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Server kernel, NULL if errors happened.
+ */
+cl_kernel clusterKernelOn(clusterKernel    kernel,
+                          cl_uint          server,
+                          cl_command_queue command_queue,
+                          cl_int *         errcode_ret);
+
+/** Wait for the events of an events wait list generated by other
+ * servers than the command queue one, removing them from the list.
+ * The servers can't wait for the events of other servers.
+ * @param command_queue Server command queue.
+ * @param num_events Number of events, returning the number of events
+ * still in the list.
+ * @param event_list Server events, which is compacted.
+ * @return CL_SUCCESS if the events are waited, an error code otherwise.
+ */
+cl_int clusterWaitList(cl_command_queue command_queue,
+                       cl_uint *        num_events,
+                       cl_event *       event_list);
+
+/** Wait for events of several servers.
+ * @param num_events Number of events.
+ * @param event_list Server events.
+ * @return CL_SUCCESS if the events are waited, an error code otherwise.
+ */
+cl_int clusterWaitForEvents(cl_uint         num_events,
+                            const cl_event *event_list);
+
+/** Get info of the split device, which is made of several devices.
+ * The device type, name, number of compute units and the memory and
+ * work group limits are computed, the rest of data is taken from the
+ * first device.
+ * @param num_devices Number of devices.
+ * @param devices Server devices.
+ * @param param_name Requested data.
+ * @param param_value_size Size of the memory pointed by param_value.
+ * @param param_value Returned value. Can be NULL.
+ * @param param_value_size_ret Returned size of the value. Can be NULL.
+ * @return CL_SUCCESS if the info is returned, an error code otherwise.
+ */
+cl_int clusterGetSplitDeviceInfo(cl_uint              num_devices,
+                                 const cl_device_id * devices,
+                                 cl_device_info       param_name,
+                                 size_t               param_value_size,
+                                 void *               param_value,
+                                 size_t *             param_value_size_ret);
+
+/** Create a split device command queue, i.e. a command queue in each
+ * device of the cluster context.
+ * @param context Cluster context.
+ * @param properties Command queues properties.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Split command queue, NULL if errors happened.
+ */
+clusterSplit clusterCreateSplit(clusterContext              context,
+                                cl_command_queue_properties properties,
+                                cl_int *                    errcode_ret);
+
+/** Release a split device command queue.
+ * @param split Split command queue.
+ * @return CL_SUCCESS if the command queues are released, an error code
+ * otherwise.
+ */
+cl_int clusterReleaseSplit(clusterSplit split);
+
+/** Execute a kernel splitting the outermost dimension between the
+ * devices, proportionally to the throughput measured in the previous
+ * launches. The partitioned buffers are gathered in the primary queue
+ * server afterwards, while the rest of the buffers are just read.
+ * The launch is blocking.
+ * @param split Split command queue.
+ * @param kernel Cluster kernel.
+ * @param work_dim Number of dimensions.
+ * @param global_work_offset Global offset. Can be NULL.
+ * @param global_work_size Global size.
+ * @param local_work_size Local size. Can be NULL.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Server events to wait for.
+ * @param event Returned event of the primary queue. Can be NULL.
+ * @return CL_SUCCESS if the kernel is executed, an error code otherwise.
+ */
+cl_int clusterEnqueueSplitNDRangeKernel(clusterSplit     split,
+                                        clusterKernel    kernel,
+                                        cl_uint          work_dim,
+                                        const size_t *   global_work_offset,
+                                        const size_t *   global_work_size,
+                                        const size_t *   local_work_size,
+                                        cl_uint          num_events_in_wait_list,
+                                        const cl_event * event_wait_list,
+                                        cl_event *       event);
+
+#endif // CLUSTER_H_INCLUDED
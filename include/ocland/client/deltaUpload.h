@@ -0,0 +1,177 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELTAUPLOAD_H_INCLUDED
+#define DELTAUPLOAD_H_INCLUDED
+
+#include <stdlib.h>
+
+#include <CL/cl.h>
+
+/** @struct deltaWrite_st
+ * Blocks of a buffer write which must be actually transmitted, i.e. the
+ * ones whose content has changed since the last write through ocland.
+ */
+struct deltaWrite_st
+{
+    /// Number of ranges to transmit
+    size_t num_ranges;
+    /// Ranges to transmit, as pairs of offset and size in the buffer
+    size_t *ranges;
+    /// Total size in bytes of the ranges
+    size_t dirty;
+    /// Buffer invalidations counter when the write was started
+    unsigned long epoch;
+};
+
+/// deltaWrite_st structure abstraction
+typedef struct deltaWrite_st deltaWrite;
+
+/** Start tracking the content of a buffer. The buffer is split in blocks
+ * of OCLAND_DELTA_BLOCK bytes, storing the hash of the data last written
+ * in each one.
+ * @param mem Buffer.
+ * @param flags Buffer creation flags.
+ * @param size Buffer size.
+ */
+void addDeltaBuffer(cl_mem mem, cl_mem_flags flags, size_t size);
+
+/** Stop tracking a buffer, which may be released or written in ways
+ * that can't be followed (e.g. by sub-buffers).
+ * @param mem Buffer.
+ */
+void delDeltaBuffer(cl_mem mem);
+
+/** Get the creation flags of a tracked buffer.
+ * @param mem Buffer.
+ * @return Buffer creation flags, 0 if the buffer is not tracked.
+ */
+cl_mem_flags getDeltaBufferFlags(cl_mem mem);
+
+/** Invalidate the hashes of a buffer region, which content will be
+ * modified without passing through the client.
+ * @param mem Buffer. Untracked buffers are ignored.
+ * @param offset Offset of the region in bytes.
+ * @param cb Size of the region in bytes. It is clamped to the buffer size.
+ */
+void invalidateDeltaBuffer(cl_mem mem, size_t offset, size_t cb);
+
+/** Register a kernel argument, such that the buffer will be invalidated
+ * when the kernel is enqueued.
+ * @param kernel Kernel.
+ * @param arg_index Argument index.
+ * @param arg_size Argument size.
+ * @param arg_value Argument value.
+ */
+void setDeltaKernelArg(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void *arg_value);
+
+/** Invalidate the buffers which can be written by a kernel, i.e. the ones
+ * set as arguments without the CL_MEM_READ_ONLY flag.
+ * @param kernel Kernel to be enqueued.
+ */
+void invalidateDeltaKernel(cl_kernel kernel);
+
+/** Forget the arguments of a kernel.
+ * @param kernel Released kernel.
+ */
+void delDeltaKernel(cl_kernel kernel);
+
+/** Compute the blocks of a write which have changed. The full blocks
+ * covered by the write are hashed, and compared with the hashes
+ * of the last write, while the partially covered blocks are always
+ * considered changed. At least one range is returned, such that the
+ * write always enqueues a command.
+ * @param mem Buffer to write.
+ * @param offset Offset of the write in bytes.
+ * @param cb Size of the write in bytes.
+ * @param ptr Data to write.
+ * @param w Returned changed blocks. endDeltaWrite() must be called
+ * after the write if CL_TRUE is returned.
+ * @return CL_TRUE if the changed blocks have been computed, CL_FALSE if
+ * the buffer is not tracked, in which case the full data must be sent.
+ */
+cl_bool beginDeltaWrite(cl_mem mem, size_t offset, size_t cb, const void *ptr, deltaWrite *w);
+
+/** Finish a write started with beginDeltaWrite(), validating the new
+ * hashes if the write has succeeded and the buffer has not been
+ * invalidated meanwhile.
+ * @param mem Written buffer.
+ * @param offset Offset of the write in bytes.
+ * @param cb Size of the write in bytes.
+ * @param w Changed blocks, released by this method.
+ * @param flag Result of the write.
+ */
+void endDeltaWrite(cl_mem mem, size_t offset, size_t cb, deltaWrite *w, cl_int flag);
+
+/** Mirror the host memory of a CL_MEM_USE_HOST_PTR buffer, which is
+ * considered synchronized with the buffer data.
+ * @param mem Tracked buffer.
+ * @param host_ptr Host memory.
+ * @see validateDeltaHostPtr
+ */
+void addDeltaHostPtr(cl_mem mem, void *host_ptr);
+
+/** Get the mirrored host memory of a buffer.
+ * @param mem Buffer.
+ * @param size Returned buffer size. Can be NULL.
+ * @param stale Returned CL_TRUE if the buffer may have been written
+ * since the host memory was synchronized, CL_FALSE otherwise. Can be NULL.
+ * @return Host memory, NULL if the buffer is not mirrored.
+ */
+void* getDeltaHostPtr(cl_mem mem, size_t *size, cl_bool *stale);
+
+/** Set the mirrored host memory as synchronized with the buffer data,
+ * e.g. after reading the buffer into it.
+ * @param mem Mirrored buffer.
+ */
+void validateDeltaHostPtr(cl_mem mem);
+
+/** Test if the mirrored host memory has been modified since it was
+ * synchronized with the buffer data. The blocks are hashed just if the
+ * host memory has been mapped for writing since it was last unmapped.
+ * @param mem Mirrored buffer.
+ * @return CL_TRUE if any block has been modified, or can't be tested,
+ * CL_FALSE otherwise.
+ * @see mapDeltaHostPtr
+ */
+cl_bool isDeltaHostPtrDirty(cl_mem mem);
+
+/** Register a mapping of the mirrored host memory, which the application
+ * may modify until it is unmapped if it is mapped for writing.
+ * @param mem Mirrored buffer.
+ * @param write CL_TRUE if the memory is mapped for writing, CL_FALSE
+ * otherwise.
+ */
+void mapDeltaHostPtr(cl_mem mem, cl_bool write);
+
+/** Register that a mapping of the mirrored host memory has been unmapped,
+ * and its modifications pushed. Once all the mappings are unmapped the
+ * host memory is considered not modified.
+ * @param mem Mirrored buffer.
+ */
+void unmapDeltaHostPtr(cl_mem mem);
+
+/** Get the mirrored buffers set as arguments of a kernel.
+ * @param kernel Kernel.
+ * @param mems Returned buffers.
+ * @param max Maximum number of buffers to return.
+ * @return Number of buffers returned.
+ */
+cl_uint getDeltaKernelHostPtrs(cl_kernel kernel, cl_mem *mems, cl_uint max);
+
+#endif // DELTAUPLOAD_H_INCLUDED
@@ -0,0 +1,130 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DESCRIPTORCACHE_H_INCLUDED
+#define DESCRIPTORCACHE_H_INCLUDED
+
+#include <time.h>
+#include <CL/cl.h>
+
+/// Platforms of a server (no object nor parameter)
+#define OCLAND_CACHE_PLATFORMS     0u
+/// Platform information (object: platform, parameter: cl_platform_info)
+#define OCLAND_CACHE_PLATFORM_INFO 1u
+/// Devices of a platform (object: platform, parameter: cl_device_type)
+#define OCLAND_CACHE_DEVICES       2u
+/// Device information (object: device, parameter: cl_device_info)
+#define OCLAND_CACHE_DEVICE_INFO   3u
+
+/** @struct descriptor_st
+ * Answer of a server to a platforms/devices query, kept in the on-disk
+ * cache such that the next processes can enumerate the server without
+ * connecting to it.
+ */
+struct descriptor_st
+{
+    /// Server address
+    char *address;
+    /// Kind of query (OCLAND_CACHE_*)
+    unsigned int kind;
+    /// Queried object (platform or device handle of the server)
+    cl_ulong object;
+    /// Queried parameter
+    cl_ulong param;
+    /// Time when the answer was received
+    time_t time;
+    /// Size of the answer
+    size_t size;
+    /// Answer
+    void *value;
+    /// Next descriptor
+    struct descriptor_st *next;
+};
+
+/// descriptor_st structure abstraction
+typedef struct descriptor_st* descriptor;
+
+/** Load the descriptors cache file, discarding the expired entries. The
+ * file is given by the OCLAND_CACHE environment variable, an empty value
+ * disabling the cache, and defaults to ".ocland_cache" in the user home.
+ * The cache is saved back when the process exits.
+ */
+void loadDescriptors();
+
+/** Save the descriptors cache file, if it has been modified. The file is
+ * replaced at once, such that concurrent processes never read it partially
+ * written.
+ */
+void saveDescriptors();
+
+/** Store an answer of a server. Storing a platforms list different from
+ * the cached one discards all the descriptors of the server, whose handles
+ * are no longer valid (e.g. the server has been restarted).
+ * @param address Server address.
+ * @param kind Kind of query.
+ * @param object Queried object.
+ * @param param Queried parameter.
+ * @param value Answer.
+ * @param size Size of the answer.
+ */
+void storeDescriptor(const char *address,
+                     unsigned int kind,
+                     const void *object,
+                     cl_ulong param,
+                     const void *value,
+                     size_t size);
+
+/** Get a cached answer of a server.
+ * @param address Server address.
+ * @param kind Kind of query.
+ * @param object Queried object.
+ * @param param Queried parameter.
+ * @param size Returned size of the answer.
+ * @return Copy of the answer, which must be released with free(). NULL
+ * if it is not cached or it has expired.
+ */
+void *getDescriptor(const char *address,
+                    unsigned int kind,
+                    const void *object,
+                    cl_ulong param,
+                    size_t *size);
+
+/** Test if a platform or device has been listed by a server, either in
+ * its platforms list or in the devices list of any of its platforms.
+ * @param address Server address.
+ * @param object Platform or device.
+ * @return CL_TRUE if the object belongs to the server, CL_FALSE otherwise.
+ */
+cl_bool isDescriptorListed(const char *address, const void *object);
+
+/** Get the age of the descriptors of a server.
+ * @param address Server address.
+ * @return Seconds since the platforms list of the server was stored, -1
+ * if it is not cached or it has expired.
+ */
+long descriptorsAge(const char *address);
+
+/** Get the queries cached for a server, in order to refresh them.
+ * @param address Server address.
+ * @param keys Returned array of descriptors, whose address and value
+ * fields are not set. It must be released with free().
+ * @return Number of descriptors.
+ */
+unsigned int getDescriptorKeys(const char *address, struct descriptor_st **keys);
+
+#endif // DESCRIPTORCACHE_H_INCLUDED
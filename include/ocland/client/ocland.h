@@ -43,6 +43,9 @@ struct oclandServers_st
     int* sockets;
     /// Server status
     cl_bool *locked;
+    /// Servers known from the descriptors cache, whose connection is
+    /// deferred until their objects are used
+    cl_bool *deferred;
 };
 
 /** clGetPlatformIDs ocland abstraction method.
@@ -375,6 +378,34 @@ cl_int oclandEnqueueCopyBuffer(cl_command_queue     command_queue ,
                                const cl_event *     event_wait_list ,
                                cl_event *           event);
 
+/** Copy a buffer region into a buffer of another server. The source
+ * server sends the data straight to the destination one, such that the
+ * client just coordinates the transfer. If the destination server is
+ * not reachable from the source one the data is relayed by the client.
+ * @param src_command_queue Command queue of the source server.
+ * @param src_buffer Source buffer.
+ * @param dst_command_queue Command queue of the destination server.
+ * @param dst_buffer Destination buffer.
+ * @param src_offset Offset of the region in the source buffer.
+ * @param dst_offset Offset of the region in the destination buffer.
+ * @param cb Size of the region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events of the source server to wait for.
+ * @param event Returned event of the destination server. Can be NULL.
+ * @return CL_SUCCESS if the copy has been enqueued, an error code
+ * otherwise.
+ */
+cl_int oclandEnqueueCopyBufferToPeer(cl_command_queue     src_command_queue ,
+                                     cl_mem               src_buffer ,
+                                     cl_command_queue     dst_command_queue ,
+                                     cl_mem               dst_buffer ,
+                                     size_t               src_offset ,
+                                     size_t               dst_offset ,
+                                     size_t               cb ,
+                                     cl_uint              num_events_in_wait_list ,
+                                     const cl_event *     event_wait_list ,
+                                     cl_event *           event);
+
 /** clEnqueueReadImage ocland abstraction method.
  * @param element_size Size of each element.
  */
@@ -443,6 +474,51 @@ cl_int oclandEnqueueCopyBufferToImage(cl_command_queue  command_queue ,
                                       const cl_event *  event_wait_list ,
                                       cl_event *        event);
 
+/** clEnqueueMapBuffer ocland abstraction method. The buffer is mapped in
+ * a client shadow region, fetched from the server unless it is mapped
+ * with the CL_MAP_WRITE_INVALIDATE_REGION flag.
+ */
+void* oclandEnqueueMapBuffer(cl_command_queue  command_queue ,
+                             cl_mem            buffer ,
+                             cl_bool           blocking_map ,
+                             cl_map_flags      map_flags ,
+                             size_t            offset ,
+                             size_t            cb ,
+                             cl_uint           num_events_in_wait_list ,
+                             const cl_event *  event_wait_list ,
+                             cl_event *        event ,
+                             cl_int *          errcode_ret);
+
+/** clEnqueueMapImage ocland abstraction method. The image region is
+ * mapped packed in a client shadow region, fetched from the server unless
+ * it is mapped with the CL_MAP_WRITE_INVALIDATE_REGION flag.
+ * @param element_size Size of each element.
+ */
+void* oclandEnqueueMapImage(cl_command_queue   command_queue ,
+                            cl_mem             image ,
+                            cl_bool            blocking_map ,
+                            cl_map_flags       map_flags ,
+                            const size_t *     origin ,
+                            const size_t *     region ,
+                            size_t *           image_row_pitch ,
+                            size_t *           image_slice_pitch ,
+                            size_t             element_size ,
+                            cl_uint            num_events_in_wait_list ,
+                            const cl_event *   event_wait_list ,
+                            cl_event *         event ,
+                            cl_int *           errcode_ret);
+
+/** clEnqueueUnmapMemObject ocland abstraction method. Just the pages of
+ * the shadow region written by the application are sent back to the
+ * server, in a blocking way.
+ */
+cl_int oclandEnqueueUnmapMemObject(cl_command_queue  command_queue ,
+                                   cl_mem            memobj ,
+                                   void *            mapped_ptr ,
+                                   cl_uint           num_events_in_wait_list ,
+                                   const cl_event *  event_wait_list ,
+                                   cl_event *        event);
+
 /** clEnqueueNDRangeKernel ocland abstraction method.
  */
 cl_int oclandEnqueueNDRangeKernel(cl_command_queue  command_queue ,
@@ -0,0 +1,155 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCLAND_EXT_H_INCLUDED
+#define OCLAND_EXT_H_INCLUDED
+
+#include <CL/cl.h>
+
+/// Direct transfers between ocland servers extension
+#define cl_ocland_peer_transfer 1
+
+/** Copy a buffer region into a buffer of another ocland server. The
+ * source server sends the data straight to the destination one, so the
+ * data does not pass through the client, which just coordinates the
+ * transfer (unless the servers can't reach each other, where the data is
+ * relayed by the client). Get the function with
+ * clGetExtensionFunctionAddressForPlatform(platform,
+ * "clEnqueueCopyBufferToPeerOCLAND").
+ * @param src_command_queue Command queue of the source server.
+ * @param src_buffer Source buffer.
+ * @param dst_command_queue Command queue of the destination server.
+ * @param dst_buffer Destination buffer.
+ * @param src_offset Offset of the region in the source buffer.
+ * @param dst_offset Offset of the region in the destination buffer.
+ * @param cb Size of the region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for, which must belong to the
+ * source server.
+ * @param event Returned event, which belongs to the destination server.
+ * It is completed when the data has been written. Can be NULL.
+ * @return CL_SUCCESS if the copy has been enqueued, an error code
+ * otherwise.
+ */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueCopyBufferToPeerOCLAND_fn)(
+    cl_command_queue     src_command_queue ,
+    cl_mem               src_buffer ,
+    cl_command_queue     dst_command_queue ,
+    cl_mem               dst_buffer ,
+    size_t               src_offset ,
+    size_t               dst_offset ,
+    size_t               cb ,
+    cl_uint              num_events_in_wait_list ,
+    const cl_event *     event_wait_list ,
+    cl_event *           event);
+
+/// Kernels split between several devices extension
+#define cl_ocland_split_device 1
+
+/** Declare the part of a buffer argument written by each slice of the
+ * kernels enqueued in the split device of the cluster platform, which
+ * splits the outermost dimension between all the context devices. The
+ * work items [a, b) of the outermost dimension must just write the bytes
+ * [a*partition_size, b*partition_size) of the buffer, which is assembled
+ * from the slices computed by each device afterwards. The buffers
+ * without partition are just read by split kernels. Get the function with
+ * clGetExtensionFunctionAddressForPlatform(platform,
+ * "clSetKernelArgPartitionOCLAND").
+ * @param kernel Kernel of a cluster context.
+ * @param arg_index Buffer argument index.
+ * @param partition_size Bytes written per work item along the outermost
+ * dimension, 0 to remove the partition.
+ * @return CL_SUCCESS if the partition is set, an error code otherwise.
+ */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clSetKernelArgPartitionOCLAND_fn)(
+    cl_kernel            kernel ,
+    cl_uint              arg_index ,
+    size_t               partition_size);
+
+/// Partitioned transfers between the host and several servers extension
+#define cl_ocland_scatter_gather 1
+
+/** Write the partitions of a host array into several buffers, which can
+ * be placed in different servers. The partitions are transferred in
+ * parallel, each one along its own data channel, and the function
+ * returns once all of them have been written. Get the function with
+ * clGetExtensionFunctionAddressForPlatform(platform,
+ * "clEnqueueScatterBufferOCLAND").
+ * @param num_partitions Number of partitions.
+ * @param command_queues Command queue of each partition.
+ * @param buffers Destination buffer of each partition.
+ * @param buffer_offsets Offset of each partition in its buffer. Can be
+ * NULL, where all the offsets are 0.
+ * @param host_offsets Offset of each partition in the host array.
+ * @param sizes Size of each partition.
+ * @param ptr Host array.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for, which can belong to any
+ * server.
+ * @param event Returned event, which belongs to the first command queue.
+ * Can be NULL.
+ * @return CL_SUCCESS if all the partitions have been written, an error
+ * code otherwise.
+ */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueScatterBufferOCLAND_fn)(
+    cl_uint                  num_partitions ,
+    const cl_command_queue * command_queues ,
+    const cl_mem *           buffers ,
+    const size_t *           buffer_offsets ,
+    const size_t *           host_offsets ,
+    const size_t *           sizes ,
+    const void *             ptr ,
+    cl_uint                  num_events_in_wait_list ,
+    const cl_event *         event_wait_list ,
+    cl_event *               event);
+
+/** Read the partitions of a host array from several buffers, which can
+ * be placed in different servers. The partitions are transferred in
+ * parallel, each one along its own data channel, and the function
+ * returns once all of them have been read. Get the function with
+ * clGetExtensionFunctionAddressForPlatform(platform,
+ * "clEnqueueGatherBufferOCLAND").
+ * @param num_partitions Number of partitions.
+ * @param command_queues Command queue of each partition.
+ * @param buffers Source buffer of each partition.
+ * @param buffer_offsets Offset of each partition in its buffer. Can be
+ * NULL, where all the offsets are 0.
+ * @param host_offsets Offset of each partition in the host array.
+ * @param sizes Size of each partition.
+ * @param ptr Host array.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for, which can belong to any
+ * server.
+ * @param event Returned event, which belongs to the first command queue.
+ * Can be NULL.
+ * @return CL_SUCCESS if all the partitions have been read, an error code
+ * otherwise.
+ */
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clEnqueueGatherBufferOCLAND_fn)(
+    cl_uint                  num_partitions ,
+    const cl_command_queue * command_queues ,
+    const cl_mem *           buffers ,
+    const size_t *           buffer_offsets ,
+    const size_t *           host_offsets ,
+    const size_t *           sizes ,
+    void *                   ptr ,
+    cl_uint                  num_events_in_wait_list ,
+    const cl_event *         event_wait_list ,
+    cl_event *               event);
+
+#endif // OCLAND_EXT_H_INCLUDED
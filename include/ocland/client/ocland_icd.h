@@ -17,6 +17,7 @@
  */
 
 #include <CL/opencl.h>
+#include <ocland/client/cluster.h>
 
 struct _cl_icd_dispatch;
 struct _cl_platform_id {
@@ -42,6 +43,8 @@ struct _cl_context
     cl_context ptr;
     /// Reference count to control when the object must be destroyed
     cl_uint rcount;
+    /// Cluster context, NULL if the context is placed in a single server
+    clusterContext cluster;
 };
 struct _cl_command_queue
 {
@@ -51,6 +54,10 @@ struct _cl_command_queue
     cl_command_queue ptr;
     /// Reference count to control when the object must be destroyed
     cl_uint rcount;
+    /// Server of the cluster context where the queue is placed
+    cl_uint server;
+    /// Split device command queues, NULL for the rest of command queues
+    clusterSplit split;
 };
 struct _cl_mem
 {
@@ -64,6 +71,8 @@ struct _cl_mem
     size_t element_size;
     /// Reference count to control when the object must be destroyed
     cl_uint rcount;
+    /// Cluster buffer, NULL if the object is placed in a single server
+    clusterMem cluster;
 };
 struct _cl_sampler
 {
@@ -82,6 +91,8 @@ struct _cl_program
     cl_program ptr;
     /// Reference count to control when the object must be destroyed
     cl_uint rcount;
+    /// Cluster program, NULL if the program is placed in a single server
+    clusterProgram cluster;
 };
 struct _cl_kernel
 {
@@ -91,6 +102,8 @@ struct _cl_kernel
     cl_kernel ptr;
     /// Reference count to control when the object must be destroyed
     cl_uint rcount;
+    /// Cluster kernel, NULL if the kernel is placed in a single server
+    clusterKernel cluster;
 };
 struct _cl_event
 {
@@ -0,0 +1,74 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PENDINGTRANSFERS_H_INCLUDED
+#define PENDINGTRANSFERS_H_INCLUDED
+
+#include <CL/cl.h>
+
+/** @struct pendingTransfer_st
+ * Asynchronous data transfer carried out by a client thread, which may
+ * still be in progress when the server reports its command as completed.
+ */
+struct pendingTransfer_st
+{
+    /// Command queue where the transfer was enqueued
+    cl_command_queue command_queue;
+    /// Event of the transfer, NULL if it was not requested
+    cl_event event;
+    /// Next pending transfer
+    struct pendingTransfer_st *next;
+};
+
+/// pendingTransfer_st structure abstraction
+typedef struct pendingTransfer_st* pendingTransfer;
+
+/** Register an asynchronous transfer, before launching the thread which
+ * carries it out.
+ * @param command_queue Command queue.
+ * @param event Transfer event. Can be NULL.
+ * @return Registered transfer, NULL if it can't be tracked.
+ */
+pendingTransfer addPendingTransfer(cl_command_queue command_queue, cl_event event);
+
+/** Mark a transfer as finished, i.e. its data is already in the client
+ * memory (reads) or has been sent (writes), waking up the threads waiting
+ * for it.
+ * @param transfer Registered transfer, released by this method. NULL
+ * transfers are ignored.
+ */
+void endPendingTransfer(pendingTransfer transfer);
+
+/** Wait until all the transfers enqueued in a command queue are finished.
+ * @param command_queue Command queue.
+ */
+void waitQueueTransfers(cl_command_queue command_queue);
+
+/** Wait until the transfers of several events are finished.
+ * @param num_events Number of events.
+ * @param event_list Events.
+ */
+void waitEventsTransfers(cl_uint num_events, const cl_event *event_list);
+
+/** Test if the transfer of an event is still in progress.
+ * @param event Event.
+ * @return CL_TRUE if the transfer is in progress, CL_FALSE otherwise.
+ */
+cl_bool isTransferPending(cl_event event);
+
+#endif // PENDINGTRANSFERS_H_INCLUDED
@@ -0,0 +1,112 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHADOWMAP_H_INCLUDED
+#define SHADOWMAP_H_INCLUDED
+
+#include <stdlib.h>
+
+#include <CL/cl.h>
+
+/** @struct shadowMap_st
+ * Client memory region where a memory object is mapped. The region is
+ * fetched from the server when mapped for reading, and the modified
+ * pages are sent back when unmapped.
+ */
+struct shadowMap_st
+{
+    /// Mapped memory object
+    cl_mem mem;
+    /// Mapping flags
+    cl_map_flags flags;
+    /// Offset of the mapped buffer region
+    size_t offset;
+    /// Origin of the mapped image region
+    size_t origin[3];
+    /// Mapped image region
+    size_t region[3];
+    /// Row pitch of the mapped image region
+    size_t row_pitch;
+    /// Slice pitch of the mapped image region
+    size_t slice_pitch;
+    /// Image element size, 0 for buffers
+    size_t element_size;
+    /// Shadow region, returned to the application
+    void *ptr;
+    /// Size of the mapped data
+    size_t size;
+    /// Size of the allocated region (a multiple of the page size)
+    size_t alloc;
+    /// Flag for each page written since the write tracking was started
+    unsigned char *dirty;
+    /// 1 if the writes are being tracked, 0 otherwise
+    volatile int tracked;
+};
+
+/// shadowMap_st structure abstraction
+typedef struct shadowMap_st* shadowMap;
+
+/** Create a shadow region, reusing one of the previously released ones
+ * if possible.
+ * @param mem Memory object to map.
+ * @param flags Mapping flags.
+ * @param size Size of the mapped data.
+ * @return Shadow region, NULL if the memory can't be allocated.
+ */
+shadowMap addShadowMap(cl_mem mem, cl_map_flags flags, size_t size);
+
+/** Get the shadow region of a mapped pointer.
+ * @param mem Mapped memory object.
+ * @param ptr Mapped pointer.
+ * @return Shadow region, NULL if the pointer is not mapped.
+ */
+shadowMap getShadowMap(cl_mem mem, void *ptr);
+
+/** Test if the pages written by the application are tracked, which must
+ * be requested setting the OCLAND_MAP_TRACKING environment variable to 1.
+ * @return CL_TRUE if the writes are tracked, CL_FALSE if the whole
+ * regions mapped for writing are considered written.
+ */
+cl_bool isShadowMapTracking();
+
+/** Start tracking the pages written by the application, protecting the
+ * region against writes. If the tracking can't be carried out (or it has
+ * not been requested with the OCLAND_MAP_TRACKING environment variable)
+ * all the pages are considered written.
+ * @param map Shadow region, already fetched from the server.
+ * @note The system calls writing in a tracked region (e.g. read()) will
+ * fail with EFAULT, so the tracking must be disabled if the application
+ * uses them.
+ */
+void trackShadowMap(shadowMap map);
+
+/** Test if some data of the shadow region has been written.
+ * @param map Shadow region.
+ * @param offset Offset of the data.
+ * @param size Size of the data.
+ * @return CL_TRUE if any page of the data has been written, CL_FALSE
+ * otherwise.
+ */
+cl_bool isShadowMapDirty(shadowMap map, size_t offset, size_t size);
+
+/** Release a shadow region.
+ * @param map Shadow region.
+ */
+void delShadowMap(shadowMap map);
+
+#endif // SHADOWMAP_H_INCLUDED
@@ -0,0 +1,95 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATACOMPRESSION_H_INCLUDED
+#define DATACOMPRESSION_H_INCLUDED
+
+#include <sys/types.h>
+
+/// Raw data transfer
+#define OCLAND_COMPRESSION_NONE    0u
+/// LZ77 fast compression of the data blocks
+#define OCLAND_COMPRESSION_LZ      1u
+/// Byte shuffle pre-filter, useful for 32 bits data (floats, integers...)
+#define OCLAND_COMPRESSION_SHUFFLE 2u
+
+/** @struct _oclandStream Compression status of a data transfer channel.
+ * The data is sent in blocks, each one being compressed only if the
+ * compression of a sample of the block pays off.
+ */
+typedef struct _oclandStream* oclandStream;
+
+/** Compression modes supported by this side of the connection. They can
+ * be disabled at run time setting the OCLAND_COMPRESSION environment
+ * variable to 0.
+ * @return Combination of OCLAND_COMPRESSION_* flags.
+ */
+unsigned int CompressionModes();
+
+/** Negotiate the compression modes with the server, just after
+ * connecting a data transfer channel. Both sides of the channel must
+ * negotiate before starting the transfer.
+ * @param socket Specifies the socket file descriptor.
+ * @return Compression modes accepted by both sides.
+ * @see AcceptCompression
+ */
+unsigned int ConnectCompression(int *socket);
+
+/** Negotiate the compression modes with the client, just after
+ * accepting a data transfer channel connection.
+ * @param socket Specifies the socket file descriptor.
+ * @return Compression modes accepted by both sides.
+ * @see ConnectCompression
+ */
+unsigned int AcceptCompression(int *socket);
+
+/** Create a compression stream.
+ * @param modes Negotiated compression modes.
+ * @return Compression stream. NULL if the memory can't be allocated,
+ * or modes is OCLAND_COMPRESSION_NONE, in which case the data will be
+ * transfered raw.
+ */
+oclandStream CreateStream(unsigned int modes);
+
+/** Release a compression stream.
+ * @param stream Compression stream. Can be NULL.
+ */
+void ReleaseStream(oclandStream stream);
+
+/** Send data along a compression stream. Large data can be sent in
+ * several calls, whose sizes must not match the ones of RecvStream().
+ * @param socket Specifies the socket file descriptor.
+ * @param stream Compression stream. If NULL raw data is sent.
+ * @param buffer Points to the buffer containing the data to send.
+ * @param length Specifies the length of the data in bytes.
+ * @return Upon successful completion, SendStream() shall return length.
+ * Otherwise, a value lower or equal to 0 shall be returned.
+ */
+ssize_t SendStream(int *socket, oclandStream stream, const void *buffer, size_t length);
+
+/** Receive data from a compression stream.
+ * @param socket Specifies the socket file descriptor.
+ * @param stream Compression stream. If NULL raw data is received.
+ * @param buffer Points to a buffer where the data should be stored.
+ * @param length Specifies the length of the data in bytes.
+ * @return Upon successful completion, RecvStream() shall return length.
+ * Otherwise, a value lower or equal to 0 shall be returned.
+ */
+ssize_t RecvStream(int *socket, oclandStream stream, void *buffer, size_t length);
+
+#endif // DATACOMPRESSION_H_INCLUDED
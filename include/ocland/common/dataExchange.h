@@ -19,6 +19,9 @@
 #ifndef DATAEXCHANGE_H_INCLUDED
 #define DATAEXCHANGE_H_INCLUDED
 
+#include <sys/types.h>
+#include <sys/uio.h>
+
 /** Returns the last socket error detected
  * @return Error detected.
  */
@@ -49,4 +52,51 @@ ssize_t Recv(int *socket, void *buffer, size_t length, int flags);
  */
 ssize_t Send(int *socket, const void *buffer, size_t length, int flags);
 
+/** Gathered send. The buffers are sent in order, as a single message,
+ * without copying them into a contiguous memory.
+ * @param socket Specifies the socket file descriptor.
+ * @param iov Array of buffers to send. It is modified during the
+ * transmission.
+ * @param iovcnt Number of buffers. It can exceed IOV_MAX, in which case
+ * several system calls are performed.
+ * @return Upon successful completion, SendV() shall return the number of bytes sent.
+ * Otherwise, -1 shall be returned and errno set to indicate the error.
+ */
+ssize_t SendV(int *socket, struct iovec *iov, int iovcnt);
+
+/** Enable the zero-copy transmission (MSG_ZEROCOPY) in a socket.
+ * @param socket Specifies the socket file descriptor.
+ * @return 1 if SendZeroCopy() will avoid copying the data, 0 if it is
+ * not supported, in which case SendZeroCopy() works as a regular send.
+ */
+int EnableZeroCopy(int *socket);
+
+/** Test if the zero-copy transmission has been enabled in a socket.
+ * @param socket Specifies the socket file descriptor.
+ * @return 1 if SendZeroCopy() will avoid copying the data, 0 otherwise.
+ */
+int IsZeroCopyEnabled(int *socket);
+
+/** Send data without copying it into the kernel. The buffer can't be
+ * modified or released until WaitZeroCopy() reports its completion.
+ * @param socket Specifies the socket file descriptor.
+ * @param buffer Points to the buffer containing the message to send.
+ * @param length Specifies the length of the message in bytes.
+ * @param calls Counter of zero-copy calls performed on the socket,
+ * increased for each call that will report a completion.
+ * @return Upon successful completion, SendZeroCopy() shall return the number of bytes
+ * sent. Otherwise, -1 shall be returned and errno set to indicate the error.
+ */
+ssize_t SendZeroCopy(int *socket, const void *buffer, size_t length, unsigned int *calls);
+
+/** Wait until the zero-copy calls performed on a socket are completed,
+ * such that the sent buffers can be reused.
+ * @param socket Specifies the socket file descriptor.
+ * @param completed Counter of zero-copy calls already completed, it
+ * will be updated.
+ * @param calls Number of calls to wait for (SendZeroCopy() counter).
+ * @return 0 if the calls are completed, -1 if the socket failed.
+ */
+int WaitZeroCopy(int *socket, unsigned int *completed, unsigned int calls);
+
 #endif // DATAEXCHANGE_H_INCLUDED
@@ -0,0 +1,72 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATASHARED_H_INCLUDED
+#define DATASHARED_H_INCLUDED
+
+#include <sys/types.h>
+
+/** Test if a socket is connected with a peer in the same host, i.e. it
+ * is an Unix domain socket, such that the data can be exchanged
+ * through shared memory.
+ * @param socket Socket to test.
+ * @return 1 if the socket is local, 0 otherwise.
+ */
+int IsLocalSocket(int *socket);
+
+/** Create an anonymous shared memory region, backed by a memory file
+ * whose size is sealed (F_SEAL_SHRINK and F_SEAL_GROW), and map it.
+ * @param cb Size of the region in bytes.
+ * @param ptr Returned mapped memory.
+ * @return Memory file descriptor, -1 if the region can't be created.
+ */
+int CreateSharedRegion(size_t cb, void **ptr);
+
+/** Map a shared memory region received from the peer. The region size
+ * must be sealed, such that the peer can't truncate it while it is mapped.
+ * @param fd Memory file descriptor.
+ * @param cb Size of the region in bytes.
+ * @return Mapped memory, NULL if the region can't be mapped, it is not
+ * sealed, or it is smaller than cb.
+ */
+void* MapSharedRegion(int fd, size_t cb);
+
+/** Unmap and close a shared memory region.
+ * @param fd Memory file descriptor.
+ * @param ptr Mapped memory. Can be NULL.
+ * @param cb Size of the region in bytes.
+ */
+void ReleaseSharedRegion(int fd, void *ptr, size_t cb);
+
+/** Pass a shared memory region to the peer, as an ancillary
+ * SCM_RIGHTS message of a local socket.
+ * @param socket Local socket.
+ * @param fd Memory file descriptor.
+ * @param cb Size of the region in bytes.
+ * @return 0 if the region is sent, -1 otherwise.
+ */
+int SendSharedRegion(int *socket, int fd, size_t cb);
+
+/** Receive a shared memory region passed by the peer.
+ * @param socket Local socket.
+ * @param cb Returned size of the region in bytes.
+ * @return Memory file descriptor, -1 if the region can't be received.
+ */
+int RecvSharedRegion(int *socket, size_t *cb);
+
+#endif // DATASHARED_H_INCLUDED
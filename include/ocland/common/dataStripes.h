@@ -0,0 +1,86 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATASTRIPES_H_INCLUDED
+#define DATASTRIPES_H_INCLUDED
+
+#include <sys/types.h>
+
+/** Number of parallel connections (streams) to be used in an asynchronous
+ * transfer. It can be forced with the OCLAND_STREAMS environment variable,
+ * otherwise it is tuned from the throughput measured in the previous
+ * transfers, up to OCLAND_MAX_STREAMS streams. Each stream will transfer
+ * at least OCLAND_STRIPE_MIN_SIZE bytes.
+ * @param cb Size of the transfer in bytes.
+ * @return Number of streams to request.
+ * @see StripeReport
+ */
+unsigned int StripeStreams(size_t cb);
+
+/** Report the throughput of a transfer, used to tune the number of
+ * streams of the next ones.
+ * @param streams Number of streams used.
+ * @param cb Size of the transfer in bytes.
+ * @param seconds Duration of the transfer.
+ */
+void StripeReport(unsigned int streams, size_t cb, double seconds);
+
+/** Negotiate the number of streams with the server, just after connecting
+ * the first stream of a transfer. The rest of streams must be connected
+ * to the same port afterwards.
+ * @param socket First stream socket.
+ * @param streams Requested number of streams, 0 to ask for exchanging the
+ * data through a shared memory region instead.
+ * @return Number of streams accepted by the server, 0 if the shared
+ * memory region has been accepted.
+ * @see AcceptStripes
+ */
+unsigned int ConnectStripes(int *socket, unsigned int streams);
+
+/** Negotiate the number of streams with the client, just after accepting
+ * the first stream of a transfer.
+ * @param socket First stream socket.
+ * @param shared 1 if the data can be exchanged through a shared memory
+ * region, 0 otherwise.
+ * @return Number of streams accepted, up to OCLAND_MAX_STREAMS, 0 if the
+ * data will be exchanged through a shared memory region.
+ * @see ConnectStripes
+ */
+unsigned int AcceptStripes(int *socket, int shared);
+
+/** Get the slice of the data transfered by a stream.
+ * @param cb Size of the transfer in bytes.
+ * @param streams Number of streams.
+ * @param index Stream index.
+ * @param offset Returned offset of the slice.
+ * @param size Returned size of the slice.
+ */
+void StripeSlice(size_t cb, unsigned int streams, unsigned int index, size_t *offset, size_t *size);
+
+/** Bind a stream socket, before connecting it, to one of the local
+ * addresses listed (comma separated) in the OCLAND_STREAM_ADDRESSES
+ * environment variable, such that the streams are spread along several
+ * network interfaces.
+ * @param socket Socket to bind.
+ * @param index Stream index.
+ * @return 0 if the socket has been binded, or no addresses are listed,
+ * -1 otherwise.
+ */
+int BindStripe(int *socket, unsigned int index);
+
+#endif // DATASTRIPES_H_INCLUDED
@@ -0,0 +1,35 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHA256_H_INCLUDED
+#define SHA256_H_INCLUDED
+
+#include <stdlib.h>
+
+/// Size in bytes of a SHA-256 digest
+#define SHA256_DIGEST_SIZE 32u
+
+/** Compute the SHA-256 digest of some data, used to identify contents
+ * which have been already transfered.
+ * @param data Data to hash.
+ * @param size Size of the data in bytes.
+ * @param digest Returned digest, of SHA256_DIGEST_SIZE bytes.
+ */
+void SHA256(const void *data, size_t size, unsigned char *digest);
+
+#endif // SHA256_H_INCLUDED
@@ -29,11 +29,13 @@
 void *client_thread(void *socket);
 
 /** Read command received and process it. Some commands
- * requires several data exchanges.
+ * requires several data exchanges. The package is received without
+ * blocking, keeping the partially received ones in the validator until
+ * they are complete.
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
- * @return 0 if message can't be dispatched, 1 otherwise.
+ * @return 0 if message can't be dispatched yet, 1 otherwise.
  */
 int dispatch(int* clientfd, char* buffer, validator v);
 
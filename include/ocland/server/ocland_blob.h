@@ -0,0 +1,98 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCLAND_BLOB_H_INCLUDED
+#define OCLAND_BLOB_H_INCLUDED
+
+#include <CL/cl.h>
+#include <CL/cl_ext.h>
+
+#include <ocland/common/sha256.h>
+
+/// The blob is in the cache, ready to be used
+#define OCLAND_BLOB_HIT       0u
+/// The blob is not in the cache, and should be sent by the client
+#define OCLAND_BLOB_MISS      1u
+/// The blob can't be cached, and should be sent by the usual commands
+#define OCLAND_BLOB_UNCACHED  2u
+
+/** @struct _ocland_blob
+ * Data uploaded by the clients, identified by its content hash, such that
+ * it can be reused by later uploads of the same data, even from other
+ * clients. The blobs are stored in a cache of OCLAND_BLOB_CACHE_SIZE
+ * bytes, where the least recently used ones are dropped first.
+ */
+struct _ocland_blob
+{
+    /// SHA-256 digest of the data
+    unsigned char hash[SHA256_DIGEST_SIZE];
+    /// Size of the data
+    size_t size;
+    /// Data
+    void *data;
+    /// Number of users of the blob
+    unsigned int refs;
+    /// Flag to know if the blob is stored in the cache
+    cl_bool cached;
+    /// Last use time stamp
+    unsigned long last_use;
+    /// Next blob in the cache
+    struct _ocland_blob *next;
+};
+
+/** @typedef ocland_blob
+ * Pointer abstraction of _ocland_blob structure.
+ */
+typedef struct _ocland_blob* ocland_blob;
+
+/** Look for a blob in the cache.
+ * @param hash SHA-256 digest of the data.
+ * @param size Size of the data.
+ * @return The blob, which must be released with releaseBlob(). NULL if
+ * the blob is not in the cache.
+ */
+ocland_blob getBlob(const unsigned char *hash, size_t size);
+
+/** Test if a blob can be stored in the cache.
+ * @param size Size of the data.
+ * @return CL_TRUE if the cache is enabled and large enough, and the data
+ * does not exceed OCLAND_MAX_MESSAGE_SIZE, CL_FALSE otherwise.
+ */
+cl_bool isBlobCacheable(size_t size);
+
+/** Receive a blob from a socket, verifying its hash and storing it
+ * in the cache. If the same blob has been stored meanwhile, the cached
+ * one is returned instead.
+ * @param fd Socket where the data will be received.
+ * @param hash Expected SHA-256 digest of the data.
+ * @param size Size of the data.
+ * @param blob Returned blob, which must be released with releaseBlob().
+ * @return CL_SUCCESS if the blob has been received, CL_OUT_OF_HOST_MEMORY
+ * if the memory can't be allocated, CL_INVALID_VALUE if the data doesn't
+ * match the hash or it is not cacheable, or CL_OUT_OF_RESOURCES if the connection has been lost.
+ * All the data is consumed from the socket even if an error is detected.
+ */
+cl_int recvBlob(int *fd, const unsigned char *hash, size_t size, ocland_blob *blob);
+
+/** Release a blob, which will be destroyed if it has been dropped from
+ * the cache and nobody else is using it.
+ * @param blob Blob to release.
+ */
+void releaseBlob(ocland_blob blob);
+
+#endif // OCLAND_BLOB_H_INCLUDED
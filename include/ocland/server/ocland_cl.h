@@ -19,6 +19,7 @@
 #include <ocland/server/validator.h>
 #include <ocland/server/ocland_event.h>
 #include <ocland/server/ocland_mem.h>
+#include <ocland/server/ocland_blob.h>
 #include <ocland/server/ocland_version.h>
 
 #ifndef OCLAND_CL_H_INCLUDED
@@ -583,25 +584,28 @@ int ocland_clSetUserEventStatus(int* clientfd, char* buffer, validator v, void*
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
+ * @param data Data received by the client.
  * @return 0 if message can't be dispatched, 1 otherwise.
  */
-int ocland_clEnqueueReadBufferRect(int* clientfd, char* buffer, validator v);
+int ocland_clEnqueueReadBufferRect(int* clientfd, char* buffer, validator v, void* data);
 
 /** clEnqueueWriteBufferRect ocland abstraction.
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
+ * @param data Data received by the client.
  * @return 0 if message can't be dispatched, 1 otherwise.
  */
-int ocland_clEnqueueWriteBufferRect(int* clientfd, char* buffer, validator v);
+int ocland_clEnqueueWriteBufferRect(int* clientfd, char* buffer, validator v, void* data);
 
 /** clEnqueueCopyBufferRect ocland abstraction.
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
+ * @param data Data received by the client.
  * @return 0 if message can't be dispatched, 1 otherwise.
  */
-int ocland_clEnqueueCopyBufferRect(int* clientfd, char* buffer, validator v);
+int ocland_clEnqueueCopyBufferRect(int* clientfd, char* buffer, validator v, void* data);
 
 // ----------------------------------
 // OpenCL 1.2
@@ -684,17 +688,19 @@ int ocland_clGetKernelArgInfo(int* clientfd, char* buffer, validator v, void* da
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
+ * @param data Data received by the client.
  * @return 0 if message can't be dispatched, 1 otherwise.
  */
-int ocland_clEnqueueFillBuffer(int* clientfd, char* buffer, validator v);
+int ocland_clEnqueueFillBuffer(int* clientfd, char* buffer, validator v, void* data);
 
 /** clEnqueueFillImage ocland abstraction.
  * @param clientfd Client connection socket.
  * @param buffer Buffer to exchange data.
  * @param v Validator.
+ * @param data Data received by the client.
  * @return 0 if message can't be dispatched, 1 otherwise.
  */
-int ocland_clEnqueueFillImage(int* clientfd, char* buffer, validator v);
+int ocland_clEnqueueFillImage(int* clientfd, char* buffer, validator v, void* data);
 
 /** clEnqueueMigrateMemObjects ocland abstraction.
  * @param clientfd Client connection socket.
@@ -720,4 +726,52 @@ int ocland_clEnqueueMarkerWithWaitList(int* clientfd, char* buffer, validator v)
  */
 int ocland_clEnqueueBarrierWithWaitList(int* clientfd, char* buffer, validator v);
 
+// ----------------------------------
+// ocland extensions
+// ----------------------------------
+/** Blocking clEnqueueWriteBuffer of a set of blocks of the same buffer,
+ * used by the client to upload just the blocks which have changed
+ * since the last write. The blocks data can exceed
+ * OCLAND_MAX_MESSAGE_SIZE, in which case it is streamed.
+ * @param clientfd Client connection socket.
+ * @param buffer Buffer to exchange data.
+ * @param v Validator.
+ * @param data Data received by the client.
+ * @return 0 if message can't be dispatched, 1 otherwise.
+ */
+int ocland_clEnqueueWriteBufferBlocks(int* clientfd, char* buffer, validator v, void* data);
+
+/** clCreateBuffer ocland abstraction for CL_MEM_COPY_HOST_PTR buffers,
+ * where just the hash of the host data is received. The data is taken
+ * from the server cache if it is available, or requested to the client
+ * otherwise.
+ * @param clientfd Client connection socket.
+ * @param buffer Buffer to exchange data.
+ * @param v Validator.
+ * @param data Data received by the client.
+ * @return 0 if message can't be dispatched, 1 otherwise.
+ */
+int ocland_clCreateBufferBlob(int* clientfd, char* buffer, validator v, void* data);
+
+/** Blocking clEnqueueWriteBuffer ocland abstraction, where just the hash
+ * of the data is received. The data is taken from the server cache if it
+ * is available, or requested to the client otherwise.
+ * @param clientfd Client connection socket.
+ * @param buffer Buffer to exchange data.
+ * @param v Validator.
+ * @param data Data received by the client.
+ * @return 0 if message can't be dispatched, 1 otherwise.
+ */
+int ocland_clEnqueueWriteBufferBlob(int* clientfd, char* buffer, validator v, void* data);
+
+/** Send a buffer region straight to another ocland server, where the
+ * client has already requested a non-blocking clEnqueueWriteBuffer.
+ * @param clientfd Client connection socket.
+ * @param buffer Buffer to exchange data.
+ * @param v Validator.
+ * @param data Data received by the client.
+ * @return 0 if message can't be dispatched, 1 otherwise.
+ */
+int ocland_clEnqueueCopyBufferToPeer(int* clientfd, char* buffer, validator v, void* data);
+
 #endif // OCLAND_CL_H_INCLUDED
@@ -37,7 +37,9 @@ struct _ocland_event
     cl_event event;
     /** ocland status, if you want to wait
      * for this event, you may look for
-     * this variable turns into CL_COMPLETE
+     * this variable turns into CL_COMPLETE,
+     * or a negative error code if the
+     * ocland work has failed
      */
     cl_int status;
     /// OpenCL associated to this context.
@@ -60,7 +62,8 @@ typedef struct _ocland_event* ocland_event;
  * @param num_events Number of events inside event_list.
  * @param event_list List of events to wait.
  * @return CL_SUCCESS if the function was executed
- * successfully. CL_INVALID_VALUE if num_events
+ * successfully. CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST if
+ * the ocland work of any event has failed. CL_INVALID_VALUE if num_events
  * is zero, CL_INVALID_CONTEXT if events specified
  * in event_list do not belong to the same context, and
  * CL_INVALID_EVENT if event objects specified in
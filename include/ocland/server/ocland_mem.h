@@ -19,11 +19,134 @@
 #include <CL/cl.h>
 #include <CL/cl_ext.h>
 
+#include <ocland/common/dataCompression.h>
 #include <ocland/server/ocland_event.h>
 
 #ifndef OCLAND_MEM_H_INCLUDED
 #define OCLAND_MEM_H_INCLUDED
 
+/// Blocking flag of the non-blocking transfers carried inline in the
+/// command package, instead of along a parallel transfer channel
+#define OCLAND_INLINE_TRANSFER 2u
+
+/** Receive and drop data from a socket. Used to keep the stream
+ * synchronized when the data sent by the peer can't be processed.
+ * @param fd Socket where the data will be received.
+ * @param cb Size in bytes of the data to discard.
+ * @return CL_SUCCESS if the data has been consumed,
+ * CL_OUT_OF_RESOURCES if the connection has been lost.
+ */
+cl_int oclandDiscard(int *fd, size_t cb);
+
+/** Create a port for a parallel data transfer, using the same kind of
+ * socket than the client main connection.
+ * @param clientfd Client main connection socket.
+ * @param async_port Returned resulting port. Can be NULL, then
+ * port data will not be returned.
+ * @return Server identifier, lower than 0 if couldn't be created.
+ */
+int openPort(int *clientfd, unsigned int *async_port);
+
+/** Close a port created with openPort(), removing the Unix domain
+ * socket file if any.
+ * @param serverfd Server identifier.
+ */
+void closePort(int serverfd);
+
+/** Receive data from a socket, writing it into a memory object.
+ * The transfer is split in chunks of OCLAND_TRANSFER_CHUNK bytes,
+ * with OCLAND_TRANSFER_NBUFFERS staging chunks, such that a chunk
+ * is received along the network while the previous ones are
+ * written into the device. On devices with CL_DEVICE_HOST_UNIFIED_MEMORY
+ * the chunks are received straight into the mapped memory object
+ * instead, avoiding the staging copy.
+ * @param fd Socket where the data will be received.
+ * @param stream Compression stream. NULL for raw data.
+ * @param command_queue Command queue where the writes are enqueued.
+ * @param mem Memory object to write.
+ * @param offset Offset in bytes in the memory object.
+ * @param cb Size in bytes of the data to transfer.
+ * @param event Returned event of the last write. Can be NULL.
+ * @return CL_SUCCESS if the data is successfully written, an error
+ * code otherwise. All the data is consumed from the socket even
+ * if an error is detected.
+ */
+cl_int oclandRecvBuffer(int *                fd ,
+                        oclandStream         stream ,
+                        cl_command_queue     command_queue ,
+                        cl_mem               mem ,
+                        size_t               offset ,
+                        size_t               cb ,
+                        cl_event *           event);
+
+/** Receive image data from a socket, writing it into an image.
+ * The data is received in host layout, with the provided pitches,
+ * and written in pieces of whole slices (or whole rows for 2D
+ * regions) of about OCLAND_TRANSFER_CHUNK bytes, such that the full
+ * data is never stored in memory.
+ * @param fd Socket where the data will be received.
+ * @param stream Compression stream. NULL for raw data.
+ * @param command_queue Command queue where the writes are enqueued.
+ * @param image Image to write.
+ * @param origin Origin of the region to write.
+ * @param region Region to write.
+ * @param row_pitch Length of each row in bytes of the received data.
+ * @param slice_pitch Size of each 2D slice in bytes of the received data.
+ * @param head First bytes of the data, already received. Can be NULL.
+ * @param head_size Size of head.
+ * @param cb Size in bytes of the data, including head and padding.
+ * @param event Returned event of the last write. Can be NULL.
+ * @return CL_SUCCESS if the data is successfully written, an error
+ * code otherwise. All the data is consumed from the socket even
+ * if an error is detected.
+ */
+cl_int oclandRecvImage(int *                fd ,
+                       oclandStream         stream ,
+                       cl_command_queue     command_queue ,
+                       cl_mem               image ,
+                       const size_t *       origin ,
+                       const size_t *       region ,
+                       size_t               row_pitch ,
+                       size_t               slice_pitch ,
+                       const void *         head ,
+                       size_t               head_size ,
+                       size_t               cb ,
+                       cl_event *           event);
+
+/** Read data from a memory object, sending it through a socket.
+ * The transfer is split in chunks of OCLAND_TRANSFER_CHUNK bytes,
+ * with OCLAND_TRANSFER_NBUFFERS staging chunks, such that a chunk
+ * is read from the device while the previous ones are sent along
+ * the network. On devices with CL_DEVICE_HOST_UNIFIED_MEMORY the
+ * chunks are mapped and sent straight from the mapped memory instead,
+ * using MSG_ZEROCOPY if it has been enabled in the socket (see
+ * EnableZeroCopy()).
+ * @param fd Socket where the data will be sent.
+ * @param stream Compression stream. NULL for raw data.
+ * @param command_queue Command queue where the reads are enqueued.
+ * @param mem Memory object to read.
+ * @param offset Offset in bytes in the memory object.
+ * @param cb Size in bytes of the data to transfer.
+ * @param header Data to be sent before the memory object
+ * content. Can be NULL.
+ * @param header_size Size of header.
+ * @param event Returned event of the last read. Can be NULL.
+ * @return CL_SUCCESS if the data has been sent, an error code
+ * otherwise. If the error is detected once the data has started to be
+ * sent, the connection is closed (and fd set to -1), such that the peer
+ * never receives corrupted data. Otherwise nothing is sent, neither the
+ * header.
+ */
+cl_int oclandSendBuffer(int *                fd ,
+                        oclandStream         stream ,
+                        cl_command_queue     command_queue ,
+                        cl_mem               mem ,
+                        size_t               offset ,
+                        size_t               cb ,
+                        const void *         header ,
+                        size_t               header_size ,
+                        cl_event *           event);
+
 /** clEnqueueReadBuffer asynchronous operation. Call this method
  * when blocking_read is CL_FALSE. See clEnqueueReadBuffer OpenCL
  * command documentation for further details on the parameters
@@ -37,7 +160,27 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
                                cl_mem               buffer ,
                                size_t               offset ,
                                size_t               cb ,
-                               void *               ptr ,
+                               cl_uint              num_events_in_wait_list ,
+                               ocland_event *       event_wait_list ,
+                               cl_bool              want_event ,
+                               ocland_event         event);
+
+/** clEnqueueReadBuffer asynchronous operation for small transfers, whose
+ * data is carried inline along the client connection (blocking_read set
+ * to OCLAND_INLINE_TRANSFER by the client). A new thread replies the
+ * flag, the event and the data once the read has finished, such that
+ * the server does not wait for it. The client must not send new
+ * commands until it has received the reply, so it only requests inline
+ * reads without events to wait for.
+ * @param clientfd Socket already open with the client.
+ * @return CL_SUCCESS if the replies are carried out by this method, an
+ * error code otherwise (nothing is sent in that case).
+ */
+cl_int oclandEnqueueReadInline(int *                clientfd ,
+                               cl_command_queue     command_queue ,
+                               cl_mem               buffer ,
+                               size_t               offset ,
+                               size_t               cb ,
                                cl_uint              num_events_in_wait_list ,
                                ocland_event *       event_wait_list ,
                                cl_bool              want_event ,
@@ -56,12 +199,84 @@ cl_int oclandEnqueueWriteBuffer(int *               clientfd ,
                                 cl_mem               buffer ,
                                 size_t               offset ,
                                 size_t               cb ,
-                                void *               ptr ,
                                 cl_uint              num_events_in_wait_list ,
                                 ocland_event *       event_wait_list ,
                                 cl_bool              want_event ,
                                 ocland_event         event);
 
+/** clEnqueueWriteBuffer asynchronous operation for small transfers, whose
+ * data is carried inline in the command package (blocking_write set to
+ * OCLAND_INLINE_TRANSFER by the client). The write is enqueued from a
+ * copy of the data, released when the write has finished, such that
+ * the server does not wait for it. If some ocland transfers of the wait
+ * list are still in progress, a new thread waits for them and enqueues
+ * the write.
+ * @param command_queue Command queue.
+ * @param buffer Buffer to write.
+ * @param offset Offset of the write in the buffer.
+ * @param cb Size of the data.
+ * @param ptr Data received in the package.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for, released by this method
+ * on success.
+ * @param want_event CL_TRUE if the event must be preserved, it is
+ * released by this method on success otherwise.
+ * @param event Write event.
+ * @return CL_SUCCESS if the write is enqueued, an error code otherwise.
+ */
+cl_int oclandEnqueueWriteInline(cl_command_queue     command_queue ,
+                                cl_mem               buffer ,
+                                size_t               offset ,
+                                size_t               cb ,
+                                const void *         ptr ,
+                                cl_uint              num_events_in_wait_list ,
+                                ocland_event *       event_wait_list ,
+                                cl_bool              want_event ,
+                                ocland_event         event);
+
+/** Set the peer servers where the data can be sent by
+ * oclandEnqueueSendBufferToPeer(). Any server listening on the transfer
+ * ports range is allowed by default.
+ * @param peers Addresses of the peer servers, as known by the clients,
+ * separated by commas. NULL or empty to allow any server.
+ */
+void setAllowedPeers(const char *peers);
+
+/** Send a buffer region straight to another ocland server, which has
+ * already opened a transfer port for a non-blocking clEnqueueWriteBuffer
+ * requested by the client. The first stream is connected by a new
+ * thread, with a deadline of OCLAND_CONNECT_TIMEOUT milliseconds, before
+ * answering, such that the client can relay the data by itself if the
+ * peer server is not reachable from this one. The port must be in the
+ * transfer ports range, and the address allowed by setAllowedPeers().
+ * @param clientfd Socket already open with the client.
+ * @param command_queue Command queue.
+ * @param buffer Buffer to read.
+ * @param offset Offset of the region in the buffer.
+ * @param cb Size of the region.
+ * @param peer Peer server address, as known by the client.
+ * @param peer_port Transfer port opened by the peer server.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param want_event CL_TRUE if the event must be preserved.
+ * @param event Event associated to the transfer.
+ * @return CL_SUCCESS if the transfer thread has been started, which
+ * replies the client, an error code otherwise, in which case nothing has
+ * been sent to the client.
+ * @note Memory transfer will be done in a new thread.
+ */
+cl_int oclandEnqueueSendBufferToPeer(int *                clientfd ,
+                                     cl_command_queue     command_queue ,
+                                     cl_mem               buffer ,
+                                     size_t               offset ,
+                                     size_t               cb ,
+                                     const char *         peer ,
+                                     unsigned int         peer_port ,
+                                     cl_uint              num_events_in_wait_list ,
+                                     ocland_event *       event_wait_list ,
+                                     cl_bool              want_event ,
+                                     ocland_event         event);
+
 /** clEnqueueReadBufferRect asynchronous operation. Call this method
  * when blocking_read is CL_FALSE. See clEnqueueReadBufferRect OpenCL
  * command documentation for further details on the parameters
@@ -114,6 +329,9 @@ cl_int oclandEnqueueWriteImage(int *                clientfd ,
  * command documentation for further details on the parameters
  * and returned values.
  * @param clientfd Socket already open with the client.
+ * @param ptr Host memory where the region is packed, i.e. of
+ * region[0]*region[1]*region[2] bytes, released when the data
+ * has been sent.
  * @note Memory transfer will be done in a new thread, and in a
  * new socket.
  */
@@ -124,8 +342,6 @@ cl_int oclandEnqueueReadBufferRect(int *                clientfd ,
                                    const size_t *       region ,
                                    size_t               buffer_row_pitch ,
                                    size_t               buffer_slice_pitch ,
-                                   size_t               host_row_pitch ,
-                                   size_t               host_slice_pitch ,
                                    void *               ptr ,
                                    cl_uint              num_events_in_wait_list ,
                                    ocland_event *       event_wait_list ,
@@ -137,6 +353,9 @@ cl_int oclandEnqueueReadBufferRect(int *                clientfd ,
  * command documentation for further details on the parameters
  * and returned values.
  * @param clientfd Socket already open with the client.
+ * @param ptr Host memory where the packed region is received, i.e. of
+ * region[0]*region[1]*region[2] bytes, released when the data has
+ * been written.
  * @note Memory transfer will be done in a new thread, and in a
  * new socket.
  */
@@ -147,8 +366,6 @@ cl_int oclandEnqueueWriteBufferRect(int *                clientfd ,
                                     const size_t *       region ,
                                     size_t               buffer_row_pitch ,
                                     size_t               buffer_slice_pitch ,
-                                    size_t               host_row_pitch ,
-                                    size_t               host_slice_pitch ,
                                     void *               ptr ,
                                     cl_uint              num_events_in_wait_list ,
                                     ocland_event *       event_wait_list ,
@@ -156,4 +373,52 @@ cl_int oclandEnqueueWriteBufferRect(int *                clientfd ,
                                     ocland_event         event);
 #endif // CL_API_SUFFIX__VERSION_1_1
 
+/** clEnqueueFillBuffer emulation for the platforms lacking it (OpenCL
+ * < 1.2). The pattern is replicated in a staging host memory, which is
+ * written as many times as needed to fill the region.
+ * @param command_queue Command queue.
+ * @param mem Buffer to fill.
+ * @param pattern Pattern.
+ * @param pattern_size Pattern size.
+ * @param offset Offset of the region to fill.
+ * @param cb Size of the region to fill, multiple of the pattern size.
+ * @param event Returned OpenCL event of the last write, NULL if the
+ * fill has failed.
+ * @return CL_SUCCESS if the region has been filled, an error code
+ * otherwise.
+ * @note The writes are blocking, so the region is already filled when
+ * this method returns.
+ */
+cl_int oclandEmulateFillBuffer(cl_command_queue     command_queue ,
+                               cl_mem               mem ,
+                               const void *         pattern ,
+                               size_t               pattern_size ,
+                               size_t               offset ,
+                               size_t               cb ,
+                               cl_event *           event);
+
+/** clEnqueueFillImage emulation for the platforms lacking it (OpenCL
+ * < 1.2). The fill color is converted into the image format in a
+ * staging host memory, which is written along the region.
+ * @param command_queue Command queue.
+ * @param image Image to fill.
+ * @param fill_color Fill color, as 4 RGBA components of the type
+ * expected by clEnqueueFillImage.
+ * @param origin Origin of the region to fill.
+ * @param region Region to fill.
+ * @param event Returned OpenCL event of the last write, NULL if the
+ * fill has failed.
+ * @return CL_SUCCESS if the region has been filled,
+ * CL_IMAGE_FORMAT_NOT_SUPPORTED if the image format can't be emulated
+ * (packed and half float formats), another error code otherwise.
+ * @note The writes are blocking, so the region is already filled when
+ * this method returns.
+ */
+cl_int oclandEmulateFillImage(cl_command_queue     command_queue ,
+                              cl_mem               image ,
+                              const void *         fill_color ,
+                              const size_t *       origin ,
+                              const size_t *       region ,
+                              cl_event *           event);
+
 #endif // OCLAND_MEM_H_INCLUDED
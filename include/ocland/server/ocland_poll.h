@@ -0,0 +1,58 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCLAND_POLL_H_INCLUDED
+#define OCLAND_POLL_H_INCLUDED
+
+/** Initialize the sockets poller, which tells the server main loop which
+ * sockets are ready to be read, such that the server sleeps while no
+ * client is requesting anything. If the server has been built with
+ * OCLAND_IO_URING, io_uring multishot polls are used, falling back to
+ * epoll if the kernel does not support them.
+ * @return 0 if the poller has been initialized, -1 otherwise.
+ */
+int initPoller();
+
+/** Get the name of the engine used by the poller.
+ * @return Engine name.
+ */
+const char* pollerName();
+
+/** Start watching a socket.
+ * @param fd Socket.
+ * @return 0 if the socket is watched, -1 otherwise.
+ */
+int watchSocket(int fd);
+
+/** Stop watching a socket. It should be called just after closing the
+ * socket, since the io_uring polls keep the socket alive.
+ * @param fd Socket.
+ */
+void unwatchSocket(int fd);
+
+/** Wait until some watched sockets are ready to be read. A socket can be
+ * reported just once for several incoming messages, so all the pending
+ * data should be consumed. Some sockets can be spuriously reported.
+ * @param fds Returned ready sockets.
+ * @param max_fds Length of the fds array.
+ * @param timeout Maximum waiting time in milliseconds, -1 to wait forever.
+ * @return Number of ready sockets, -1 if an error has been detected.
+ */
+int waitSockets(int *fds, unsigned int max_fds, int timeout);
+
+#endif // OCLAND_POLL_H_INCLUDED
@@ -65,6 +65,14 @@ struct validator_st{
     cl_uint num_events;
     /// Generated events
     ocland_event *events;
+    /// Bytes of the message being dispatched still pending in the socket
+    size_t pending;
+    /// Size of the package being received, as announced by the client
+    size_t comm_size;
+    /// Bytes of the package size, or of the message, already received
+    size_t received;
+    /// Message being received, NULL while the package size is received
+    void *msg;
 };
 
 /// Abstraction of validator_st structure
@@ -0,0 +1,1299 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <ocland/client/ocland.h>
+#include <ocland/client/shortcut.h>
+#include <ocland/client/cluster.h>
+
+/// Cluster platform name
+#define OCLAND_CLUSTER_NAME "ocland cluster"
+/// Cluster platform version
+#define OCLAND_CLUSTER_VERSION "OpenCL 1.1 ocland cluster"
+/// Split device name
+#define OCLAND_SPLIT_NAME "ocland split device"
+
+/// Replicas state mutex
+static pthread_mutex_t cluster_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// Signaled when the data of a replica has been copied
+static pthread_cond_t cluster_cond = PTHREAD_COND_INITIALIZER;
+
+cl_bool isClusterEnabled()
+{
+    static int enabled = -1;
+    if(enabled < 0){
+        const char *env = getenv("OCLAND_CLUSTER");
+        enabled = (env && strcmp(env, "0")) ? 1 : 0;
+    }
+    return enabled ? CL_TRUE : CL_FALSE;
+}
+
+cl_int clusterSetInfo(const void *value,
+                      size_t      value_size,
+                      size_t      param_value_size,
+                      void *      param_value,
+                      size_t *    param_value_size_ret)
+{
+    if(param_value_size_ret) *param_value_size_ret = value_size;
+    if(!param_value)
+        return CL_SUCCESS;
+    if(param_value_size < value_size)
+        return CL_INVALID_VALUE;
+    memcpy(param_value, value, value_size);
+    return CL_SUCCESS;
+}
+
+cl_int clusterGetPlatformInfo(cl_platform_info param_name,
+                              size_t           param_value_size,
+                              void *           param_value,
+                              size_t *         param_value_size_ret)
+{
+    const char *value;
+    switch(param_name){
+        case CL_PLATFORM_PROFILE:
+            value = "FULL_PROFILE";
+            break;
+        case CL_PLATFORM_VERSION:
+            value = OCLAND_CLUSTER_VERSION;
+            break;
+        case CL_PLATFORM_NAME:
+            value = OCLAND_CLUSTER_NAME;
+            break;
+        case CL_PLATFORM_VENDOR:
+            value = "ocland";
+            break;
+        case CL_PLATFORM_EXTENSIONS:
+            value = "cl_khr_icd";
+            break;
+        case CL_PLATFORM_ICD_SUFFIX_KHR:
+            value = "ocland";
+            break;
+        default:
+            return CL_INVALID_VALUE;
+    }
+    return clusterSetInfo(value, strlen(value) + 1,
+                          param_value_size, param_value, param_value_size_ret);
+}
+
+/** Release the server contexts once the cluster context, and all the
+ * objects using it, are released.
+ * @param context Cluster context.
+ * @return CL_SUCCESS if the context is released, an error code otherwise.
+ */
+static cl_int unrefContext(clusterContext context)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    pthread_mutex_lock(&cluster_mutex);
+    context->rcount--;
+    cl_uint rcount = context->rcount;
+    pthread_mutex_unlock(&cluster_mutex);
+    if(rcount)
+        return CL_SUCCESS;
+    for(i=0;i<context->num_servers;i++){
+        struct clusterServer_st *server = &(context->servers[i]);
+        if(server->queue)
+            oclandReleaseCommandQueue(server->queue);
+        if(server->context){
+            cl_int f = oclandReleaseContext(server->context);
+            if(f != CL_SUCCESS)
+                flag = f;
+        }
+        free(server->devices);
+    }
+    free(context->servers);
+    free(context->devices);
+    free(context);
+    return flag;
+}
+
+clusterContext clusterCreateContext(cl_uint              num_devices,
+                                    const cl_device_id * devices,
+                                    cl_int *             errcode_ret)
+{
+    cl_uint i, j;
+    cl_int flag;
+    clusterContext context = (clusterContext)calloc(1, sizeof(struct clusterContext_st));
+    if(context){
+        context->servers = (struct clusterServer_st*)calloc(num_devices, sizeof(struct clusterServer_st));
+        context->devices = (cl_device_id*)malloc(num_devices*sizeof(cl_device_id));
+    }
+    if(!context || !context->servers || !context->devices){
+        if(context){
+            free(context->servers);
+            free(context->devices);
+            free(context);
+        }
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    context->rcount = 1;
+    // Group the devices by server platform
+    for(i=0;i<num_devices;i++){
+        int *socket = getShortcut(devices[i]);
+        cl_platform_id platform = NULL;
+        flag = oclandGetDeviceInfo(devices[i], CL_DEVICE_PLATFORM,
+                                   sizeof(cl_platform_id), &platform, NULL);
+        if(!socket || (flag != CL_SUCCESS)){
+            unrefContext(context);
+            if(errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+            return NULL;
+        }
+        for(j=0;j<context->num_servers;j++){
+            if(    (context->servers[j].socket == socket)
+                && (context->servers[j].platform == platform))
+                break;
+        }
+        struct clusterServer_st *server = &(context->servers[j]);
+        if(j == context->num_servers){
+            server->devices = (cl_device_id*)malloc(num_devices*sizeof(cl_device_id));
+            if(!server->devices){
+                unrefContext(context);
+                if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+                return NULL;
+            }
+            server->socket   = socket;
+            server->platform = platform;
+            context->num_servers++;
+        }
+        server->devices[server->num_devices] = devices[i];
+        server->num_devices++;
+    }
+    // Create the server contexts
+    for(i=0;i<context->num_servers;i++){
+        struct clusterServer_st *server = &(context->servers[i]);
+        cl_context_properties properties[3] = {CL_CONTEXT_PLATFORM,
+                                               (cl_context_properties)server->platform,
+                                               0};
+        server->context = oclandCreateContext(properties, 3,
+                                              server->num_devices, server->devices,
+                                              NULL, NULL, &flag);
+        if(flag != CL_SUCCESS){
+            server->context = NULL;
+            unrefContext(context);
+            if(errcode_ret) *errcode_ret = flag;
+            return NULL;
+        }
+        memcpy(context->devices + context->num_devices, server->devices,
+               server->num_devices*sizeof(cl_device_id));
+        context->num_devices += server->num_devices;
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return context;
+}
+
+cl_int clusterReleaseContext(clusterContext context)
+{
+    return unrefContext(context);
+}
+
+cl_int clusterGetContextInfo(clusterContext     context,
+                             cl_context_info    param_name,
+                             size_t             param_value_size,
+                             void *             param_value,
+                             size_t *           param_value_size_ret)
+{
+    if(param_name == CL_CONTEXT_NUM_DEVICES){
+        return clusterSetInfo(&(context->num_devices), sizeof(cl_uint),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_CONTEXT_DEVICES){
+        return clusterSetInfo(context->devices, context->num_devices*sizeof(cl_device_id),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_CONTEXT_PROPERTIES){
+        cl_context_properties properties[3] = {CL_CONTEXT_PLATFORM, 0, 0};
+        return clusterSetInfo(properties, sizeof(properties),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    return oclandGetContextInfo(context->servers[0].context, param_name,
+                                param_value_size, param_value, param_value_size_ret);
+}
+
+cl_uint clusterGetServer(clusterContext context, cl_device_id device)
+{
+    cl_uint i, j;
+    for(i=0;i<context->num_servers;i++){
+        for(j=0;j<context->servers[i].num_devices;j++){
+            if(context->servers[i].devices[j] == device)
+                return i;
+        }
+    }
+    return context->num_servers;
+}
+
+cl_command_queue clusterCreateCommandQueue(clusterContext              context,
+                                           cl_device_id                device,
+                                           cl_command_queue_properties properties,
+                                           cl_uint *                   server,
+                                           cl_int *                    errcode_ret)
+{
+    *server = clusterGetServer(context, device);
+    if(*server == context->num_servers){
+        if(errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+        return NULL;
+    }
+    return oclandCreateCommandQueue(context->servers[*server].context, device,
+                                    properties, errcode_ret);
+}
+
+clusterMem clusterCreateBuffer(clusterContext context,
+                               cl_mem_flags   flags,
+                               size_t         size,
+                               void *         host_ptr,
+                               cl_int *       errcode_ret)
+{
+    if(    (flags & CL_MEM_USE_HOST_PTR)
+        || (flags & CL_MEM_ALLOC_HOST_PTR)
+        || !size ){
+        if(errcode_ret) *errcode_ret = CL_INVALID_VALUE;
+        return NULL;
+    }
+    clusterMem mem = (clusterMem)calloc(1, sizeof(struct clusterMem_st));
+    if(mem){
+        mem->replicas = (cl_mem*)calloc(context->num_servers, sizeof(cl_mem));
+        mem->valid = (cl_bool*)calloc(context->num_servers, sizeof(cl_bool));
+        mem->migrating = (cl_bool*)calloc(context->num_servers, sizeof(cl_bool));
+        if(flags & CL_MEM_COPY_HOST_PTR)
+            mem->host_data = malloc(size);
+    }
+    if(    !mem || !mem->replicas || !mem->valid || !mem->migrating
+        || ((flags & CL_MEM_COPY_HOST_PTR) && !mem->host_data) ){
+        if(mem){
+            free(mem->replicas);
+            free(mem->valid);
+            free(mem->migrating);
+            free(mem->host_data);
+            free(mem);
+        }
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    // The data is kept until the buffer is used in a server
+    if(flags & CL_MEM_COPY_HOST_PTR)
+        memcpy(mem->host_data, host_ptr, size);
+    mem->context = context;
+    mem->flags = flags;
+    mem->size = size;
+    pthread_mutex_lock(&cluster_mutex);
+    context->rcount++;
+    pthread_mutex_unlock(&cluster_mutex);
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return mem;
+}
+
+cl_int clusterReleaseMem(clusterMem mem)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    for(i=0;i<mem->context->num_servers;i++){
+        if(!mem->replicas[i])
+            continue;
+        cl_int f = oclandReleaseMemObject(mem->replicas[i]);
+        if(f != CL_SUCCESS)
+            flag = f;
+    }
+    unrefContext(mem->context);
+    free(mem->replicas);
+    free(mem->valid);
+    free(mem->migrating);
+    free(mem->host_data);
+    free(mem);
+    return flag;
+}
+
+cl_int clusterGetMemObjectInfo(clusterMem    mem,
+                               cl_mem_info   param_name,
+                               size_t        param_value_size,
+                               void *        param_value,
+                               size_t *      param_value_size_ret)
+{
+    cl_mem_object_type type = CL_MEM_OBJECT_BUFFER;
+    void *ptr = NULL;
+    size_t offset = 0;
+    cl_uint map_count = 0;
+    switch(param_name){
+        case CL_MEM_TYPE:
+            return clusterSetInfo(&type, sizeof(cl_mem_object_type),
+                                  param_value_size, param_value, param_value_size_ret);
+        case CL_MEM_FLAGS:
+            return clusterSetInfo(&(mem->flags), sizeof(cl_mem_flags),
+                                  param_value_size, param_value, param_value_size_ret);
+        case CL_MEM_SIZE:
+            return clusterSetInfo(&(mem->size), sizeof(size_t),
+                                  param_value_size, param_value, param_value_size_ret);
+        case CL_MEM_HOST_PTR:
+        case CL_MEM_ASSOCIATED_MEMOBJECT:
+            return clusterSetInfo(&ptr, sizeof(void*),
+                                  param_value_size, param_value, param_value_size_ret);
+        case CL_MEM_OFFSET:
+            return clusterSetInfo(&offset, sizeof(size_t),
+                                  param_value_size, param_value, param_value_size_ret);
+        case CL_MEM_MAP_COUNT:
+            return clusterSetInfo(&map_count, sizeof(cl_uint),
+                                  param_value_size, param_value, param_value_size_ret);
+    }
+    return CL_INVALID_VALUE;
+}
+
+/** Copy the data of a replica into another one, server to server. The
+ * commands writing the buffer are finished before. The caller must hold
+ * cluster_mutex, which is released meanwhile the data is copied, marking
+ * the destination replica as migrating. The destination replica is
+ * marked as up to date only if the source one has not been overwritten
+ * meanwhile.
+ * @param mem Cluster buffer.
+ * @param src Index of the server with the up to date replica.
+ * @param dst Index of the server with the outdated replica.
+ * @param command_queue Command queue of the destination server.
+ * @return CL_SUCCESS if the data has been copied, an error code otherwise.
+ */
+static cl_int migrateMem(clusterMem       mem,
+                         cl_uint          src,
+                         cl_uint          dst,
+                         cl_command_queue command_queue)
+{
+    cl_int flag;
+    struct clusterServer_st *server = &(mem->context->servers[src]);
+    cl_command_queue queue = mem->queue;
+    if(!server->queue){
+        server->queue = oclandCreateCommandQueue(server->context, server->devices[0],
+                                                 0, &flag);
+        if(flag != CL_SUCCESS){
+            server->queue = NULL;
+            return flag;
+        }
+    }
+    cl_command_queue src_queue = server->queue;
+    cl_mem src_mem = mem->replicas[src], dst_mem = mem->replicas[dst];
+    mem->migrating[dst] = CL_TRUE;
+    pthread_mutex_unlock(&cluster_mutex);
+    // The writing queue can be already released, which is not an error
+    if(queue)
+        oclandFinish(queue);
+    cl_event event;
+    flag = oclandEnqueueCopyBufferToPeer(src_queue, src_mem,
+                                         command_queue, dst_mem,
+                                         0, 0, mem->size, 0, NULL, &event);
+    if(flag == CL_SUCCESS){
+        flag = oclandWaitForEvents(1, &event);
+        oclandReleaseEvent(event);
+    }
+    pthread_mutex_lock(&cluster_mutex);
+    mem->migrating[dst] = CL_FALSE;
+    if((flag == CL_SUCCESS) && mem->valid[src])
+        mem->valid[dst] = CL_TRUE;
+    pthread_cond_broadcast(&cluster_cond);
+    return flag;
+}
+
+/** Get the replica of a buffer in a server, creating it if needed. The
+ * replicas state is not modified, except when the data is copied into
+ * the replica. The caller must hold cluster_mutex, which is released
+ * meanwhile the data is copied.
+ * @param mem Cluster buffer.
+ * @param server Index of the server context.
+ * @param command_queue Server command queue.
+ * @param migrate CL_TRUE if the data must be copied into an outdated
+ * replica, CL_FALSE if the replica is just allocated.
+ * @param errcode_ret Returned error code.
+ * @return Server buffer, NULL if errors happened.
+ */
+static cl_mem replicaOn(clusterMem       mem,
+                        cl_uint          server,
+                        cl_command_queue command_queue,
+                        cl_bool          migrate,
+                        cl_int *         errcode_ret)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    clusterContext context = mem->context;
+    // Wait for the copy into this replica still in progress
+    while(mem->migrating[server])
+        pthread_cond_wait(&cluster_cond, &cluster_mutex);
+    if(!mem->replicas[server]){
+        cl_mem_flags flags = mem->flags & ~CL_MEM_COPY_HOST_PTR;
+        if(mem->host_data)
+            flags |= CL_MEM_COPY_HOST_PTR;
+        mem->replicas[server] = oclandCreateBuffer(context->servers[server].context,
+                                                   flags, mem->size,
+                                                   mem->host_data, &flag);
+        if(flag != CL_SUCCESS){
+            mem->replicas[server] = NULL;
+            *errcode_ret = flag;
+            return NULL;
+        }
+        if(mem->host_data){
+            free(mem->host_data); mem->host_data = NULL;
+            mem->valid[server] = CL_TRUE;
+        }
+    }
+    // The source replica can be overwritten while the data is copied, so
+    // we keep trying until the replica is up to date
+    while(!mem->valid[server] && migrate){
+        for(i=0;i<context->num_servers;i++){
+            if(mem->valid[i])
+                break;
+        }
+        // If no replica holds data the buffer has not been written yet
+        if(i == context->num_servers)
+            break;
+        flag = migrateMem(mem, i, server, command_queue);
+        if(flag != CL_SUCCESS){
+            *errcode_ret = flag;
+            return NULL;
+        }
+    }
+    *errcode_ret = CL_SUCCESS;
+    return mem->replicas[server];
+}
+
+cl_mem clusterMemOn(clusterMem       mem,
+                    cl_uint          server,
+                    cl_command_queue command_queue,
+                    cl_mem_flags     access,
+                    cl_int *         errcode_ret)
+{
+    cl_uint i;
+    cl_int flag;
+    clusterContext context = mem->context;
+    pthread_mutex_lock(&cluster_mutex);
+    cl_mem replica = replicaOn(mem, server, command_queue,
+                               access != CL_MEM_WRITE_ONLY, &flag);
+    if(flag != CL_SUCCESS){
+        pthread_mutex_unlock(&cluster_mutex);
+        if(errcode_ret) *errcode_ret = flag;
+        return NULL;
+    }
+    if(access != CL_MEM_READ_ONLY){
+        for(i=0;i<context->num_servers;i++)
+            mem->valid[i] = CL_FALSE;
+        mem->queue = command_queue;
+    }
+    mem->valid[server] = CL_TRUE;
+    pthread_mutex_unlock(&cluster_mutex);
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return replica;
+}
+
+/** Release the server programs once the cluster program, and all the
+ * kernels using it, are released.
+ * @param program Cluster program.
+ * @return CL_SUCCESS if the program is released, an error code otherwise.
+ */
+static cl_int unrefProgram(clusterProgram program)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    pthread_mutex_lock(&cluster_mutex);
+    program->rcount--;
+    cl_uint rcount = program->rcount;
+    pthread_mutex_unlock(&cluster_mutex);
+    if(rcount)
+        return CL_SUCCESS;
+    for(i=0;i<program->context->num_servers;i++){
+        if(!program->programs[i])
+            continue;
+        cl_int f = oclandReleaseProgram(program->programs[i]);
+        if(f != CL_SUCCESS)
+            flag = f;
+    }
+    unrefContext(program->context);
+    free(program->programs);
+    free(program);
+    return flag;
+}
+
+clusterProgram clusterCreateProgramWithSource(clusterContext context,
+                                              cl_uint        count,
+                                              const char **  strings,
+                                              const size_t * lengths,
+                                              cl_int *       errcode_ret)
+{
+    cl_uint i;
+    cl_int flag;
+    clusterProgram program = (clusterProgram)malloc(sizeof(struct clusterProgram_st));
+    if(program){
+        program->programs = (cl_program*)calloc(context->num_servers, sizeof(cl_program));
+    }
+    if(!program || !program->programs){
+        free(program);
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    program->context = context;
+    program->rcount = 1;
+    pthread_mutex_lock(&cluster_mutex);
+    context->rcount++;
+    pthread_mutex_unlock(&cluster_mutex);
+    for(i=0;i<context->num_servers;i++){
+        program->programs[i] = oclandCreateProgramWithSource(context->servers[i].context,
+                                                             count, strings, lengths,
+                                                             &flag);
+        if(flag != CL_SUCCESS){
+            program->programs[i] = NULL;
+            unrefProgram(program);
+            if(errcode_ret) *errcode_ret = flag;
+            return NULL;
+        }
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return program;
+}
+
+cl_int clusterReleaseProgram(clusterProgram program)
+{
+    return unrefProgram(program);
+}
+
+cl_int clusterBuildProgram(clusterProgram       program,
+                           cl_uint              num_devices,
+                           const cl_device_id * device_list,
+                           const char *         options)
+{
+    cl_uint i, j, n;
+    clusterContext context = program->context;
+    for(j=0;j<num_devices;j++){
+        if(clusterGetServer(context, device_list[j]) == context->num_servers)
+            return CL_INVALID_DEVICE;
+    }
+    for(i=0;i<context->num_servers;i++){
+        cl_device_id devices[num_devices ? num_devices : 1];
+        n = 0;
+        for(j=0;j<num_devices;j++){
+            if(clusterGetServer(context, device_list[j]) == i){
+                devices[n] = device_list[j];
+                n++;
+            }
+        }
+        if(num_devices && !n)
+            continue;
+        cl_int flag = oclandBuildProgram(program->programs[i], n, n ? devices : NULL,
+                                         options, NULL, NULL);
+        if(flag != CL_SUCCESS)
+            return flag;
+    }
+    return CL_SUCCESS;
+}
+
+cl_program clusterGetProgram(clusterProgram program, cl_device_id device)
+{
+    if(!device)
+        return program->programs[0];
+    cl_uint server = clusterGetServer(program->context, device);
+    if(server == program->context->num_servers)
+        return NULL;
+    return program->programs[server];
+}
+
+cl_int clusterGetProgramInfo(clusterProgram   program,
+                             cl_program_info  param_name,
+                             size_t           param_value_size,
+                             void *           param_value,
+                             size_t *         param_value_size_ret)
+{
+    cl_uint i;
+    clusterContext context = program->context;
+    if(param_name == CL_PROGRAM_NUM_DEVICES){
+        return clusterSetInfo(&(context->num_devices), sizeof(cl_uint),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_PROGRAM_DEVICES){
+        return clusterSetInfo(context->devices, context->num_devices*sizeof(cl_device_id),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_PROGRAM_BINARY_SIZES){
+        // Sorted as the devices, which are sorted by server
+        size_t size = context->num_devices*sizeof(size_t);
+        if(param_value_size_ret) *param_value_size_ret = size;
+        if(!param_value)
+            return CL_SUCCESS;
+        if(param_value_size < size)
+            return CL_INVALID_VALUE;
+        size_t *sizes = (size_t*)param_value;
+        for(i=0;i<context->num_servers;i++){
+            size = context->servers[i].num_devices*sizeof(size_t);
+            cl_int flag = oclandGetProgramInfo(program->programs[i], param_name,
+                                               size, sizes, NULL);
+            if(flag != CL_SUCCESS)
+                return flag;
+            sizes += context->servers[i].num_devices;
+        }
+        return CL_SUCCESS;
+    }
+    return oclandGetProgramInfo(program->programs[0], param_name,
+                                param_value_size, param_value, param_value_size_ret);
+}
+
+clusterKernel clusterCreateKernel(clusterProgram program,
+                                  const char *   kernel_name,
+                                  cl_int *       errcode_ret)
+{
+    cl_uint i;
+    cl_int flag, error = CL_INVALID_PROGRAM_EXECUTABLE;
+    clusterContext context = program->context;
+    clusterKernel kernel = (clusterKernel)calloc(1, sizeof(struct clusterKernel_st));
+    if(kernel){
+        kernel->kernels = (cl_kernel*)calloc(context->num_servers, sizeof(cl_kernel));
+    }
+    if(!kernel || !kernel->kernels){
+        free(kernel);
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    kernel->program = program;
+    pthread_mutex_lock(&cluster_mutex);
+    program->rcount++;
+    pthread_mutex_unlock(&cluster_mutex);
+    // The program may be built just in some servers
+    for(i=0;i<context->num_servers;i++){
+        kernel->kernels[i] = oclandCreateKernel(program->programs[i], kernel_name, &flag);
+        if(flag != CL_SUCCESS){
+            kernel->kernels[i] = NULL;
+            error = flag;
+            continue;
+        }
+        if(kernel->args)
+            continue;
+        flag = oclandGetKernelInfo(kernel->kernels[i], CL_KERNEL_NUM_ARGS,
+                                   sizeof(cl_uint), &(kernel->num_args), NULL);
+        if(flag == CL_SUCCESS)
+            kernel->args = (struct clusterArg_st*)calloc(kernel->num_args ? kernel->num_args : 1,
+                                                         sizeof(struct clusterArg_st));
+        if(!kernel->args){
+            clusterReleaseKernel(kernel);
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            return NULL;
+        }
+    }
+    if(!kernel->args){
+        clusterReleaseKernel(kernel);
+        if(errcode_ret) *errcode_ret = error;
+        return NULL;
+    }
+    for(i=0;i<kernel->num_args;i++){
+        kernel->args[i].applied = (cl_bool*)calloc(context->num_servers, sizeof(cl_bool));
+        if(!kernel->args[i].applied){
+            clusterReleaseKernel(kernel);
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            return NULL;
+        }
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return kernel;
+}
+
+cl_int clusterCreateKernelsInProgram(clusterProgram  program,
+                                     cl_uint         num_kernels,
+                                     clusterKernel * kernels,
+                                     cl_uint *       num_kernels_ret)
+{
+    cl_uint i, j, n;
+    cl_int flag = CL_INVALID_PROGRAM_EXECUTABLE;
+    // Get the kernel names from the first server where the program is built
+    for(i=0;i<program->context->num_servers;i++){
+        flag = oclandCreateKernelsInProgram(program->programs[i], 0, NULL, &n);
+        if(flag == CL_SUCCESS)
+            break;
+    }
+    if(flag != CL_SUCCESS)
+        return flag;
+    if(num_kernels_ret)
+        *num_kernels_ret = n;
+    if(!kernels)
+        return CL_SUCCESS;
+    if(num_kernels < n)
+        return CL_INVALID_VALUE;
+    cl_kernel server_kernels[n ? n : 1];
+    flag = oclandCreateKernelsInProgram(program->programs[i], n, server_kernels, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    for(j=0;j<n;j++){
+        char name[1024];
+        flag = oclandGetKernelInfo(server_kernels[j], CL_KERNEL_FUNCTION_NAME,
+                                   sizeof(name), name, NULL);
+        if(flag == CL_SUCCESS)
+            kernels[j] = clusterCreateKernel(program, name, &flag);
+        if(flag != CL_SUCCESS){
+            while(j--)
+                clusterReleaseKernel(kernels[j]);
+            break;
+        }
+    }
+    for(j=0;j<n;j++)
+        oclandReleaseKernel(server_kernels[j]);
+    return flag;
+}
+
+cl_int clusterReleaseKernel(clusterKernel kernel)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    for(i=0;i<kernel->program->context->num_servers;i++){
+        if(!kernel->kernels[i])
+            continue;
+        cl_int f = oclandReleaseKernel(kernel->kernels[i]);
+        if(f != CL_SUCCESS)
+            flag = f;
+    }
+    if(kernel->args){
+        for(i=0;i<kernel->num_args;i++){
+            free(kernel->args[i].value);
+            free(kernel->args[i].applied);
+        }
+        free(kernel->args);
+    }
+    unrefProgram(kernel->program);
+    free(kernel->kernels);
+    free(kernel);
+    return flag;
+}
+
+cl_int clusterSetKernelArg(clusterKernel kernel,
+                           cl_uint       arg_index,
+                           size_t        arg_size,
+                           const void *  arg_value,
+                           clusterMem    mem)
+{
+    cl_uint i;
+    if(arg_index >= kernel->num_args)
+        return CL_INVALID_ARG_INDEX;
+    if(!arg_size)
+        return CL_INVALID_ARG_SIZE;
+    struct clusterArg_st *arg = &(kernel->args[arg_index]);
+    void *value = NULL;
+    if(arg_value && !mem){
+        value = malloc(arg_size);
+        if(!value)
+            return CL_OUT_OF_HOST_MEMORY;
+        memcpy(value, arg_value, arg_size);
+    }
+    free(arg->value);
+    arg->size = arg_size;
+    arg->value = value;
+    arg->mem = mem;
+    for(i=0;i<kernel->program->context->num_servers;i++)
+        arg->applied[i] = CL_FALSE;
+    return CL_SUCCESS;
+}
+
+cl_kernel clusterGetKernel(clusterKernel kernel, cl_device_id device)
+{
+    cl_uint i;
+    clusterContext context = kernel->program->context;
+    if(device){
+        i = clusterGetServer(context, device);
+        return (i < context->num_servers) ? kernel->kernels[i] : NULL;
+    }
+    for(i=0;i<context->num_servers;i++){
+        if(kernel->kernels[i])
+            return kernel->kernels[i];
+    }
+    return NULL;
+}
+
+cl_int clusterSetKernelArgPartition(clusterKernel kernel,
+                                    cl_uint       arg_index,
+                                    size_t        partition_size)
+{
+    if(arg_index >= kernel->num_args)
+        return CL_INVALID_ARG_INDEX;
+    kernel->args[arg_index].partition = partition_size;
+    return CL_SUCCESS;
+}
+
+/** Get the server kernel to be enqueued in a server, setting there the
+ * arguments and getting the buffers replicas up to date.
+ * @param kernel Cluster kernel.
+ * @param server Index of the server context.
+ * @param command_queue Server command queue.
+ * @param split CL_TRUE for split launches, where the buffers replicas
+ * are not invalidated. The write only partitioned buffers are just
+ * allocated.
+ * @param errcode_ret Returned error code.
+ * @return Server kernel, NULL if errors happened.
+ */
+static cl_kernel kernelOn(clusterKernel    kernel,
+                          cl_uint          server,
+                          cl_command_queue command_queue,
+                          cl_bool          split,
+                          cl_int *         errcode_ret)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    cl_kernel server_kernel = kernel->kernels[server];
+    if(!server_kernel){
+        *errcode_ret = CL_INVALID_PROGRAM_EXECUTABLE;
+        return NULL;
+    }
+    for(i=0;i<kernel->num_args;i++){
+        struct clusterArg_st *arg = &(kernel->args[i]);
+        // Unset arguments are reported by the server
+        if(!arg->size)
+            continue;
+        if(arg->mem){
+            // The replica must be up to date even if the argument is already set
+            cl_mem replica;
+            if(split){
+                cl_bool migrate = !arg->partition || !(arg->mem->flags & CL_MEM_WRITE_ONLY);
+                pthread_mutex_lock(&cluster_mutex);
+                replica = replicaOn(arg->mem, server, command_queue, migrate, &flag);
+                pthread_mutex_unlock(&cluster_mutex);
+            }
+            else{
+                cl_mem_flags access = (arg->mem->flags & CL_MEM_READ_ONLY) ?
+                                      CL_MEM_READ_ONLY : CL_MEM_READ_WRITE;
+                replica = clusterMemOn(arg->mem, server, command_queue,
+                                       access, &flag);
+            }
+            if(flag != CL_SUCCESS)
+                break;
+            if(!arg->applied[server])
+                flag = oclandSetKernelArg(server_kernel, i, sizeof(cl_mem), &replica);
+        }
+        else if(!arg->applied[server]){
+            flag = oclandSetKernelArg(server_kernel, i, arg->size, arg->value);
+        }
+        if(flag != CL_SUCCESS)
+            break;
+        arg->applied[server] = CL_TRUE;
+    }
+    *errcode_ret = flag;
+    return (flag == CL_SUCCESS) ? server_kernel : NULL;
+}
+
+cl_kernel clusterKernelOn(clusterKernel    kernel,
+                          cl_uint          server,
+                          cl_command_queue command_queue,
+                          cl_int *         errcode_ret)
+{
+    cl_int flag;
+    cl_kernel server_kernel = kernelOn(kernel, server, command_queue, CL_FALSE, &flag);
+    if(errcode_ret) *errcode_ret = flag;
+    return server_kernel;
+}
+
+cl_int clusterWaitList(cl_command_queue command_queue,
+                       cl_uint *        num_events,
+                       cl_event *       event_list)
+{
+    cl_uint i, n = 0, m = 0;
+    if(!*num_events)
+        return CL_SUCCESS;
+    int *sockfd = getShortcut(command_queue);
+    cl_event *foreign = (cl_event*)malloc(*num_events * sizeof(cl_event));
+    if(!foreign)
+        return CL_OUT_OF_HOST_MEMORY;
+    for(i=0;i<*num_events;i++){
+        if(getShortcut(event_list[i]) == sockfd){
+            event_list[n] = event_list[i];
+            n++;
+        }
+        else{
+            foreign[m] = event_list[i];
+            m++;
+        }
+    }
+    *num_events = n;
+    cl_int flag = CL_SUCCESS;
+    if(m)
+        flag = clusterWaitForEvents(m, foreign);
+    free(foreign);
+    return flag;
+}
+
+cl_int clusterWaitForEvents(cl_uint         num_events,
+                            const cl_event *event_list)
+{
+    cl_uint i, j, n;
+    cl_int flag = CL_SUCCESS;
+    if(!num_events)
+        return CL_SUCCESS;
+    cl_event *events = (cl_event*)malloc(num_events*sizeof(cl_event));
+    cl_bool *done = (cl_bool*)calloc(num_events, sizeof(cl_bool));
+    if(!events || !done){
+        free(events);
+        free(done);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    for(i=0;i<num_events;i++){
+        if(done[i])
+            continue;
+        // Wait for all the events of the same server at once
+        int *sockfd = getShortcut(event_list[i]);
+        n = 0;
+        for(j=i;j<num_events;j++){
+            if(!done[j] && (getShortcut(event_list[j]) == sockfd)){
+                events[n] = event_list[j];
+                done[j] = CL_TRUE;
+                n++;
+            }
+        }
+        flag = oclandWaitForEvents(n, events);
+        if(flag != CL_SUCCESS)
+            break;
+    }
+    free(events);
+    free(done);
+    return flag;
+}
+
+cl_int clusterGetSplitDeviceInfo(cl_uint              num_devices,
+                                 const cl_device_id * devices,
+                                 cl_device_info       param_name,
+                                 size_t               param_value_size,
+                                 void *               param_value,
+                                 size_t *             param_value_size_ret)
+{
+    cl_uint i;
+    cl_int flag;
+    if(param_name == CL_DEVICE_NAME){
+        return clusterSetInfo(OCLAND_SPLIT_NAME, strlen(OCLAND_SPLIT_NAME) + 1,
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_DEVICE_TYPE){
+        cl_device_type type = 0, device_type;
+        for(i=0;i<num_devices;i++){
+            flag = oclandGetDeviceInfo(devices[i], param_name, sizeof(cl_device_type),
+                                       &device_type, NULL);
+            if(flag != CL_SUCCESS)
+                return flag;
+            type |= device_type;
+        }
+        return clusterSetInfo(&type, sizeof(cl_device_type),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_DEVICE_MAX_COMPUTE_UNITS){
+        cl_uint units = 0, device_units;
+        for(i=0;i<num_devices;i++){
+            flag = oclandGetDeviceInfo(devices[i], param_name, sizeof(cl_uint),
+                                       &device_units, NULL);
+            if(flag != CL_SUCCESS)
+                return flag;
+            units += device_units;
+        }
+        return clusterSetInfo(&units, sizeof(cl_uint),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    // The buffers are replicated in every server, and the work groups
+    // are executed in every device
+    if(    (param_name == CL_DEVICE_GLOBAL_MEM_SIZE)
+        || (param_name == CL_DEVICE_MAX_MEM_ALLOC_SIZE)){
+        cl_ulong size = 0, device_size;
+        for(i=0;i<num_devices;i++){
+            flag = oclandGetDeviceInfo(devices[i], param_name, sizeof(cl_ulong),
+                                       &device_size, NULL);
+            if(flag != CL_SUCCESS)
+                return flag;
+            if(!i || (device_size < size))
+                size = device_size;
+        }
+        return clusterSetInfo(&size, sizeof(cl_ulong),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    if(param_name == CL_DEVICE_MAX_WORK_GROUP_SIZE){
+        size_t size = 0, device_size;
+        for(i=0;i<num_devices;i++){
+            flag = oclandGetDeviceInfo(devices[i], param_name, sizeof(size_t),
+                                       &device_size, NULL);
+            if(flag != CL_SUCCESS)
+                return flag;
+            if(!i || (device_size < size))
+                size = device_size;
+        }
+        return clusterSetInfo(&size, sizeof(size_t),
+                              param_value_size, param_value, param_value_size_ret);
+    }
+    return oclandGetDeviceInfo(devices[0], param_name,
+                               param_value_size, param_value, param_value_size_ret);
+}
+
+clusterSplit clusterCreateSplit(clusterContext              context,
+                                cl_command_queue_properties properties,
+                                cl_int *                    errcode_ret)
+{
+    cl_uint i;
+    cl_int flag;
+    clusterSplit split = (clusterSplit)calloc(1, sizeof(struct clusterSplit_st));
+    if(split){
+        split->queues = (cl_command_queue*)calloc(context->num_devices, sizeof(cl_command_queue));
+        split->servers = (cl_uint*)calloc(context->num_devices, sizeof(cl_uint));
+        split->throughput = (double*)calloc(context->num_devices, sizeof(double));
+    }
+    if(!split || !split->queues || !split->servers || !split->throughput){
+        if(split){
+            free(split->queues);
+            free(split->servers);
+            free(split->throughput);
+            free(split);
+        }
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    split->context = context;
+    pthread_mutex_lock(&cluster_mutex);
+    context->rcount++;
+    pthread_mutex_unlock(&cluster_mutex);
+    // The devices are sorted by server, so the primary queue is placed
+    // in the first server
+    for(i=0;i<context->num_devices;i++){
+        split->queues[i] = clusterCreateCommandQueue(context, context->devices[i],
+                                                     properties, &(split->servers[i]),
+                                                     &flag);
+        if(flag != CL_SUCCESS){
+            clusterReleaseSplit(split);
+            if(errcode_ret) *errcode_ret = flag;
+            return NULL;
+        }
+        split->num_queues++;
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return split;
+}
+
+cl_int clusterReleaseSplit(clusterSplit split)
+{
+    cl_uint i;
+    cl_int flag = CL_SUCCESS;
+    for(i=0;i<split->num_queues;i++){
+        cl_int f = oclandReleaseCommandQueue(split->queues[i]);
+        if(f != CL_SUCCESS)
+            flag = f;
+    }
+    unrefContext(split->context);
+    free(split->queues);
+    free(split->servers);
+    free(split->throughput);
+    free(split);
+    return flag;
+}
+
+/** @struct splitSlice_st
+ * Slice of a split launch, computed by a device.
+ */
+struct splitSlice_st
+{
+    /// Index of the server context
+    cl_uint server;
+    /// First work group of the slice along the outermost dimension
+    size_t start;
+    /// Number of work groups of the slice
+    size_t length;
+    /// Kernel execution event, NULL if the slice is not enqueued
+    cl_event event;
+    /// Time when the slice is enqueued
+    struct timeval t0;
+    /// Seconds elapsed until the slice is computed
+    double elapsed;
+    /// Execution error code
+    cl_int flag;
+};
+
+/** @struct splitWait_st
+ * Slices of a split launch computed in a server.
+ */
+struct splitWait_st
+{
+    /// Index of the server context
+    cl_uint server;
+    /// Number of slices, of all the servers
+    cl_uint num_slices;
+    /// Slices
+    struct splitSlice_st *slices;
+};
+
+/** Thread which waits for the slices computed in a server, measuring
+ * the time elapsed by each one.
+ * @param data splitWait_st object.
+ * @return NULL
+ */
+static void *splitWait_thread(void *data)
+{
+    cl_uint i;
+    struct timeval t1;
+    struct splitWait_st *wait = (struct splitWait_st*)data;
+    for(i=0;i<wait->num_slices;i++){
+        struct splitSlice_st *slice = &(wait->slices[i]);
+        if((slice->server != wait->server) || !slice->event)
+            continue;
+        slice->flag = oclandWaitForEvents(1, &(slice->event));
+        gettimeofday(&t1, NULL);
+        slice->elapsed = (t1.tv_sec - slice->t0.tv_sec) + 1.0E-6 * (t1.tv_usec - slice->t0.tv_usec);
+    }
+    return NULL;
+}
+
+cl_int clusterEnqueueSplitNDRangeKernel(clusterSplit     split,
+                                        clusterKernel    kernel,
+                                        cl_uint          work_dim,
+                                        const size_t *   global_work_offset,
+                                        const size_t *   global_work_size,
+                                        const size_t *   local_work_size,
+                                        cl_uint          num_events_in_wait_list,
+                                        const cl_event * event_wait_list,
+                                        cl_event *       event)
+{
+    cl_uint i, j;
+    cl_int flag = CL_SUCCESS;
+    clusterContext context = split->context;
+    cl_uint n = split->num_queues;
+    cl_uint dim = work_dim - 1;
+    size_t group = local_work_size ? local_work_size[dim] : 1;
+    if(!group || (global_work_size[dim] % group))
+        return CL_INVALID_WORK_GROUP_SIZE;
+    size_t num_groups = global_work_size[dim] / group;
+    if(num_events_in_wait_list){
+        flag = clusterWaitForEvents(num_events_in_wait_list, event_wait_list);
+        if(flag != CL_SUCCESS)
+            return flag;
+    }
+    // Split the work groups proportionally to the devices throughput,
+    // using equal slices until all the devices have been measured
+    double weight = 0.0, cumulative = 0.0;
+    for(i=0;i<n;i++){
+        if(split->throughput[i] <= 0.0){
+            weight = 0.0;
+            break;
+        }
+        weight += split->throughput[i];
+    }
+    struct splitSlice_st slices[n];
+    size_t end = 0;
+    for(i=0;i<n;i++){
+        cumulative += (weight > 0.0) ? split->throughput[i] : 1.0;
+        slices[i].server = split->servers[i];
+        slices[i].start = end;
+        end = (size_t)(num_groups * cumulative / ((weight > 0.0) ? weight : n) + 0.5);
+        if((end > num_groups) || (i == n - 1))
+            end = num_groups;
+        slices[i].length = end - slices[i].start;
+        slices[i].event = NULL;
+        slices[i].elapsed = 0.0;
+        slices[i].flag = CL_SUCCESS;
+    }
+    // Enqueue the slices, moving the global offset
+    size_t offset[3] = {0, 0, 0}, global[3] = {1, 1, 1};
+    for(j=0;j<work_dim;j++){
+        if(global_work_offset)
+            offset[j] = global_work_offset[j];
+        global[j] = global_work_size[j];
+    }
+    size_t origin = offset[dim];
+    for(i=0;i<n;i++){
+        if(!slices[i].length)
+            continue;
+        cl_kernel server_kernel = kernelOn(kernel, slices[i].server, split->queues[i],
+                                           CL_TRUE, &flag);
+        if(flag != CL_SUCCESS)
+            break;
+        offset[dim] = origin + slices[i].start*group;
+        global[dim] = slices[i].length*group;
+        gettimeofday(&(slices[i].t0), NULL);
+        flag = oclandEnqueueNDRangeKernel(split->queues[i], server_kernel, work_dim,
+                                          offset, global, local_work_size,
+                                          0, NULL, &(slices[i].event));
+        if(flag != CL_SUCCESS){
+            slices[i].event = NULL;
+            break;
+        }
+        oclandFlush(split->queues[i]);
+    }
+    // Wait for the enqueued slices, each server in its own thread
+    pthread_t threads[context->num_servers];
+    int joinable[context->num_servers];
+    struct splitWait_st waits[context->num_servers];
+    for(i=0;i<context->num_servers;i++){
+        waits[i].server = i;
+        waits[i].num_slices = n;
+        waits[i].slices = slices;
+        joinable[i] = !pthread_create(&(threads[i]), NULL, splitWait_thread, (void*)&(waits[i]));
+        if(!joinable[i])
+            splitWait_thread((void*)&(waits[i]));
+    }
+    for(i=0;i<context->num_servers;i++){
+        if(joinable[i])
+            pthread_join(threads[i], NULL);
+    }
+    for(i=0;i<n;i++){
+        if(!slices[i].event)
+            continue;
+        oclandReleaseEvent(slices[i].event);
+        if(slices[i].flag != CL_SUCCESS){
+            if(flag == CL_SUCCESS)
+                flag = slices[i].flag;
+            continue;
+        }
+        if(slices[i].elapsed <= 0.0)
+            continue;
+        double throughput = slices[i].length*group / slices[i].elapsed;
+        if(split->throughput[i] > 0.0)
+            throughput = 0.5*(split->throughput[i] + throughput);
+        split->throughput[i] = throughput;
+    }
+    if(flag != CL_SUCCESS)
+        return flag;
+    // Gather the partitioned buffers in the primary server
+    cl_uint primary = split->servers[0];
+    for(j=0;j<kernel->num_args;j++){
+        struct clusterArg_st *arg = &(kernel->args[j]);
+        if(!arg->mem || !arg->partition)
+            continue;
+        clusterMem mem = arg->mem;
+        pthread_mutex_lock(&cluster_mutex);
+        cl_mem dst = replicaOn(mem, primary, split->queues[0],
+                               !(mem->flags & CL_MEM_WRITE_ONLY), &flag);
+        pthread_mutex_unlock(&cluster_mutex);
+        if(flag != CL_SUCCESS)
+            return flag;
+        for(i=0;i<n;i++){
+            if((slices[i].server == primary) || !slices[i].length)
+                continue;
+            size_t start = (origin + slices[i].start*group)*arg->partition;
+            size_t cb = slices[i].length*group*arg->partition;
+            if(start >= mem->size)
+                continue;
+            if(start + cb > mem->size)
+                cb = mem->size - start;
+            cl_event copy_event;
+            flag = oclandEnqueueCopyBufferToPeer(split->queues[i], mem->replicas[slices[i].server],
+                                                 split->queues[0], dst,
+                                                 start, start, cb, 0, NULL, &copy_event);
+            if(flag != CL_SUCCESS)
+                return flag;
+            flag = oclandWaitForEvents(1, &copy_event);
+            oclandReleaseEvent(copy_event);
+            if(flag != CL_SUCCESS)
+                return flag;
+        }
+        // Just the primary replica holds the whole result
+        pthread_mutex_lock(&cluster_mutex);
+        for(i=0;i<context->num_servers;i++)
+            mem->valid[i] = CL_FALSE;
+        mem->valid[primary] = CL_TRUE;
+        mem->queue = split->queues[0];
+        pthread_mutex_unlock(&cluster_mutex);
+    }
+    if(event)
+        flag = oclandEnqueueMarkerWithWaitList(split->queues[0], 0, NULL, event);
+    return flag;
+}
@@ -0,0 +1,559 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ocland/client/deltaUpload.h>
+
+#ifndef OCLAND_DELTA_BLOCK
+    #define OCLAND_DELTA_BLOCK 65536u
+#endif
+
+/** @struct deltaBuffer_st
+ * Tracked buffer.
+ */
+struct deltaBuffer_st
+{
+    /// Buffer
+    cl_mem mem;
+    /// Buffer creation flags
+    cl_mem_flags flags;
+    /// Buffer size
+    size_t size;
+    /// Number of blocks
+    size_t num_blocks;
+    /// Hash of each block, allocated on the first write
+    uint64_t *hashes;
+    /// Flag to know if each block hash match the buffer content
+    unsigned char *valid;
+    /// Invalidations counter
+    unsigned long epoch;
+    /// Host memory of CL_MEM_USE_HOST_PTR buffers, NULL otherwise
+    void *host_ptr;
+    /// 1 if the buffer may have been written since the host memory was
+    /// synchronized, 0 otherwise
+    int stale;
+    /// Number of mappings of the host memory not unmapped yet
+    unsigned int maps;
+    /// 1 if the host memory has been mapped for writing since it was
+    /// last unmapped, 0 otherwise
+    int written;
+};
+
+/** @struct deltaArg_st
+ * Tracked buffer set as kernel argument.
+ */
+struct deltaArg_st
+{
+    /// Kernel
+    cl_kernel kernel;
+    /// Argument index
+    cl_uint arg_index;
+    /// Buffer
+    cl_mem mem;
+};
+
+static unsigned int num_buffers = 0;
+static struct deltaBuffer_st *buffers = NULL;
+static unsigned int num_args = 0;
+static struct deltaArg_st *args = NULL;
+static pthread_mutex_t delta_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/** Hash a block of data. The data is processed along 4 independent 64
+ * bits lanes, which the compiler can vectorize, and then mixed.
+ * @param data Data to hash.
+ * @param size Size of the data in bytes.
+ * @return Data hash.
+ */
+static uint64_t hashBlock(const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    uint64_t acc[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+    uint64_t lane[4];
+    uint64_t h;
+    size_t i = 0;
+    unsigned int j;
+    for(i=0;i+sizeof(lane)<=size;i+=sizeof(lane)){
+        memcpy(lane, p + i, sizeof(lane));
+        for(j=0;j<4;j++){
+            acc[j] += lane[j] * PRIME2;
+            acc[j]  = ROTL(acc[j], 31);
+            acc[j] *= PRIME1;
+        }
+    }
+    h = ROTL(acc[0], 1) + ROTL(acc[1], 7) + ROTL(acc[2], 12) + ROTL(acc[3], 18);
+    for(;i<size;i++){
+        h ^= p[i] * PRIME3;
+        h  = ROTL(h, 11) * PRIME1;
+    }
+    h ^= (uint64_t)size;
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME4;
+    h ^= h >> 32;
+    return h;
+}
+
+/** Look for a tracked buffer. The mutex must be locked.
+ * @param mem Buffer.
+ * @return Tracked buffer, NULL if it is not tracked.
+ */
+static struct deltaBuffer_st* findDeltaBuffer(cl_mem mem)
+{
+    unsigned int i;
+    for(i=0;i<num_buffers;i++){
+        if(buffers[i].mem == mem)
+            return &(buffers[i]);
+    }
+    return NULL;
+}
+
+/** Invalidate the blocks of a tracked buffer overlapping a region.
+ * The mutex must be locked.
+ * @param b Tracked buffer.
+ * @param offset Offset of the region in bytes.
+ * @param cb Size of the region in bytes.
+ */
+static void invalidateBlocks(struct deltaBuffer_st *b, size_t offset, size_t cb)
+{
+    size_t first, last;
+    b->epoch++;
+    b->stale = 1;
+    if((!b->valid) || (offset >= b->size) || (!cb))
+        return;
+    if(cb > b->size - offset)
+        cb = b->size - offset;
+    first = offset / OCLAND_DELTA_BLOCK;
+    last  = (offset + cb - 1) / OCLAND_DELTA_BLOCK;
+    memset(b->valid + first, 0, last - first + 1);
+}
+
+void addDeltaBuffer(cl_mem mem, cl_mem_flags flags, size_t size)
+{
+    struct deltaBuffer_st *backup;
+    // Writes smaller than a block are always sent in full, but the
+    // mirrored host memory must be tracked anyway
+    if((size < OCLAND_DELTA_BLOCK) && !(flags & CL_MEM_USE_HOST_PTR))
+        return;
+    pthread_mutex_lock(&delta_mutex);
+    if(findDeltaBuffer(mem)){
+        pthread_mutex_unlock(&delta_mutex);
+        return;
+    }
+    backup  = buffers;
+    buffers = (struct deltaBuffer_st*)realloc(buffers, (num_buffers + 1) * sizeof(struct deltaBuffer_st));
+    if(!buffers){
+        buffers = backup;
+        pthread_mutex_unlock(&delta_mutex);
+        return;
+    }
+    buffers[num_buffers].mem        = mem;
+    buffers[num_buffers].flags      = flags;
+    buffers[num_buffers].size       = size;
+    buffers[num_buffers].num_blocks = (size + OCLAND_DELTA_BLOCK - 1) / OCLAND_DELTA_BLOCK;
+    buffers[num_buffers].hashes     = NULL;
+    buffers[num_buffers].valid      = NULL;
+    buffers[num_buffers].epoch      = 0;
+    buffers[num_buffers].host_ptr   = NULL;
+    buffers[num_buffers].stale      = 0;
+    buffers[num_buffers].maps       = 0;
+    buffers[num_buffers].written    = 0;
+    num_buffers++;
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void delDeltaBuffer(cl_mem mem)
+{
+    unsigned int i, id=0;
+    pthread_mutex_lock(&delta_mutex);
+    for(i=0;i<num_buffers;i++){
+        if(buffers[i].mem == mem){
+            free(buffers[i].hashes);
+            free(buffers[i].valid);
+            continue;
+        }
+        buffers[id] = buffers[i];
+        id++;
+    }
+    num_buffers = id;
+    id = 0;
+    for(i=0;i<num_args;i++){
+        if(args[i].mem == mem)
+            continue;
+        args[id] = args[i];
+        id++;
+    }
+    num_args = id;
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+cl_mem_flags getDeltaBufferFlags(cl_mem mem)
+{
+    struct deltaBuffer_st *b;
+    cl_mem_flags flags = 0;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b)
+        flags = b->flags;
+    pthread_mutex_unlock(&delta_mutex);
+    return flags;
+}
+
+void invalidateDeltaBuffer(cl_mem mem, size_t offset, size_t cb)
+{
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b)
+        invalidateBlocks(b, offset, cb);
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void setDeltaKernelArg(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void *arg_value)
+{
+    unsigned int i, id=0;
+    struct deltaArg_st *backup;
+    pthread_mutex_lock(&delta_mutex);
+    // Forget the previous value of the argument
+    for(i=0;i<num_args;i++){
+        if((args[i].kernel == kernel) && (args[i].arg_index == arg_index))
+            continue;
+        args[id] = args[i];
+        id++;
+    }
+    num_args = id;
+    if((arg_size != sizeof(cl_mem)) || (!arg_value) || (!findDeltaBuffer(*(cl_mem*)arg_value))){
+        pthread_mutex_unlock(&delta_mutex);
+        return;
+    }
+    backup = args;
+    args   = (struct deltaArg_st*)realloc(args, (num_args + 1) * sizeof(struct deltaArg_st));
+    if(!args){
+        // The kernel can't be followed anymore, so the buffer is dropped
+        args = backup;
+        pthread_mutex_unlock(&delta_mutex);
+        delDeltaBuffer(*(cl_mem*)arg_value);
+        return;
+    }
+    args[num_args].kernel    = kernel;
+    args[num_args].arg_index = arg_index;
+    args[num_args].mem       = *(cl_mem*)arg_value;
+    num_args++;
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void invalidateDeltaKernel(cl_kernel kernel)
+{
+    unsigned int i;
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    for(i=0;i<num_args;i++){
+        if(args[i].kernel != kernel)
+            continue;
+        b = findDeltaBuffer(args[i].mem);
+        if(b && !(b->flags & CL_MEM_READ_ONLY))
+            invalidateBlocks(b, 0, b->size);
+    }
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void delDeltaKernel(cl_kernel kernel)
+{
+    unsigned int i, id=0;
+    pthread_mutex_lock(&delta_mutex);
+    for(i=0;i<num_args;i++){
+        if(args[i].kernel == kernel)
+            continue;
+        args[id] = args[i];
+        id++;
+    }
+    num_args = id;
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+cl_bool beginDeltaWrite(cl_mem mem, size_t offset, size_t cb, const void *ptr, deltaWrite *w)
+{
+    struct deltaBuffer_st *b;
+    size_t i, first, last, start, end, size;
+    uint64_t *hashes;
+    cl_bool clean;
+    w->num_ranges = 0;
+    w->ranges     = NULL;
+    w->dirty      = cb;
+    w->epoch      = 0;
+    if(!cb)
+        return CL_FALSE;
+    // Get the buffer data, allocating the hashes in the first write
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if((!b) || (offset > b->size) || (cb > b->size - offset)){
+        pthread_mutex_unlock(&delta_mutex);
+        return CL_FALSE;
+    }
+    if(!b->hashes){
+        b->hashes = (uint64_t*)malloc(b->num_blocks * sizeof(uint64_t));
+        b->valid  = (unsigned char*)calloc(b->num_blocks, sizeof(unsigned char));
+        if((!b->hashes) || (!b->valid)){
+            free(b->hashes); b->hashes = NULL;
+            free(b->valid); b->valid = NULL;
+            pthread_mutex_unlock(&delta_mutex);
+            return CL_FALSE;
+        }
+    }
+    size = b->size;
+    pthread_mutex_unlock(&delta_mutex);
+    // Hash the data out of the lock, since it is the expensive part
+    first  = offset / OCLAND_DELTA_BLOCK;
+    last   = (offset + cb - 1) / OCLAND_DELTA_BLOCK;
+    hashes = (uint64_t*)malloc((last - first + 1) * sizeof(uint64_t));
+    w->ranges = (size_t*)malloc(2 * (last - first + 1) * sizeof(size_t));
+    if((!hashes) || (!w->ranges)){
+        free(hashes);
+        free(w->ranges); w->ranges = NULL;
+        return CL_FALSE;
+    }
+    for(i=first;i<=last;i++){
+        start = i * OCLAND_DELTA_BLOCK;
+        end   = start + OCLAND_DELTA_BLOCK < size ? start + OCLAND_DELTA_BLOCK : size;
+        if((start < offset) || (end > offset + cb))
+            continue;
+        hashes[i - first] = hashBlock((const char*)ptr + (start - offset), end - start);
+    }
+    // Compare with the stored hashes, which are replaced
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(!b || !b->hashes){
+        pthread_mutex_unlock(&delta_mutex);
+        free(hashes);
+        free(w->ranges); w->ranges = NULL;
+        return CL_FALSE;
+    }
+    w->dirty = 0;
+    for(i=first;i<=last;i++){
+        start = i * OCLAND_DELTA_BLOCK;
+        end   = start + OCLAND_DELTA_BLOCK < size ? start + OCLAND_DELTA_BLOCK : size;
+        clean = CL_FALSE;
+        if((start >= offset) && (end <= offset + cb)){
+            clean = b->valid[i] && (b->hashes[i] == hashes[i - first]);
+            b->hashes[i] = hashes[i - first];
+        }
+        b->valid[i] = 0;
+        if(clean)
+            continue;
+        if(start < offset)
+            start = offset;
+        if(end > offset + cb)
+            end = offset + cb;
+        w->dirty += end - start;
+        if(w->num_ranges && (w->ranges[2 * w->num_ranges - 2] + w->ranges[2 * w->num_ranges - 1] == start)){
+            w->ranges[2 * w->num_ranges - 1] += end - start;
+            continue;
+        }
+        w->ranges[2 * w->num_ranges]     = start;
+        w->ranges[2 * w->num_ranges + 1] = end - start;
+        w->num_ranges++;
+    }
+    b->epoch++;
+    w->epoch = b->epoch;
+    // The buffer data doesn't match the mirrored host memory anymore
+    if(b->host_ptr && ((const char*)b->host_ptr + offset != (const char*)ptr))
+        b->stale = 1;
+    pthread_mutex_unlock(&delta_mutex);
+    free(hashes);
+    if(!w->num_ranges){
+        // Nothing changed, but the first block is sent anyway
+        end = (first + 1) * OCLAND_DELTA_BLOCK;
+        w->ranges[0]  = offset;
+        w->ranges[1]  = (end < offset + cb ? end : offset + cb) - offset;
+        w->dirty      = w->ranges[1];
+        w->num_ranges = 1;
+    }
+    return CL_TRUE;
+}
+
+void endDeltaWrite(cl_mem mem, size_t offset, size_t cb, deltaWrite *w, cl_int flag)
+{
+    struct deltaBuffer_st *b;
+    size_t i, first, last, start, end;
+    free(w->ranges); w->ranges = NULL;
+    w->num_ranges = 0;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if((!b) || (!b->valid)){
+        pthread_mutex_unlock(&delta_mutex);
+        return;
+    }
+    if((flag != CL_SUCCESS) || (b->epoch != w->epoch)){
+        invalidateBlocks(b, offset, cb);
+        pthread_mutex_unlock(&delta_mutex);
+        return;
+    }
+    first = offset / OCLAND_DELTA_BLOCK;
+    last  = (offset + cb - 1) / OCLAND_DELTA_BLOCK;
+    for(i=first;i<=last;i++){
+        start = i * OCLAND_DELTA_BLOCK;
+        end   = start + OCLAND_DELTA_BLOCK < b->size ? start + OCLAND_DELTA_BLOCK : b->size;
+        if((start >= offset) && (end <= offset + cb))
+            b->valid[i] = 1;
+    }
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void addDeltaHostPtr(cl_mem mem, void *host_ptr)
+{
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b)
+        b->host_ptr = host_ptr;
+    pthread_mutex_unlock(&delta_mutex);
+    if(b)
+        validateDeltaHostPtr(mem);
+}
+
+void* getDeltaHostPtr(cl_mem mem, size_t *size, cl_bool *stale)
+{
+    struct deltaBuffer_st *b;
+    void *host_ptr = NULL;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b && b->host_ptr){
+        host_ptr = b->host_ptr;
+        if(size) *size = b->size;
+        if(stale) *stale = b->stale ? CL_TRUE : CL_FALSE;
+    }
+    pthread_mutex_unlock(&delta_mutex);
+    return host_ptr;
+}
+
+void validateDeltaHostPtr(cl_mem mem)
+{
+    struct deltaBuffer_st *b;
+    deltaWrite w;
+    size_t size;
+    void *host_ptr = getDeltaHostPtr(mem, &size, NULL);
+    if(!host_ptr)
+        return;
+    // Store the hashes as if the host memory had been written
+    if(beginDeltaWrite(mem, 0, size, host_ptr, &w))
+        endDeltaWrite(mem, 0, size, &w, CL_SUCCESS);
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b && (b->epoch == w.epoch))
+        b->stale = 0;
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+cl_bool isDeltaHostPtrDirty(cl_mem mem)
+{
+    struct deltaBuffer_st *b;
+    size_t i, start, end, num_blocks, size;
+    const char *host_ptr;
+    uint64_t *hashes;
+    unsigned char *valid;
+    cl_bool dirty = CL_FALSE;
+    // Copy the hashes, to compute the new ones out of the lock
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if((!b) || (!b->host_ptr) || (!b->hashes)){
+        pthread_mutex_unlock(&delta_mutex);
+        return CL_TRUE;
+    }
+    // The host memory can't be modified unless it is mapped for writing
+    if(!b->written){
+        pthread_mutex_unlock(&delta_mutex);
+        return CL_FALSE;
+    }
+    host_ptr   = (const char*)b->host_ptr;
+    size       = b->size;
+    num_blocks = b->num_blocks;
+    hashes     = (uint64_t*)malloc(num_blocks * sizeof(uint64_t));
+    valid      = (unsigned char*)malloc(num_blocks * sizeof(unsigned char));
+    if((!hashes) || (!valid)){
+        pthread_mutex_unlock(&delta_mutex);
+        free(hashes);
+        free(valid);
+        return CL_TRUE;
+    }
+    memcpy(hashes, b->hashes, num_blocks * sizeof(uint64_t));
+    memcpy(valid, b->valid, num_blocks * sizeof(unsigned char));
+    pthread_mutex_unlock(&delta_mutex);
+    for(i=0;i<num_blocks;i++){
+        start = i * OCLAND_DELTA_BLOCK;
+        end   = start + OCLAND_DELTA_BLOCK < size ? start + OCLAND_DELTA_BLOCK : size;
+        if((!valid[i]) || (hashes[i] != hashBlock(host_ptr + start, end - start))){
+            dirty = CL_TRUE;
+            break;
+        }
+    }
+    free(hashes);
+    free(valid);
+    return dirty;
+}
+
+void mapDeltaHostPtr(cl_mem mem, cl_bool write)
+{
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b && b->host_ptr){
+        b->maps++;
+        if(write == CL_TRUE)
+            b->written = 1;
+    }
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+void unmapDeltaHostPtr(cl_mem mem)
+{
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    b = findDeltaBuffer(mem);
+    if(b && b->host_ptr && b->maps){
+        b->maps--;
+        if(!b->maps)
+            b->written = 0;
+    }
+    pthread_mutex_unlock(&delta_mutex);
+}
+
+cl_uint getDeltaKernelHostPtrs(cl_kernel kernel, cl_mem *mems, cl_uint max)
+{
+    unsigned int i;
+    cl_uint n = 0;
+    struct deltaBuffer_st *b;
+    pthread_mutex_lock(&delta_mutex);
+    for(i=0;(i<num_args)&&(n<max);i++){
+        if(args[i].kernel != kernel)
+            continue;
+        b = findDeltaBuffer(args[i].mem);
+        if(b && b->host_ptr)
+            mems[n++] = args[i].mem;
+    }
+    pthread_mutex_unlock(&delta_mutex);
+    return n;
+}
@@ -0,0 +1,406 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <ocland/client/descriptorCache.h>
+
+#ifndef OCLAND_CACHE_TTL
+    #define OCLAND_CACHE_TTL 300u
+#endif
+
+/// Cache file identifier, followed by the format version
+#define OCLAND_CACHE_MAGIC   0x6f636c64u
+#define OCLAND_CACHE_VERSION 1u
+
+/// Cached descriptors
+static descriptor descriptors = NULL;
+/// Cache file path, NULL if the cache is disabled
+static char *cache_path = NULL;
+/// Modified cache flag
+static cl_bool dirty = CL_FALSE;
+/// Descriptors list mutex
+static pthread_mutex_t descriptors_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Test if a descriptor has expired.
+ * @param d Descriptor.
+ * @param now Current time.
+ * @return CL_TRUE if the descriptor has expired, CL_FALSE otherwise.
+ */
+static cl_bool isExpired(descriptor d, time_t now)
+{
+    if((now < d->time) || (now - d->time > (time_t)OCLAND_CACHE_TTL))
+        return CL_TRUE;
+    return CL_FALSE;
+}
+
+/** Release a descriptor.
+ * @param d Descriptor.
+ */
+static void freeDescriptor(descriptor d)
+{
+    free(d->address);
+    free(d->value);
+    free(d);
+}
+
+/** Find a descriptor. The mutex must be locked.
+ * @param address Server address.
+ * @param kind Kind of query.
+ * @param object Queried object.
+ * @param param Queried parameter.
+ * @return Pointer to the list link of the descriptor, which points to NULL
+ * if it is not cached.
+ */
+static descriptor *findDescriptor(const char *address,
+                                  unsigned int kind,
+                                  cl_ulong object,
+                                  cl_ulong param)
+{
+    descriptor *d;
+    for(d=&descriptors;*d;d=&((*d)->next)){
+        if(    ((*d)->kind == kind)
+            && ((*d)->object == object)
+            && ((*d)->param == param)
+            && !strcmp((*d)->address, address))
+            break;
+    }
+    return d;
+}
+
+/** Discard all the descriptors of a server. The mutex must be locked.
+ * @param address Server address.
+ */
+static void dropDescriptors(const char *address)
+{
+    descriptor *d = &descriptors;
+    while(*d){
+        descriptor next = (*d)->next;
+        if(!strcmp((*d)->address, address)){
+            freeDescriptor(*d);
+            *d = next;
+            continue;
+        }
+        d = &((*d)->next);
+    }
+}
+
+/** Read a descriptor from the cache file.
+ * @param f Cache file.
+ * @return Descriptor, NULL if the end of the file has been reached or it
+ * is corrupted.
+ */
+static descriptor readDescriptor(FILE *f)
+{
+    uint32_t len, kind;
+    uint64_t object, param, size;
+    int64_t t;
+    if(    (fread(&len, sizeof(uint32_t), 1, f) != 1)
+        || (len > 4096))
+        return NULL;
+    descriptor d = (descriptor)calloc(1, sizeof(struct descriptor_st));
+    if(!d)
+        return NULL;
+    d->address = (char*)malloc((len+1)*sizeof(char));
+    if(    !d->address
+        || (fread(d->address, sizeof(char), len, f) != len)
+        || (fread(&kind, sizeof(uint32_t), 1, f) != 1)
+        || (fread(&object, sizeof(uint64_t), 1, f) != 1)
+        || (fread(&param, sizeof(uint64_t), 1, f) != 1)
+        || (fread(&t, sizeof(int64_t), 1, f) != 1)
+        || (fread(&size, sizeof(uint64_t), 1, f) != 1)
+        || (size > 65536)){
+        freeDescriptor(d);
+        return NULL;
+    }
+    d->address[len] = '\0';
+    d->kind   = kind;
+    d->object = object;
+    d->param  = param;
+    d->time   = (time_t)t;
+    d->size   = size;
+    d->value  = malloc(size ? size : 1);
+    if(!d->value || (fread(d->value, 1, size, f) != size)){
+        freeDescriptor(d);
+        return NULL;
+    }
+    return d;
+}
+
+/** Write a descriptor to the cache file.
+ * @param f Cache file.
+ * @param d Descriptor.
+ * @return CL_TRUE if the descriptor has been written, CL_FALSE otherwise.
+ */
+static cl_bool writeDescriptor(FILE *f, descriptor d)
+{
+    uint32_t len  = strlen(d->address);
+    uint32_t kind = d->kind;
+    uint64_t object = d->object, param = d->param, size = d->size;
+    int64_t t = d->time;
+    if(    (fwrite(&len, sizeof(uint32_t), 1, f) != 1)
+        || (fwrite(d->address, sizeof(char), len, f) != len)
+        || (fwrite(&kind, sizeof(uint32_t), 1, f) != 1)
+        || (fwrite(&object, sizeof(uint64_t), 1, f) != 1)
+        || (fwrite(&param, sizeof(uint64_t), 1, f) != 1)
+        || (fwrite(&t, sizeof(int64_t), 1, f) != 1)
+        || (fwrite(&size, sizeof(uint64_t), 1, f) != 1)
+        || (fwrite(d->value, 1, d->size, f) != d->size))
+        return CL_FALSE;
+    return CL_TRUE;
+}
+
+void loadDescriptors()
+{
+    uint32_t header[2];
+    pthread_mutex_lock(&descriptors_mutex);
+    if(cache_path){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    // Get the cache file path
+    const char *env = getenv("OCLAND_CACHE");
+    if(env){
+        if(!strlen(env)){
+            pthread_mutex_unlock(&descriptors_mutex);
+            return;
+        }
+        cache_path = strdup(env);
+    }
+    else{
+        const char *home = getenv("HOME");
+        if(!home){
+            pthread_mutex_unlock(&descriptors_mutex);
+            return;
+        }
+        cache_path = (char*)malloc((strlen(home)+strlen("/.ocland_cache")+1)*sizeof(char));
+        if(cache_path)
+            sprintf(cache_path, "%s/.ocland_cache", home);
+    }
+    if(!cache_path){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    atexit(saveDescriptors);
+    // Read the descriptors, keeping the ones not expired yet
+    FILE *f = fopen(cache_path, "rb");
+    if(!f){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    if(    (fread(header, sizeof(uint32_t), 2, f) == 2)
+        && (header[0] == OCLAND_CACHE_MAGIC)
+        && (header[1] == OCLAND_CACHE_VERSION)){
+        time_t now = time(NULL);
+        descriptor d;
+        while((d = readDescriptor(f))){
+            if(isExpired(d, now)){
+                freeDescriptor(d);
+                continue;
+            }
+            d->next     = descriptors;
+            descriptors = d;
+        }
+    }
+    fclose(f);
+    pthread_mutex_unlock(&descriptors_mutex);
+}
+
+void saveDescriptors()
+{
+    uint32_t header[2] = {OCLAND_CACHE_MAGIC, OCLAND_CACHE_VERSION};
+    descriptor d;
+    pthread_mutex_lock(&descriptors_mutex);
+    if(!cache_path || !dirty){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    // Write a temporary file, renamed later over the cache file
+    char tmp_path[strlen(cache_path)+strlen(".XXXXXX")+1];
+    sprintf(tmp_path, "%s.XXXXXX", cache_path);
+    int fd = mkstemp(tmp_path);
+    if(fd < 0){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    FILE *f = fdopen(fd, "wb");
+    if(!f){
+        close(fd);
+        unlink(tmp_path);
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    cl_bool ok = (fwrite(header, sizeof(uint32_t), 2, f) == 2) ? CL_TRUE : CL_FALSE;
+    time_t now = time(NULL);
+    for(d=descriptors;d && ok;d=d->next){
+        if(isExpired(d, now))
+            continue;
+        ok = writeDescriptor(f, d);
+    }
+    if(fclose(f))
+        ok = CL_FALSE;
+    if(!ok || rename(tmp_path, cache_path))
+        unlink(tmp_path);
+    else
+        dirty = CL_FALSE;
+    pthread_mutex_unlock(&descriptors_mutex);
+}
+
+void storeDescriptor(const char *address,
+                     unsigned int kind,
+                     const void *object,
+                     cl_ulong param,
+                     const void *value,
+                     size_t size)
+{
+    pthread_mutex_lock(&descriptors_mutex);
+    if(!cache_path){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    descriptor *link = findDescriptor(address, kind, (cl_ulong)(uintptr_t)object, param);
+    descriptor d = *link;
+    if(d && (kind == OCLAND_CACHE_PLATFORMS)){
+        // A new platforms list means that the server handles changed
+        if((d->size != size) || (size && memcmp(d->value, value, size))){
+            dropDescriptors(address);
+            d = NULL;
+        }
+    }
+    if(!d){
+        d = (descriptor)calloc(1, sizeof(struct descriptor_st));
+        if(!d){
+            pthread_mutex_unlock(&descriptors_mutex);
+            return;
+        }
+        d->address = strdup(address);
+        if(!d->address){
+            free(d);
+            pthread_mutex_unlock(&descriptors_mutex);
+            return;
+        }
+        d->kind     = kind;
+        d->object   = (cl_ulong)(uintptr_t)object;
+        d->param    = param;
+        d->next     = descriptors;
+        descriptors = d;
+    }
+    void *copy = malloc(size ? size : 1);
+    if(!copy){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return;
+    }
+    if(size)
+        memcpy(copy, value, size);
+    free(d->value);
+    d->value = copy;
+    d->size  = size;
+    d->time  = time(NULL);
+    dirty    = CL_TRUE;
+    pthread_mutex_unlock(&descriptors_mutex);
+}
+
+void *getDescriptor(const char *address,
+                    unsigned int kind,
+                    const void *object,
+                    cl_ulong param,
+                    size_t *size)
+{
+    void *value = NULL;
+    pthread_mutex_lock(&descriptors_mutex);
+    descriptor d = *findDescriptor(address, kind, (cl_ulong)(uintptr_t)object, param);
+    if(d && !isExpired(d, time(NULL))){
+        value = malloc(d->size ? d->size : 1);
+        if(value){
+            memcpy(value, d->value, d->size);
+            *size = d->size;
+        }
+    }
+    pthread_mutex_unlock(&descriptors_mutex);
+    return value;
+}
+
+cl_bool isDescriptorListed(const char *address, const void *object)
+{
+    size_t i;
+    descriptor d;
+    cl_bool listed = CL_FALSE;
+    pthread_mutex_lock(&descriptors_mutex);
+    for(d=descriptors;d && !listed;d=d->next){
+        if(    ((d->kind != OCLAND_CACHE_PLATFORMS) && (d->kind != OCLAND_CACHE_DEVICES))
+            || strcmp(d->address, address))
+            continue;
+        // Platforms and devices lists are arrays of handles
+        for(i=0;i<d->size/sizeof(void*);i++){
+            if(((void**)d->value)[i] == object){
+                listed = CL_TRUE;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&descriptors_mutex);
+    return listed;
+}
+
+long descriptorsAge(const char *address)
+{
+    long age = -1;
+    time_t now = time(NULL);
+    pthread_mutex_lock(&descriptors_mutex);
+    descriptor d = *findDescriptor(address, OCLAND_CACHE_PLATFORMS, 0, 0);
+    if(d && !isExpired(d, now))
+        age = (long)(now - d->time);
+    pthread_mutex_unlock(&descriptors_mutex);
+    return age;
+}
+
+unsigned int getDescriptorKeys(const char *address, struct descriptor_st **keys)
+{
+    unsigned int n = 0;
+    descriptor d;
+    *keys = NULL;
+    pthread_mutex_lock(&descriptors_mutex);
+    for(d=descriptors;d;d=d->next){
+        if(!strcmp(d->address, address))
+            n++;
+    }
+    if(n)
+        *keys = (struct descriptor_st*)calloc(n, sizeof(struct descriptor_st));
+    if(!*keys){
+        pthread_mutex_unlock(&descriptors_mutex);
+        return 0;
+    }
+    n = 0;
+    for(d=descriptors;d;d=d->next){
+        if(strcmp(d->address, address))
+            continue;
+        (*keys)[n].kind   = d->kind;
+        (*keys)[n].object = d->object;
+        (*keys)[n].param  = d->param;
+        (*keys)[n].time   = d->time;
+        n++;
+    }
+    pthread_mutex_unlock(&descriptors_mutex);
+    return n;
+}
@@ -17,17 +17,29 @@
  */
 
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <fcntl.h>
 
 #include <ocland/common/dataExchange.h>
+#include <ocland/common/dataCompression.h>
+#include <ocland/common/dataStripes.h>
+#include <ocland/common/dataShared.h>
+#include <ocland/common/sha256.h>
 #include <ocland/client/ocland_icd.h>
 #include <ocland/client/ocland.h>
 #include <ocland/client/shortcut.h>
+#include <ocland/client/deltaUpload.h>
+#include <ocland/client/pendingTransfers.h>
+#include <ocland/client/shadowMap.h>
+#include <ocland/client/descriptorCache.h>
 
 #ifndef OCLAND_PORT
     #define OCLAND_PORT 51000u
@@ -37,6 +49,49 @@
     #define BUFF_SIZE 1025u
 #endif
 
+#ifndef OCLAND_MAX_STREAMS
+    #define OCLAND_MAX_STREAMS 8u
+#endif
+
+#ifndef OCLAND_SHARED_MIN_SIZE
+    #define OCLAND_SHARED_MIN_SIZE 262144u
+#endif
+
+/// Maximum number of CL_MEM_USE_HOST_PTR buffers pushed before a kernel
+#define OCLAND_MAX_KERNEL_HOST_PTRS 64u
+
+#ifndef OCLAND_INLINE_SIZE
+    #define OCLAND_INLINE_SIZE 65536u
+#endif
+
+#ifndef OCLAND_INLINE_MAX_SIZE
+    #define OCLAND_INLINE_MAX_SIZE 1048576u
+#endif
+
+#ifndef OCLAND_DEDUP_MIN_SIZE
+    #define OCLAND_DEDUP_MIN_SIZE 1048576u
+#endif
+
+#ifndef OCLAND_CONNECT_TIMEOUT
+    #define OCLAND_CONNECT_TIMEOUT 3000u
+#endif
+
+#ifndef OCLAND_CACHE_TTL
+    #define OCLAND_CACHE_TTL 300u
+#endif
+
+/// Prefix of the servers reached through an Unix domain socket
+#define OCLAND_UNIX_PREFIX "unix:"
+
+/// Blocking flag of the non-blocking transfers carried inline in the
+/// command package, instead of along a parallel transfer channel
+#define OCLAND_INLINE_TRANSFER 2u
+
+/// Cache status of a deduplicated upload, as reported by the server
+#define OCLAND_BLOB_HIT       0u
+#define OCLAND_BLOB_MISS      1u
+#define OCLAND_BLOB_UNCACHED  2u
+
 /// Servers data storage
 static oclandServers* servers = NULL;
 /// Servers initialization flag
@@ -117,7 +172,11 @@ enum {
     ocland_clEnqueueMarkerWithWaitList,
     ocland_clEnqueueBarrierWithWaitList,
     ocland_clCreateImage2D,
-    ocland_clCreateImage3D
+    ocland_clCreateImage3D,
+    ocland_clEnqueueWriteBufferBlocks,
+    ocland_clCreateBufferBlob,
+    ocland_clEnqueueWriteBufferBlob,
+    ocland_clEnqueueCopyBufferToPeer
 };
 
 /** Waits until the server is locked, and then gives access
@@ -166,7 +225,9 @@ void unlock(int socket){
 }
 
 /** Load servers file "ocland". File must contain
- * IP address of each server, one per line.
+ * IP address of each server, one per line. Servers running in the same
+ * host can be reached through their Unix domain socket, using the
+ * "unix:/path/to/socket" form.
  * @return Number of servers.
  */
 unsigned int loadServers()
@@ -178,6 +239,7 @@ unsigned int loadServers()
     servers->address = NULL;
     servers->sockets = NULL;
     servers->locked  = NULL;
+    servers->deferred = NULL;
     // Load servers definition files
     FILE *fin = NULL;
     fin = fopen("ocland", "r");
@@ -200,6 +262,7 @@ unsigned int loadServers()
     servers->address = (char**)malloc(servers->num_servers*sizeof(char*));
     servers->sockets = (int*)malloc(servers->num_servers*sizeof(int));
     servers->locked  = (cl_bool*)malloc(servers->num_servers*sizeof(cl_bool));
+    servers->deferred = (cl_bool*)malloc(servers->num_servers*sizeof(cl_bool));
     i = 0;
     line = NULL;linelen = 0;
     while((read = getline(&line, &linelen, fin)) != -1) {
@@ -212,38 +275,148 @@ unsigned int loadServers()
         strcpy(strstr(servers->address[i], "\n"), "");
         servers->sockets[i] = -1;
         servers->locked[i]  = CL_FALSE;
+        servers->deferred[i] = CL_FALSE;
         free(line); line = NULL;linelen = 0;
         i++;
     }
     return servers->num_servers;
 }
 
-/** Connect to servers found on "ocland" file.
- * @return Number of active servers.
+/** Build the socket address of a server.
+ * @param address Server address, either an IP address or an Unix domain
+ * socket in "unix:/path/to/socket" form.
+ * @param port Port of the asynchronous data transfer, 0 for the main
+ * connection. In Unix domain sockets the port is appended to the path.
+ * @param addr Returned socket address.
+ * @param addrlen Returned socket address length.
+ * @return Socket domain, -1 if the address is not valid.
+ */
+static int serverSocketAddress(const char *address, unsigned int port,
+                               struct sockaddr_storage *addr, socklen_t *addrlen)
+{
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    if(!strncmp(address, OCLAND_UNIX_PREFIX, strlen(OCLAND_UNIX_PREFIX))){
+        struct sockaddr_un *serv_addr = (struct sockaddr_un*)addr;
+        const char *path = address + strlen(OCLAND_UNIX_PREFIX);
+        int len;
+        serv_addr->sun_family = AF_UNIX;
+        if(port)
+            len = snprintf(serv_addr->sun_path, sizeof(serv_addr->sun_path), "%s.%u", path, port);
+        else
+            len = snprintf(serv_addr->sun_path, sizeof(serv_addr->sun_path), "%s", path);
+        if((len <= 0) || ((size_t)len >= sizeof(serv_addr->sun_path)))
+            return -1;
+        *addrlen = sizeof(struct sockaddr_un);
+        return AF_UNIX;
+    }
+    struct sockaddr_in *serv_addr = (struct sockaddr_in*)addr;
+    serv_addr->sin_family = AF_INET;
+    serv_addr->sin_port   = htons(port ? port : OCLAND_PORT);
+    if(inet_pton(AF_INET, address, &serv_addr->sin_addr)<=0)
+        return -1;
+    *addrlen = sizeof(struct sockaddr_in);
+    return AF_INET;
+}
+
+/** Get the time given to the servers to accept the connection. It can
+ * be set in milliseconds with the OCLAND_CONNECT_TIMEOUT environment
+ * variable.
+ * @return Connection timeout in milliseconds.
+ */
+static long connectTimeout()
+{
+    static long timeout = -1;
+    if(timeout < 0){
+        const char *env = getenv("OCLAND_CONNECT_TIMEOUT");
+        timeout = env ? atol(env) : -1;
+        if(timeout < 0)
+            timeout = OCLAND_CONNECT_TIMEOUT;
+    }
+    return timeout;
+}
+
+/** Connect to servers found on "ocland" file. The connections are
+ * started at once with non-blocking sockets, such that the unreachable
+ * servers are discarded after the connection timeout, instead of
+ * stalling the initialization for the whole TCP timeout each one.
+ * @param targets Servers to connect to.
+ * @return Number of servers connected.
  */
-unsigned int connectServers()
+unsigned int connectServers(const cl_bool *targets)
 {
     int switch_on  = 1;
-    int switch_off = 0;
-    unsigned int i,n=0;
+    unsigned int i,n=0,pending=0;
+    if(!servers->num_servers)
+        return 0;
+    int domains[servers->num_servers];
+    struct pollfd fds[servers->num_servers];
     for(i=0;i<servers->num_servers;i++){
-        // Try to connect to server
+        // Negative sockets are ignored by poll()
+        fds[i].fd      = -1;
+        fds[i].events  = POLLOUT;
+        fds[i].revents = 0;
+        if(!targets[i])
+            continue;
+        // Start the connection to server
         int sockfd = 0;
-        struct sockaddr_in serv_addr;
-        if((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        struct sockaddr_storage serv_addr;
+        socklen_t serv_addr_len;
+        domains[i] = serverSocketAddress(servers->address[i], 0, &serv_addr, &serv_addr_len);
+        if(domains[i] < 0)
             continue;
-        memset(&serv_addr, '0', sizeof(serv_addr));
-        serv_addr.sin_family = AF_INET;
-        serv_addr.sin_port = htons(OCLAND_PORT);
-        if(inet_pton(AF_INET, servers->address[i], &serv_addr.sin_addr)<=0)
+        if((sockfd = socket(domains[i], SOCK_STREAM, 0)) < 0)
             continue;
-        if( connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+        fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+        if(    (connect(sockfd, (struct sockaddr *)&serv_addr, serv_addr_len) < 0)
+            && (errno != EINPROGRESS)){
+            close(sockfd);
             continue;
-        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY,  (char *) &switch_on, sizeof(int));
-        setsockopt(sockfd, IPPROTO_TCP, TCP_QUICKACK, (char *) &switch_on, sizeof(int));
-        // Store socket
-        servers->sockets[i] = sockfd;
-        n++;
+        }
+        fds[i].fd = sockfd;
+        pending++;
+    }
+    // Wait for the servers until the deadline
+    struct timeval t0, t1;
+    gettimeofday(&t0, NULL);
+    long timeout = connectTimeout();
+    while(pending){
+        gettimeofday(&t1, NULL);
+        long elapsed = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_usec - t0.tv_usec) / 1000;
+        if(elapsed >= timeout)
+            break;
+        int ready = poll(fds, servers->num_servers, (int)(timeout - elapsed));
+        if((ready < 0) && (errno == EINTR))
+            continue;
+        if(ready <= 0)
+            break;
+        for(i=0;i<servers->num_servers;i++){
+            if((fds[i].fd < 0) || (!fds[i].revents))
+                continue;
+            int sockfd = fds[i].fd;
+            int error = 0;
+            socklen_t error_len = sizeof(int);
+            fds[i].fd = -1;
+            pending--;
+            if(    (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0)
+                || error){
+                close(sockfd);
+                continue;
+            }
+            // The commands are exchanged with blocking sockets
+            fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) & ~O_NONBLOCK);
+            if(domains[i] == AF_INET){
+                setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY,  (char *) &switch_on, sizeof(int));
+                setsockopt(sockfd, IPPROTO_TCP, TCP_QUICKACK, (char *) &switch_on, sizeof(int));
+            }
+            // Store socket
+            servers->sockets[i] = sockfd;
+            n++;
+        }
+    }
+    // Discard the servers which have not answered in time
+    for(i=0;i<servers->num_servers;i++){
+        if(fds[i].fd >= 0)
+            close(fds[i].fd);
     }
     return n;
 }
@@ -263,25 +436,328 @@ char* serverAddress(int socket)
     return NULL;
 }
 
+/** Send a package whose last field is user data, gathering the package
+ * header and the user memory in a single transmission, such that the
+ * data is never copied into the package. The socket must be already
+ * locked.
+ * @param sockfd Server socket.
+ * @param msg Package header.
+ * @param msgSize Size of the package, user data included.
+ * @param data User data appended at the end of the package. Can be NULL.
+ * @param size Size of the user data.
+ */
+static void sendPackage(int *sockfd, void *msg, size_t msgSize, const void *data, size_t size)
+{
+    struct iovec iov[3];
+    iov[0].iov_base = &msgSize;
+    iov[0].iov_len  = sizeof(size_t);
+    iov[1].iov_base = msg;
+    iov[1].iov_len  = msgSize - size;
+    iov[2].iov_base = (void*)data;
+    iov[2].iov_len  = size;
+    SendV(sockfd, iov, 3);
+}
+
+
+/** @struct platformsQuery
+ * Platforms query to a server, carried out in its own thread.
+ */
+struct platformsQuery
+{
+    /// Server index
+    unsigned int server;
+    /// Maximum number of platforms to get
+    cl_uint num_entries;
+    /// Returned platforms
+    cl_platform_id *platforms;
+    /// Returned number of platforms of the server
+    cl_uint num_platforms;
+    /// Returned error code
+    cl_int flag;
+};
+
+/** Thread which gets the platforms of a server. The platforms list is
+ * stored in the descriptors cache when it is complete.
+ * @param data struct platformsQuery casted variable.
+ * @return NULL
+ */
+static void *platformsQuery_thread(void *data)
+{
+    unsigned int j;
+    struct platformsQuery *query = (struct platformsQuery*)data;
+    // Create a package with all the data to send,
+    // in order to accelerate as much as possible
+    // the data transmission, requesting only one
+    // connection to send, and another one to receive
+    size_t msgSize  = sizeof(unsigned int);  // Command index
+    msgSize        += sizeof(cl_uint);       // num_entries
+    void* msg = (void*)malloc(msgSize);
+    void* ptr = msg;
+    ((unsigned int*)ptr)[0] = ocland_clGetPlatformIDs; ptr = (unsigned int*)ptr + 1;
+    ((cl_uint*)ptr)[0]      = query->num_entries;
+    // Send the package (first the size, and then the data)
+    lock(servers->sockets[query->server]);
+    int *sockfd = &(servers->sockets[query->server]);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    ptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(servers->sockets[query->server]);
+    // Decript the data
+    query->flag = ((cl_int*)ptr)[0];  ptr = (cl_int*)ptr  + 1;
+    if(query->flag != CL_SUCCESS){
+        free(msg); msg=NULL;
+        return NULL;
+    }
+    query->num_platforms = ((cl_uint*)ptr)[0]; ptr = (cl_uint*)ptr + 1;
+    cl_uint n = (query->num_platforms < query->num_entries) ? query->num_platforms : query->num_entries;
+    for(j=0;j<n;j++){
+        query->platforms[j] = ((cl_platform_id*)ptr)[j];
+    }
+    if(query->num_platforms <= query->num_entries){
+        storeDescriptor(servers->address[query->server], OCLAND_CACHE_PLATFORMS,
+                        NULL, 0, query->platforms, n*sizeof(cl_platform_id));
+    }
+    free(msg); msg=NULL;
+    return NULL;
+}
+
+/** Get the full platforms list of a server, such that it is stored in the
+ * descriptors cache. If the platforms have changed since they were cached
+ * (e.g. the server has been restarted), all the cached descriptors of the
+ * server are discarded.
+ * @param server Server index.
+ */
+static void checkPlatforms(unsigned int server)
+{
+    struct platformsQuery query;
+    query.server        = server;
+    query.num_entries   = 0;
+    query.platforms     = NULL;
+    query.num_platforms = 0;
+    query.flag          = CL_SUCCESS;
+    platformsQuery_thread((void *)&query);
+    if((query.flag != CL_SUCCESS) || !query.num_platforms)
+        return;
+    query.platforms = (cl_platform_id*)malloc(query.num_platforms*sizeof(cl_platform_id));
+    if(!query.platforms)
+        return;
+    query.num_entries = query.num_platforms;
+    platformsQuery_thread((void *)&query);
+    free(query.platforms); query.platforms=NULL;
+}
+
+/// Deferred connections mutex
+static pthread_mutex_t connect_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Connect to a server whose connection was deferred. The platforms of
+ * the server are checked against the cached ones, such that the handles
+ * given from an outdated cache are reported as invalid afterwards.
+ * @param server Server index.
+ * @return CL_TRUE if the server is active, CL_FALSE otherwise.
+ */
+static cl_bool connectDeferred(unsigned int server)
+{
+    unsigned int i;
+    pthread_mutex_lock(&connect_mutex);
+    if(servers->deferred[server]){
+        cl_bool targets[servers->num_servers];
+        for(i=0;i<servers->num_servers;i++)
+            targets[i] = (i == server) ? CL_TRUE : CL_FALSE;
+        if(connectServers(targets))
+            checkPlatforms(server);
+        servers->deferred[server] = CL_FALSE;
+    }
+    pthread_mutex_unlock(&connect_mutex);
+    return (servers->sockets[server] >= 0) ? CL_TRUE : CL_FALSE;
+}
+
+/** Connect to the deferred servers owning a platform or device, before
+ * sending them a command about it.
+ * @param object Platform or device. NULL to connect to all the deferred
+ * servers.
+ */
+static void connectOwner(const void *object)
+{
+    unsigned int i;
+    for(i=0;i<servers->num_servers;i++){
+        if(!servers->deferred[i])
+            continue;
+        if(!object || isDescriptorListed(servers->address[i], object))
+            connectDeferred(i);
+    }
+}
+
+/** Connect to the deferred servers owning the platform of some context
+ * properties, or to all of them if the platform is not specified.
+ * @param properties Context properties.
+ * @param num_properties Number of properties into properties array.
+ */
+static void connectPropertiesOwner(const cl_context_properties *properties,
+                                   cl_uint                      num_properties)
+{
+    cl_uint i;
+    for(i=0;i+1<num_properties;i+=2){
+        if(properties[i] == CL_CONTEXT_PLATFORM){
+            connectOwner((void*)properties[i+1]);
+            return;
+        }
+    }
+    connectOwner(NULL);
+}
+
+/** Get the answer to a query from the descriptors cache, if the queried
+ * object belongs to a deferred server. If the answer is not cached the
+ * server is connected, such that the query is sent to it.
+ * @param kind Kind of query.
+ * @param object Queried platform or device.
+ * @param param Queried parameter.
+ * @param size Returned size of the answer.
+ * @return Cached answer, which must be released with free(). NULL if the
+ * query must be sent to the servers.
+ */
+static void *cachedDescriptor(unsigned int  kind,
+                              const void   *object,
+                              cl_ulong      param,
+                              size_t       *size)
+{
+    unsigned int i;
+    for(i=0;i<servers->num_servers;i++){
+        if(    !servers->deferred[i]
+            || !isDescriptorListed(servers->address[i], object))
+            continue;
+        void *value = getDescriptor(servers->address[i], kind, object, param, size);
+        if(value)
+            return value;
+        connectDeferred(i);
+    }
+    return NULL;
+}
+
+/** Answer a platform or device information query from the descriptors
+ * cache.
+ * @param kind Kind of query.
+ * @param object Queried platform or device.
+ * @param param_name Queried parameter.
+ * @param param_value_size Size of param_value.
+ * @param param_value Returned information.
+ * @param param_value_size_ret Returned size of the information.
+ * @param flag Returned error code.
+ * @return CL_TRUE if the query has been answered, CL_FALSE if it must be
+ * sent to the servers.
+ */
+static cl_bool cachedInfo(unsigned int  kind,
+                          const void   *object,
+                          cl_ulong      param_name,
+                          size_t        param_value_size,
+                          void         *param_value,
+                          size_t       *param_value_size_ret,
+                          cl_int       *flag)
+{
+    size_t size_ret;
+    void *value = cachedDescriptor(kind, object, param_name, &size_ret);
+    if(!value)
+        return CL_FALSE;
+    *flag = CL_SUCCESS;
+    if(param_value && (param_value_size < size_ret)){
+        *flag = CL_INVALID_VALUE;
+    }
+    else{
+        if(param_value_size_ret) *param_value_size_ret = size_ret;
+        if(param_value) memcpy(param_value, value, size_ret);
+    }
+    free(value);
+    return CL_TRUE;
+}
+
+/** Thread which connects to a deferred server in order to refresh its
+ * cached descriptors, before they expire.
+ * @param data Server index casted variable.
+ * @return NULL
+ */
+static void *refresh_thread(void *data)
+{
+    unsigned int i, n, server = (unsigned int)(size_t)data;
+    struct descriptor_st *keys = NULL;
+    if(!connectDeferred(server))
+        return NULL;
+    // The server is already connected, so the queries are sent to it and
+    // their answers stored again
+    n = getDescriptorKeys(servers->address[server], &keys);
+    for(i=0;i<n;i++){
+        size_t size = 0;
+        cl_uint num_devices = 0;
+        void *value = NULL;
+        if(keys[i].kind == OCLAND_CACHE_PLATFORM_INFO){
+            cl_platform_id platform = (cl_platform_id)(size_t)keys[i].object;
+            if(oclandGetPlatformInfo(platform, (cl_platform_info)keys[i].param, 0, NULL, &size) != CL_SUCCESS)
+                continue;
+            value = malloc(size ? size : 1);
+            if(value)
+                oclandGetPlatformInfo(platform, (cl_platform_info)keys[i].param, size, value, NULL);
+        }
+        else if(keys[i].kind == OCLAND_CACHE_DEVICES){
+            cl_platform_id platform = (cl_platform_id)(size_t)keys[i].object;
+            if(oclandGetDeviceIDs(platform, (cl_device_type)keys[i].param, 0, NULL, &num_devices) != CL_SUCCESS)
+                continue;
+            value = malloc(num_devices ? num_devices*sizeof(cl_device_id) : 1);
+            if(value)
+                oclandGetDeviceIDs(platform, (cl_device_type)keys[i].param, num_devices, (cl_device_id*)value, NULL);
+        }
+        else if(keys[i].kind == OCLAND_CACHE_DEVICE_INFO){
+            cl_device_id device = (cl_device_id)(size_t)keys[i].object;
+            if(oclandGetDeviceInfo(device, (cl_device_info)keys[i].param, 0, NULL, &size) != CL_SUCCESS)
+                continue;
+            value = malloc(size ? size : 1);
+            if(value)
+                oclandGetDeviceInfo(device, (cl_device_info)keys[i].param, size, value, NULL);
+        }
+        free(value); value=NULL;
+    }
+    free(keys); keys=NULL;
+    return NULL;
+}
 
-/** Initializes ocland, loading server files
- * and connecting to servers.
- * @return Number of active servers.
+/** Initializes ocland, loading server files and connecting to servers.
+ * The servers whose platforms and devices are found in the descriptors
+ * cache are not connected until their objects are actually used, their
+ * enumeration being answered from the cache meanwhile.
+ * @return Number of available servers.
  */
 unsigned int oclandInit()
 {
     unsigned int i,n;
-    if(initialized){
-        n = 0;
+    if(!initialized){
+        initialized = CL_TRUE;
+        if(!loadServers())
+            return 0;
+        loadDescriptors();
+        cl_bool targets[servers->num_servers];
+        for(i=0;i<servers->num_servers;i++){
+            servers->deferred[i] = (descriptorsAge(servers->address[i]) >= 0) ? CL_TRUE : CL_FALSE;
+            targets[i] = !servers->deferred[i];
+        }
+        connectServers(targets);
+        // Refresh in background the descriptors close to expire
         for(i=0;i<servers->num_servers;i++){
-            if(servers->sockets[i] >= 0)
-                n++;
+            pthread_t thread;
+            if(    !servers->deferred[i]
+                || (descriptorsAge(servers->address[i]) <= (long)(OCLAND_CACHE_TTL / 2)))
+                continue;
+            if(!pthread_create(&thread, NULL, refresh_thread, (void *)(size_t)i))
+                pthread_detach(thread);
         }
-        return n;
     }
-    initialized = CL_TRUE;
-    n = loadServers();
-    return connectServers();
+    n = 0;
+    for(i=0;i<servers->num_servers;i++){
+        if((servers->sockets[i] >= 0) || servers->deferred[i])
+            n++;
+    }
+    return n;
 }
 
 cl_int oclandGetPlatformIDs(cl_uint         num_entries,
@@ -289,57 +765,68 @@ cl_int oclandGetPlatformIDs(cl_uint         num_entries,
                             cl_uint*        num_platforms)
 {
     unsigned int i,j;
+    cl_int flag = CL_SUCCESS;
     cl_uint t_num_platforms = 0;
     if(num_platforms) *num_platforms = 0;
     // Ensure that ocland is already running
     // and exist servers to use
     if(!oclandInit())
         return CL_SUCCESS;
-    // Get number of platforms from servers
+    if(!platforms)
+        num_entries = 0;
+    // Query all the active servers at once, each one may return up to
+    // num_entries platforms
+    pthread_t threads[servers->num_servers];
+    int joinable[servers->num_servers];
+    struct platformsQuery queries[servers->num_servers];
     for(i=0;i<servers->num_servers;i++){
+        queries[i].server        = i;
+        queries[i].num_entries   = num_entries;
+        queries[i].platforms     = NULL;
+        queries[i].num_platforms = 0;
+        queries[i].flag          = CL_SUCCESS;
+        joinable[i] = 0;
+        // Deferred servers are answered from the descriptors cache
+        if(servers->deferred[i]){
+            size_t size;
+            cl_platform_id *cached = (cl_platform_id*)getDescriptor(servers->address[i],
+                                                                    OCLAND_CACHE_PLATFORMS,
+                                                                    NULL, 0, &size);
+            if(cached){
+                queries[i].platforms     = cached;
+                queries[i].num_platforms = size / sizeof(cl_platform_id);
+                continue;
+            }
+            connectDeferred(i);
+        }
         // Ensure that the server still being active
         if(servers->sockets[i] < 0)
             continue;
-        // Count the remaining number of platforms to take
-        cl_uint r_num_entries = num_entries - t_num_platforms;
-        if(r_num_entries < 0) r_num_entries = 0;
-        // Create a package with all the data to send,
-        // in order to accelerate as much as possible
-        // the data transmission, requesting only one
-        // connection to send, and another one to receive
-        size_t msgSize  = sizeof(unsigned int);  // Command index
-        msgSize        += sizeof(cl_uint);       // num_entries
-        void* msg = (void*)malloc(msgSize);
-        void* ptr = msg;
-        ((unsigned int*)ptr)[0] = ocland_clGetPlatformIDs; ptr = (unsigned int*)ptr + 1;
-        ((cl_uint*)ptr)[0]      = r_num_entries;
-        // Send the package (first the size, and then the data)
-        lock(servers->sockets[i]);
-        int *sockfd = &(servers->sockets[i]);
-        Send(sockfd, &msgSize, sizeof(size_t), 0);
-        Send(sockfd, msg, msgSize, 0);
-        free(msg); msg=NULL;
-        // Receive the package (first size, and then data)
-        Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
-        msg = (void*)malloc(msgSize);
-        ptr = msg;
-        Recv(sockfd, msg, msgSize, MSG_WAITALL);
-        unlock(servers->sockets[i]);
-        // Decript the data
-        cl_int  flag = ((cl_int*)ptr)[0];  ptr = (cl_int*)ptr  + 1;
-        if(flag != CL_SUCCESS){
-            free(msg); msg=NULL;
-            unlock(servers->sockets[i]);
-            return flag;
+        if(num_entries){
+            queries[i].platforms = (cl_platform_id*)malloc(num_entries*sizeof(cl_platform_id));
+            if(!queries[i].platforms){
+                queries[i].flag = CL_OUT_OF_HOST_MEMORY;
+                continue;
+            }
         }
-        cl_uint l_num_platforms = ((cl_uint*)ptr)[0]; ptr = (cl_uint*)ptr + 1;
-        cl_uint n = (l_num_platforms < r_num_entries) ? l_num_platforms : r_num_entries;
-        for(j=0;j<n;j++){
-            platforms[t_num_platforms + j] = ((cl_platform_id*)ptr)[j];
+        joinable[i] = !pthread_create(&(threads[i]), NULL, platformsQuery_thread, (void *)&(queries[i]));
+        if(!joinable[i])
+            platformsQuery_thread((void *)&(queries[i]));
+    }
+    // Collect the platforms in the servers order
+    for(i=0;i<servers->num_servers;i++){
+        if(joinable[i])
+            pthread_join(threads[i], NULL);
+        if((queries[i].flag != CL_SUCCESS) && (flag == CL_SUCCESS))
+            flag = queries[i].flag;
+        for(j=0;(j<queries[i].num_platforms) && (t_num_platforms + j < num_entries);j++){
+            platforms[t_num_platforms + j] = queries[i].platforms[j];
         }
-        t_num_platforms += l_num_platforms;
-        free(msg); msg=NULL;
+        t_num_platforms += queries[i].num_platforms;
+        free(queries[i].platforms); queries[i].platforms=NULL;
     }
+    if(flag != CL_SUCCESS)
+        return flag;
     if(num_platforms) *num_platforms = t_num_platforms;
     return CL_SUCCESS;
 }
@@ -351,10 +838,15 @@ cl_int oclandGetPlatformInfo(cl_platform_id    platform,
                              size_t *          param_value_size_ret)
 {
     unsigned int i;
+    cl_int flag;
     // Ensure that ocland is already running
     // and exist servers to use
     if(!oclandInit())
         return CL_SUCCESS;
+    // Deferred servers are answered from the descriptors cache
+    if(cachedInfo(OCLAND_CACHE_PLATFORM_INFO, platform, param_name,
+                  param_value_size, param_value, param_value_size_ret, &flag))
+        return flag;
     // Try the platform in all the servers
     for(i=0;i<servers->num_servers;i++){
         // Ensure that the server still being active
@@ -384,7 +876,7 @@ cl_int oclandGetPlatformInfo(cl_platform_id    platform,
         Recv(sockfd, msg, msgSize, MSG_WAITALL);
         unlock(servers->sockets[i]);
         // Decript the data
-        cl_int  flag = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr  + 1;
+        flag = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr  + 1;
         if(flag != CL_SUCCESS){
             free(msg); msg=NULL;
             if(flag == CL_INVALID_PLATFORM){
@@ -394,7 +886,11 @@ cl_int oclandGetPlatformInfo(cl_platform_id    platform,
         }
         size_t size_ret = ((size_t*)ptr)[0]; ptr = (size_t*)ptr  + 1;
         if(param_value_size_ret) *param_value_size_ret = size_ret;
-        if(param_value) memcpy(param_value, ptr, size_ret);
+        if(param_value){
+            memcpy(param_value, ptr, size_ret);
+            storeDescriptor(servers->address[i], OCLAND_CACHE_PLATFORM_INFO,
+                            platform, param_name, param_value, size_ret);
+        }
         free(msg); msg=NULL;
         return CL_SUCCESS;
     }
@@ -414,6 +910,19 @@ cl_int oclandGetDeviceIDs(cl_platform_id   platform,
     // and exist servers to use
     if(!oclandInit())
         return CL_SUCCESS;
+    // Deferred servers are answered from the descriptors cache
+    size_t size;
+    cl_device_id *cached = (cl_device_id*)cachedDescriptor(OCLAND_CACHE_DEVICES,
+                                                           platform, device_type, &size);
+    if(cached){
+        cl_uint n = size / sizeof(cl_device_id);
+        if(num_devices) *num_devices = n;
+        if(num_entries < n)
+            n = num_entries;
+        if(devices) memcpy((void*)devices, cached, n*sizeof(cl_device_id));
+        free(cached); cached=NULL;
+        return CL_SUCCESS;
+    }
     // Test all the servers looking for this platform
     for(i=0;i<servers->num_servers;i++){
         // Ensure that the server still being active
@@ -452,6 +961,10 @@ cl_int oclandGetDeviceIDs(cl_platform_id   platform,
         }
         cl_uint n = ((cl_uint*)ptr)[0];  ptr = (cl_uint*)ptr  + 1;
         if(num_devices) *num_devices = n;
+        if(devices && (n <= num_entries)){
+            storeDescriptor(servers->address[i], OCLAND_CACHE_DEVICES,
+                            platform, device_type, ptr, n*sizeof(cl_device_id));
+        }
         if(num_entries < n)
             n = num_entries;
         if(devices) memcpy((void*)devices, ptr, n*sizeof(cl_device_id));
@@ -469,11 +982,16 @@ cl_int oclandGetDeviceInfo(cl_device_id    device,
                            size_t *        param_value_size_ret)
 {
     unsigned int i;
+    cl_int flag;
     if(param_value_size_ret) *param_value_size_ret = 0;
     // Ensure that ocland is already running
     // and exist servers to use
     if(!oclandInit())
         return CL_SUCCESS;
+    // Deferred servers are answered from the descriptors cache
+    if(cachedInfo(OCLAND_CACHE_DEVICE_INFO, device, param_name,
+                  param_value_size, param_value, param_value_size_ret, &flag))
+        return flag;
     // Test all the servers looking for this device
     for(i=0;i<servers->num_servers;i++){
         // Ensure that the server still being active
@@ -503,7 +1021,7 @@ cl_int oclandGetDeviceInfo(cl_device_id    device,
         Recv(sockfd, msg, msgSize, MSG_WAITALL);
         unlock(servers->sockets[i]);
         // Decript the data
-        cl_int  flag = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr  + 1;
+        flag = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr  + 1;
         if(flag != CL_SUCCESS){
             free(msg); msg=NULL;
             if(flag == CL_INVALID_DEVICE)
@@ -513,6 +1031,11 @@ cl_int oclandGetDeviceInfo(cl_device_id    device,
         size_t size_ret = ((size_t*)ptr)[0]; ptr = (size_t*)ptr  + 1;
         if(param_value_size_ret) *param_value_size_ret = size_ret;
         if(param_value) memcpy((void*)param_value, ptr, size_ret);
+        // The reference count is not a descriptor of the device
+        if(param_value && (param_name != CL_DEVICE_REFERENCE_COUNT)){
+            storeDescriptor(servers->address[i], OCLAND_CACHE_DEVICE_INFO,
+                            device, param_name, param_value, size_ret);
+        }
         free(msg); msg=NULL;
         return CL_SUCCESS;
     }
@@ -536,6 +1059,10 @@ cl_context oclandCreateContext(const cl_context_properties * properties,
         if(errcode_ret) *errcode_ret=CL_INVALID_PLATFORM;
         return NULL;
     }
+    // Connect to the deferred servers involved
+    connectPropertiesOwner(properties, num_properties);
+    for(i=0;i<num_devices;i++)
+        connectOwner(devices[i]);
     // Try devices in all servers
     for(i=0;i<servers->num_servers;i++){
         // Ensure that the server still being active
@@ -599,6 +1126,8 @@ cl_context oclandCreateContextFromType(const cl_context_properties * properties,
         if(errcode_ret) *errcode_ret=CL_INVALID_PLATFORM;
         return NULL;
     }
+    // Connect to the deferred servers involved
+    connectPropertiesOwner(properties, num_properties);
     // Try all the servers
     for(i=0;i<servers->num_servers;i++){
         // Ensure that the server still being active
@@ -895,6 +1424,184 @@ cl_int oclandGetCommandQueueInfo(cl_command_queue      command_queue,
     return flag;
 }
 
+/// Measured round trip time of the transfer commands
+static double inline_rtt = 0.0;
+/// Measured bandwidth of the transfer commands
+static double inline_bandwidth = 0.0;
+/// Transfer measures mutex
+static pthread_mutex_t inline_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Get the size below which the asynchronous transfers are carried inline
+ * in the command package, or in its reply, instead of along a parallel
+ * transfer channel. A parallel channel costs about three extra round
+ * trips (the port reply and the connection handshake), so the size is
+ * the data that can be transferred meanwhile, as measured from the
+ * previous inline and blocking transfers. It can be forced with the
+ * OCLAND_INLINE_SIZE environment variable (0 to disable the inline
+ * transfers).
+ * @return Maximum size of the inline transfers.
+ */
+static size_t inlineSize()
+{
+    static long forced = -2;
+    size_t size = OCLAND_INLINE_SIZE;
+    if(forced == -2){
+        const char *env = getenv("OCLAND_INLINE_SIZE");
+        forced = env ? atol(env) : -1;
+    }
+    if(forced >= 0)
+        return (size_t)forced;
+    pthread_mutex_lock(&inline_mutex);
+    if((inline_rtt > 0.0) && (inline_bandwidth > 0.0))
+        size = (size_t)(3.0 * inline_rtt * inline_bandwidth);
+    pthread_mutex_unlock(&inline_mutex);
+    return size < OCLAND_INLINE_MAX_SIZE ? size : OCLAND_INLINE_MAX_SIZE;
+}
+
+/** Report the duration of a transfer carried out along the command
+ * channel, used to tune the inline transfers size. Small transfers
+ * measure the round trip time, and the larger ones the bandwidth.
+ * @param cb Size of the transfer.
+ * @param t0 Time when the command was sent.
+ * @see inlineSize
+ */
+static void reportInlineTransfer(size_t cb, const struct timeval *t0)
+{
+    struct timeval t1;
+    double seconds;
+    gettimeofday(&t1, NULL);
+    seconds = (t1.tv_sec - t0->tv_sec) + 1.0E-6 * (t1.tv_usec - t0->tv_usec);
+    if(seconds <= 0.0)
+        return;
+    pthread_mutex_lock(&inline_mutex);
+    if(cb <= 4096){
+        // Kernels executed meanwhile increase the time, so the lowest
+        // values are preferred
+        if((inline_rtt == 0.0) || (seconds < inline_rtt))
+            inline_rtt = seconds;
+        else
+            inline_rtt = 0.9 * inline_rtt + 0.1 * seconds;
+    }
+    else if((inline_rtt > 0.0) && (seconds > 1.5 * inline_rtt)){
+        double bandwidth = cb / (seconds - inline_rtt);
+        if(inline_bandwidth == 0.0)
+            inline_bandwidth = bandwidth;
+        else
+            inline_bandwidth = 0.75 * inline_bandwidth + 0.25 * bandwidth;
+    }
+    pthread_mutex_unlock(&inline_mutex);
+}
+
+/** Test if the upload of some data should be deduplicated, sending its
+ * hash first such that the server can take it from its cache. Large
+ * uploads are deduplicated unless the OCLAND_DEDUP environment variable
+ * is set to 0.
+ * @param size Size of the data.
+ * @return CL_TRUE if the data hash should be sent, CL_FALSE otherwise.
+ */
+static cl_bool useBlob(size_t size)
+{
+    static int enabled = -1;
+    if(enabled < 0){
+        const char *env = getenv("OCLAND_DEDUP");
+        enabled = (env && !strcmp(env, "0")) ? 0 : 1;
+    }
+    return (enabled && (size >= OCLAND_DEDUP_MIN_SIZE)) ? CL_TRUE : CL_FALSE;
+}
+
+/** Receive the cache status of a deduplicated upload. The socket must be
+ * already locked.
+ * @param sockfd Server socket.
+ * @param status Returned cache status.
+ * @return Error code returned by the server.
+ */
+static cl_int recvBlobStatus(int *sockfd, cl_uint *status)
+{
+    size_t msgSize = 0;
+    cl_int flag = CL_OUT_OF_RESOURCES;
+    *status = OCLAND_BLOB_UNCACHED;
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    void* msg = (void*)malloc(msgSize);
+    void* ptr = msg;
+    if(!msg)
+        return CL_OUT_OF_HOST_MEMORY;
+    if(Recv(sockfd, msg, msgSize, MSG_WAITALL) > 0){
+        flag    = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr + 1;
+        *status = ((cl_uint*)ptr)[0];
+    }
+    free(msg); msg=NULL;
+    return flag;
+}
+
+/** Create a buffer sending just the hash of the host data, if the
+ * server has it in its cache.
+ * @param sockfd Server socket.
+ * @param context Context.
+ * @param flags Buffer flags, including CL_MEM_COPY_HOST_PTR.
+ * @param size Buffer size.
+ * @param host_ptr Host data.
+ * @param memobj Returned buffer.
+ * @return CL_FALSE if the server can't cache the data, in which case it
+ * should be uploaded by ocland_clCreateBuffer, CL_TRUE otherwise.
+ */
+static cl_bool createBufferBlob(int *           sockfd ,
+                                cl_context      context ,
+                                cl_mem_flags    flags ,
+                                size_t          size ,
+                                const void *    host_ptr ,
+                                cl_mem *        memobj ,
+                                cl_int *        errcode_ret)
+{
+    cl_uint status;
+    unsigned char hash[SHA256_DIGEST_SIZE];
+    SHA256(host_ptr, size, hash);
+    *memobj = NULL;
+    // Build the package
+    size_t msgSize  = sizeof(unsigned int);   // Command index
+    msgSize        += sizeof(cl_context);     // context
+    msgSize        += sizeof(cl_mem_flags);   // flags
+    msgSize        += sizeof(size_t);         // size
+    msgSize        += SHA256_DIGEST_SIZE;     // hash
+    void* msg = (void*)malloc(msgSize);
+    void* ptr = msg;
+    if(!msg)
+        return CL_FALSE;
+    ((unsigned int*)ptr)[0]   = ocland_clCreateBufferBlob; ptr = (unsigned int*)ptr + 1;
+    ((cl_context*)ptr)[0]     = context;                   ptr = (cl_context*)ptr + 1;
+    ((cl_mem_flags*)ptr)[0]   = flags;                     ptr = (cl_mem_flags*)ptr + 1;
+    ((size_t*)ptr)[0]         = size;                      ptr = (size_t*)ptr + 1;
+    memcpy(ptr, hash, SHA256_DIGEST_SIZE);
+    // Send the package, and the data only if the server lacks it
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    cl_int flag = recvBlobStatus(sockfd, &status);
+    if((flag == CL_SUCCESS) && (status == OCLAND_BLOB_UNCACHED)){
+        unlock(*sockfd);
+        return CL_FALSE;
+    }
+    if(flag != CL_SUCCESS){
+        unlock(*sockfd);
+        if(errcode_ret) *errcode_ret = flag;
+        return CL_TRUE;
+    }
+    if(status == OCLAND_BLOB_MISS)
+        Send(sockfd, host_ptr, size, 0);
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    ptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    flag = ((cl_int*)ptr)[0]; ptr = (cl_int*)ptr  + 1;
+    if(errcode_ret) *errcode_ret = flag;
+    if(flag == CL_SUCCESS)
+        *memobj = ((cl_mem*)ptr)[0];
+    free(msg); msg=NULL;
+    return CL_TRUE;
+}
+
 cl_mem oclandCreateBuffer(cl_context    context ,
                           cl_mem_flags  flags ,
                           size_t        size ,
@@ -906,6 +1613,24 @@ cl_mem oclandCreateBuffer(cl_context    context ,
     if(!sockfd){
         return CL_INVALID_CONTEXT;
     }
+    // The host memory of the CL_MEM_USE_HOST_PTR buffers is mirrored
+    // by the client, so the server just takes a copy
+    cl_mem_flags server_flags = flags;
+    if(flags & CL_MEM_USE_HOST_PTR)
+        server_flags = (flags & ~CL_MEM_USE_HOST_PTR) | CL_MEM_COPY_HOST_PTR;
+    // Large host data may be already cached by the server
+    if(host_ptr && (server_flags & CL_MEM_COPY_HOST_PTR) && useBlob(size)){
+        cl_mem memobj = NULL;
+        if(createBufferBlob(sockfd, context, server_flags, size, host_ptr, &memobj, errcode_ret)){
+            if(memobj){
+                addShortcut((void*)memobj, sockfd);
+                addDeltaBuffer(memobj, flags, size);
+                if(flags & CL_MEM_USE_HOST_PTR)
+                    addDeltaHostPtr(memobj, host_ptr);
+            }
+            return memobj;
+        }
+    }
     // Build the package
     cl_bool hasPtr = CL_FALSE;
     if(host_ptr) hasPtr = CL_TRUE;
@@ -915,18 +1640,17 @@ cl_mem oclandCreateBuffer(cl_context    context ,
     msgSize        += sizeof(size_t);         // size
     msgSize        += sizeof(cl_bool);        // hasPtr
     if(host_ptr) msgSize += size;             // host_ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(host_ptr ? msgSize - size : msgSize);
     void* ptr = msg;
     ((unsigned int*)ptr)[0]   = ocland_clCreateBuffer; ptr = (unsigned int*)ptr + 1;
     ((cl_context*)ptr)[0]     = context;               ptr = (cl_context*)ptr + 1;
-    ((cl_mem_flags*)ptr)[0]   = flags;                 ptr = (cl_mem_flags*)ptr + 1;
+    ((cl_mem_flags*)ptr)[0]   = server_flags;          ptr = (cl_mem_flags*)ptr + 1;
     ((size_t*)ptr)[0]         = size;                  ptr = (size_t*)ptr + 1;
     ((cl_bool*)ptr)[0]        = hasPtr;                ptr = (cl_bool*)ptr + 1;
-    if(host_ptr) memcpy(ptr, host_ptr, size);
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // host data straight from the user memory)
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, host_ptr, host_ptr ? size : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -941,6 +1665,9 @@ cl_mem oclandCreateBuffer(cl_context    context ,
         return NULL;
     cl_mem memobj = ((cl_mem*)ptr)[0];
     addShortcut((void*)memobj, sockfd);
+    addDeltaBuffer(memobj, flags, size);
+    if(flags & CL_MEM_USE_HOST_PTR)
+        addDeltaHostPtr(memobj, host_ptr);
     return memobj;
 }
 
@@ -1001,8 +1728,10 @@ cl_int oclandReleaseMemObject(cl_mem memobj)
     unlock(*sockfd);
     // Decript the data
     cl_int flag = ((cl_int*)ptr)[0];
-    if(flag == CL_SUCCESS)
+    if(flag == CL_SUCCESS){
         delShortcut(memobj);
+        delDeltaBuffer(memobj);
+    }
     return flag;
 }
 
@@ -1728,8 +2457,10 @@ cl_int oclandReleaseKernel(cl_kernel    kernel)
     unlock(*sockfd);
     // Decript the data
     cl_int flag = ((cl_int*)ptr)[0];
-    if(flag == CL_SUCCESS)
+    if(flag == CL_SUCCESS){
         delShortcut(kernel);
+        delDeltaKernel(kernel);
+    }
     return flag;
 }
 
@@ -1773,6 +2504,8 @@ cl_int oclandSetKernelArg(cl_kernel     kernel ,
     unlock(*sockfd);
     // Decript the data
     cl_int flag = ((cl_int*)ptr)[0];
+    if(flag == CL_SUCCESS)
+        setDeltaKernelArg(kernel, arg_index, arg_size, arg_value);
     return flag;
 }
 
@@ -1893,6 +2626,9 @@ cl_int oclandWaitForEvents(cl_uint              num_events ,
     unlock(*sockfd);
     // Decript the data
     cl_int flag = ((cl_int*)ptr)[0];
+    // The server can't know when the data of the asynchronous
+    // transfers is actually in the client memory
+    waitEventsTransfers(num_events, event_list);
     return flag;
 }
 
@@ -1935,6 +2671,13 @@ cl_int oclandGetEventInfo(cl_event          event ,
     if(param_value_size_ret) *param_value_size_ret = size_ret;
     if( (flag == CL_SUCCESS) && param_value )
         memcpy(param_value, ptr, size_ret);
+    // The command can't be considered completed until its data has
+    // been transferred to/from the client memory
+    if( (flag == CL_SUCCESS) && param_value &&
+        (param_name == CL_EVENT_COMMAND_EXECUTION_STATUS) &&
+        (*(cl_int*)param_value == CL_COMPLETE) &&
+        isTransferPending(event) )
+        *(cl_int*)param_value = CL_RUNNING;
     return flag;
 }
 
@@ -2072,12 +2815,78 @@ cl_int oclandFlush(cl_command_queue command_queue)
     return flag;
 }
 
-cl_int oclandFinish(cl_command_queue  command_queue)
+/** @struct peerEvent Event of a transfer between servers, requested
+ * to the destination server just to let clFinish wait for the transfer,
+ * when the user did not request it.
+ */
+struct peerEvent{
+    /// Destination command queue
+    cl_command_queue command_queue;
+    /// Remote event
+    cl_event event;
+    /// Next event
+    struct peerEvent *next;
+};
+
+/// Events of the transfers between servers not requested by the user
+static struct peerEvent *peer_events = NULL;
+/// Peer events list mutex
+static pthread_mutex_t peer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Keep the event of a transfer between servers until its destination
+ * command queue is finished.
+ * @param command_queue Destination command queue.
+ * @param event Remote event.
+ */
+static void addPeerEvent(cl_command_queue command_queue, cl_event event)
 {
-    // Get the server
-    int *sockfd = getShortcut(command_queue);
-    if(!sockfd){
-        return CL_INVALID_COMMAND_QUEUE;
+    struct peerEvent *p = (struct peerEvent*)malloc(sizeof(struct peerEvent));
+    if(!p){
+        // The event will live in the server until the disconnection
+        return;
+    }
+    p->command_queue = command_queue;
+    p->event         = event;
+    pthread_mutex_lock(&peer_mutex);
+    p->next     = peer_events;
+    peer_events = p;
+    pthread_mutex_unlock(&peer_mutex);
+}
+
+/** Release the events of the transfers between servers enqueued in a
+ * command queue, which must be already finished.
+ * @param command_queue Destination command queue.
+ */
+static void releasePeerEvents(cl_command_queue command_queue)
+{
+    struct peerEvent *p, **prev, *done = NULL;
+    pthread_mutex_lock(&peer_mutex);
+    prev = &peer_events;
+    while(*prev){
+        p = *prev;
+        if(p->command_queue != command_queue){
+            prev = &(p->next);
+            continue;
+        }
+        *prev   = p->next;
+        p->next = done;
+        done    = p;
+    }
+    pthread_mutex_unlock(&peer_mutex);
+    while(done){
+        p    = done;
+        done = p->next;
+        oclandReleaseEvent(p->event);
+        free(p);
+    }
+}
+
+cl_int oclandFinish(cl_command_queue  command_queue)
+{
+    // Get the server
+    int *sockfd = getShortcut(command_queue);
+    if(!sockfd){
+        return CL_INVALID_COMMAND_QUEUE;
     }
     // Build the package
     size_t msgSize  = sizeof(unsigned int);     // Command index
@@ -2099,6 +2908,11 @@ cl_int oclandFinish(cl_command_queue  command_queue)
     unlock(*sockfd);
     // Decript the data
     cl_int flag = ((cl_int*)ptr)[0];
+    // The server can't know when the data of the asynchronous
+    // transfers is actually in the client memory
+    waitQueueTransfers(command_queue);
+    if(flag == CL_SUCCESS)
+        releasePeerEvents(command_queue);
     return flag;
 }
 
@@ -2114,43 +2928,40 @@ struct dataTransfer{
     size_t cb;
     /// Data array
     void *ptr;
+    /// Tracked transfer, ended when the data is transferred
+    pendingTransfer transfer;
 };
 
-/** Thread that receives data from server.
- * @param data struct dataTransfer casted variable.
- * @return NULL
+/** Connect a new stream for an asynchronous data transfer.
+ * @param sockfd Server main connection socket.
+ * @param port Port where the server is listening.
+ * @param index Stream index.
+ * @return Stream socket, -1 if the connection has failed.
  */
-void *asyncDataRecv_thread(void *data)
+static int connectDataStream(int sockfd, unsigned int port, unsigned int index)
 {
-    struct dataTransfer* _data = (struct dataTransfer*)data;
-    // Connect to the received port.
-    unsigned int port = _data->port;
-    struct sockaddr_in serv_addr, adr_inet;
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if(fd < 0){
-        printf("ERROR: Can't register a new socket for the asynchronous data transfer\n"); fflush(stdout);
-        return;
-    }
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    socklen_t len_inet;
-    len_inet = sizeof(serv_addr);
-    char* ip = serverAddress(_data->fd);
+    struct sockaddr_storage serv_addr;
+    socklen_t serv_addr_len;
+    char* ip = serverAddress(sockfd);
     if(!ip){
         printf("ERROR: Can't find the server associated with the socket\n"); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
+        return -1;
     }
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port   = htons(port);
-    if(inet_pton(AF_INET, ip, &serv_addr.sin_addr)<=0){
+    int domain = serverSocketAddress(ip, port, &serv_addr, &serv_addr_len);
+    if(domain < 0){
         // we can't work, disconnect from server
         printf("ERROR: Invalid address assigment (%s)\n", ip); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
+        return -1;
+    }
+    int fd = socket(domain, SOCK_STREAM, 0);
+    if(fd < 0){
+        printf("ERROR: Can't register a new socket for the asynchronous data transfer\n"); fflush(stdout);
+        return -1;
     }
-    while( connect(fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 ){
+    // Local streams can't be spread along the network interfaces
+    if(domain == AF_INET)
+        BindStripe(&fd, index);
+    while( connect(fd, (struct sockaddr *)&serv_addr, serv_addr_len) < 0 ){
         if(errno == ECONNREFUSED){
             // Pobably the server is not ready yet, simply retry
             // it until the server start listening
@@ -2159,12 +2970,191 @@ void *asyncDataRecv_thread(void *data)
         // we can't work, disconnect from server
         printf("ERROR: Can't connect for the asynchronous data transfer\n"); fflush(stdout);
         printf("\t%s\n", SocketsError()); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
+        close(fd);
+        return -1;
     }
-    // Receive the data
-    Recv(&fd, _data->ptr, _data->cb, MSG_WAITALL);
+    return fd;
+}
+
+/** @struct dataStripe Slice of a striped data transfer.
+ */
+struct dataStripe{
+    /// Stream socket
+    int fd;
+    /// Size of the slice
+    size_t cb;
+    /// Slice data
+    void *ptr;
+    /// CL_TRUE if the data is sent, CL_FALSE if it is received
+    cl_bool send;
+    /// Result of the slice transfer
+    cl_int flag;
+};
+
+/** Thread that transfers a slice of the data.
+ * @param data struct dataStripe casted variable.
+ * @return NULL
+ */
+static void *dataStripe_thread(void *data)
+{
+    struct dataStripe* _data = (struct dataStripe*)data;
+    ssize_t done = 0;
+    _data->flag = CL_OUT_OF_RESOURCES;
+    if(_data->fd < 0)
+        return NULL;
+    oclandStream stream = CreateStream(ConnectCompression(&(_data->fd)));
+    if(_data->send)
+        done = SendStream(&(_data->fd), stream, _data->ptr, _data->cb);
+    else
+        done = RecvStream(&(_data->fd), stream, _data->ptr, _data->cb);
+    ReleaseStream(stream);
+    if((done > 0) || (!_data->cb))
+        _data->flag = CL_SUCCESS;
+    return NULL;
+}
+
+/** Test if a transfer should be carried out through shared memory, which
+ * is possible if the server is connected through an Unix domain socket.
+ * Large transfers use shared memory unless the OCLAND_SHARED environment
+ * variable is set to 0.
+ * @param sockfd Server socket.
+ * @param size Size of the data.
+ * @return CL_TRUE if the data should be exchanged through shared memory,
+ * CL_FALSE otherwise.
+ */
+static cl_bool useSharedMemory(int *sockfd, size_t size)
+{
+    static int enabled = -1;
+    if(enabled < 0){
+        const char *env = getenv("OCLAND_SHARED");
+        enabled = (env && !strcmp(env, "0")) ? 0 : 1;
+    }
+    return (enabled && (size >= OCLAND_SHARED_MIN_SIZE) && IsLocalSocket(sockfd)) ? CL_TRUE : CL_FALSE;
+}
+
+/** Exchange the data through a shared memory region, which is passed
+ * to the server along the data connection. The server transfers the
+ * data straight from/into the region.
+ * @param fd Data connection socket.
+ * @param mfd Memory file descriptor of the region.
+ * @param shm Mapped region.
+ * @param data Data to transfer.
+ * @param send CL_TRUE if the data is sent, CL_FALSE if it is received.
+ * @return CL_SUCCESS if the data has been transferred, an error code
+ * otherwise.
+ */
+static cl_int sharedTransfer(int *fd, int mfd, void *shm, struct dataTransfer *data, cl_bool send)
+{
+    cl_int flag = CL_OUT_OF_RESOURCES;
+    if(SendSharedRegion(fd, mfd, data->cb)){
+        printf("ERROR: Can't pass the shared memory region to the server\n"); fflush(stdout);
+        return flag;
+    }
+    if(Recv(fd, &flag, sizeof(cl_int), MSG_WAITALL) <= 0)
+        flag = CL_OUT_OF_RESOURCES;
+    if((flag == CL_SUCCESS) && (!send))
+        memcpy(data->ptr, shm, data->cb);
+    return flag;
+}
+
+/** Transfer data along several parallel streams, each one transferring
+ * a slice straight from/into the user memory. If the server is in the
+ * same host the data is exchanged through shared memory instead.
+ * @param data Data to transfer.
+ * @param send CL_TRUE if the data is sent, CL_FALSE if it is received.
+ * @return CL_SUCCESS if the data has been transferred, an error code
+ * otherwise.
+ */
+static cl_int stripedTransfer(struct dataTransfer *data, cl_bool send)
+{
+    unsigned int i, streams;
+    size_t offset;
+    cl_int flag = CL_SUCCESS;
+    struct timeval t0, t1;
+    pthread_t threads[OCLAND_MAX_STREAMS];
+    int joinable[OCLAND_MAX_STREAMS];
+    struct dataStripe stripes[OCLAND_MAX_STREAMS];
+    gettimeofday(&t0, NULL);
+    // Connect the first stream, and negotiate the rest
+    int fd = connectDataStream(data->fd, data->port, 0);
+    if(fd < 0)
+        return CL_OUT_OF_RESOURCES;
+    void *shm = NULL;
+    int mfd = -1;
+    if(useSharedMemory(&fd, data->cb))
+        mfd = CreateSharedRegion(data->cb, &shm);
+    if(mfd >= 0){
+        if(send)
+            memcpy(shm, data->ptr, data->cb);
+        streams = ConnectStripes(&fd, 0);
+        if(!streams){
+            cl_int flag = sharedTransfer(&fd, mfd, shm, data, send);
+            ReleaseSharedRegion(mfd, shm, data->cb);
+            close(fd);
+            return flag;
+        }
+        ReleaseSharedRegion(mfd, shm, data->cb);
+    }
+    else{
+        streams = ConnectStripes(&fd, StripeStreams(data->cb));
+    }
+    if((!streams) || (streams > OCLAND_MAX_STREAMS)){
+        printf("ERROR: Invalid number of streams requested by the server (%u)\n", streams); fflush(stdout);
+        close(fd);
+        return CL_OUT_OF_RESOURCES;
+    }
+    for(i=0;i<streams;i++){
+        stripes[i].fd = i ? connectDataStream(data->fd, data->port, i) : fd;
+        StripeSlice(data->cb, streams, i, &offset, &(stripes[i].cb));
+        stripes[i].ptr  = (char*)data->ptr + offset;
+        stripes[i].send = send;
+        if(stripes[i].fd < 0)
+            flag = CL_OUT_OF_RESOURCES;
+    }
+    // The server can't transfer a missing slice, so the whole transfer
+    // is aborted, disconnecting the streams already connected such that
+    // the server detects it
+    if(flag != CL_SUCCESS){
+        printf("ERROR: Can't connect all the streams of the data transfer\n"); fflush(stdout);
+        for(i=0;i<streams;i++){
+            if(stripes[i].fd >= 0)
+                close(stripes[i].fd);
+        }
+        return flag;
+    }
+    // Transfer the slices, the first one in this thread
+    for(i=1;i<streams;i++){
+        joinable[i] = !pthread_create(&(threads[i]), NULL, dataStripe_thread, (void *)&(stripes[i]));
+        if(!joinable[i])
+            dataStripe_thread(&(stripes[i]));
+    }
+    dataStripe_thread(&(stripes[0]));
+    for(i=1;i<streams;i++){
+        if(joinable[i])
+            pthread_join(threads[i], NULL);
+    }
+    for(i=0;i<streams;i++){
+        if(stripes[i].fd >= 0)
+            close(stripes[i].fd);
+        if((flag == CL_SUCCESS) && (stripes[i].flag != CL_SUCCESS))
+            flag = stripes[i].flag;
+    }
+    if(flag != CL_SUCCESS)
+        return flag;
+    gettimeofday(&t1, NULL);
+    StripeReport(streams, data->cb, (t1.tv_sec - t0.tv_sec) + 1.0E-6 * (t1.tv_usec - t0.tv_usec));
+    return CL_SUCCESS;
+}
+
+/** Thread that receives data from server.
+ * @param data struct dataTransfer casted variable.
+ * @return NULL
+ */
+void *asyncDataRecv_thread(void *data)
+{
+    struct dataTransfer* _data = (struct dataTransfer*)data;
+    stripedTransfer(_data, CL_FALSE);
+    endPendingTransfer(_data->transfer);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -2184,7 +3174,96 @@ void asyncDataRecv(int* sockfd, struct dataTransfer data)
     _data->fd    = data.fd;
     _data->cb    = data.cb;
     _data->ptr   = data.ptr;
+    _data->transfer = data.transfer;
     int rc = pthread_create(&thread, NULL, asyncDataRecv_thread, (void *)(_data));
+    if(rc){
+        printf("ERROR: Can't create the data transfer thread\n");
+        endPendingTransfer(_data->transfer);
+        free(_data); _data=NULL;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+/** Receive the header of a read command reply, i.e. the flag and
+ * the event, leaving the rest of the reply (the data or the transfer
+ * port) in the socket. The socket must be already locked.
+ * @param sockfd Server socket.
+ * @param revent Returned remote event.
+ * @param remaining Returned size of the reply still pending in the socket.
+ * @return Flag returned by the server.
+ */
+static cl_int recvReadHeader(int *sockfd, cl_event *revent, size_t *remaining)
+{
+    char buffer[BUFF_SIZE];
+    size_t msgSize = 0, size;
+    cl_int flag = CL_OUT_OF_RESOURCES;
+    *remaining = 0;
+    if(Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL) != sizeof(size_t))
+        return flag;
+    if(msgSize < sizeof(cl_int))
+        return flag;
+    if(Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL) != sizeof(cl_int))
+        return CL_OUT_OF_RESOURCES;
+    msgSize -= sizeof(cl_int);
+    if((flag == CL_SUCCESS) && (msgSize >= sizeof(cl_event))){
+        if(Recv(sockfd, revent, sizeof(cl_event), MSG_WAITALL) != sizeof(cl_event))
+            return CL_OUT_OF_RESOURCES;
+        *remaining = msgSize - sizeof(cl_event);
+        return flag;
+    }
+    // Error replies should not carry more data, but we must keep the
+    // stream sync anyway
+    while(msgSize){
+        size = msgSize < BUFF_SIZE ? msgSize : BUFF_SIZE;
+        if(Recv(sockfd, buffer, size, MSG_WAITALL) <= 0)
+            break;
+        msgSize -= size;
+    }
+    if(flag == CL_SUCCESS)
+        flag = CL_OUT_OF_RESOURCES;
+    return flag;
+}
+
+/** Receive the rest of a read command reply, storing the data
+ * straight into the user memory, or the port of the parallel transfer
+ * channel in the asynchronous case. The socket must be already locked.
+ * @param sockfd Server socket.
+ * @param remaining Size of the reply pending in the socket.
+ * @param ptr User memory where the data should be stored, NULL if
+ * the port is expected.
+ * @param cb Size of the user memory.
+ * @param port Returned port in the asynchronous case.
+ * @return CL_SUCCESS if all the expected data has been received,
+ * CL_OUT_OF_RESOURCES if the reply is short or the connection failed.
+ */
+static cl_int recvReadData(int *sockfd, size_t remaining, void *ptr, size_t cb, unsigned int *port)
+{
+    char buffer[BUFF_SIZE];
+    size_t size, expected;
+    cl_int flag = CL_SUCCESS;
+    if(ptr){
+        expected = cb;
+        size = remaining < cb ? remaining : cb;
+        if((size_t)Recv(sockfd, ptr, size, MSG_WAITALL) != size)
+            return CL_OUT_OF_RESOURCES;
+    }
+    else{
+        expected = sizeof(unsigned int);
+        size = remaining < sizeof(unsigned int) ? remaining : sizeof(unsigned int);
+        if((size_t)Recv(sockfd, port, size, MSG_WAITALL) != size)
+            return CL_OUT_OF_RESOURCES;
+    }
+    if(size < expected)
+        flag = CL_OUT_OF_RESOURCES;
+    remaining -= size;
+    while(remaining){
+        size = remaining < BUFF_SIZE ? remaining : BUFF_SIZE;
+        if((size_t)Recv(sockfd, buffer, size, MSG_WAITALL) != size)
+            return CL_OUT_OF_RESOURCES;
+        remaining -= size;
+    }
+    return flag;
 }
 
 cl_int oclandEnqueueReadBuffer(cl_command_queue     command_queue ,
@@ -2203,6 +3282,20 @@ cl_int oclandEnqueueReadBuffer(cl_command_queue     command_queue ,
     if(!sockfd){
         return CL_INVALID_EVENT;
     }
+    // Large blocking reads from local servers are requested as
+    // asynchronous ones, receiving the data through shared memory
+    cl_bool shared = CL_FALSE, inlined = CL_FALSE;
+    if((blocking_read == CL_TRUE) && useSharedMemory(sockfd, cb)){
+        shared = CL_TRUE;
+        blocking_read = CL_FALSE;
+    }
+    // Small asynchronous reads without events to wait for are served
+    // along the main connection, saving the parallel transfer channel.
+    // The server replies with the data once the read has finished, such
+    // that the connection is not kept locked after returning
+    else if((blocking_read != CL_TRUE) && (cb <= inlineSize()) && !num_events_in_wait_list){
+        inlined = CL_TRUE;
+    }
     // Build the package
     cl_bool want_event = CL_FALSE;
     if(event) want_event = CL_TRUE;
@@ -2220,39 +3313,42 @@ cl_int oclandEnqueueReadBuffer(cl_command_queue     command_queue ,
     ((unsigned int*)mptr)[0]     = ocland_clEnqueueReadBuffer; mptr = (unsigned int*)mptr + 1;
     ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
     ((cl_mem*)mptr)[0]           = buffer;                     mptr = (cl_mem*)mptr + 1;
-    ((cl_bool*)mptr)[0]          = blocking_read;              mptr = (cl_bool*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = inlined ? OCLAND_INLINE_TRANSFER : blocking_read; mptr = (cl_bool*)mptr + 1;
     ((size_t*)mptr)[0]           = offset;                     mptr = (size_t*)mptr + 1;
     ((size_t*)mptr)[0]           = cb;                         mptr = (size_t*)mptr + 1;
     ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
     ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
     memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
     // Send the package (first the size, and then the data)
+    struct timeval t0;
+    gettimeofday(&t0, NULL);
     lock(*sockfd);
     Send(sockfd, &msgSize, sizeof(size_t), 0);
     Send(sockfd, msg, msgSize, 0);
     free(msg); msg=NULL;
-    // Receive the package (first size, and then data)
-    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
-    msg = (void*)malloc(msgSize);
-    mptr = msg;
-    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    // Receive the package header (size, flag and event), and then
+    // the data straight into the user memory, or the port
+    unsigned int port = 0;
+    cl_int flag = recvReadHeader(sockfd, &revent, &msgSize);
+    if(flag != CL_SUCCESS){
+        unlock(*sockfd);
+        return flag;
+    }
+    flag = recvReadData(sockfd, msgSize, ((blocking_read == CL_TRUE) || inlined) ? ptr : NULL, cb, &port);
     unlock(*sockfd);
-    // Decript the flag, if CL_SUCCESS don't received, we can't
-    // still working
-    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
     if(flag != CL_SUCCESS)
         return flag;
+    if(event){
+        *event = revent;
+        addShortcut(*event, sockfd);
+    }
+    if(blocking_read == CL_TRUE)
+        reportInlineTransfer(cb, &t0);
     // ------------------------------------------------------------
-    // Blocking read case:
+    // Blocking and inline read cases:
     // We may have received the flag, the event, and the data.
     // ------------------------------------------------------------
-    if(blocking_read == CL_TRUE){
-        revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
-        if(event){
-            *event = revent;
-            addShortcut(*event, sockfd);
-        }
-        memcpy(ptr, mptr, cb);
+    if((blocking_read == CL_TRUE) || inlined){
         return flag;
     }
     // ------------------------------------------------------------
@@ -2260,17 +3356,14 @@ cl_int oclandEnqueueReadBuffer(cl_command_queue     command_queue ,
     // We may have received the flag, the event, and a port to open
     // a parallel transfer channel.
     // ------------------------------------------------------------
-    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
-    if(event){
-        *event = revent;
-        addShortcut(*event, sockfd);
-    }
-    unsigned int port = ((unsigned int*)mptr)[0];
     struct dataTransfer data;
     data.port  = port;
     data.fd    = *sockfd;
     data.cb    = cb;
     data.ptr   = ptr;
+    if(shared)
+        return stripedTransfer(&data, CL_FALSE);
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataRecv(sockfd, data);
     return flag;
 }
@@ -2282,48 +3375,8 @@ cl_int oclandEnqueueReadBuffer(cl_command_queue     command_queue ,
 void *asyncDataSend_thread(void *data)
 {
     struct dataTransfer* _data = (struct dataTransfer*)data;
-    // Connect to the received port.
-    unsigned int port = _data->port;
-    struct sockaddr_in serv_addr;
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if(fd < 0){
-        printf("ERROR: Can't register a new socket for the asynchronous data transfer\n"); fflush(stdout);
-        return;
-    }
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    socklen_t len_inet;
-    len_inet = sizeof(serv_addr);
-    char* ip = serverAddress(_data->fd);
-    if(!ip){
-        printf("ERROR: Can't find the server associated with the socket\n"); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port   = htons(port);
-    if(inet_pton(AF_INET, ip, &serv_addr.sin_addr)<=0){
-        // we can't work, disconnect from server
-        printf("ERROR: Invalid address assigment (%s)\n", ip); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    while( connect(fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 ){
-        if(errno == ECONNREFUSED){
-            // Pobably the server is not ready yet, simply retry
-            // it until the server start listening
-            continue;
-        }
-        // we can't work, disconnect from server
-        printf("ERROR: Can't connect for the asynchronous data transfer\n"); fflush(stdout);
-        printf("\t%s\n", SocketsError()); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    // Send the data
-    Send(&fd, _data->ptr, _data->cb, 0);
+    stripedTransfer(_data, CL_TRUE);
+    endPendingTransfer(_data->transfer);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -2343,7 +3396,191 @@ void asyncDataSend(int* sockfd, struct dataTransfer data)
     _data->fd    = data.fd;
     _data->cb    = data.cb;
     _data->ptr   = data.ptr;
+    _data->transfer = data.transfer;
     int rc = pthread_create(&thread, NULL, asyncDataSend_thread, (void *)(_data));
+    if(rc){
+        printf("ERROR: Can't create the data transfer thread\n");
+        endPendingTransfer(_data->transfer);
+        free(_data); _data=NULL;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+/** Write only the blocks of a buffer which have changed since the last
+ * write, as computed by beginDeltaWrite(). The blocks are written by the
+ * server in a blocking way.
+ * @param sockfd Server socket.
+ * @param command_queue Command queue.
+ * @param buffer Buffer to write.
+ * @param offset Offset of the write in the buffer.
+ * @param ptr Data to write, starting at offset.
+ * @param delta Blocks to transmit.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @return CL_SUCCESS if the blocks are written, an error code otherwise.
+ */
+static cl_int enqueueWriteBufferBlocks(int *               sockfd ,
+                                       cl_command_queue    command_queue ,
+                                       cl_mem              buffer ,
+                                       size_t              offset ,
+                                       const void *        ptr ,
+                                       const deltaWrite *  delta ,
+                                       cl_uint             num_events_in_wait_list ,
+                                       const cl_event *    event_wait_list ,
+                                       cl_event *          event)
+{
+    size_t i;
+    cl_event revent = NULL;
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    cl_uint num_blocks = delta->num_ranges;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // buffer
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(cl_event);        // event_wait_list
+    msgSize        += sizeof(cl_uint);                                 // num_blocks
+    msgSize        += 2*num_blocks*sizeof(size_t);                     // blocks
+    size_t headSize = msgSize;
+    msgSize        += delta->dirty;                                    // blocks data
+    void* msg = (void*)malloc(headSize);
+    struct iovec *iov = (struct iovec*)malloc((num_blocks + 2)*sizeof(struct iovec));
+    if((!msg) || (!iov)){
+        free(msg); free(iov);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteBufferBlocks; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = buffer;                     mptr = (cl_mem*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    mptr = (cl_event*)mptr + num_events_in_wait_list;
+    ((cl_uint*)mptr)[0]          = num_blocks;                 mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, delta->ranges, 2*num_blocks*sizeof(size_t));
+    // Gather the header and the changed blocks straight from the user
+    // memory
+    iov[0].iov_base = &msgSize;
+    iov[0].iov_len  = sizeof(size_t);
+    iov[1].iov_base = msg;
+    iov[1].iov_len  = headSize;
+    for(i=0;i<num_blocks;i++){
+        iov[i + 2].iov_base = (char*)ptr + (delta->ranges[2*i] - offset);
+        iov[i + 2].iov_len  = delta->ranges[2*i + 1];
+    }
+    lock(*sockfd);
+    SendV(sockfd, iov, num_blocks + 2);
+    free(msg); msg=NULL;
+    free(iov); iov=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag == CL_SUCCESS){
+        revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+        if(event){
+            *event = revent;
+            addShortcut(*event, sockfd);
+        }
+    }
+    free(msg); msg=NULL;
+    return flag;
+}
+
+/** Blocking write of a buffer sending just the hash of the data, if the
+ * server has it in its cache.
+ * @param sockfd Server socket.
+ * @param command_queue Command queue.
+ * @param buffer Buffer to write.
+ * @param offset Offset of the write in the buffer.
+ * @param cb Size of the data.
+ * @param ptr Data to write.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @param flag Returned error code.
+ * @return CL_FALSE if the server can't cache the data, in which case it
+ * should be uploaded by ocland_clEnqueueWriteBuffer, CL_TRUE otherwise.
+ */
+static cl_bool enqueueWriteBufferBlob(int *               sockfd ,
+                                      cl_command_queue    command_queue ,
+                                      cl_mem              buffer ,
+                                      size_t              offset ,
+                                      size_t              cb ,
+                                      const void *        ptr ,
+                                      cl_uint             num_events_in_wait_list ,
+                                      const cl_event *    event_wait_list ,
+                                      cl_event *          event ,
+                                      cl_int *            flag)
+{
+    cl_uint status;
+    cl_event revent = NULL;
+    unsigned char hash[SHA256_DIGEST_SIZE];
+    SHA256(ptr, cb, hash);
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // buffer
+    msgSize        += sizeof(size_t);                                  // offset
+    msgSize        += sizeof(size_t);                                  // cb
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(cl_event);        // event_wait_list
+    msgSize        += SHA256_DIGEST_SIZE;                              // hash
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    if(!msg)
+        return CL_FALSE;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteBufferBlob; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = buffer;                     mptr = (cl_mem*)mptr + 1;
+    ((size_t*)mptr)[0]           = offset;                     mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = cb;                         mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    mptr = (cl_event*)mptr + num_events_in_wait_list;
+    memcpy(mptr, hash, SHA256_DIGEST_SIZE);
+    // Send the package, and the data only if the server lacks it
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    *flag = recvBlobStatus(sockfd, &status);
+    if((*flag == CL_SUCCESS) && (status == OCLAND_BLOB_UNCACHED)){
+        unlock(*sockfd);
+        return CL_FALSE;
+    }
+    if(*flag != CL_SUCCESS){
+        unlock(*sockfd);
+        return CL_TRUE;
+    }
+    if(status == OCLAND_BLOB_MISS)
+        Send(sockfd, ptr, cb, 0);
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    *flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(*flag == CL_SUCCESS){
+        revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+        if(event){
+            *event = revent;
+            addShortcut(*event, sockfd);
+        }
+    }
+    free(msg); msg=NULL;
+    return CL_TRUE;
 }
 
 cl_int oclandEnqueueWriteBuffer(cl_command_queue    command_queue ,
@@ -2362,6 +3599,50 @@ cl_int oclandEnqueueWriteBuffer(cl_command_queue    command_queue ,
     if(!sockfd){
         return CL_INVALID_EVENT;
     }
+    // Blocking writes of tracked buffers send just the changed blocks,
+    // if they are a minor part of the data
+    deltaWrite delta;
+    cl_bool tracked = CL_FALSE;
+    if(blocking_write == CL_TRUE){
+        tracked = beginDeltaWrite(buffer, offset, cb, ptr, &delta);
+        if(tracked && (delta.dirty <= cb / 2)){
+            cl_int flag = enqueueWriteBufferBlocks(sockfd, command_queue, buffer,
+                                                   offset, ptr, &delta,
+                                                   num_events_in_wait_list,
+                                                   event_wait_list, event);
+            endDeltaWrite(buffer, offset, cb, &delta, flag);
+            return flag;
+        }
+        // Read only buffers are usually lookup tables uploaded by several
+        // processes, so the server may have the data already cached
+        if((getDeltaBufferFlags(buffer) & CL_MEM_READ_ONLY) && useBlob(cb)){
+            cl_int flag;
+            if(enqueueWriteBufferBlob(sockfd, command_queue, buffer, offset, cb, ptr,
+                                      num_events_in_wait_list, event_wait_list,
+                                      event, &flag)){
+                if(tracked)
+                    endDeltaWrite(buffer, offset, cb, &delta, flag);
+                return flag;
+            }
+        }
+    }
+    else{
+        invalidateDeltaBuffer(buffer, offset, cb);
+    }
+    // Large blocking writes to local servers are requested as
+    // asynchronous ones, sending the data through shared memory
+    cl_bool shared = CL_FALSE;
+    if((blocking_write == CL_TRUE) && useSharedMemory(sockfd, cb)){
+        shared = CL_TRUE;
+        blocking_write = CL_FALSE;
+    }
+    // Small asynchronous writes are carried in the package, as the
+    // blocking ones, saving the parallel transfer channel
+    cl_bool inlined = CL_FALSE;
+    if((blocking_write != CL_TRUE) && (!shared) && (cb <= inlineSize())){
+        inlined = CL_TRUE;
+        blocking_write = CL_TRUE;
+    }
     // Build the package
     cl_bool want_event = CL_FALSE;
     if(event) want_event = CL_TRUE;
@@ -2376,25 +3657,23 @@ cl_int oclandEnqueueWriteBuffer(cl_command_queue    command_queue ,
     msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
     if(blocking_write == CL_TRUE)
         msgSize    += cb;                                              // ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(blocking_write == CL_TRUE ? msgSize - cb : msgSize);
     void* mptr = msg;
     ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteBuffer; mptr = (unsigned int*)mptr + 1;
     ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
     ((cl_mem*)mptr)[0]           = buffer;                     mptr = (cl_mem*)mptr + 1;
-    ((cl_bool*)mptr)[0]          = blocking_write;             mptr = (cl_bool*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = inlined ? OCLAND_INLINE_TRANSFER : blocking_write; mptr = (cl_bool*)mptr + 1;
     ((size_t*)mptr)[0]           = offset;                     mptr = (size_t*)mptr + 1;
     ((size_t*)mptr)[0]           = cb;                         mptr = (size_t*)mptr + 1;
     ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
     ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
     memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
-    if(blocking_write == CL_TRUE){
-        mptr = (cl_event*)mptr + num_events_in_wait_list;
-        memcpy(mptr, ptr, cb);
-    }
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // data straight from the user memory)
+    struct timeval t0;
+    gettimeofday(&t0, NULL);
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, ptr, blocking_write == CL_TRUE ? cb : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -2402,9 +3681,32 @@ cl_int oclandEnqueueWriteBuffer(cl_command_queue    command_queue ,
     mptr = msg;
     Recv(sockfd, msg, msgSize, MSG_WAITALL);
     unlock(*sockfd);
+    if(blocking_write == CL_TRUE)
+        reportInlineTransfer(cb, &t0);
     // Decript the flag, if CL_SUCCESS don't received, we can't
     // still working
     cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(shared){
+        if(flag == CL_SUCCESS){
+            struct dataTransfer data;
+            revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+            data.port  = ((unsigned int*)mptr)[0];
+            data.fd    = *sockfd;
+            data.cb    = cb;
+            data.ptr   = (void*)ptr;
+            flag = stripedTransfer(&data, CL_TRUE);
+            if(event){
+                *event = revent;
+                addShortcut(*event, sockfd);
+            }
+        }
+        free(msg); msg=NULL;
+        if(tracked)
+            endDeltaWrite(buffer, offset, cb, &delta, flag);
+        return flag;
+    }
+    if(tracked)
+        endDeltaWrite(buffer, offset, cb, &delta, flag);
     if(flag != CL_SUCCESS)
         return flag;
     // ------------------------------------------------------------
@@ -2435,6 +3737,7 @@ cl_int oclandEnqueueWriteBuffer(cl_command_queue    command_queue ,
     data.fd    = *sockfd;
     data.cb    = cb;
     data.ptr   = (void*)ptr;
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataSend(sockfd, data);
     return flag;
 }
@@ -2455,6 +3758,7 @@ cl_int oclandEnqueueCopyBuffer(cl_command_queue     command_queue ,
     if(!sockfd){
         return CL_INVALID_EVENT;
     }
+    invalidateDeltaBuffer(dst_buffer, dst_offset, cb);
     // Build the package
     cl_bool want_event = CL_FALSE;
     if(event) want_event = CL_TRUE;
@@ -2504,6 +3808,209 @@ cl_int oclandEnqueueCopyBuffer(cl_command_queue     command_queue ,
     return flag;
 }
 
+/** Test if a server address is only valid from its own host, i.e. it is
+ * an Unix domain socket or a loopback address.
+ * @param address Server address.
+ * @return CL_TRUE if the address is local, CL_FALSE otherwise.
+ */
+static cl_bool isLocalAddress(const char *address)
+{
+    if(    (!strncmp(address, OCLAND_UNIX_PREFIX, strlen(OCLAND_UNIX_PREFIX)))
+        || (!strncmp(address, "127.", strlen("127."))))
+        return CL_TRUE;
+    return CL_FALSE;
+}
+
+/** Connect to the transfer port opened by a server and close the
+ * connection at once, such that the server gives up the transfer.
+ * @param sockfd Server main connection socket.
+ * @param port Port where the server is listening.
+ */
+static void abortDataTransfer(int sockfd, unsigned int port)
+{
+    int fd = connectDataStream(sockfd, port, 0);
+    if(fd >= 0)
+        close(fd);
+}
+
+/** Relay a transfer between servers through the client, reading the
+ * data from the source server, and sending it to the transfer port
+ * opened by the destination one.
+ * @return CL_SUCCESS if the data has been transferred, an error code
+ * otherwise.
+ * @see oclandEnqueueCopyBufferToPeer
+ */
+static cl_int relayPeerTransfer(cl_command_queue     src_command_queue ,
+                                cl_mem               src_buffer ,
+                                size_t               src_offset ,
+                                size_t               cb ,
+                                int *                dst_sockfd ,
+                                unsigned int         port ,
+                                cl_uint              num_events_in_wait_list ,
+                                const cl_event *     event_wait_list)
+{
+    cl_int flag;
+    struct dataTransfer data;
+    void *ptr = malloc(cb);
+    if(!ptr){
+        abortDataTransfer(*dst_sockfd, port);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    flag = oclandEnqueueReadBuffer(src_command_queue, src_buffer, CL_TRUE,
+                                   src_offset, cb, ptr,
+                                   num_events_in_wait_list, event_wait_list,
+                                   NULL);
+    if(flag != CL_SUCCESS){
+        abortDataTransfer(*dst_sockfd, port);
+        free(ptr);
+        return flag;
+    }
+    data.port = port;
+    data.fd   = *dst_sockfd;
+    data.cb   = cb;
+    data.ptr  = ptr;
+    flag = stripedTransfer(&data, CL_TRUE);
+    free(ptr);
+    return flag;
+}
+
+cl_int oclandEnqueueCopyBufferToPeer(cl_command_queue     src_command_queue ,
+                                     cl_mem               src_buffer ,
+                                     cl_command_queue     dst_command_queue ,
+                                     cl_mem               dst_buffer ,
+                                     size_t               src_offset ,
+                                     size_t               dst_offset ,
+                                     size_t               cb ,
+                                     cl_uint              num_events_in_wait_list ,
+                                     const cl_event *     event_wait_list ,
+                                     cl_event *           event)
+{
+    cl_event revent = NULL;
+    // Get the servers
+    int *src_sockfd = getShortcut(src_command_queue);
+    int *dst_sockfd = getShortcut(dst_command_queue);
+    if((!src_sockfd) || (!dst_sockfd)){
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    if(!cb){
+        return CL_INVALID_VALUE;
+    }
+    char *peer = serverAddress(*dst_sockfd);
+    if(!peer){
+        return CL_INVALID_COMMAND_QUEUE;
+    }
+    invalidateDeltaBuffer(dst_buffer, dst_offset, cb);
+    // ------------------------------------------------------------
+    // The destination server opens a transfer port, as in a non
+    // blocking write. Its event is always requested, such that
+    // clFinish will wait for the transfer.
+    // ------------------------------------------------------------
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // buffer
+    msgSize        += sizeof(cl_bool);                                 // blocking_write
+    msgSize        += sizeof(size_t);                                  // offset
+    msgSize        += sizeof(size_t);                                  // cb
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteBuffer; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = dst_command_queue;           mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = dst_buffer;                  mptr = (cl_mem*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = CL_FALSE;                    mptr = (cl_bool*)mptr + 1;
+    ((size_t*)mptr)[0]           = dst_offset;                  mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = cb;                          mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = CL_TRUE;                     mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = 0;                           mptr = (cl_uint*)mptr + 1;
+    // Send the package (first the size, and then the data)
+    lock(*dst_sockfd);
+    Send(dst_sockfd, &msgSize, sizeof(size_t), 0);
+    Send(dst_sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(dst_sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(dst_sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*dst_sockfd);
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag != CL_SUCCESS){
+        free(msg); msg=NULL;
+        return flag;
+    }
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+    unsigned int port = ((unsigned int*)mptr)[0];
+    free(msg); msg=NULL;
+    addShortcut(revent, dst_sockfd);
+    // ------------------------------------------------------------
+    // The source server sends the data straight to the destination
+    // one, unless the destination address is only valid from the
+    // client host (and the source server is not there).
+    // ------------------------------------------------------------
+    char *src_peer = serverAddress(*src_sockfd);
+    cl_bool direct = CL_FALSE;
+    if(    (src_sockfd == dst_sockfd)
+        || (!isLocalAddress(peer))
+        || (src_peer && isLocalAddress(src_peer)))
+        direct = CL_TRUE;
+    flag = CL_OUT_OF_RESOURCES;
+    if(direct){
+        size_t peer_size = strlen(peer) + 1;
+        msgSize  = sizeof(unsigned int);                            // Command index
+        msgSize += sizeof(cl_command_queue);                        // command_queue
+        msgSize += sizeof(cl_mem);                                  // buffer
+        msgSize += sizeof(size_t);                                  // offset
+        msgSize += sizeof(size_t);                                  // cb
+        msgSize += sizeof(unsigned int);                            // port
+        msgSize += sizeof(size_t);                                  // peer_size
+        msgSize += peer_size;                                       // peer
+        msgSize += sizeof(cl_bool);                                 // want_event
+        msgSize += sizeof(cl_uint);                                 // num_events_in_wait_list
+        msgSize += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+        msg  = (void*)malloc(msgSize);
+        mptr = msg;
+        ((unsigned int*)mptr)[0]     = ocland_clEnqueueCopyBufferToPeer; mptr = (unsigned int*)mptr + 1;
+        ((cl_command_queue*)mptr)[0] = src_command_queue;                mptr = (cl_command_queue*)mptr + 1;
+        ((cl_mem*)mptr)[0]           = src_buffer;                       mptr = (cl_mem*)mptr + 1;
+        ((size_t*)mptr)[0]           = src_offset;                       mptr = (size_t*)mptr + 1;
+        ((size_t*)mptr)[0]           = cb;                               mptr = (size_t*)mptr + 1;
+        ((unsigned int*)mptr)[0]     = port;                             mptr = (unsigned int*)mptr + 1;
+        ((size_t*)mptr)[0]           = peer_size;                        mptr = (size_t*)mptr + 1;
+        memcpy(mptr, peer, peer_size);                                   mptr = (char*)mptr + peer_size;
+        ((cl_bool*)mptr)[0]          = CL_FALSE;                         mptr = (cl_bool*)mptr + 1;
+        ((cl_uint*)mptr)[0]          = num_events_in_wait_list;          mptr = (cl_uint*)mptr + 1;
+        memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+        // Send the package (first the size, and then the data)
+        lock(*src_sockfd);
+        Send(src_sockfd, &msgSize, sizeof(size_t), 0);
+        Send(src_sockfd, msg, msgSize, 0);
+        free(msg); msg=NULL;
+        // Receive the package (first size, and then data)
+        Recv(src_sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+        msg = (void*)malloc(msgSize);
+        mptr = msg;
+        Recv(src_sockfd, msg, msgSize, MSG_WAITALL);
+        unlock(*src_sockfd);
+        flag = ((cl_int*)mptr)[0];
+        free(msg); msg=NULL;
+    }
+    // ------------------------------------------------------------
+    // Otherwise the data is relayed by the client, the destination
+    // server is waiting for it anyway.
+    // ------------------------------------------------------------
+    if(flag != CL_SUCCESS){
+        flag = relayPeerTransfer(src_command_queue, src_buffer, src_offset, cb,
+                                 dst_sockfd, port,
+                                 num_events_in_wait_list, event_wait_list);
+    }
+    if(event && (flag == CL_SUCCESS))
+        *event = revent;
+    else
+        addPeerEvent(dst_command_queue, revent);
+    return flag;
+}
+
 cl_int oclandEnqueueCopyImage(cl_command_queue      command_queue ,
                               cl_mem                src_image ,
                               cl_mem                dst_image ,
@@ -2585,6 +4092,7 @@ cl_int oclandEnqueueCopyImageToBuffer(cl_command_queue  command_queue ,
     if(!sockfd){
         return CL_INVALID_EVENT;
     }
+    invalidateDeltaBuffer(dst_buffer, dst_offset, (size_t)-1);
     // Build the package
     cl_bool want_event = CL_FALSE;
     if(event) want_event = CL_TRUE;
@@ -2631,72 +4139,489 @@ cl_int oclandEnqueueCopyImageToBuffer(cl_command_queue  command_queue ,
         *event = revent;
         addShortcut(*event, sockfd);
     }
-    return flag;
+    return flag;
+}
+
+cl_int oclandEnqueueCopyBufferToImage(cl_command_queue  command_queue ,
+                                      cl_mem            src_buffer ,
+                                      cl_mem            dst_image ,
+                                      size_t            src_offset ,
+                                      const size_t *    dst_origin ,
+                                      const size_t *    region ,
+                                      cl_uint           num_events_in_wait_list ,
+                                      const cl_event *  event_wait_list ,
+                                      cl_event *        event)
+{
+    cl_event revent = NULL;
+    // Get the server
+    int *sockfd = getShortcut(command_queue);
+    if(!sockfd){
+        return CL_INVALID_EVENT;
+    }
+    // Build the package
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // src_buffer
+    msgSize        += sizeof(cl_mem);                                  // dst_image
+    msgSize        += sizeof(size_t);                                  // src_offset
+    msgSize        += 3*sizeof(size_t);                                // dst_origin
+    msgSize        += 3*sizeof(size_t);                                // region
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueCopyBufferToImage; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;                     mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = src_buffer;                        mptr = (cl_mem*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = dst_image;                         mptr = (cl_mem*)mptr + 1;
+    ((size_t*)mptr)[0]           = src_offset;                        mptr = (size_t*)mptr + 1;
+    memcpy(mptr, dst_origin, 3*sizeof(size_t));                       mptr = (size_t*)mptr + 3;
+    memcpy(mptr, region,     3*sizeof(size_t));                       mptr = (size_t*)mptr + 3;
+    ((cl_bool*)mptr)[0]          = want_event;                        mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;           mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, and then the data)
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    // Decript the flag, if CL_SUCCESS don't received, we can't
+    // still working
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag != CL_SUCCESS)
+        return flag;
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+    if(event){
+        *event = revent;
+        addShortcut(*event, sockfd);
+    }
+    return flag;
+}
+
+/** Enqueue a command transferring just one element of a mapped memory
+ * object, used to get an event when there is no data to transfer, since
+ * the markers are not available in all the servers.
+ * @param command_queue Command queue.
+ * @param map Shadow region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event.
+ * @return CL_SUCCESS if the command is enqueued, an error code otherwise.
+ */
+static cl_int enqueueShadowMapProbe(cl_command_queue  command_queue ,
+                                    shadowMap         map ,
+                                    cl_uint           num_events_in_wait_list ,
+                                    const cl_event *  event_wait_list ,
+                                    cl_event *        event)
+{
+    // Image elements are 16 bytes at most
+    char element[16];
+    const size_t region[3] = {1, 1, 1};
+    if(!map->element_size){
+        return oclandEnqueueReadBuffer(command_queue, map->mem, CL_TRUE,
+                                       map->offset, 1, element,
+                                       num_events_in_wait_list,
+                                       event_wait_list, event);
+    }
+    return oclandEnqueueReadImage(command_queue, map->mem, CL_TRUE,
+                                  map->origin, region, 0, 0,
+                                  map->element_size, element,
+                                  num_events_in_wait_list,
+                                  event_wait_list, event);
+}
+
+/** Fetch the data of a shadow region from the server, and start tracking
+ * the writes of the application if it has been mapped for writing.
+ * @param command_queue Command queue.
+ * @param map Shadow region.
+ * @param blocking_map CL_TRUE if the data must be fetched before
+ * returning, CL_FALSE otherwise.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @return CL_SUCCESS if the data is fetched, an error code otherwise.
+ */
+static cl_int fetchShadowMap(cl_command_queue  command_queue ,
+                             shadowMap         map ,
+                             cl_bool           blocking_map ,
+                             cl_uint           num_events_in_wait_list ,
+                             const cl_event *  event_wait_list ,
+                             cl_event *        event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_bool write = (map->flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) ? CL_TRUE : CL_FALSE;
+    // The application will overwrite the data, so it must not be fetched
+    if(map->flags & CL_MAP_WRITE_INVALIDATE_REGION){
+        if(event){
+            flag = enqueueShadowMapProbe(command_queue, map,
+                                         num_events_in_wait_list,
+                                         event_wait_list, event);
+        }
+        else if((blocking_map == CL_TRUE) && num_events_in_wait_list){
+            flag = oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
+        }
+        if(flag == CL_SUCCESS)
+            trackShadowMap(map);
+        return flag;
+    }
+    // The writes can't be tracked until the data is fetched
+    if(write && (isShadowMapTracking() == CL_TRUE))
+        blocking_map = CL_TRUE;
+    if(!map->element_size){
+        flag = oclandEnqueueReadBuffer(command_queue, map->mem, blocking_map,
+                                       map->offset, map->size, map->ptr,
+                                       num_events_in_wait_list,
+                                       event_wait_list, event);
+    }
+    else{
+        flag = oclandEnqueueReadImage(command_queue, map->mem, blocking_map,
+                                      map->origin, map->region,
+                                      map->row_pitch, map->slice_pitch,
+                                      map->element_size, map->ptr,
+                                      num_events_in_wait_list,
+                                      event_wait_list, event);
+    }
+    if((flag == CL_SUCCESS) && write)
+        trackShadowMap(map);
+    return flag;
+}
+
+/** Map a CL_MEM_USE_HOST_PTR buffer in its host memory, which is
+ * synchronized just if the buffer may have been written.
+ * @param command_queue Command queue.
+ * @param buffer Mirrored buffer.
+ * @param map_flags Mapping flags.
+ * @param offset Offset of the mapped region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Mapped pointer, NULL if errors happened.
+ */
+static void* mapHostPtr(cl_command_queue  command_queue ,
+                        cl_mem            buffer ,
+                        cl_map_flags      map_flags ,
+                        size_t            offset ,
+                        cl_uint           num_events_in_wait_list ,
+                        const cl_event *  event_wait_list ,
+                        cl_event *        event ,
+                        cl_int *          errcode_ret)
+{
+    char element;
+    size_t size;
+    cl_bool stale;
+    cl_int flag = CL_SUCCESS;
+    char *host_ptr = (char*)getDeltaHostPtr(buffer, &size, &stale);
+    // The whole buffer is pulled, such that the mirror is synchronized
+    // again, and the writes can be tracked
+    if(stale){
+        flag = oclandEnqueueReadBuffer(command_queue, buffer, CL_TRUE,
+                                       0, size, host_ptr,
+                                       num_events_in_wait_list,
+                                       event_wait_list, event);
+        if(flag == CL_SUCCESS)
+            validateDeltaHostPtr(buffer);
+    }
+    else if(event){
+        flag = oclandEnqueueReadBuffer(command_queue, buffer, CL_TRUE,
+                                       offset, 1, &element,
+                                       num_events_in_wait_list,
+                                       event_wait_list, event);
+    }
+    else if(num_events_in_wait_list){
+        flag = oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
+    }
+    if(errcode_ret) *errcode_ret = flag;
+    if(flag != CL_SUCCESS)
+        return NULL;
+    mapDeltaHostPtr(buffer, (map_flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) ? CL_TRUE : CL_FALSE);
+    return host_ptr + offset;
+}
+
+/** Unmap a CL_MEM_USE_HOST_PTR buffer, pushing the blocks of the host
+ * memory which have been modified.
+ * @param command_queue Command queue.
+ * @param memobj Mirrored buffer.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @return CL_SUCCESS if the buffer is unmapped, an error code otherwise.
+ */
+static cl_int unmapHostPtr(cl_command_queue  command_queue ,
+                           cl_mem            memobj ,
+                           cl_uint           num_events_in_wait_list ,
+                           const cl_event *  event_wait_list ,
+                           cl_event *        event)
+{
+    char element;
+    size_t size;
+    cl_bool stale;
+    cl_int flag = CL_SUCCESS;
+    char *host_ptr = (char*)getDeltaHostPtr(memobj, &size, &stale);
+    // Just the modified blocks are sent
+    if((!stale) && isDeltaHostPtrDirty(memobj)){
+        flag = oclandEnqueueWriteBuffer(command_queue, memobj, CL_TRUE,
+                                        0, size, host_ptr,
+                                        num_events_in_wait_list,
+                                        event_wait_list, event);
+    }
+    else if(event){
+        flag = oclandEnqueueReadBuffer(command_queue, memobj, CL_TRUE,
+                                       0, 1, &element,
+                                       num_events_in_wait_list,
+                                       event_wait_list, event);
+    }
+    if(flag == CL_SUCCESS)
+        unmapDeltaHostPtr(memobj);
+    return flag;
+}
+
+/** Push the modified host memory of the CL_MEM_USE_HOST_PTR buffers set
+ * as arguments of a kernel, before enqueueing it. Just the buffers
+ * still mapped for writing are tested.
+ * @param command_queue Command queue.
+ * @param kernel Kernel.
+ */
+static void pushKernelHostPtrs(cl_command_queue command_queue, cl_kernel kernel)
+{
+    cl_mem mems[OCLAND_MAX_KERNEL_HOST_PTRS];
+    cl_uint i, n = getDeltaKernelHostPtrs(kernel, mems, OCLAND_MAX_KERNEL_HOST_PTRS);
+    size_t size;
+    cl_bool stale;
+    void *host_ptr;
+    for(i=0;i<n;i++){
+        host_ptr = getDeltaHostPtr(mems[i], &size, &stale);
+        // The stale host memory must be mapped before modifying it
+        if((!host_ptr) || stale || !isDeltaHostPtrDirty(mems[i]))
+            continue;
+        oclandEnqueueWriteBuffer(command_queue, mems[i], CL_TRUE,
+                                 0, size, host_ptr, 0, NULL, NULL);
+    }
+}
+
+void* oclandEnqueueMapBuffer(cl_command_queue  command_queue ,
+                             cl_mem            buffer ,
+                             cl_bool           blocking_map ,
+                             cl_map_flags      map_flags ,
+                             size_t            offset ,
+                             size_t            cb ,
+                             cl_uint           num_events_in_wait_list ,
+                             const cl_event *  event_wait_list ,
+                             cl_event *        event ,
+                             cl_int *          errcode_ret)
+{
+    cl_int flag;
+    // The CL_MEM_USE_HOST_PTR buffers are mapped in their host memory
+    if(getDeltaHostPtr(buffer, NULL, NULL)){
+        return mapHostPtr(command_queue, buffer, map_flags, offset,
+                          num_events_in_wait_list, event_wait_list,
+                          event, errcode_ret);
+    }
+    shadowMap map = addShadowMap(buffer, map_flags, cb);
+    if(!map){
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    map->offset = offset;
+    flag = fetchShadowMap(command_queue, map, blocking_map,
+                          num_events_in_wait_list, event_wait_list, event);
+    if(errcode_ret) *errcode_ret = flag;
+    if(flag != CL_SUCCESS){
+        delShadowMap(map);
+        return NULL;
+    }
+    return map->ptr;
+}
+
+void* oclandEnqueueMapImage(cl_command_queue   command_queue ,
+                            cl_mem             image ,
+                            cl_bool            blocking_map ,
+                            cl_map_flags       map_flags ,
+                            const size_t *     origin ,
+                            const size_t *     region ,
+                            size_t *           image_row_pitch ,
+                            size_t *           image_slice_pitch ,
+                            size_t             element_size ,
+                            cl_uint            num_events_in_wait_list ,
+                            const cl_event *   event_wait_list ,
+                            cl_event *         event ,
+                            cl_int *           errcode_ret)
+{
+    cl_int flag;
+    unsigned int i;
+    // The region is mapped packed
+    size_t row_pitch   = region[0] * element_size;
+    size_t slice_pitch = region[1] * row_pitch;
+    shadowMap map = addShadowMap(image, map_flags, region[2] * slice_pitch);
+    if(!map){
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    for(i=0;i<3;i++){
+        map->origin[i] = origin[i];
+        map->region[i] = region[i];
+    }
+    map->row_pitch    = row_pitch;
+    map->slice_pitch  = region[2] > 1 ? slice_pitch : 0;
+    map->element_size = element_size;
+    flag = fetchShadowMap(command_queue, map, blocking_map,
+                          num_events_in_wait_list, event_wait_list, event);
+    if(errcode_ret) *errcode_ret = flag;
+    if(flag != CL_SUCCESS){
+        delShadowMap(map);
+        return NULL;
+    }
+    if(image_row_pitch) *image_row_pitch = map->row_pitch;
+    if(image_slice_pitch) *image_slice_pitch = map->slice_pitch;
+    return map->ptr;
 }
 
-cl_int oclandEnqueueCopyBufferToImage(cl_command_queue  command_queue ,
-                                      cl_mem            src_buffer ,
-                                      cl_mem            dst_image ,
-                                      size_t            src_offset ,
-                                      const size_t *    dst_origin ,
-                                      const size_t *    region ,
-                                      cl_uint           num_events_in_wait_list ,
-                                      const cl_event *  event_wait_list ,
-                                      cl_event *        event)
+/** Send back the pages of a mapped buffer written by the application.
+ * @param command_queue Command queue.
+ * @param map Shadow region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event of the last write, NULL if there is no
+ * data to write.
+ * @return CL_SUCCESS if the data is written, an error code otherwise.
+ */
+static cl_int writeBackShadowBuffer(cl_command_queue  command_queue ,
+                                    shadowMap         map ,
+                                    cl_uint           num_events_in_wait_list ,
+                                    const cl_event *  event_wait_list ,
+                                    cl_event *        event)
 {
-    cl_event revent = NULL;
-    // Get the server
-    int *sockfd = getShortcut(command_queue);
-    if(!sockfd){
-        return CL_INVALID_EVENT;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start, end;
+    cl_int flag;
+    for(start=0;start<map->size;start=end){
+        if(!isShadowMapDirty(map, start, 1)){
+            end = start + page;
+            continue;
+        }
+        for(end=start+page;end<map->size;end+=page){
+            if(!isShadowMapDirty(map, end, 1))
+                break;
+        }
+        if(end > map->size)
+            end = map->size;
+        if(event && *event)
+            oclandReleaseEvent(*event);
+        // The region will be released, so the data must be already
+        // sent when the write returns
+        flag = oclandEnqueueWriteBuffer(command_queue, map->mem, CL_TRUE,
+                                        map->offset + start, end - start,
+                                        (char*)map->ptr + start,
+                                        num_events_in_wait_list,
+                                        event_wait_list, event);
+        if(flag != CL_SUCCESS)
+            return flag;
     }
-    // Build the package
-    cl_bool want_event = CL_FALSE;
-    if(event) want_event = CL_TRUE;
-    size_t msgSize  = sizeof(unsigned int);                            // Command index
-    msgSize        += sizeof(cl_command_queue);                        // command_queue
-    msgSize        += sizeof(cl_mem);                                  // src_buffer
-    msgSize        += sizeof(cl_mem);                                  // dst_image
-    msgSize        += sizeof(size_t);                                  // src_offset
-    msgSize        += 3*sizeof(size_t);                                // dst_origin
-    msgSize        += 3*sizeof(size_t);                                // region
-    msgSize        += sizeof(cl_bool);                                 // want_event
-    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
-    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
-    void* msg = (void*)malloc(msgSize);
-    void* mptr = msg;
-    ((unsigned int*)mptr)[0]     = ocland_clEnqueueCopyBufferToImage; mptr = (unsigned int*)mptr + 1;
-    ((cl_command_queue*)mptr)[0] = command_queue;                     mptr = (cl_command_queue*)mptr + 1;
-    ((cl_mem*)mptr)[0]           = src_buffer;                        mptr = (cl_mem*)mptr + 1;
-    ((cl_mem*)mptr)[0]           = dst_image;                         mptr = (cl_mem*)mptr + 1;
-    ((size_t*)mptr)[0]           = src_offset;                        mptr = (size_t*)mptr + 1;
-    memcpy(mptr, dst_origin, 3*sizeof(size_t));                       mptr = (size_t*)mptr + 3;
-    memcpy(mptr, region,     3*sizeof(size_t));                       mptr = (size_t*)mptr + 3;
-    ((cl_bool*)mptr)[0]          = want_event;                        mptr = (cl_bool*)mptr + 1;
-    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;           mptr = (cl_uint*)mptr + 1;
-    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
-    // Send the package (first the size, and then the data)
-    lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
-    free(msg); msg=NULL;
-    // Receive the package (first size, and then data)
-    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
-    msg = (void*)malloc(msgSize);
-    mptr = msg;
-    Recv(sockfd, msg, msgSize, MSG_WAITALL);
-    unlock(*sockfd);
-    // Decript the flag, if CL_SUCCESS don't received, we can't
-    // still working
-    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
-    if(flag != CL_SUCCESS)
+    return CL_SUCCESS;
+}
+
+/** Send back the rows of a mapped image written by the application.
+ * @param command_queue Command queue.
+ * @param map Shadow region.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event of the last write, NULL if there is no
+ * data to write.
+ * @return CL_SUCCESS if the data is written, an error code otherwise.
+ */
+static cl_int writeBackShadowImage(cl_command_queue  command_queue ,
+                                   shadowMap         map ,
+                                   cl_uint           num_events_in_wait_list ,
+                                   const cl_event *  event_wait_list ,
+                                   cl_event *        event)
+{
+    size_t slice_pitch = map->region[1] * map->row_pitch;
+    size_t origin[3], region[3];
+    size_t slice, start, end;
+    cl_int flag;
+    for(slice=0;slice<map->region[2];slice++){
+        for(start=0;start<map->region[1];start=end+1){
+            end = start;
+            if(!isShadowMapDirty(map, slice * slice_pitch + start * map->row_pitch, map->row_pitch))
+                continue;
+            while((end + 1 < map->region[1]) &&
+                  isShadowMapDirty(map, slice * slice_pitch + (end + 1) * map->row_pitch, map->row_pitch))
+                end++;
+            origin[0] = map->origin[0];
+            origin[1] = map->origin[1] + start;
+            origin[2] = map->origin[2] + slice;
+            region[0] = map->region[0];
+            region[1] = end - start + 1;
+            region[2] = 1;
+            if(event && *event)
+                oclandReleaseEvent(*event);
+            flag = oclandEnqueueWriteImage(command_queue, map->mem, CL_TRUE,
+                                           origin, region, map->row_pitch, 0,
+                                           map->element_size,
+                                           (char*)map->ptr + slice * slice_pitch + start * map->row_pitch,
+                                           num_events_in_wait_list,
+                                           event_wait_list, event);
+            if(flag != CL_SUCCESS)
+                return flag;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int oclandEnqueueUnmapMemObject(cl_command_queue  command_queue ,
+                                   cl_mem            memobj ,
+                                   void *            mapped_ptr ,
+                                   cl_uint           num_events_in_wait_list ,
+                                   const cl_event *  event_wait_list ,
+                                   cl_event *        event)
+{
+    cl_int flag = CL_SUCCESS;
+    if(getDeltaHostPtr(memobj, NULL, NULL)){
+        return unmapHostPtr(command_queue, memobj,
+                            num_events_in_wait_list, event_wait_list,
+                            event);
+    }
+    shadowMap map = getShadowMap(memobj, mapped_ptr);
+    if(!map){
+        return CL_INVALID_VALUE;
+    }
+    if(event) *event = NULL;
+    if(map->flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)){
+        if(!map->element_size)
+            flag = writeBackShadowBuffer(command_queue, map,
+                                         num_events_in_wait_list,
+                                         event_wait_list, event);
+        else
+            flag = writeBackShadowImage(command_queue, map,
+                                        num_events_in_wait_list,
+                                        event_wait_list, event);
+    }
+    if(flag != CL_SUCCESS){
+        if(event && *event){
+            oclandReleaseEvent(*event);
+            *event = NULL;
+        }
         return flag;
-    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
-    if(event){
-        *event = revent;
-        addShortcut(*event, sockfd);
     }
-    return flag;
+    // Nothing has been written, but an event must be returned anyway
+    if(event && !(*event)){
+        flag = enqueueShadowMapProbe(command_queue, map,
+                                     num_events_in_wait_list,
+                                     event_wait_list, event);
+        if(flag != CL_SUCCESS)
+            return flag;
+    }
+    delShadowMap(map);
+    return CL_SUCCESS;
 }
 
 cl_int oclandEnqueueNDRangeKernel(cl_command_queue  command_queue ,
@@ -2715,6 +4640,10 @@ cl_int oclandEnqueueNDRangeKernel(cl_command_queue  command_queue ,
     if(!sockfd){
         return CL_INVALID_EVENT;
     }
+    // The mirrored host memory may have been modified
+    pushKernelHostPtrs(command_queue, kernel);
+    // The buffers that the kernel may write can't be patched anymore
+    invalidateDeltaKernel(kernel);
     // Build the package
     cl_bool want_event = CL_FALSE;
     if(event) want_event = CL_TRUE;
@@ -2791,7 +4720,7 @@ struct dataTransferRect{
     /// Socket
     int fd;
     /// Region to read
-    const size_t *region;
+    size_t region[3];
     /// Size of a row
     size_t row;
     /// Size of a 2D slice (row*column)
@@ -2800,8 +4729,71 @@ struct dataTransferRect{
     size_t cb;
     /// Data array (conviniently sifted with origin)
     void *ptr;
+    /// Packed copy of the region transferred, released after the
+    /// transfer. NULL if the data array is already packed
+    void *packed;
+    /// Tracked transfer, ended when the data is transferred
+    pendingTransfer transfer;
 };
 
+/** Test if the rows and slices of a region are contiguous in the host
+ * memory, such that it can be transferred without packing it.
+ * @param region Region size.
+ * @param row Size of a host memory row.
+ * @param slice Size of a host memory 2D slice.
+ * @return CL_TRUE if the region is packed, CL_FALSE otherwise.
+ */
+static cl_bool isPackedRect(const size_t *region, size_t row, size_t slice)
+{
+    if((region[1] > 1) && (row != region[0]))
+        return CL_FALSE;
+    if((region[2] > 1) && (slice != region[0]*region[1]))
+        return CL_FALSE;
+    return CL_TRUE;
+}
+
+/** Pack a region of the host memory, copying it row by row.
+ * @param packed Packed memory, of region[0]*region[1]*region[2] bytes.
+ * @param ptr Host memory, shifted with the region origin.
+ * @param region Region size.
+ * @param row Size of a host memory row.
+ * @param slice Size of a host memory 2D slice.
+ */
+static void packRect(void *packed, const void *ptr, const size_t *region, size_t row, size_t slice)
+{
+    size_t j, k;
+    char *dst = (char*)packed;
+    for(k=0;k<region[2];k++){
+        const char *src = (const char*)ptr + k*slice;
+        for(j=0;j<region[1];j++){
+            memcpy(dst, src, region[0]);
+            dst += region[0];
+            src += row;
+        }
+    }
+}
+
+/** Unpack a region into the host memory, copying it row by row.
+ * @param packed Packed memory, of region[0]*region[1]*region[2] bytes.
+ * @param ptr Host memory, shifted with the region origin.
+ * @param region Region size.
+ * @param row Size of a host memory row.
+ * @param slice Size of a host memory 2D slice.
+ */
+static void unpackRect(const void *packed, void *ptr, const size_t *region, size_t row, size_t slice)
+{
+    size_t j, k;
+    const char *src = (const char*)packed;
+    for(k=0;k<region[2];k++){
+        char *dst = (char*)ptr + k*slice;
+        for(j=0;j<region[1];j++){
+            memcpy(dst, src, region[0]);
+            src += region[0];
+            dst += row;
+        }
+    }
+}
+
 /** Thread that receives data from server for
  * a clEnqueueReadBufferRect specific command.
  * @param data struct dataTransfer casted variable.
@@ -2811,47 +4803,24 @@ void *asyncDataRecvRect_thread(void *data)
 {
     struct dataTransferRect* _data = (struct dataTransferRect*)data;
     // Connect to the received port.
-    unsigned int port = _data->port;
-    struct sockaddr_in serv_addr;
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = connectDataStream(_data->fd, _data->port, 0);
     if(fd < 0){
-        printf("ERROR: Can't register a new socket for the asynchronous data transfer\n"); fflush(stdout);
-        return;
-    }
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    socklen_t len_inet;
-    len_inet = sizeof(serv_addr);
-    char* ip = serverAddress(_data->fd);
-    if(!ip){
-        printf("ERROR: Can't find the server associated with the socket\n"); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port   = htons(port);
-    if(inet_pton(AF_INET, ip, &serv_addr.sin_addr)<=0){
-        // we can't work, disconnect from server
-        printf("ERROR: Invalid address assigment (%s)\n", ip); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    while( connect(fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 ){
-        if(errno == ECONNREFUSED){
-            // Pobably the server is not ready yet, simply retry
-            // it until the server start listening
-            continue;
-        }
-        // we can't work, disconnect from server
-        printf("ERROR: Can't connect for the asynchronous data transfer\n"); fflush(stdout);
-        printf("\t%s\n", SocketsError()); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
+        endPendingTransfer(_data->transfer);
+        free(_data->packed);
+        free(_data); _data=NULL;
+        pthread_exit(NULL);
+        return NULL;
     }
     // Receive the data
-    Recv(&fd, _data->ptr, _data->cb, MSG_WAITALL);
+    oclandStream stream = CreateStream(ConnectCompression(&fd));
+    RecvStream(&fd, stream, _data->packed ? _data->packed : _data->ptr, _data->cb);
+    ReleaseStream(stream);
+    close(fd);
+    if(_data->packed){
+        unpackRect(_data->packed, _data->ptr, _data->region, _data->row, _data->slice);
+        free(_data->packed);
+    }
+    endPendingTransfer(_data->transfer);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -2870,12 +4839,22 @@ void asyncDataRecvRect(int* sockfd, struct dataTransferRect data)
     struct dataTransferRect* _data = (struct dataTransferRect*)malloc(sizeof(struct dataTransferRect));
     _data->port  = data.port;
     _data->fd    = data.fd;
-    _data->region = data.region;
+    memcpy(_data->region, data.region, 3*sizeof(size_t));
     _data->row    = data.row;
     _data->slice  = data.slice;
     _data->cb    = data.cb;
     _data->ptr   = data.ptr;
+    _data->packed = data.packed;
+    _data->transfer = data.transfer;
     int rc = pthread_create(&thread, NULL, asyncDataRecvRect_thread, (void *)(_data));
+    if(rc){
+        printf("ERROR: Can't create the data transfer thread\n");
+        endPendingTransfer(_data->transfer);
+        free(_data->packed);
+        free(_data); _data=NULL;
+        return;
+    }
+    pthread_detach(thread);
 }
 
 cl_int oclandEnqueueReadImage(cl_command_queue      command_queue ,
@@ -2929,29 +4908,28 @@ cl_int oclandEnqueueReadImage(cl_command_queue      command_queue ,
     Send(sockfd, &msgSize, sizeof(size_t), 0);
     Send(sockfd, msg, msgSize, 0);
     free(msg); msg=NULL;
-    // Receive the package (first size, and then data)
-    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
-    msg = (void*)malloc(msgSize);
-    mptr = msg;
-    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    // Receive the package header (size, flag and event), and then
+    // the data straight into the user memory, or the port
+    size_t cb = region[2]*slice_pitch + region[1]*row_pitch + region[0]*element_size;
+    unsigned int port = 0;
+    cl_int flag = recvReadHeader(sockfd, &revent, &msgSize);
+    if(flag != CL_SUCCESS){
+        unlock(*sockfd);
+        return flag;
+    }
+    flag = recvReadData(sockfd, msgSize, blocking_read == CL_TRUE ? ptr : NULL, cb, &port);
     unlock(*sockfd);
-    // Decript the flag, if CL_SUCCESS don't received, we can't
-    // still working
-    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
     if(flag != CL_SUCCESS)
         return flag;
-    size_t cb = region[2]*slice_pitch + region[1]*row_pitch + region[0]*element_size;
+    if(event){
+        *event = revent;
+        addShortcut(*event, sockfd);
+    }
     // ------------------------------------------------------------
     // Blocking read case:
     // We may have received the flag, the event, and the data.
     // ------------------------------------------------------------
     if(blocking_read == CL_TRUE){
-        revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
-        if(event){
-            *event = revent;
-            addShortcut(*event, sockfd);
-        }
-        memcpy(ptr, mptr, cb);
         return flag;
     }
     // ------------------------------------------------------------
@@ -2959,20 +4937,16 @@ cl_int oclandEnqueueReadImage(cl_command_queue      command_queue ,
     // We may have received the flag, the event, and a port to open
     // a parallel transfer channel.
     // ------------------------------------------------------------
-    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
-    if(event){
-        *event = revent;
-        addShortcut(*event, sockfd);
-    }
-    unsigned int port = ((unsigned int*)mptr)[0];
     struct dataTransferRect data;
     data.port   = port;
     data.fd     = *sockfd;
-    data.region = region;
+    memcpy(data.region, region, 3*sizeof(size_t));
     data.row    = row_pitch;
     data.slice  = slice_pitch;
     data.cb     = cb;
     data.ptr    = ptr;
+    data.packed = NULL;
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataRecvRect(sockfd, data);
     return flag;
 }
@@ -2985,47 +4959,21 @@ void *asyncDataSendRect_thread(void *data)
 {
     struct dataTransferRect* _data = (struct dataTransferRect*)data;
     // Connect to the received port.
-    unsigned int port = _data->port;
-    struct sockaddr_in serv_addr;
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = connectDataStream(_data->fd, _data->port, 0);
     if(fd < 0){
-        printf("ERROR: Can't register a new socket for the asynchronous data transfer\n"); fflush(stdout);
-        return;
-    }
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    socklen_t len_inet;
-    len_inet = sizeof(serv_addr);
-    char* ip = serverAddress(_data->fd);
-    if(!ip){
-        printf("ERROR: Can't find the server associated with the socket\n"); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port   = htons(port);
-    if(inet_pton(AF_INET, ip, &serv_addr.sin_addr)<=0){
-        // we can't work, disconnect from server
-        printf("ERROR: Invalid address assigment (%s)\n", ip); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
-    }
-    while( connect(fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 ){
-        if(errno == ECONNREFUSED){
-            // Pobably the server is not ready yet, simply retry
-            // it until the server start listening
-            continue;
-        }
-        // we can't work, disconnect from server
-        printf("ERROR: Can't connect for the asynchronous data transfer\n"); fflush(stdout);
-        printf("\t%s\n", SocketsError()); fflush(stdout);
-        shutdown(fd, 2);
-        fd = -1;
-        return;
+        endPendingTransfer(_data->transfer);
+        free(_data->packed);
+        free(_data); _data=NULL;
+        pthread_exit(NULL);
+        return NULL;
     }
     // Send the data
-    Send(&fd, _data->ptr, _data->cb, 0);
+    oclandStream stream = CreateStream(ConnectCompression(&fd));
+    SendStream(&fd, stream, _data->packed ? _data->packed : _data->ptr, _data->cb);
+    ReleaseStream(stream);
+    close(fd);
+    free(_data->packed);
+    endPendingTransfer(_data->transfer);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -3043,12 +4991,22 @@ void asyncDataSendRect(int* sockfd, struct dataTransferRect data)
     struct dataTransferRect* _data = (struct dataTransferRect*)malloc(sizeof(struct dataTransferRect));
     _data->port  = data.port;
     _data->fd    = data.fd;
-    _data->region = data.region;
+    memcpy(_data->region, data.region, 3*sizeof(size_t));
     _data->row    = data.row;
     _data->slice  = data.slice;
     _data->cb    = data.cb;
     _data->ptr   = data.ptr;
+    _data->packed = data.packed;
+    _data->transfer = data.transfer;
     int rc = pthread_create(&thread, NULL, asyncDataSendRect_thread, (void *)(_data));
+    if(rc){
+        printf("ERROR: Can't create the data transfer thread\n");
+        endPendingTransfer(_data->transfer);
+        free(_data->packed);
+        free(_data); _data=NULL;
+        return;
+    }
+    pthread_detach(thread);
 }
 
 cl_int oclandEnqueueWriteImage(cl_command_queue     command_queue ,
@@ -3087,7 +5045,7 @@ cl_int oclandEnqueueWriteImage(cl_command_queue     command_queue ,
     msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
     if(blocking_write == CL_TRUE)
         msgSize    += cb;                                              // ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(blocking_write == CL_TRUE ? msgSize - cb : msgSize);
     void* mptr = msg;
     ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteImage; mptr = (unsigned int*)mptr + 1;
     ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
@@ -3100,14 +5058,10 @@ cl_int oclandEnqueueWriteImage(cl_command_queue     command_queue ,
     ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
     ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
     memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
-    if(blocking_write == CL_TRUE){
-        mptr = (cl_event*)mptr + num_events_in_wait_list;
-        memcpy(mptr, ptr, cb);
-    }
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // data straight from the user memory)
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, ptr, blocking_write == CL_TRUE ? cb : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -3146,11 +5100,13 @@ cl_int oclandEnqueueWriteImage(cl_command_queue     command_queue ,
     struct dataTransferRect data;
     data.port  = port;
     data.fd    = *sockfd;
-    data.region = region;
+    memcpy(data.region, region, 3*sizeof(size_t));
     data.row    = row_pitch;
     data.slice  = slice_pitch;
     data.cb    = cb;
     data.ptr   = (void*)ptr;
+    data.packed = NULL;
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataSendRect(sockfd, data);
     return flag;
 }
@@ -3183,7 +5139,7 @@ cl_mem oclandCreateImage2D(cl_context context,
     msgSize        += sizeof(size_t);          // image_row_pitch
     msgSize        += sizeof(cl_bool);         // hasPtr
     if(host_ptr) msgSize += size;              // host_ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(host_ptr ? msgSize - size : msgSize);
     void* ptr = msg;
     ((unsigned int*)ptr)[0]    = ocland_clCreateImage2D; ptr = (unsigned int*)ptr + 1;
     ((cl_context*)ptr)[0]      = context;                ptr = (cl_context*)ptr + 1;
@@ -3193,11 +5149,10 @@ cl_mem oclandCreateImage2D(cl_context context,
     ((size_t*)ptr)[0]          = image_height;           ptr = (size_t*)ptr + 1;
     ((size_t*)ptr)[0]          = image_row_pitch;        ptr = (size_t*)ptr + 1;
     ((cl_bool*)ptr)[0]         = hasPtr;                 ptr = (cl_bool*)ptr + 1;
-    if(host_ptr) memcpy(ptr, host_ptr, size);
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // host data straight from the user memory)
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, host_ptr, host_ptr ? size : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -3247,7 +5202,7 @@ cl_mem oclandCreateImage3D(cl_context context,
     msgSize        += sizeof(size_t);          // image_slice_pitch
     msgSize        += sizeof(cl_bool);         // hasPtr
     if(host_ptr) msgSize += size;              // host_ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(host_ptr ? msgSize - size : msgSize);
     void* ptr = msg;
     ((unsigned int*)ptr)[0]    = ocland_clCreateImage3D; ptr = (unsigned int*)ptr + 1;
     ((cl_context*)ptr)[0]      = context;                ptr = (cl_context*)ptr + 1;
@@ -3259,11 +5214,10 @@ cl_mem oclandCreateImage3D(cl_context context,
     ((size_t*)ptr)[0]          = image_row_pitch;        ptr = (size_t*)ptr + 1;
     ((size_t*)ptr)[0]          = image_slice_pitch;      ptr = (size_t*)ptr + 1;
     ((cl_bool*)ptr)[0]         = hasPtr;                 ptr = (cl_bool*)ptr + 1;
-    if(host_ptr) memcpy(ptr, host_ptr, size);
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // host data straight from the user memory)
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, host_ptr, host_ptr ? size : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -3331,6 +5285,8 @@ cl_mem oclandCreateSubBuffer(cl_mem                    buffer ,
         return NULL;
     cl_mem memobj = ((cl_mem*)ptr)[0];
     addShortcut((void*)memobj, sockfd);
+    // The parent buffer can be modified through the sub-buffer
+    delDeltaBuffer(buffer);
     return memobj;
 }
 
@@ -3418,87 +5374,101 @@ cl_int oclandEnqueueReadBufferRect(cl_command_queue     command_queue ,
                                    const cl_event *     event_wait_list ,
                                    cl_event *           event)
 {
-    char buffer[BUFF_SIZE];
-    cl_bool want_event = CL_FALSE;
-    // Look for a shortcut
+    cl_event revent = NULL;
+    // Get the server
     int *sockfd = getShortcut(command_queue);
     if(!sockfd){
         return CL_INVALID_COMMAND_QUEUE;
     }
-    // Execute the command on server
-    unsigned int commDim = strlen("clEnqueueReadBufferRect")+1;
-    Send(sockfd, &commDim, sizeof(unsigned int), 0);
-    // Send command to perform
-    strcpy(buffer, "clEnqueueReadBufferRect");
-    Send(sockfd, buffer, strlen(buffer)+1, 0);
-    // Send parameters. Host origin will be omissed for the
-    // server, and all the responsability to generate store
-    // the input data is rely to the client.
-    Send(sockfd, &command_queue, sizeof(cl_command_queue), 0);
-    Send(sockfd, &mem, sizeof(cl_mem), 0);
-    Send(sockfd, &blocking_read, sizeof(cl_bool), 0);
-    Send(sockfd, buffer_origin, 3*sizeof(size_t), 0);
-    Send(sockfd, region, 3*sizeof(size_t), 0);
-    Send(sockfd, &buffer_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &buffer_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &host_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &host_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &num_events_in_wait_list, sizeof(cl_uint), 0);
-    if(num_events_in_wait_list)
-        Send(sockfd, &event_wait_list, num_events_in_wait_list*sizeof(cl_event), 0);
-    if(event)
-        want_event = CL_TRUE;
-    Send(sockfd, &want_event, sizeof(cl_bool), 0);
-    // And request flag, and event if needed
-    cl_int flag = CL_INVALID_CONTEXT;
-    Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
-    if(flag != CL_SUCCESS)
+    // Only the region is transferred, packed, so a staging memory is
+    // needed if the host memory is not packed already
+    size_t cb = region[0]*region[1]*region[2];
+    void *host = (char*)ptr + host_origin[0]
+                            + host_origin[1]*host_row_pitch
+                            + host_origin[2]*host_slice_pitch;
+    void *packed = NULL;
+    if(!isPackedRect(region, host_row_pitch, host_slice_pitch)){
+        packed = malloc(cb);
+        if(!packed)
+            return CL_OUT_OF_HOST_MEMORY;
+    }
+    // Build the package
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // mem
+    msgSize        += sizeof(cl_bool);                                 // blocking_read
+    msgSize        += 3*sizeof(size_t);                                // buffer_origin
+    msgSize        += 3*sizeof(size_t);                                // region
+    msgSize        += sizeof(size_t);                                  // buffer_row_pitch
+    msgSize        += sizeof(size_t);                                  // buffer_slice_pitch
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueReadBufferRect; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;                  mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = mem;                            mptr = (cl_mem*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = blocking_read;                  mptr = (cl_bool*)mptr + 1;
+    memcpy(mptr,(void*)buffer_origin,3*sizeof(size_t));            mptr = (size_t*)mptr + 3;
+    memcpy(mptr,(void*)region,3*sizeof(size_t));                   mptr = (size_t*)mptr + 3;
+    ((size_t*)mptr)[0]           = buffer_row_pitch;               mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = buffer_slice_pitch;             mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                     mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;        mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, and then the data)
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package header (size, flag and event), and then
+    // the packed data, or the port
+    unsigned int port = 0;
+    cl_int flag = recvReadHeader(sockfd, &revent, &msgSize);
+    if(flag != CL_SUCCESS){
+        unlock(*sockfd);
+        free(packed);
+        return flag;
+    }
+    flag = recvReadData(sockfd, msgSize, blocking_read == CL_TRUE ? (packed ? packed : host) : NULL, cb, &port);
+    unlock(*sockfd);
+    if(flag != CL_SUCCESS){
+        free(packed);
         return flag;
+    }
     if(event){
-        Recv(sockfd, event, sizeof(cl_event), MSG_WAITALL);
+        *event = revent;
         addShortcut(*event, sockfd);
     }
-    size_t origin = host_origin[0] +
-                    host_origin[1]*host_row_pitch +
-                    host_origin[2]*host_slice_pitch;
-    // In case of blocking simply receive the data.
-    // In rect reading process the data will read in
-    // blocks of host_row_pitch size, along all the
-    // region specified.
+    // ------------------------------------------------------------
+    // Blocking read case:
+    // We may have received the flag, the event, and the data.
+    // ------------------------------------------------------------
     if(blocking_read == CL_TRUE){
-        unsigned int i, j, k, n;
-        // Receive first the buffer purposed by server,
-        // in order to can send data larger than the transfer
-        // buffer.
-        size_t buffsize;
-        Recv(sockfd, &buffsize, sizeof(size_t), MSG_WAITALL);
-        if(!buffsize){
-            return CL_OUT_OF_HOST_MEMORY;
-        }
-        // Compute the number of packages needed per row
-        n = host_row_pitch / buffsize;
-        for(j=0;j<region[1];j++){
-            for(k=0;k<region[2];k++){
-                // Receive package by pieces
-                for(i=0;i<n;i++){
-                    Send(sockfd, ptr + i*buffsize + origin, buffsize, 0);
-                }
-                if(host_row_pitch % buffsize){
-                    // Remains some data to transfer
-                    Send(sockfd, ptr + n*buffsize + origin, host_row_pitch % buffsize, 0);
-                }
-                // Compute the new origin
-                origin += host_row_pitch;
-            }
+        if(packed){
+            unpackRect(packed, host, region, host_row_pitch, host_slice_pitch);
+            free(packed);
         }
         return flag;
     }
-    // In the non blocking case more complex operations are requested
+    // ------------------------------------------------------------
+    // Asynchronous read case:
+    // We may have received the flag, the event, and a port to open
+    // a parallel transfer channel.
+    // ------------------------------------------------------------
     struct dataTransferRect data;
-    data.region = region;
+    data.port   = port;
+    data.fd     = *sockfd;
+    memcpy(data.region, region, 3*sizeof(size_t));
     data.row    = host_row_pitch;
     data.slice  = host_slice_pitch;
-    data.ptr    = ptr + origin;
+    data.cb     = cb;
+    data.ptr    = host;
+    data.packed = packed;
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataRecvRect(sockfd, data);
     return flag;
 }
@@ -3517,86 +5487,112 @@ cl_int oclandEnqueueWriteBufferRect(cl_command_queue     command_queue ,
                                     cl_uint              num_events_in_wait_list ,
                                     const cl_event *     event_wait_list ,
                                     cl_event *           event)
-{
-    char buffer[BUFF_SIZE];
-    cl_bool want_event = CL_FALSE;
-    // Look for a shortcut
+{
+    cl_event revent = NULL;
+    // Get the server
     int *sockfd = getShortcut(command_queue);
     if(!sockfd){
         return CL_INVALID_COMMAND_QUEUE;
     }
-    // Execute the command on server
-    unsigned int commDim = strlen("clEnqueueWriteBufferRect")+1;
-    Send(sockfd, &commDim, sizeof(unsigned int), 0);
-    // Send command to perform
-    strcpy(buffer, "clEnqueueWriteBufferRect");
-    Send(sockfd, buffer, strlen(buffer)+1, 0);
-    // Send parameters
-    Send(sockfd, &command_queue, sizeof(cl_command_queue), 0);
-    Send(sockfd, &mem, sizeof(cl_mem), 0);
-    Send(sockfd, &blocking_write, sizeof(cl_bool), 0);
-    Send(sockfd, buffer_origin, 3*sizeof(size_t), 0);
-    Send(sockfd, region, 3*sizeof(size_t), 0);
-    Send(sockfd, &buffer_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &buffer_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &host_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &host_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &num_events_in_wait_list, sizeof(cl_uint), 0);
-    if(num_events_in_wait_list)
-        Send(sockfd, &event_wait_list, num_events_in_wait_list*sizeof(cl_event), 0);
-    if(event)
-        want_event = CL_TRUE;
-    Send(sockfd, &want_event, sizeof(cl_bool), 0);
-    // And request flag, and event if request
-    cl_int flag = CL_INVALID_CONTEXT;
-    Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
-    if(flag != CL_SUCCESS)
+    // Only the region is transferred, packed, so the host memory
+    // should be packed if it is not already
+    size_t cb = region[0]*region[1]*region[2];
+    void *host = (char*)ptr + host_origin[0]
+                            + host_origin[1]*host_row_pitch
+                            + host_origin[2]*host_slice_pitch;
+    void *packed = NULL;
+    if(!isPackedRect(region, host_row_pitch, host_slice_pitch)){
+        packed = malloc(cb);
+        if(!packed)
+            return CL_OUT_OF_HOST_MEMORY;
+        packRect(packed, host, region, host_row_pitch, host_slice_pitch);
+    }
+    size_t offset = buffer_origin[0]
+                  + buffer_origin[1]*buffer_row_pitch
+                  + buffer_origin[2]*buffer_slice_pitch;
+    invalidateDeltaBuffer(mem, offset,
+                          (region[2] - 1)*buffer_slice_pitch
+                          + (region[1] - 1)*buffer_row_pitch
+                          + region[0]);
+    // Build the package
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // mem
+    msgSize        += sizeof(cl_bool);                                 // blocking_write
+    msgSize        += 3*sizeof(size_t);                                // buffer_origin
+    msgSize        += 3*sizeof(size_t);                                // region
+    msgSize        += sizeof(size_t);                                  // buffer_row_pitch
+    msgSize        += sizeof(size_t);                                  // buffer_slice_pitch
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    if(blocking_write == CL_TRUE)
+        msgSize    += cb;                                              // packed data
+    void* msg = (void*)malloc(blocking_write == CL_TRUE ? msgSize - cb : msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueWriteBufferRect; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;                   mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = mem;                             mptr = (cl_mem*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = blocking_write;                  mptr = (cl_bool*)mptr + 1;
+    memcpy(mptr,(void*)buffer_origin,3*sizeof(size_t));             mptr = (size_t*)mptr + 3;
+    memcpy(mptr,(void*)region,3*sizeof(size_t));                    mptr = (size_t*)mptr + 3;
+    ((size_t*)mptr)[0]           = buffer_row_pitch;                mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = buffer_slice_pitch;              mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                      mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;         mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, then the header, and the
+    // packed data)
+    lock(*sockfd);
+    sendPackage(sockfd, msg, msgSize, packed ? packed : host, blocking_write == CL_TRUE ? cb : 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    // Decript the flag, if CL_SUCCESS don't received, we can't
+    // still working
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if((flag != CL_SUCCESS) || (blocking_write == CL_TRUE))
+        free(packed);
+    if(flag != CL_SUCCESS){
+        free(msg); msg=NULL;
         return flag;
+    }
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
     if(event){
-        Recv(sockfd, event, sizeof(cl_event), MSG_WAITALL);
+        *event = revent;
         addShortcut(*event, sockfd);
     }
-    // In case of blocking simply receive the data
+    // ------------------------------------------------------------
+    // Blocking write case:
+    // We may have received the flag, and the event.
+    // ------------------------------------------------------------
     if(blocking_write == CL_TRUE){
-        unsigned int i,j,k,n;
-        // Receive first the buffer purposed by server,
-        // in order to can send data larger than the transfer
-        // buffer.
-        size_t buffsize;
-        Recv(sockfd, &buffsize, sizeof(size_t), MSG_WAITALL);
-        if(!buffsize){
-            return CL_OUT_OF_HOST_MEMORY;
-        }
-        // Compute the number of packages needed
-        n = host_row_pitch / buffsize;
-        // Send package by pieces
-        size_t origin=0;
-        for(j=0;j<region[1];j++){
-            for(k=0;k<region[2];k++){
-                // Receive package by pieces
-                for(i=0;i<n;i++){
-                    Send(sockfd, (void*)ptr + i*buffsize + origin, buffsize, 0);
-                }
-                if(host_row_pitch % buffsize){
-                    // Remains some data to transfer
-                    Send(sockfd, (void*)ptr + n*buffsize + origin, host_row_pitch % buffsize, 0);
-                }
-                // Compute the new origin
-                origin += host_row_pitch;
-            }
-        }
-        // Get new flag after clEnqueueWriteBuffer has been
-        // called in the server
-        flag = CL_INVALID_CONTEXT;
-        Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
+        free(msg); msg=NULL;
         return flag;
     }
-    // In the non blocking case more complex operations are requested
+    // ------------------------------------------------------------
+    // Asynchronous write case:
+    // We may have received the flag, the event, and a port to open
+    // a parallel transfer channel.
+    // ------------------------------------------------------------
+    unsigned int port = ((unsigned int*)mptr)[0];
+    free(msg); msg=NULL;
     struct dataTransferRect data;
-    data.region = region;
+    data.port   = port;
+    data.fd     = *sockfd;
+    memcpy(data.region, region, 3*sizeof(size_t));
     data.row    = host_row_pitch;
     data.slice  = host_slice_pitch;
-    data.ptr    = (void*)ptr;
+    data.cb     = cb;
+    data.ptr    = host;
+    data.packed = packed;
+    data.transfer = addPendingTransfer(command_queue, event ? revent : NULL);
     asyncDataSendRect(sockfd, data);
     return flag;
 }
@@ -3615,43 +5611,74 @@ cl_int oclandEnqueueCopyBufferRect(cl_command_queue     command_queue ,
                                    const cl_event *     event_wait_list ,
                                    cl_event *           event)
 {
-    char buffer[BUFF_SIZE];
-    cl_bool want_event = CL_FALSE;
-    // Look for a shortcut
+    cl_event revent = NULL;
+    // Get the server
     int *sockfd = getShortcut(command_queue);
     if(!sockfd){
         return CL_INVALID_COMMAND_QUEUE;
     }
-    // Execute the command on server
-    unsigned int commDim = strlen("clEnqueueCopyBufferRect")+1;
-    Send(sockfd, &commDim, sizeof(unsigned int), 0);
-    // Send command to perform
-    strcpy(buffer, "clEnqueueCopyBufferRect");
-    Send(sockfd, buffer, strlen(buffer)+1, 0);
-    // Send parameters
-    Send(sockfd, &command_queue, sizeof(cl_command_queue), 0);
-    Send(sockfd, &src_buffer, sizeof(cl_mem), 0);
-    Send(sockfd, &dst_buffer, sizeof(cl_mem), 0);
-    Send(sockfd, src_origin, 3*sizeof(size_t), 0);
-    Send(sockfd, dst_origin, 3*sizeof(size_t), 0);
-    Send(sockfd, region, 3*sizeof(size_t), 0);
-    Send(sockfd, &src_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &src_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &dst_row_pitch, sizeof(size_t), 0);
-    Send(sockfd, &dst_slice_pitch, sizeof(size_t), 0);
-    Send(sockfd, &num_events_in_wait_list, sizeof(cl_uint), 0);
-    if(num_events_in_wait_list)
-        Send(sockfd, &event_wait_list, num_events_in_wait_list*sizeof(cl_event), 0);
-    if(event)
-        want_event = CL_TRUE;
-    Send(sockfd, &want_event, sizeof(cl_bool), 0);
-    // And request flag, and event if request
-    cl_int flag = CL_INVALID_CONTEXT;
-    Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
-    if(flag != CL_SUCCESS)
+    size_t dst_offset = dst_origin[0]
+                      + dst_origin[1]*dst_row_pitch
+                      + dst_origin[2]*dst_slice_pitch;
+    invalidateDeltaBuffer(dst_buffer, dst_offset,
+                          (region[2] - 1)*dst_slice_pitch
+                          + (region[1] - 1)*dst_row_pitch
+                          + region[0]);
+    // Build the package
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // src_buffer
+    msgSize        += sizeof(cl_mem);                                  // dst_buffer
+    msgSize        += 3*sizeof(size_t);                                // src_origin
+    msgSize        += 3*sizeof(size_t);                                // dst_origin
+    msgSize        += 3*sizeof(size_t);                                // region
+    msgSize        += sizeof(size_t);                                  // src_row_pitch
+    msgSize        += sizeof(size_t);                                  // src_slice_pitch
+    msgSize        += sizeof(size_t);                                  // dst_row_pitch
+    msgSize        += sizeof(size_t);                                  // dst_slice_pitch
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueCopyBufferRect; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;                  mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = src_buffer;                     mptr = (cl_mem*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = dst_buffer;                     mptr = (cl_mem*)mptr + 1;
+    memcpy(mptr,(void*)src_origin,3*sizeof(size_t));               mptr = (size_t*)mptr + 3;
+    memcpy(mptr,(void*)dst_origin,3*sizeof(size_t));               mptr = (size_t*)mptr + 3;
+    memcpy(mptr,(void*)region,3*sizeof(size_t));                   mptr = (size_t*)mptr + 3;
+    ((size_t*)mptr)[0]           = src_row_pitch;                  mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = src_slice_pitch;                mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = dst_row_pitch;                  mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = dst_slice_pitch;                mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                     mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;        mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, and then the data)
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    // Decript the flag, if CL_SUCCESS don't received, we can't
+    // still working
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag != CL_SUCCESS){
+        free(msg); msg=NULL;
         return flag;
-    if((flag != CL_SUCCESS) && (event)){
-        Recv(sockfd, event, sizeof(cl_event), MSG_WAITALL);
+    }
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+    free(msg); msg=NULL;
+    if(event){
+        *event = revent;
         addShortcut(*event, sockfd);
     }
     return flag;
@@ -3677,6 +5704,7 @@ cl_int oclandCreateSubDevices(cl_device_id                         in_device,
     if(!oclandInit()){
         return CL_INVALID_DEVICE;
     }
+    connectOwner(in_device);
     // Try platform in all servers
     for(i=0;i<servers->num_servers;i++){
         if(servers->sockets[i] < 0)
@@ -3739,6 +5767,7 @@ cl_int oclandRetainDevice(cl_device_id device)
     if(!oclandInit()){
         return CL_INVALID_DEVICE;
     }
+    connectOwner(device);
     // Try platform in all servers
     for(i=0;i<servers->num_servers;i++){
         if(servers->sockets[i] < 0)
@@ -3779,6 +5808,7 @@ cl_int oclandReleaseDevice(cl_device_id device)
     if(!oclandInit()){
         return CL_INVALID_DEVICE;
     }
+    connectOwner(device);
     // Try platform in all servers
     for(i=0;i<servers->num_servers;i++){
         if(servers->sockets[i] < 0)
@@ -3834,7 +5864,7 @@ cl_mem oclandCreateImage(cl_context              context,
     msgSize        += sizeof(cl_image_desc);   // cl_image_desc
     msgSize        += sizeof(cl_bool);         // hasPtr
     if(host_ptr) msgSize += size;              // host_ptr
-    void* msg = (void*)malloc(msgSize);
+    void* msg = (void*)malloc(host_ptr ? msgSize - size : msgSize);
     void* ptr = msg;
     ((unsigned int*)ptr)[0]    = ocland_clCreateImage; ptr = (unsigned int*)ptr + 1;
     ((cl_context*)ptr)[0]      = context;              ptr = (cl_context*)ptr + 1;
@@ -3842,11 +5872,10 @@ cl_mem oclandCreateImage(cl_context              context,
     memcpy(ptr,image_format,sizeof(cl_image_format));  ptr = (cl_image_format*)ptr + 1;
     memcpy(ptr,image_desc,sizeof(cl_image_desc));      ptr = (cl_image_desc*)ptr + 1;
     ((cl_bool*)ptr)[0]         = hasPtr;                 ptr = (cl_bool*)ptr + 1;
-    if(host_ptr) memcpy(ptr, host_ptr, size);
-    // Send the package (first the size, and then the data)
+    // Send the package (first the size, then the header, and the
+    // host data straight from the user memory)
     lock(*sockfd);
-    Send(sockfd, &msgSize, sizeof(size_t), 0);
-    Send(sockfd, msg, msgSize, 0);
+    sendPackage(sockfd, msg, msgSize, host_ptr, host_ptr ? size : 0);
     free(msg); msg=NULL;
     // Receive the package (first size, and then data)
     Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
@@ -4083,6 +6112,7 @@ cl_int oclandUnloadPlatformCompiler(cl_platform_id  platform)
     if(!oclandInit()){
         return CL_INVALID_CONTEXT;
     }
+    connectOwner(platform);
     // Try platform in all servers
     for(i=0;i<servers->num_servers;i++){
         if(servers->sockets[i] < 0)
@@ -4169,37 +6199,61 @@ cl_int oclandEnqueueFillBuffer(cl_command_queue    command_queue ,
                                const cl_event *    event_wait_list ,
                                cl_event *          event)
 {
-    char buffer[BUFF_SIZE];
-    cl_bool want_event = CL_FALSE;
-    // Look for a shortcut
+    cl_event revent = NULL;
+    // Get the server
     int *sockfd = getShortcut(command_queue);
     if(!sockfd){
         return CL_INVALID_COMMAND_QUEUE;
     }
-    // Execute the command on server
-    unsigned int commDim = strlen("clEnqueueFillBuffer")+1;
-    Send(sockfd, &commDim, sizeof(unsigned int), 0);
-    // Send command to perform
-    strcpy(buffer, "clEnqueueFillBuffer");
-    Send(sockfd, buffer, strlen(buffer)+1, 0);
-    // Send parameters
-    Send(sockfd, &command_queue, sizeof(cl_command_queue), 0);
-    Send(sockfd, &mem, sizeof(cl_mem), 0);
-    Send(sockfd, &pattern_size, sizeof(size_t), 0);
-    Send(sockfd, &pattern, pattern_size, 0);
-    Send(sockfd, &offset, sizeof(size_t), 0);
-    Send(sockfd, &cb, sizeof(size_t), 0);
-    Send(sockfd, &num_events_in_wait_list, sizeof(cl_uint), 0);
-    if(num_events_in_wait_list)
-        Send(sockfd, &event_wait_list, num_events_in_wait_list*sizeof(cl_event), 0);
-    if(event)
-        want_event = CL_TRUE;
-    Send(sockfd, &want_event, sizeof(cl_bool), 0);
-    // And request flag, and event if request
-    cl_int flag = CL_INVALID_CONTEXT;
-    Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
-    if((flag == CL_SUCCESS) && (event)){
-        Recv(sockfd, event, sizeof(cl_event), MSG_WAITALL);
+    invalidateDeltaBuffer(mem, offset, cb);
+    // Build the package. Just the pattern is sent, the server will
+    // replicate it along the region
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // mem
+    msgSize        += sizeof(size_t);                                  // pattern_size
+    msgSize        += pattern_size;                                    // pattern
+    msgSize        += sizeof(size_t);                                  // offset
+    msgSize        += sizeof(size_t);                                  // cb
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueFillBuffer; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;              mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = mem;                        mptr = (cl_mem*)mptr + 1;
+    ((size_t*)mptr)[0]           = pattern_size;               mptr = (size_t*)mptr + 1;
+    memcpy(mptr, pattern, pattern_size);                       mptr = (char*)mptr + pattern_size;
+    ((size_t*)mptr)[0]           = offset;                     mptr = (size_t*)mptr + 1;
+    ((size_t*)mptr)[0]           = cb;                         mptr = (size_t*)mptr + 1;
+    ((cl_bool*)mptr)[0]          = want_event;                 mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;    mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, and then the data)
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    // Decript the flag, if CL_SUCCESS don't received, we can't
+    // still working
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag != CL_SUCCESS){
+        free(msg); msg=NULL;
+        return flag;
+    }
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+    free(msg); msg=NULL;
+    if(event){
+        *event = revent;
         addShortcut(*event, sockfd);
     }
     return flag;
@@ -4215,37 +6269,59 @@ cl_int oclandEnqueueFillImage(cl_command_queue    command_queue ,
                               const cl_event *    event_wait_list ,
                               cl_event *          event)
 {
-    char buffer[BUFF_SIZE];
-    cl_bool want_event = CL_FALSE;
-    // Look for a shortcut
+    cl_event revent = NULL;
+    // Get the server
     int *sockfd = getShortcut(command_queue);
     if(!sockfd){
         return CL_INVALID_COMMAND_QUEUE;
     }
-    // Execute the command on server
-    unsigned int commDim = strlen("clEnqueueFillImage")+1;
-    Send(sockfd, &commDim, sizeof(unsigned int), 0);
-    // Send command to perform
-    strcpy(buffer, "clEnqueueFillImage");
-    Send(sockfd, buffer, strlen(buffer)+1, 0);
-    // Send parameters
-    Send(sockfd, &command_queue, sizeof(cl_command_queue), 0);
-    Send(sockfd, &image, sizeof(cl_mem), 0);
-    Send(sockfd, &fill_color_size, sizeof(size_t), 0);
-    Send(sockfd, &fill_color, fill_color_size, 0);
-    Send(sockfd, origin, 3*sizeof(size_t), 0);
-    Send(sockfd, region, 3*sizeof(size_t), 0);
-    Send(sockfd, &num_events_in_wait_list, sizeof(cl_uint), 0);
-    if(num_events_in_wait_list)
-        Send(sockfd, &event_wait_list, num_events_in_wait_list*sizeof(cl_event), 0);
-    if(event)
-        want_event = CL_TRUE;
-    Send(sockfd, &want_event, sizeof(cl_bool), 0);
-    // And request flag, and event if request
-    cl_int flag = CL_INVALID_CONTEXT;
-    Recv(sockfd, &flag, sizeof(cl_int), MSG_WAITALL);
-    if((flag == CL_SUCCESS) && (event)){
-        Recv(sockfd, event, sizeof(cl_event), MSG_WAITALL);
+    // Build the package
+    cl_bool want_event = CL_FALSE;
+    if(event) want_event = CL_TRUE;
+    size_t msgSize  = sizeof(unsigned int);                            // Command index
+    msgSize        += sizeof(cl_command_queue);                        // command_queue
+    msgSize        += sizeof(cl_mem);                                  // image
+    msgSize        += sizeof(size_t);                                  // fill_color_size
+    msgSize        += fill_color_size;                                 // fill_color
+    msgSize        += 3*sizeof(size_t);                                // origin
+    msgSize        += 3*sizeof(size_t);                                // region
+    msgSize        += sizeof(cl_bool);                                 // want_event
+    msgSize        += sizeof(cl_uint);                                 // num_events_in_wait_list
+    msgSize        += num_events_in_wait_list*sizeof(event_wait_list); // event_wait_list
+    void* msg = (void*)malloc(msgSize);
+    void* mptr = msg;
+    ((unsigned int*)mptr)[0]     = ocland_clEnqueueFillImage; mptr = (unsigned int*)mptr + 1;
+    ((cl_command_queue*)mptr)[0] = command_queue;             mptr = (cl_command_queue*)mptr + 1;
+    ((cl_mem*)mptr)[0]           = image;                     mptr = (cl_mem*)mptr + 1;
+    ((size_t*)mptr)[0]           = fill_color_size;           mptr = (size_t*)mptr + 1;
+    memcpy(mptr, fill_color, fill_color_size);                mptr = (char*)mptr + fill_color_size;
+    memcpy(mptr, origin, 3*sizeof(size_t));                   mptr = (size_t*)mptr + 3;
+    memcpy(mptr, region, 3*sizeof(size_t));                   mptr = (size_t*)mptr + 3;
+    ((cl_bool*)mptr)[0]          = want_event;                mptr = (cl_bool*)mptr + 1;
+    ((cl_uint*)mptr)[0]          = num_events_in_wait_list;   mptr = (cl_uint*)mptr + 1;
+    memcpy(mptr, event_wait_list, num_events_in_wait_list*sizeof(cl_event));
+    // Send the package (first the size, and then the data)
+    lock(*sockfd);
+    Send(sockfd, &msgSize, sizeof(size_t), 0);
+    Send(sockfd, msg, msgSize, 0);
+    free(msg); msg=NULL;
+    // Receive the package (first size, and then data)
+    Recv(sockfd, &msgSize, sizeof(size_t), MSG_WAITALL);
+    msg = (void*)malloc(msgSize);
+    mptr = msg;
+    Recv(sockfd, msg, msgSize, MSG_WAITALL);
+    unlock(*sockfd);
+    // Decript the flag, if CL_SUCCESS don't received, we can't
+    // still working
+    cl_int flag = ((cl_int*)mptr)[0]; mptr = (cl_int*)mptr + 1;
+    if(flag != CL_SUCCESS){
+        free(msg); msg=NULL;
+        return flag;
+    }
+    revent = ((cl_event*)mptr)[0]; mptr = (cl_event*)mptr + 1;
+    free(msg); msg=NULL;
+    if(event){
+        *event = revent;
         addShortcut(*event, sockfd);
     }
     return flag;
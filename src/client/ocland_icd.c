@@ -17,9 +17,12 @@
  */
 
 #include <ocland/client/ocland_opencl.h>
+#include <ocland/client/ocland_ext.h>
+#include <ocland/client/shortcut.h>
 
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 // Log macros
 #define WHERESTR  "[file %s, line %d]: "
@@ -80,6 +83,11 @@ cl_uint num_master_kernels = 0;
 cl_kernel master_kernels[MAX_N_KERNELS];
 cl_uint num_master_events = 0;
 cl_event master_events[MAX_N_EVENTS];
+/// Virtual platform holding the devices of all the servers
+struct _cl_platform_id cluster_platform = {&master_dispatch, NULL};
+/// Virtual device of the cluster platform splitting the kernels between
+/// all the devices of the context
+struct _cl_device_id split_device = {&master_dispatch, NULL, 1};
 
 // --------------------------------------------------------------
 // Platforms
@@ -122,12 +130,16 @@ __GetPlatformIDs(cl_uint num_entries,
     // Send requested data
     if( !num_master_platforms )
         return CL_PLATFORM_NOT_FOUND_KHR;
+    // The cluster platform is reported after the server ones
+    cl_uint n = num_master_platforms;
+    if(isClusterEnabled())
+        n++;
     if( num_platforms )
-        *num_platforms = num_master_platforms;
+        *num_platforms = n;
     if( platforms ) {
         cl_uint i;
-        for( i=0; i<(num_master_platforms<num_entries?num_master_platforms:num_entries); i++)
-            platforms[i] = &master_platforms[i];
+        for( i=0; i<(n<num_entries?n:num_entries); i++)
+            platforms[i] = (i < num_master_platforms) ? &master_platforms[i] : &cluster_platform;
     }
     return CL_SUCCESS;
 }
@@ -168,6 +180,11 @@ icd_clGetPlatformInfo(cl_platform_id   platform,
         VERBOSE_OUT(CL_INVALID_VALUE);
         return CL_INVALID_VALUE;
     }
+    if(platform == &cluster_platform){
+        cl_int flag = clusterGetPlatformInfo(param_name, param_value_size, param_value, param_value_size_ret);
+        VERBOSE_OUT(flag);
+        return flag;
+    }
     // Connect to servers to get info
     cl_int flag = oclandGetPlatformInfo(platform->ptr, param_name, param_value_size, param_value, param_value_size_ret);
     VERBOSE_OUT(flag);
@@ -192,6 +209,36 @@ icd_clGetDeviceIDs(cl_platform_id   platform,
         return CL_INVALID_VALUE;
     }
     cl_uint i,j,n;
+    // The cluster platform holds the devices of all the server platforms
+    if(platform == &cluster_platform){
+        cl_uint num = 0;
+        for(i=0;i<num_master_platforms;i++){
+            cl_uint entries = (devices && (num < num_entries)) ? num_entries - num : 0;
+            cl_int flag = icd_clGetDeviceIDs(&master_platforms[i], device_type, entries,
+                                             entries ? devices + num : NULL, &n);
+            if(flag == CL_DEVICE_NOT_FOUND)
+                continue;
+            if(flag != CL_SUCCESS){
+                VERBOSE_OUT(flag);
+                return flag;
+            }
+            num += n;
+        }
+        if(!num){
+            VERBOSE_OUT(CL_DEVICE_NOT_FOUND);
+            return CL_DEVICE_NOT_FOUND;
+        }
+        // The split device is reported after the server ones
+        if(num > 1){
+            if(devices && (num < num_entries))
+                devices[num] = &split_device;
+            num++;
+        }
+        if(num_devices)
+            *num_devices = num;
+        VERBOSE_OUT(CL_SUCCESS);
+        return CL_SUCCESS;
+    }
     // Init devices array
     cl_int flag = oclandGetDeviceIDs(platform->ptr, device_type, 0, NULL, &n);
     if(flag != CL_SUCCESS){
@@ -247,6 +294,35 @@ icd_clGetDeviceIDs(cl_platform_id   platform,
 }
 SYMB(clGetDeviceIDs);
 
+/** Get the devices the split device is made of, i.e. all the devices of
+ * the cluster platform.
+ * @param num_entries Size of the devices array.
+ * @param devices Returned devices. Can be NULL.
+ * @param num_devices Returned number of devices. Can be NULL.
+ * @return CL_SUCCESS if the devices are returned, an error code otherwise.
+ */
+static cl_int
+__GetSplitDevices(cl_uint        num_entries,
+                  cl_device_id * devices,
+                  cl_uint *      num_devices)
+{
+    cl_uint n;
+    cl_int flag = icd_clGetDeviceIDs(&cluster_platform, CL_DEVICE_TYPE_ALL, 0, NULL, &n);
+    if(flag != CL_SUCCESS)
+        return flag;
+    cl_device_id all_devices[n];
+    flag = icd_clGetDeviceIDs(&cluster_platform, CL_DEVICE_TYPE_ALL, n, all_devices, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    if(all_devices[n-1] == &split_device)
+        n--;
+    if(num_devices)
+        *num_devices = n;
+    if(devices)
+        memcpy(devices, all_devices, (n < num_entries ? n : num_entries)*sizeof(cl_device_id));
+    return CL_SUCCESS;
+}
+
 CL_API_ENTRY cl_int CL_API_CALL
 icd_clGetDeviceInfo(cl_device_id    device,
                     cl_device_info  param_name,
@@ -255,7 +331,25 @@ icd_clGetDeviceInfo(cl_device_id    device,
                     size_t *        param_value_size_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    cl_uint i;
+    cl_uint i,n;
+    if(device == &split_device){
+        cl_int flag = __GetSplitDevices(0, NULL, &n);
+        if(flag != CL_SUCCESS){
+            VERBOSE_OUT(flag);
+            return flag;
+        }
+        cl_device_id devices[n];
+        flag = __GetSplitDevices(n, devices, NULL);
+        for(i=0;i<n;i++){
+            devices[i] = devices[i]->ptr;
+        }
+        if(flag == CL_SUCCESS)
+            flag = clusterGetSplitDeviceInfo(n, devices, param_name, param_value_size, param_value, param_value_size_ret);
+        if((param_name == CL_DEVICE_PLATFORM) && param_value && (flag == CL_SUCCESS))
+            *(cl_platform_id*)param_value = &cluster_platform;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
     cl_int flag = oclandGetDeviceInfo(device->ptr, param_name, param_value_size, param_value, param_value_size_ret);
     // If requested data is a platform, must be convinently corrected
     if((param_name == CL_DEVICE_PLATFORM) && param_value){
@@ -335,6 +429,11 @@ CL_API_ENTRY cl_int CL_API_CALL
 icd_clReleaseDevice(cl_device_id device) CL_API_SUFFIX__VERSION_1_2
 {
     VERBOSE_IN();
+    // The split device is not a server object
+    if(device == &split_device){
+        VERBOSE_OUT(CL_SUCCESS);
+        return CL_SUCCESS;
+    }
     // Ensure that the object can be destroyed
     device->rcount--;
     if(device->rcount)
@@ -364,6 +463,67 @@ SYMB(clReleaseDevice);
 // Context
 // --------------------------------------------------------------
 
+/** Create a context of the cluster platform.
+ * @param num_devices Number of devices.
+ * @param devices Devices, which can be placed in several servers.
+ * @param errcode_ret Returned error code. Can be NULL.
+ * @return Context, NULL if errors happened.
+ */
+static cl_context
+__CreateClusterContext(cl_uint              num_devices,
+                       const cl_device_id * devices,
+                       cl_int *             errcode_ret)
+{
+    cl_uint i, n = 0;
+    cl_int flag;
+    // The split device is made of the rest of devices, or of all the
+    // cluster platform devices if it is the only one
+    for(i=0;i<num_devices;i++){
+        if(devices[i] != &split_device)
+            n++;
+    }
+    if(!n){
+        flag = __GetSplitDevices(0, NULL, &n);
+        if(flag != CL_SUCCESS){
+            if(errcode_ret) *errcode_ret = flag;
+            return NULL;
+        }
+        cl_device_id split_devices[n];
+        flag = __GetSplitDevices(n, split_devices, NULL);
+        if(flag != CL_SUCCESS){
+            if(errcode_ret) *errcode_ret = flag;
+            return NULL;
+        }
+        return __CreateClusterContext(n, split_devices, errcode_ret);
+    }
+    cl_device_id devs[n];
+    n = 0;
+    for(i=0;i<num_devices;i++){
+        if(devices[i] == &split_device)
+            continue;
+        devs[n] = devices[i]->ptr;
+        n++;
+    }
+    cl_context context = (cl_context)malloc(sizeof(struct _cl_context));
+    if(!context){
+        if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+        return NULL;
+    }
+    context->cluster = clusterCreateContext(n, devs, &flag);
+    if(flag != CL_SUCCESS){
+        free(context);
+        if(errcode_ret) *errcode_ret = flag;
+        return NULL;
+    }
+    context->dispatch = &master_dispatch;
+    context->ptr      = NULL;
+    context->rcount   = 1;
+    num_master_contexts++;
+    master_contexts[num_master_contexts-1] = context;
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    return context;
+}
+
 CL_API_ENTRY cl_context CL_API_CALL
 icd_clCreateContext(const cl_context_properties * properties,
                     cl_uint                       num_devices ,
@@ -395,6 +555,35 @@ icd_clCreateContext(const cl_context_properties * properties,
             num_properties++;
         num_properties++;   // Final zero must be counted
     }
+    // The contexts of the cluster platform, or with devices placed in
+    // several servers, are cluster contexts
+    cl_bool cluster = CL_FALSE;
+    for(i=0;i+1<num_properties;i+=2){
+        if(    (properties[i] == CL_CONTEXT_PLATFORM)
+            && ((cl_platform_id)(properties[i+1]) == &cluster_platform))
+            cluster = CL_TRUE;
+    }
+    for(i=0;i<num_devices;i++){
+        if(devices[i] == &split_device)
+            cluster = CL_TRUE;
+    }
+    for(i=1;!cluster && (i<num_devices);i++){
+        if(getShortcut(devices[i]->ptr) != getShortcut(devices[0]->ptr))
+            cluster = CL_TRUE;
+    }
+    // Without the cluster platform a context can't span several servers
+    if(cluster && !isClusterEnabled()){
+        if(errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+        VERBOSE_OUT(CL_INVALID_DEVICE);
+        return NULL;
+    }
+    if(cluster){
+        cl_int flag;
+        cl_context context = __CreateClusterContext(num_devices, devices, &flag);
+        if(errcode_ret) *errcode_ret = flag;
+        VERBOSE_OUT(flag);
+        return context;
+    }
     // Look for platform property that must be corrected
     cl_context_properties *props = (cl_context_properties*)properties;
     for(i=0;i<num_properties-1;i++){
@@ -417,6 +606,7 @@ icd_clCreateContext(const cl_context_properties * properties,
     context->dispatch = &master_dispatch;
     context->ptr = oclandCreateContext(properties, num_properties, num_devices, devs, NULL, NULL, &flag);
     context->rcount = 1;
+    context->cluster = NULL;
     num_master_contexts++;
     master_contexts[num_master_contexts-1] = context;
     if(errcode_ret) *errcode_ret = flag;
@@ -454,6 +644,35 @@ icd_clCreateContextFromType(const cl_context_properties * properties,
             num_properties++;
         num_properties++;   // Final zero must be counted
     }
+    // The devices of the cluster platform are placed in several servers
+    for(i=0;i+1<num_properties;i+=2){
+        if(    (properties[i] != CL_CONTEXT_PLATFORM)
+            || ((cl_platform_id)(properties[i+1]) != &cluster_platform))
+            continue;
+        if(!isClusterEnabled()){
+            if(errcode_ret) *errcode_ret = CL_INVALID_PLATFORM;
+            VERBOSE_OUT(CL_INVALID_PLATFORM);
+            return NULL;
+        }
+        cl_uint num_devices;
+        cl_int flag = icd_clGetDeviceIDs(&cluster_platform, device_type, 0, NULL, &num_devices);
+        if(flag != CL_SUCCESS){
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+        cl_device_id devices[num_devices];
+        flag = icd_clGetDeviceIDs(&cluster_platform, device_type, num_devices, devices, NULL);
+        if(flag != CL_SUCCESS){
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+        cl_context context = __CreateClusterContext(num_devices, devices, &flag);
+        if(errcode_ret) *errcode_ret = flag;
+        VERBOSE_OUT(flag);
+        return context;
+    }
     // Look for platform property that must be corrected
     cl_context_properties *props = (cl_context_properties*)properties;
     for(i=0;i<num_properties-1;i++){
@@ -471,6 +690,7 @@ icd_clCreateContextFromType(const cl_context_properties * properties,
     context->dispatch = &master_dispatch;
     context->ptr      = oclandCreateContextFromType(properties, num_properties, device_type, NULL, NULL, &flag);
     context->rcount   = 1;
+    context->cluster  = NULL;
     master_contexts[num_master_contexts-1] = context;
     if(errcode_ret) *errcode_ret = flag;
     VERBOSE_OUT(flag);
@@ -501,7 +721,11 @@ icd_clReleaseContext(cl_context context) CL_API_SUFFIX__VERSION_1_0
     }
     // Reference count has reached 0, object should be destroyed
     cl_uint i,j;
-    cl_int flag = oclandReleaseContext(context->ptr);
+    cl_int flag;
+    if(context->cluster)
+        flag = clusterReleaseContext(context->cluster);
+    else
+        flag = oclandReleaseContext(context->ptr);
     free(context);
     for(i=0;i<num_master_contexts;i++){
         if(master_contexts[i] == context){
@@ -525,7 +749,17 @@ icd_clGetContextInfo(cl_context         context,
 {
     VERBOSE_IN();
     cl_uint i,j,n;
-    cl_int flag = oclandGetContextInfo(context->ptr, param_name, param_value_size, param_value, param_value_size_ret);
+    cl_int flag;
+    if(context->cluster){
+        flag = clusterGetContextInfo(context->cluster, param_name, param_value_size, param_value, param_value_size_ret);
+        if((param_name == CL_CONTEXT_PROPERTIES) && param_value && (flag == CL_SUCCESS)){
+            ((cl_context_properties*)param_value)[1] = (cl_context_properties)&cluster_platform;
+            VERBOSE_OUT(flag);
+            return flag;
+        }
+    }
+    else
+        flag = oclandGetContextInfo(context->ptr, param_name, param_value_size, param_value, param_value_size_ret);
     // If requested data is the devices, must be convinently corrected
     if((param_name == CL_CONTEXT_DEVICES) && param_value){
         n = param_value_size / sizeof(cl_device_id);
@@ -573,7 +807,31 @@ icd_clCreateCommandQueue(cl_context                     context,
     }
     cl_int flag;
     queue->dispatch = &master_dispatch;
-    queue->ptr      = oclandCreateCommandQueue(context->ptr,device->ptr,properties,&flag);
+    queue->server   = 0;
+    queue->split    = NULL;
+    // The split device commands, but the kernels, are enqueued in the
+    // primary queue
+    if(device == &split_device){
+        if(!context->cluster){
+            free(queue);
+            if(errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+            VERBOSE_OUT(CL_INVALID_DEVICE);
+            return NULL;
+        }
+        queue->split = clusterCreateSplit(context->cluster,properties,&flag);
+        if(flag != CL_SUCCESS){
+            free(queue);
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+        queue->ptr    = queue->split->queues[0];
+        queue->server = queue->split->servers[0];
+    }
+    else if(context->cluster)
+        queue->ptr  = clusterCreateCommandQueue(context->cluster,device->ptr,properties,&(queue->server),&flag);
+    else
+        queue->ptr  = oclandCreateCommandQueue(context->ptr,device->ptr,properties,&flag);
     queue->rcount   = 1;
     num_master_queues++;
     master_queues[num_master_queues-1] = queue;
@@ -606,7 +864,11 @@ icd_clReleaseCommandQueue(cl_command_queue command_queue) CL_API_SUFFIX__VERSION
     }
     // Reference count has reached 0, object should be destroyed
     cl_uint i,j;
-    cl_int flag = oclandReleaseCommandQueue(command_queue->ptr);
+    cl_int flag;
+    if(command_queue->split)
+        flag = clusterReleaseSplit(command_queue->split);
+    else
+        flag = oclandReleaseCommandQueue(command_queue->ptr);
     free(command_queue);
     for(i=0;i<num_master_queues;i++){
         if(master_queues[i] == command_queue){
@@ -639,10 +901,21 @@ icd_clGetCommandQueueInfo(cl_command_queue      command_queue,
                 *context = (void*) master_contexts[i];
                 break;
             }
+            // The queues of the cluster contexts are placed in a server context
+            clusterContext cluster = master_contexts[i]->cluster;
+            if(    cluster
+                && (command_queue->server < cluster->num_servers)
+                && (cluster->servers[command_queue->server].context == *context)){
+                *context = (void*) master_contexts[i];
+                break;
+            }
         }
     }
     // If requested data is a device, must be convinently corrected
-    if((param_name == CL_QUEUE_DEVICE) && param_value){
+    if((param_name == CL_QUEUE_DEVICE) && param_value && command_queue->split){
+        *(cl_device_id*)param_value = &split_device;
+    }
+    else if((param_name == CL_QUEUE_DEVICE) && param_value){
         cl_device_id *device = param_value;
         for(i=0;i<num_master_devices;i++){
             if(master_devices[i].ptr == *device){
@@ -668,12 +941,12 @@ icd_clCreateBuffer(cl_context    context ,
                    cl_int *      errcode_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    /** CL_MEM_USE_HOST_PTR and CL_MEM_ALLOC_HOST_PTR are unusable
-     * along network, so if detected CL_INVALID_VALUE will
-     * returned. In future developments a walking around method can
-     * be drafted.
+    /** CL_MEM_ALLOC_HOST_PTR is unusable along network, so if detected
+     * CL_INVALID_VALUE will returned. The host memory of the
+     * CL_MEM_USE_HOST_PTR buffers is mirrored by the client instead.
      */
-    if( (flags & CL_MEM_USE_HOST_PTR) || (flags & CL_MEM_ALLOC_HOST_PTR) ){
+    if( (flags & CL_MEM_ALLOC_HOST_PTR) ||
+        ((flags & CL_MEM_USE_HOST_PTR) && (flags & CL_MEM_COPY_HOST_PTR)) ){
         if(errcode_ret) *errcode_ret=CL_INVALID_VALUE;
         VERBOSE_OUT(CL_INVALID_VALUE);
         return NULL;
@@ -698,7 +971,19 @@ icd_clCreateBuffer(cl_context    context ,
     }
     cl_int flag;
     mem_obj->dispatch     = &master_dispatch;
-    mem_obj->ptr          = oclandCreateBuffer(context->ptr, flags, size, host_ptr, &flag);
+    mem_obj->ptr          = NULL;
+    mem_obj->cluster      = NULL;
+    if(context->cluster){
+        mem_obj->cluster  = clusterCreateBuffer(context->cluster, flags, size, host_ptr, &flag);
+        if(flag != CL_SUCCESS){
+            free(mem_obj);
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+    }
+    else
+        mem_obj->ptr      = oclandCreateBuffer(context->ptr, flags, size, host_ptr, &flag);
     mem_obj->size         = size;
     mem_obj->element_size = 0;
     mem_obj->rcount       = 1;
@@ -733,7 +1018,11 @@ icd_clReleaseMemObject(cl_mem memobj) CL_API_SUFFIX__VERSION_1_0
     }
     // Reference count has reached 0, object should be destroyed
     cl_uint i,j;
-    cl_int flag = oclandReleaseMemObject(memobj->ptr);
+    cl_int flag;
+    if(memobj->cluster)
+        flag = clusterReleaseMem(memobj->cluster);
+    else
+        flag = oclandReleaseMemObject(memobj->ptr);
     free(memobj);
 
     for(i=0;i<num_master_mems;i++){
@@ -782,6 +1071,26 @@ icd_clGetMemObjectInfo(cl_mem            memobj ,
 {
     VERBOSE_IN();
     cl_uint i;
+    // The cluster buffers data is known by the client
+    if(memobj->cluster){
+        cl_int flag;
+        if(param_name == CL_MEM_CONTEXT){
+            cl_context context = NULL;
+            for(i=0;i<num_master_contexts;i++){
+                if(master_contexts[i]->cluster == memobj->cluster->context){
+                    context = master_contexts[i];
+                    break;
+                }
+            }
+            flag = clusterSetInfo(&context, sizeof(cl_context), param_value_size, param_value, param_value_size_ret);
+        }
+        else if(param_name == CL_MEM_REFERENCE_COUNT)
+            flag = clusterSetInfo(&(memobj->rcount), sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        else
+            flag = clusterGetMemObjectInfo(memobj->cluster, param_name, param_value_size, param_value, param_value_size_ret);
+        VERBOSE_OUT(flag);
+        return flag;
+    }
     cl_int flag = oclandGetMemObjectInfo(memobj->ptr,param_name,param_value_size,param_value,param_value_size_ret);
     // If requested data is a context, must be convinently corrected
     if((param_name == CL_MEM_CONTEXT) && param_value){
@@ -849,6 +1158,7 @@ icd_clCreateSubBuffer(cl_mem                    buffer ,
     }
     cl_int flag;
     mem_obj->dispatch     = &master_dispatch;
+    mem_obj->cluster      = NULL;
     mem_obj->ptr          = oclandCreateSubBuffer(buffer->ptr, flags, buffer_create_type, buffer_create_info, &flag);
     mem_obj->size         = ((cl_buffer_region*)buffer_create_info)->size;
     mem_obj->element_size = 0;
@@ -959,6 +1269,7 @@ icd_clCreateImage(cl_context              context,
     mem_obj->size = image_desc->image_depth*image_desc->image_height*image_desc->image_width * element_size;
     // Create the image
     mem_obj->dispatch = &master_dispatch;
+    mem_obj->cluster  = NULL;
     mem_obj->ptr      = oclandCreateImage(context->ptr, flags, image_format, image_desc,
                                           element_size, host_ptr, &flag);
     mem_obj->rcount   = 1;
@@ -1055,6 +1366,7 @@ icd_clCreateImage2D(cl_context              context ,
     mem_obj->size = image_height*image_width * element_size;
     // Create the image
     mem_obj->dispatch = &master_dispatch;
+    mem_obj->cluster  = NULL;
     mem_obj->ptr = oclandCreateImage2D(context->ptr, flags, image_format,
                                        image_width, image_height,
                                        image_row_pitch, element_size,
@@ -1155,6 +1467,7 @@ icd_clCreateImage3D(cl_context              context,
     mem_obj->size = image_depth*image_height*image_width * element_size;
     // Create the image
     mem_obj->dispatch = &master_dispatch;
+    mem_obj->cluster  = NULL;
     mem_obj->ptr = oclandCreateImage3D(context->ptr, flags, image_format,
                                        image_width, image_height,image_depth,
                                        image_row_pitch, image_slice_pitch, element_size,
@@ -1297,7 +1610,19 @@ icd_clCreateProgramWithSource(cl_context         context ,
     }
     cl_int flag;
     program->dispatch = &master_dispatch;
-    program->ptr = oclandCreateProgramWithSource(context->ptr,count,strings,lengths,&flag);
+    program->ptr = NULL;
+    program->cluster = NULL;
+    if(context->cluster){
+        program->cluster = clusterCreateProgramWithSource(context->cluster,count,strings,lengths,&flag);
+        if(flag != CL_SUCCESS){
+            free(program);
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+    }
+    else
+        program->ptr = oclandCreateProgramWithSource(context->ptr,count,strings,lengths,&flag);
     program->rcount = 1;
     num_master_programs++;
     master_programs[num_master_programs-1] = program;
@@ -1339,6 +1664,7 @@ icd_clCreateProgramWithBinary(cl_context                      context ,
     }
     cl_int flag;
     program->dispatch = &master_dispatch;
+    program->cluster = NULL;
     program->ptr = oclandCreateProgramWithBinary(context->ptr,num_devices,device_list,
                                                  lengths,binaries,binary_status,
                                                  &flag);
@@ -1374,7 +1700,11 @@ icd_clReleaseProgram(cl_program  program) CL_API_SUFFIX__VERSION_1_0
     }
     // Reference count has reached 0, object should be destroyed
     cl_uint i,j;
-    cl_int flag = oclandReleaseProgram(program->ptr);
+    cl_int flag;
+    if(program->cluster)
+        flag = clusterReleaseProgram(program->cluster);
+    else
+        flag = oclandReleaseProgram(program->ptr);
     free(program);
     for(i=0;i<num_master_programs;i++){
         if(master_programs[i] == program){
@@ -1417,8 +1747,17 @@ icd_clBuildProgram(cl_program            program ,
     cl_device_id devs[num_devices];
     for(i=0;i<num_devices;i++){
         devs[i] = device_list[i]->ptr;
+        // The split device is made of all the context devices
+        if(device_list[i] == &split_device){
+            num_devices = 0;
+            break;
+        }
     }
-    cl_int flag = oclandBuildProgram(program->ptr,num_devices,devs,options,NULL,NULL);
+    cl_int flag;
+    if(program->cluster)
+        flag = clusterBuildProgram(program->cluster,num_devices,devs,options);
+    else
+        flag = oclandBuildProgram(program->ptr,num_devices,devs,options,NULL,NULL);
     VERBOSE_OUT(flag);
     return flag;
 }
@@ -1433,12 +1772,17 @@ icd_clGetProgramInfo(cl_program          program ,
 {
     VERBOSE_IN();
     cl_uint i,j,n;
-    cl_int flag = oclandGetProgramInfo(program->ptr,param_name,param_value_size,param_value,param_value_size_ret);
+    cl_int flag;
+    if(program->cluster)
+        flag = clusterGetProgramInfo(program->cluster,param_name,param_value_size,param_value,param_value_size_ret);
+    else
+        flag = oclandGetProgramInfo(program->ptr,param_name,param_value_size,param_value,param_value_size_ret);
     // If requested data is a context, must be convinently corrected
     if((param_name == CL_PROGRAM_CONTEXT) && param_value){
         cl_context *context = param_value;
         for(i=0;i<num_master_contexts;i++){
-            if(master_contexts[i]->ptr == *context){
+            if(    (master_contexts[i]->ptr == *context)
+                || (program->cluster && (master_contexts[i]->cluster == program->cluster->context))){
                 *context = (void*) master_contexts[i];
                 break;
             }
@@ -1471,7 +1815,22 @@ icd_clGetProgramBuildInfo(cl_program             program ,
                           size_t *               param_value_size_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    cl_int flag = oclandGetProgramBuildInfo(program->ptr,device->ptr,param_name,param_value_size,param_value,param_value_size_ret);
+    cl_program ptr = program->ptr;
+    // The split device is represented by the first context device
+    if(program->cluster && (device == &split_device)){
+        ptr = clusterGetProgram(program->cluster,program->cluster->context->devices[0]);
+        cl_int flag = oclandGetProgramBuildInfo(ptr,program->cluster->context->devices[0],param_name,param_value_size,param_value,param_value_size_ret);
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    if(program->cluster){
+        ptr = clusterGetProgram(program->cluster,device->ptr);
+        if(!ptr){
+            VERBOSE_OUT(CL_INVALID_DEVICE);
+            return CL_INVALID_DEVICE;
+        }
+    }
+    cl_int flag = oclandGetProgramBuildInfo(ptr,device->ptr,param_name,param_value_size,param_value,param_value_size_ret);
     VERBOSE_OUT(flag);
     return flag;
 }
@@ -1505,6 +1864,7 @@ icd_clCreateProgramWithBuiltInKernels(cl_context             context ,
     }
     cl_int flag;
     program->dispatch = &master_dispatch;
+    program->cluster = NULL;
     program->ptr = oclandCreateProgramWithBuiltInKernels(context->ptr,num_devices,devices,
                                                          kernel_names,&flag);
     program->rcount = 1;
@@ -1629,6 +1989,7 @@ icd_clLinkProgram(cl_context            context ,
     }
     cl_int flag;
     program->dispatch = &master_dispatch;
+    program->cluster = NULL;
     program->ptr = oclandLinkProgram(context->ptr,num_devices,devices,options,num_input_programs,programs,NULL,NULL,&flag);
     free(devices); devices=NULL;
     free(programs); programs=NULL;
@@ -1668,7 +2029,19 @@ icd_clCreateKernel(cl_program       program ,
     }
     cl_int flag;
     kernel->dispatch = &master_dispatch;
-    kernel->ptr = oclandCreateKernel(program->ptr,kernel_name,&flag);
+    kernel->ptr = NULL;
+    kernel->cluster = NULL;
+    if(program->cluster){
+        kernel->cluster = clusterCreateKernel(program->cluster,kernel_name,&flag);
+        if(flag != CL_SUCCESS){
+            free(kernel);
+            if(errcode_ret) *errcode_ret = flag;
+            VERBOSE_OUT(flag);
+            return NULL;
+        }
+    }
+    else
+        kernel->ptr = oclandCreateKernel(program->ptr,kernel_name,&flag);
     kernel->rcount = 1;
     num_master_kernels++;
     master_kernels[num_master_kernels-1] = kernel;
@@ -1692,6 +2065,33 @@ icd_clCreateKernelsInProgram(cl_program      program ,
         VERBOSE_OUT(CL_INVALID_VALUE);
         return CL_INVALID_VALUE;
     }
+    if(program->cluster){
+        clusterKernel cluster_kernels[num_kernels ? num_kernels : 1];
+        cl_int flag = clusterCreateKernelsInProgram(program->cluster,num_kernels,
+                                                    kernels ? cluster_kernels : NULL,&n);
+        if(flag != CL_SUCCESS){
+            VERBOSE_OUT(flag);
+            return flag;
+        }
+        if(num_kernels_ret)
+            *num_kernels_ret = n;
+        for(i=0;kernels && (i<n);i++){
+            cl_kernel kernel = (cl_kernel)malloc(sizeof(struct _cl_kernel));
+            if(!kernel){
+                VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+                return CL_OUT_OF_HOST_MEMORY;
+            }
+            kernel->dispatch = &master_dispatch;
+            kernel->ptr      = NULL;
+            kernel->cluster  = cluster_kernels[i];
+            kernel->rcount   = 1;
+            kernels[i]       = kernel;
+            num_master_kernels++;
+            master_kernels[num_master_kernels-1] = kernel;
+        }
+        VERBOSE_OUT(CL_SUCCESS);
+        return CL_SUCCESS;
+    }
     cl_int flag = oclandCreateKernelsInProgram(program->ptr,num_kernels,kernels,&n);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
@@ -1709,6 +2109,7 @@ icd_clCreateKernelsInProgram(cl_program      program ,
             }
             kernel->dispatch = &master_dispatch;
             kernel->ptr      = kernels[i];
+            kernel->cluster  = NULL;
             kernel->rcount   = 1;
             kernels[i]       = kernel;
             num_master_kernels++;
@@ -1743,7 +2144,11 @@ icd_clReleaseKernel(cl_kernel    kernel) CL_API_SUFFIX__VERSION_1_0
     }
     // Reference count has reached 0, object should be destroyed
     cl_uint i,j;
-    cl_int flag = oclandReleaseKernel(kernel->ptr);
+    cl_int flag;
+    if(kernel->cluster)
+        flag = clusterReleaseKernel(kernel->cluster);
+    else
+        flag = oclandReleaseKernel(kernel->ptr);
     free(kernel);
     for(i=0;i<num_master_kernels;i++){
         if(master_kernels[i] == kernel){
@@ -1780,6 +2185,23 @@ icd_clSetKernelArg(cl_kernel     kernel ,
      * try to don't call if is not necessary.
      */
     cl_int flag;
+    // The cluster kernels arguments are set when the kernel is enqueued
+    if(kernel->cluster){
+        clusterMem mem = NULL;
+        if(arg_value && (arg_size == sizeof(cl_mem))){
+            cl_uint i;
+            cl_mem mem_obj = * (cl_mem*)(arg_value);
+            for(i=0;i<num_master_mems;i++){
+                if(master_mems[i] == mem_obj){
+                    mem = mem_obj->cluster;
+                    break;
+                }
+            }
+        }
+        flag = clusterSetKernelArg(kernel->cluster,arg_index,arg_size,arg_value,mem);
+        VERBOSE_OUT(flag);
+        return flag;
+    }
     if(arg_size == sizeof(cl_mem)){
         cl_uint i;
         // Can be a cl_mem object
@@ -1815,12 +2237,14 @@ icd_clGetKernelInfo(cl_kernel        kernel ,
 {
     VERBOSE_IN();
     cl_uint i;
-    cl_int flag = oclandGetKernelInfo(kernel->ptr,param_name,param_value_size,param_value,param_value_size_ret);
+    cl_kernel ptr = kernel->cluster ? clusterGetKernel(kernel->cluster,NULL) : kernel->ptr;
+    cl_int flag = oclandGetKernelInfo(ptr,param_name,param_value_size,param_value,param_value_size_ret);
     // If requested data is a context, must be convinently corrected
     if((param_name == CL_KERNEL_CONTEXT) && param_value){
         cl_context *context = param_value;
         for(i=0;i<num_master_contexts;i++){
-            if(master_contexts[i]->ptr == *context){
+            if(    (master_contexts[i]->ptr == *context)
+                || (kernel->cluster && (master_contexts[i]->cluster == kernel->cluster->program->context))){
                 *context = (void*) master_contexts[i];
                 break;
             }
@@ -1830,7 +2254,8 @@ icd_clGetKernelInfo(cl_kernel        kernel ,
     if((param_name == CL_KERNEL_PROGRAM) && param_value){
         cl_program *program = param_value;
         for(i=0;i<num_master_programs;i++){
-            if(master_programs[i]->ptr == *program){
+            if(    (master_programs[i]->ptr == *program)
+                || (kernel->cluster && (master_programs[i]->cluster == kernel->cluster->program))){
                 *program = (void*) master_programs[i];
                 break;
             }
@@ -1850,7 +2275,27 @@ icd_clGetKernelWorkGroupInfo(cl_kernel                   kernel ,
                              size_t *                    param_value_size_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    cl_int flag = oclandGetKernelWorkGroupInfo(kernel->ptr,device->ptr,param_name,param_value_size,param_value,param_value_size_ret);
+    cl_kernel ptr = kernel->ptr;
+    // The split device is represented by the first context device
+    if(kernel->cluster && (device == &split_device)){
+        cl_device_id server_device = kernel->cluster->program->context->devices[0];
+        ptr = clusterGetKernel(kernel->cluster,server_device);
+        if(!ptr){
+            VERBOSE_OUT(CL_INVALID_PROGRAM_EXECUTABLE);
+            return CL_INVALID_PROGRAM_EXECUTABLE;
+        }
+        cl_int flag = oclandGetKernelWorkGroupInfo(ptr,server_device,param_name,param_value_size,param_value,param_value_size_ret);
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    if(kernel->cluster){
+        ptr = clusterGetKernel(kernel->cluster,device->ptr);
+        if(!ptr){
+            VERBOSE_OUT(CL_INVALID_DEVICE);
+            return CL_INVALID_DEVICE;
+        }
+    }
+    cl_int flag = oclandGetKernelWorkGroupInfo(ptr,device->ptr,param_name,param_value_size,param_value,param_value_size_ret);
     VERBOSE_OUT(flag);
     return flag;
 }
@@ -1865,7 +2310,8 @@ icd_clGetKernelArgInfo(cl_kernel        kernel ,
                        size_t *         param_value_size_ret) CL_API_SUFFIX__VERSION_1_2
 {
     VERBOSE_IN();
-    cl_int flag = oclandGetKernelArgInfo(kernel->ptr,arg_indx,param_name,param_value_size,param_value,param_value_size_ret);
+    cl_kernel ptr = kernel->cluster ? clusterGetKernel(kernel->cluster,NULL) : kernel->ptr;
+    cl_int flag = oclandGetKernelArgInfo(ptr,arg_indx,param_name,param_value_size,param_value,param_value_size_ret);
     VERBOSE_OUT(flag);
     return flag;
 }
@@ -1890,7 +2336,8 @@ icd_clWaitForEvents(cl_uint              num_events ,
     for(i=0;i<num_events;i++){
         events[i] = event_list[i]->ptr;
     }
-    cl_int flag = oclandWaitForEvents(num_events,events);
+    // The events can belong to several servers
+    cl_int flag = clusterWaitForEvents(num_events,events);
     VERBOSE_OUT(flag);
     return flag;
 }
@@ -2031,6 +2478,27 @@ SYMB(clSetEventCallback);
 // Enqueues
 // --------------------------------------------------------------
 
+/** Get the server instance of a memory object to be used in a command
+ * queue. The cluster buffers are replicated in the server of the queue.
+ * @param command_queue Command queue.
+ * @param mem Memory object.
+ * @param access How the memory object will be accessed, see clusterMemOn().
+ * @param errcode_ret Returned error code.
+ * @return Server memory object, NULL if errors happened.
+ */
+static cl_mem
+__MemOn(cl_command_queue  command_queue,
+        cl_mem            mem,
+        cl_mem_flags      access,
+        cl_int *          errcode_ret)
+{
+    *errcode_ret = CL_SUCCESS;
+    if(!mem->cluster)
+        return mem->ptr;
+    return clusterMemOn(mem->cluster, command_queue->server, command_queue->ptr,
+                        access, errcode_ret);
+}
+
 CL_API_ENTRY cl_int CL_API_CALL
 icd_clFlush(cl_command_queue  command_queue) CL_API_SUFFIX__VERSION_1_0
 {
@@ -2084,10 +2552,21 @@ icd_clEnqueueReadBuffer(cl_command_queue     command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueReadBuffer(command_queue->ptr,buffer->ptr,
-                                          blocking_read,offset,cb,ptr,
-                                          num_events_in_wait_list,events_wait,
-                                          event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,CL_MEM_READ_ONLY,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueReadBuffer(command_queue->ptr,mem,
+                                   blocking_read,offset,cb,ptr,
+                                   num_events_in_wait_list,events_wait,
+                                   event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -2145,9 +2624,20 @@ icd_clEnqueueWriteBuffer(cl_command_queue    command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueWriteBuffer(command_queue->ptr,buffer->ptr,
-                                           blocking_write,offset,cb,ptr,
-                                           num_events_in_wait_list,events_wait,event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,(offset || (cb < buffer->size)) ? CL_MEM_READ_WRITE : CL_MEM_WRITE_ONLY,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueWriteBuffer(command_queue->ptr,mem,
+                                    blocking_write,offset,cb,ptr,
+                                    num_events_in_wait_list,events_wait,event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -2201,10 +2691,23 @@ icd_clEnqueueCopyBuffer(cl_command_queue     command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueCopyBuffer(command_queue->ptr,
-                                          src_buffer->ptr,dst_buffer->ptr,
-                                          src_offset,dst_offset,cb,
-                                          num_events_in_wait_list,events_wait,event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem src = NULL, dst = NULL;
+    if(flag == CL_SUCCESS)
+        src = __MemOn(command_queue,src_buffer,CL_MEM_READ_ONLY,&flag);
+    if(flag == CL_SUCCESS)
+        dst = __MemOn(command_queue,dst_buffer,(dst_offset || (cb < dst_buffer->size)) ? CL_MEM_READ_WRITE : CL_MEM_WRITE_ONLY,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueCopyBuffer(command_queue->ptr,
+                            src,dst,
+                                   src_offset,dst_offset,cb,
+                                   num_events_in_wait_list,events_wait,event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -2589,12 +3092,73 @@ icd_clEnqueueMapBuffer(cl_command_queue  command_queue ,
                        cl_int *          errcode_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    /** ocland doesn't allow mapping memory objects due to the imposibility
-     * to have the host pointer and the memory object in the same space.
+    /** ocland maps the memory objects in a client shadow region, which
+     * is sent back when unmapped.
      */
-    if(errcode_ret) *errcode_ret = CL_MAP_FAILURE;
-    VERBOSE_OUT(CL_MAP_FAILURE);
-    return NULL;
+    if((!cb) || (offset + cb > buffer->size)){
+        if(errcode_ret) *errcode_ret = CL_INVALID_VALUE;
+        VERBOSE_OUT(CL_INVALID_VALUE);
+        return NULL;
+    }
+    if(    ( num_events_in_wait_list && !event_wait_list)
+        || (!num_events_in_wait_list &&  event_wait_list)){
+        if(errcode_ret) *errcode_ret = CL_INVALID_EVENT_WAIT_LIST;
+        VERBOSE_OUT(CL_INVALID_EVENT_WAIT_LIST);
+        return NULL;
+    }
+    // Correct input events
+    cl_uint i;
+    cl_event *events_wait = NULL;
+    if(num_events_in_wait_list){
+        events_wait = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
+        if(!events_wait){
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return NULL;
+        }
+        for(i=0;i<num_events_in_wait_list;i++)
+            events_wait[i] = event_wait_list[i]->ptr;
+    }
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,(map_flags == CL_MAP_READ) ? CL_MEM_READ_ONLY : CL_MEM_READ_WRITE,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        if(errcode_ret) *errcode_ret = flag;
+        VERBOSE_OUT(flag);
+        return NULL;
+    }
+    void *ptr = oclandEnqueueMapBuffer(command_queue->ptr,mem,
+                                       blocking_map,map_flags,offset,cb,
+                                       num_events_in_wait_list,events_wait,
+                                       event,&flag);
+    free(events_wait); events_wait=NULL;
+    if(flag != CL_SUCCESS){
+        if(errcode_ret) *errcode_ret = flag;
+        VERBOSE_OUT(flag);
+        return NULL;
+    }
+    // Correct output event
+    if(event){
+        cl_event e = (cl_event)malloc(sizeof(struct _cl_event));
+        if(!e){
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return NULL;
+        }
+        e->dispatch = &master_dispatch;
+        e->ptr = *event;
+        e->rcount = 1;
+        *event = e;
+        num_master_events++;
+        master_events[num_master_events-1] = e;
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    VERBOSE_OUT(CL_SUCCESS);
+    return ptr;
 }
 SYMB(clEnqueueMapBuffer);
 
@@ -2613,12 +3177,66 @@ icd_clEnqueueMapImage(cl_command_queue   command_queue ,
                       cl_int *           errcode_ret) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    /** ocland doesn't allow mapping memory objects due to the imposibility
-     * to have the host pointer and the memory object in the same space.
+    /** ocland maps the memory objects in a client shadow region, which
+     * is sent back when unmapped.
      */
-    if(errcode_ret) *errcode_ret = CL_MAP_FAILURE;
-    VERBOSE_OUT(CL_MAP_FAILURE);
-    return NULL;
+    if(   (!origin)
+       || (!region)
+       || (!image_row_pitch)){
+        if(errcode_ret) *errcode_ret = CL_INVALID_VALUE;
+        VERBOSE_OUT(CL_INVALID_VALUE);
+        return NULL;
+    }
+    if(    ( num_events_in_wait_list && !event_wait_list)
+        || (!num_events_in_wait_list &&  event_wait_list)){
+        if(errcode_ret) *errcode_ret = CL_INVALID_EVENT_WAIT_LIST;
+        VERBOSE_OUT(CL_INVALID_EVENT_WAIT_LIST);
+        return NULL;
+    }
+    // Correct input events
+    cl_uint i;
+    cl_event *events_wait = NULL;
+    if(num_events_in_wait_list){
+        events_wait = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
+        if(!events_wait){
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return NULL;
+        }
+        for(i=0;i<num_events_in_wait_list;i++)
+            events_wait[i] = event_wait_list[i]->ptr;
+    }
+    cl_int flag;
+    void *ptr = oclandEnqueueMapImage(command_queue->ptr,image->ptr,
+                                      blocking_map,map_flags,origin,region,
+                                      image_row_pitch,image_slice_pitch,
+                                      image->element_size,
+                                      num_events_in_wait_list,events_wait,
+                                      event,&flag);
+    free(events_wait); events_wait=NULL;
+    if(flag != CL_SUCCESS){
+        if(errcode_ret) *errcode_ret = flag;
+        VERBOSE_OUT(flag);
+        return NULL;
+    }
+    // Correct output event
+    if(event){
+        cl_event e = (cl_event)malloc(sizeof(struct _cl_event));
+        if(!e){
+            if(errcode_ret) *errcode_ret = CL_OUT_OF_HOST_MEMORY;
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return NULL;
+        }
+        e->dispatch = &master_dispatch;
+        e->ptr = *event;
+        e->rcount = 1;
+        *event = e;
+        num_master_events++;
+        master_events[num_master_events-1] = e;
+    }
+    if(errcode_ret) *errcode_ret = CL_SUCCESS;
+    VERBOSE_OUT(CL_SUCCESS);
+    return ptr;
 }
 SYMB(clEnqueueMapImage);
 
@@ -2631,9 +3249,63 @@ icd_clEnqueueUnmapMemObject(cl_command_queue  command_queue ,
                             cl_event *         event) CL_API_SUFFIX__VERSION_1_0
 {
     VERBOSE_IN();
-    /// In ocland memopry cannot be mapped, so never can be unmapped
-    VERBOSE_OUT(CL_INVALID_VALUE);
-    return CL_INVALID_VALUE;
+    if(!mapped_ptr){
+        VERBOSE_OUT(CL_INVALID_VALUE);
+        return CL_INVALID_VALUE;
+    }
+    if(    ( num_events_in_wait_list && !event_wait_list)
+        || (!num_events_in_wait_list &&  event_wait_list)){
+        VERBOSE_OUT(CL_INVALID_EVENT_WAIT_LIST);
+        return CL_INVALID_EVENT_WAIT_LIST;
+    }
+    // Correct input events
+    cl_uint i;
+    cl_event *events_wait = NULL;
+    if(num_events_in_wait_list){
+        events_wait = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
+        if(!events_wait){
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        for(i=0;i<num_events_in_wait_list;i++)
+            events_wait[i] = event_wait_list[i]->ptr;
+    }
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,memobj,CL_MEM_READ_WRITE,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueUnmapMemObject(command_queue->ptr,mem,
+                                       mapped_ptr,
+                                       num_events_in_wait_list,events_wait,
+                                       event);
+    free(events_wait); events_wait=NULL;
+    if(flag != CL_SUCCESS){
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    // Correct output event
+    if(event){
+        cl_event e = (cl_event)malloc(sizeof(struct _cl_event));
+        if(!e){
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        e->dispatch = &master_dispatch;
+        e->ptr = *event;
+        e->rcount = 1;
+        *event = e;
+        num_master_events++;
+        master_events[num_master_events-1] = e;
+    }
+    VERBOSE_OUT(CL_SUCCESS);
+    return CL_SUCCESS;
 }
 SYMB(clEnqueueUnmapMemObject);
 
@@ -2672,16 +3344,34 @@ icd_clEnqueueNDRangeKernel(cl_command_queue  command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueNDRangeKernel(command_queue->ptr,kernel->ptr,
-                                             work_dim,global_work_offset,
-                                             global_work_size,local_work_size,
-                                             num_events_in_wait_list,events_wait,
-                                             event);
+    cl_int flag;
+    cl_kernel ptr = kernel->ptr;
+    if(command_queue->split){
+        // The split device kernels are executed by all the context devices
+        flag = clusterEnqueueSplitNDRangeKernel(command_queue->split,kernel->cluster,
+                                                work_dim,global_work_offset,
+                                                global_work_size,local_work_size,
+                                                num_events_in_wait_list,events_wait,
+                                                event);
+    }
+    else{
+        // The events of other servers are waited, and the cluster kernels
+        // arguments set in the command queue server, by the client
+        flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+        if(kernel->cluster && (flag == CL_SUCCESS))
+            ptr = clusterKernelOn(kernel->cluster,command_queue->server,command_queue->ptr,&flag);
+        if(flag == CL_SUCCESS)
+            flag = oclandEnqueueNDRangeKernel(command_queue->ptr,ptr,
+                                              work_dim,global_work_offset,
+                                              global_work_size,local_work_size,
+                                              num_events_in_wait_list,events_wait,
+                                              event);
+    }
+    free(events_wait); events_wait=NULL;
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
     }
-    free(events_wait); events_wait=NULL;
     // Correct output event
     if(event){
         cl_event e = (cl_event)malloc(sizeof(struct _cl_event));
@@ -2810,12 +3500,23 @@ icd_clEnqueueReadBufferRect(cl_command_queue     command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueReadBufferRect(command_queue->ptr,buffer->ptr,blocking_read,
-                                              buffer_origin,host_origin,region,
-                                              buffer_row_pitch,buffer_slice_pitch,
-                                              host_row_pitch,host_slice_pitch,ptr,
-                                              num_events_in_wait_list,events_wait,
-                                              event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,CL_MEM_READ_ONLY,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueReadBufferRect(command_queue->ptr,mem,blocking_read,
+                                       buffer_origin,host_origin,region,
+                                       buffer_row_pitch,buffer_slice_pitch,
+                                       host_row_pitch,host_slice_pitch,ptr,
+                                       num_events_in_wait_list,events_wait,
+                                       event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -2900,12 +3601,23 @@ icd_clEnqueueWriteBufferRect(cl_command_queue     command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueWriteBufferRect(command_queue->ptr,buffer->ptr,blocking_write,
-                                               buffer_origin,host_origin,region,
-                                               buffer_row_pitch,buffer_slice_pitch,
-                                               host_row_pitch,host_slice_pitch,ptr,
-                                               num_events_in_wait_list,events_wait,
-                                               event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,CL_MEM_READ_WRITE,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueWriteBufferRect(command_queue->ptr,mem,blocking_write,
+                                        buffer_origin,host_origin,region,
+                                        buffer_row_pitch,buffer_slice_pitch,
+                                        host_row_pitch,host_slice_pitch,ptr,
+                                        num_events_in_wait_list,events_wait,
+                                        event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -2986,12 +3698,25 @@ icd_clEnqueueCopyBufferRect(cl_command_queue     command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueCopyBufferRect(command_queue->ptr,src_buffer->ptr,dst_buffer->ptr,
-                                              src_origin,dst_origin,region,
-                                              src_row_pitch,src_slice_pitch,
-                                              dst_row_pitch,dst_slice_pitch,
-                                              num_events_in_wait_list,events_wait,
-                                              event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem src = NULL, dst = NULL;
+    if(flag == CL_SUCCESS)
+        src = __MemOn(command_queue,src_buffer,CL_MEM_READ_ONLY,&flag);
+    if(flag == CL_SUCCESS)
+        dst = __MemOn(command_queue,dst_buffer,CL_MEM_READ_WRITE,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueCopyBufferRect(command_queue->ptr,src,dst,
+                                       src_origin,dst_origin,region,
+                                       src_row_pitch,src_slice_pitch,
+                                       dst_row_pitch,dst_slice_pitch,
+                                       num_events_in_wait_list,events_wait,
+                                       event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -3051,10 +3776,21 @@ icd_clEnqueueFillBuffer(cl_command_queue    command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueFillBuffer(command_queue->ptr,buffer->ptr,
-                                          pattern,pattern_size,offset,cb,
-                                          num_events_in_wait_list,events_wait,
-                                          event);
+    // The events of other servers are waited, and the cluster buffers
+    // replicated in the command queue server, by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    cl_mem mem = NULL;
+    if(flag == CL_SUCCESS)
+        mem = __MemOn(command_queue,buffer,(offset || (cb < buffer->size)) ? CL_MEM_READ_WRITE : CL_MEM_WRITE_ONLY,&flag);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueFillBuffer(command_queue->ptr,mem,
+                                   pattern,pattern_size,offset,cb,
+                                   num_events_in_wait_list,events_wait,
+                                   event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -3267,9 +4003,16 @@ icd_clEnqueueMarkerWithWaitList(cl_command_queue  command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueMarkerWithWaitList(command_queue->ptr,
-                                                  num_events_in_wait_list,events_wait,
-                                                  event);
+    // The events of other servers are waited by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueMarkerWithWaitList(command_queue->ptr,
+                                           num_events_in_wait_list,events_wait,
+                                           event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -3318,9 +4061,16 @@ icd_clEnqueueBarrierWithWaitList(cl_command_queue  command_queue ,
         for(i=0;i<num_events_in_wait_list;i++)
             events_wait[i] = event_wait_list[i]->ptr;
     }
-    cl_int flag = oclandEnqueueBarrierWithWaitList(command_queue->ptr,
-                                                   num_events_in_wait_list,events_wait,
-                                                   event);
+    // The events of other servers are waited by the client
+    cl_int flag = clusterWaitList(command_queue->ptr,&num_events_in_wait_list,events_wait);
+    if(flag != CL_SUCCESS){
+        free(events_wait); events_wait=NULL;
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    flag = oclandEnqueueBarrierWithWaitList(command_queue->ptr,
+                                            num_events_in_wait_list,events_wait,
+                                            event);
     if(flag != CL_SUCCESS){
         VERBOSE_OUT(flag);
         return flag;
@@ -3549,6 +4299,318 @@ icd_clGetGLContextInfoKHR(const cl_context_properties * properties ,
 }
 SYMB(clGetGLContextInfoKHR);
 
+// --------------------------------------------------------------
+// ocland extensions
+// --------------------------------------------------------------
+
+CL_API_ENTRY cl_int CL_API_CALL
+icd_clEnqueueCopyBufferToPeerOCLAND(cl_command_queue     src_command_queue ,
+                                    cl_mem               src_buffer ,
+                                    cl_command_queue     dst_command_queue ,
+                                    cl_mem               dst_buffer ,
+                                    size_t               src_offset ,
+                                    size_t               dst_offset ,
+                                    size_t               cb ,
+                                    cl_uint              num_events_in_wait_list ,
+                                    const cl_event *     event_wait_list ,
+                                    cl_event *           event)
+{
+    VERBOSE_IN();
+    cl_uint i;
+    if(    ( num_events_in_wait_list && !event_wait_list)
+        || (!num_events_in_wait_list &&  event_wait_list)){
+        VERBOSE_OUT(CL_INVALID_EVENT_WAIT_LIST);
+        return CL_INVALID_EVENT_WAIT_LIST;
+    }
+    // Correct input events
+    cl_event *events_wait = NULL;
+    if(num_events_in_wait_list){
+        events_wait = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
+        if(!events_wait){
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        for(i=0;i<num_events_in_wait_list;i++)
+            events_wait[i] = event_wait_list[i]->ptr;
+    }
+    cl_int flag = oclandEnqueueCopyBufferToPeer(src_command_queue->ptr,src_buffer->ptr,
+                                                dst_command_queue->ptr,dst_buffer->ptr,
+                                                src_offset,dst_offset,cb,
+                                                num_events_in_wait_list,events_wait,event);
+    free(events_wait); events_wait=NULL;
+    if(flag != CL_SUCCESS){
+        VERBOSE_OUT(flag);
+        return flag;
+    }
+    // Correct output event
+    if(event){
+        cl_event e = (cl_event)malloc(sizeof(struct _cl_event));
+        if(!e){
+            VERBOSE_OUT(CL_OUT_OF_HOST_MEMORY);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        e->dispatch = &master_dispatch;
+        e->ptr = *event;
+        e->rcount = 1;
+        *event = e;
+        num_master_events++;
+        master_events[num_master_events-1] = e;
+    }
+    VERBOSE_OUT(flag);
+    return CL_SUCCESS;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL
+icd_clSetKernelArgPartitionOCLAND(cl_kernel            kernel ,
+                                  cl_uint              arg_index ,
+                                  size_t               partition_size)
+{
+    VERBOSE_IN();
+    // Just the kernels of cluster contexts can be split
+    if(!kernel->cluster){
+        VERBOSE_OUT(CL_INVALID_KERNEL);
+        return CL_INVALID_KERNEL;
+    }
+    cl_int flag = clusterSetKernelArgPartition(kernel->cluster,arg_index,partition_size);
+    VERBOSE_OUT(flag);
+    return flag;
+}
+
+/** @struct __partition_st
+ * Partition of a scatter/gather transfer.
+ */
+struct __partition_st
+{
+    /// Command queue
+    cl_command_queue command_queue;
+    /// Buffer
+    cl_mem buffer;
+    /// Offset in the buffer
+    size_t offset;
+    /// Size of the partition
+    size_t cb;
+    /// Host memory of the partition
+    void *ptr;
+};
+
+/** @struct __partitions_server_st
+ * Partitions of a scatter/gather transfer placed in the same server.
+ */
+struct __partitions_server_st
+{
+    /// Server socket
+    int *sockfd;
+    /// Number of partitions
+    cl_uint num_partitions;
+    /// Partitions, in the order given by the application
+    struct __partition_st *partitions;
+    /// CL_TRUE if the partitions are written, CL_FALSE if they are read
+    cl_bool send;
+    /// Returned error code
+    cl_int flag;
+};
+
+/** Thread which transfers the partitions of a scatter/gather transfer
+ * placed in a server, one after the other. The partitions are enqueued
+ * as non-blocking transfers, such that the large ones take the striped
+ * parallel channels, and then the command queues are finished.
+ * @param data __partitions_server_st object.
+ * @return NULL
+ */
+static void *__partitions_thread(void *data)
+{
+    cl_uint i, j;
+    cl_int flag;
+    struct __partitions_server_st *server = (struct __partitions_server_st*)data;
+    struct __partition_st *partitions = server->partitions;
+    server->flag = CL_SUCCESS;
+    for(i=0;i<server->num_partitions;i++){
+        if(server->send)
+            flag = icd_clEnqueueWriteBuffer(partitions[i].command_queue,partitions[i].buffer,
+                                            CL_FALSE,partitions[i].offset,partitions[i].cb,
+                                            partitions[i].ptr,0,NULL,NULL);
+        else
+            flag = icd_clEnqueueReadBuffer(partitions[i].command_queue,partitions[i].buffer,
+                                           CL_FALSE,partitions[i].offset,partitions[i].cb,
+                                           partitions[i].ptr,0,NULL,NULL);
+        if(flag != CL_SUCCESS){
+            server->flag = flag;
+            break;
+        }
+    }
+    // The enqueued transfers must be finished before the host memory
+    // is released to the application, even if some of them failed
+    for(i=0;i<server->num_partitions;i++){
+        for(j=0;j<i;j++){
+            if(partitions[j].command_queue == partitions[i].command_queue)
+                break;
+        }
+        if(j < i)
+            continue;
+        flag = icd_clFinish(partitions[i].command_queue);
+        if((flag != CL_SUCCESS) && (server->flag == CL_SUCCESS))
+            server->flag = flag;
+    }
+    return NULL;
+}
+
+/** Transfer the partitions of a host array. The partitions are grouped
+ * by server, and each server is served by its own thread, such that the
+ * transfers to different servers are not serialized.
+ * @param num_partitions Number of partitions.
+ * @param command_queues Command queue of each partition.
+ * @param buffers Buffer of each partition.
+ * @param buffer_offsets Offset of each partition in its buffer. Can be NULL.
+ * @param host_offsets Offset of each partition in the host array.
+ * @param sizes Size of each partition.
+ * @param ptr Host array.
+ * @param send CL_TRUE for scatter transfers, CL_FALSE for gather ones.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned event. Can be NULL.
+ * @return CL_SUCCESS if all the partitions have been transferred, an
+ * error code otherwise.
+ */
+static cl_int
+__EnqueuePartitions(cl_uint                  num_partitions ,
+                    const cl_command_queue * command_queues ,
+                    const cl_mem *           buffers ,
+                    const size_t *           buffer_offsets ,
+                    const size_t *           host_offsets ,
+                    const size_t *           sizes ,
+                    void *                   ptr ,
+                    cl_bool                  send ,
+                    cl_uint                  num_events_in_wait_list ,
+                    const cl_event *         event_wait_list ,
+                    cl_event *               event)
+{
+    cl_uint i, j, num_servers = 0;
+    cl_int flag = CL_SUCCESS;
+    if(!num_partitions || !command_queues || !buffers || !host_offsets || !sizes || !ptr)
+        return CL_INVALID_VALUE;
+    if(    ( num_events_in_wait_list && !event_wait_list)
+        || (!num_events_in_wait_list &&  event_wait_list))
+        return CL_INVALID_EVENT_WAIT_LIST;
+    // The events may belong to several servers, so they are waited by
+    // the client
+    if(num_events_in_wait_list){
+        cl_event *events_wait = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
+        if(!events_wait)
+            return CL_OUT_OF_HOST_MEMORY;
+        for(i=0;i<num_events_in_wait_list;i++)
+            events_wait[i] = event_wait_list[i]->ptr;
+        flag = clusterWaitForEvents(num_events_in_wait_list,events_wait);
+        free(events_wait); events_wait=NULL;
+        if(flag != CL_SUCCESS)
+            return flag;
+    }
+    // The number of partitions is given by the application, so the
+    // arrays can't be placed in the stack
+    cl_uint *owner = (cl_uint*)malloc(num_partitions*sizeof(cl_uint));
+    pthread_t *threads = (pthread_t*)malloc(num_partitions*sizeof(pthread_t));
+    int *joinable = (int*)malloc(num_partitions*sizeof(int));
+    struct __partition_st *partitions = (struct __partition_st*)malloc(num_partitions*sizeof(struct __partition_st));
+    struct __partitions_server_st *servers = (struct __partitions_server_st*)calloc(num_partitions, sizeof(struct __partitions_server_st));
+    if(!owner || !threads || !joinable || !partitions || !servers){
+        free(owner); free(threads); free(joinable); free(partitions); free(servers);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    // Group the partitions by server, keeping their order
+    for(i=0;i<num_partitions;i++){
+        int *sockfd = getShortcut(command_queues[i]->ptr);
+        for(j=0;j<num_servers;j++){
+            if(servers[j].sockfd == sockfd)
+                break;
+        }
+        if(j == num_servers){
+            servers[j].sockfd = sockfd;
+            servers[j].send   = send;
+            num_servers++;
+        }
+        servers[j].num_partitions++;
+        owner[i] = j;
+    }
+    for(j=0,i=0;j<num_servers;j++){
+        servers[j].partitions = partitions + i;
+        i += servers[j].num_partitions;
+        servers[j].num_partitions = 0;
+    }
+    for(i=0;i<num_partitions;i++){
+        struct __partitions_server_st *server = &(servers[owner[i]]);
+        struct __partition_st *partition = &(server->partitions[server->num_partitions++]);
+        partition->command_queue = command_queues[i];
+        partition->buffer        = buffers[i];
+        partition->offset        = buffer_offsets ? buffer_offsets[i] : 0;
+        partition->cb            = sizes[i];
+        partition->ptr           = (char*)ptr + host_offsets[i];
+    }
+    for(j=0;j<num_servers;j++){
+        joinable[j] = !pthread_create(&(threads[j]), NULL, __partitions_thread, (void*)&(servers[j]));
+        if(!joinable[j])
+            __partitions_thread((void*)&(servers[j]));
+    }
+    for(j=0;j<num_servers;j++){
+        if(joinable[j])
+            pthread_join(threads[j], NULL);
+        if((servers[j].flag != CL_SUCCESS) && (flag == CL_SUCCESS))
+            flag = servers[j].flag;
+    }
+    free(owner); owner=NULL;
+    free(threads); threads=NULL;
+    free(joinable); joinable=NULL;
+    free(partitions); partitions=NULL;
+    free(servers); servers=NULL;
+    if(flag != CL_SUCCESS)
+        return flag;
+    if(event)
+        flag = icd_clEnqueueMarkerWithWaitList(command_queues[0],0,NULL,event);
+    return flag;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL
+icd_clEnqueueScatterBufferOCLAND(cl_uint                  num_partitions ,
+                                 const cl_command_queue * command_queues ,
+                                 const cl_mem *           buffers ,
+                                 const size_t *           buffer_offsets ,
+                                 const size_t *           host_offsets ,
+                                 const size_t *           sizes ,
+                                 const void *             ptr ,
+                                 cl_uint                  num_events_in_wait_list ,
+                                 const cl_event *         event_wait_list ,
+                                 cl_event *               event)
+{
+    VERBOSE_IN();
+    cl_int flag = __EnqueuePartitions(num_partitions,command_queues,buffers,
+                                      buffer_offsets,host_offsets,sizes,
+                                      (void*)ptr,CL_TRUE,
+                                      num_events_in_wait_list,event_wait_list,
+                                      event);
+    VERBOSE_OUT(flag);
+    return flag;
+}
+
+CL_API_ENTRY cl_int CL_API_CALL
+icd_clEnqueueGatherBufferOCLAND(cl_uint                  num_partitions ,
+                                const cl_command_queue * command_queues ,
+                                const cl_mem *           buffers ,
+                                const size_t *           buffer_offsets ,
+                                const size_t *           host_offsets ,
+                                const size_t *           sizes ,
+                                void *                   ptr ,
+                                cl_uint                  num_events_in_wait_list ,
+                                const cl_event *         event_wait_list ,
+                                cl_event *               event)
+{
+    VERBOSE_IN();
+    cl_int flag = __EnqueuePartitions(num_partitions,command_queues,buffers,
+                                      buffer_offsets,host_offsets,sizes,
+                                      ptr,CL_FALSE,
+                                      num_events_in_wait_list,event_wait_list,
+                                      event);
+    VERBOSE_OUT(flag);
+    return flag;
+}
+
 // --------------------------------------------------------------
 // Extensions, only used at the start of icd_loader
 // --------------------------------------------------------------
@@ -3560,6 +4622,14 @@ icd_clGetExtensionFunctionAddress(const char *   func_name) CL_API_SUFFIX__VERSI
     VERBOSE_OUT(CL_SUCCESS);
     if( func_name != NULL &&  strcmp("clIcdGetPlatformIDsKHR", func_name) == 0 )
         return (void *)__GetPlatformIDs;
+    if( func_name != NULL &&  strcmp("clEnqueueCopyBufferToPeerOCLAND", func_name) == 0 )
+        return (void *)(clEnqueueCopyBufferToPeerOCLAND_fn)icd_clEnqueueCopyBufferToPeerOCLAND;
+    if( func_name != NULL &&  strcmp("clSetKernelArgPartitionOCLAND", func_name) == 0 )
+        return (void *)(clSetKernelArgPartitionOCLAND_fn)icd_clSetKernelArgPartitionOCLAND;
+    if( func_name != NULL &&  strcmp("clEnqueueScatterBufferOCLAND", func_name) == 0 )
+        return (void *)(clEnqueueScatterBufferOCLAND_fn)icd_clEnqueueScatterBufferOCLAND;
+    if( func_name != NULL &&  strcmp("clEnqueueGatherBufferOCLAND", func_name) == 0 )
+        return (void *)(clEnqueueGatherBufferOCLAND_fn)icd_clEnqueueGatherBufferOCLAND;
     return NULL;
 }
 SYMB(clGetExtensionFunctionAddress);
@@ -3695,7 +4765,7 @@ struct _cl_icd_dispatch master_dispatch = {
   (void(*)(void))& icd_clEnqueueMigrateMemObjects,
   (void(*)(void))& icd_clEnqueueMarkerWithWaitList,
   (void(*)(void))& icd_clEnqueueBarrierWithWaitList,
-  (void(*)(void))& dummyFunc,    // clGetExtensionFunctionAddressForPlatform (don't set it)
+  (void(*)(void))& icd_clGetExtensionFunctionAddressForPlatform,
   (void(*)(void))& icd_clCreateFromGLTexture,
   (void(*)(void))& dummyFunc,    // 109,
   (void(*)(void))& dummyFunc,    // 110,
@@ -0,0 +1,137 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <ocland/client/pendingTransfers.h>
+
+/// Transfers in progress
+static pendingTransfer transfers = NULL;
+/// Transfers list mutex
+static pthread_mutex_t transfers_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// Finished transfers condition
+static pthread_cond_t transfers_cond = PTHREAD_COND_INITIALIZER;
+
+pendingTransfer addPendingTransfer(cl_command_queue command_queue, cl_event event)
+{
+    pendingTransfer transfer = (pendingTransfer)malloc(sizeof(struct pendingTransfer_st));
+    if(!transfer)
+        return NULL;
+    transfer->command_queue = command_queue;
+    transfer->event         = event;
+    pthread_mutex_lock(&transfers_mutex);
+    transfer->next = transfers;
+    transfers      = transfer;
+    pthread_mutex_unlock(&transfers_mutex);
+    return transfer;
+}
+
+void endPendingTransfer(pendingTransfer transfer)
+{
+    pendingTransfer *t;
+    if(!transfer)
+        return;
+    pthread_mutex_lock(&transfers_mutex);
+    for(t=&transfers;*t;t=&((*t)->next)){
+        if(*t == transfer){
+            *t = transfer->next;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&transfers_cond);
+    pthread_mutex_unlock(&transfers_mutex);
+    free(transfer);
+}
+
+/** Test if a transfer is waited. The mutex must be locked.
+ * @param transfer Transfer.
+ * @param command_queue Waited command queue, NULL if events are waited.
+ * @param num_events Number of waited events.
+ * @param event_list Waited events.
+ * @return CL_TRUE if the transfer is waited, CL_FALSE otherwise.
+ */
+static cl_bool isWaited(pendingTransfer   transfer,
+                        cl_command_queue  command_queue,
+                        cl_uint           num_events,
+                        const cl_event   *event_list)
+{
+    cl_uint i;
+    if(command_queue)
+        return transfer->command_queue == command_queue ? CL_TRUE : CL_FALSE;
+    if(!transfer->event)
+        return CL_FALSE;
+    for(i=0;i<num_events;i++){
+        if(event_list[i] == transfer->event)
+            return CL_TRUE;
+    }
+    return CL_FALSE;
+}
+
+/** Wait until the waited transfers are finished.
+ * @param command_queue Waited command queue, NULL if events are waited.
+ * @param num_events Number of waited events.
+ * @param event_list Waited events.
+ */
+static void waitTransfers(cl_command_queue  command_queue,
+                          cl_uint           num_events,
+                          const cl_event   *event_list)
+{
+    pendingTransfer t;
+    pthread_mutex_lock(&transfers_mutex);
+    for(t=transfers;t;){
+        if(isWaited(t, command_queue, num_events, event_list)){
+            // The list may change meanwhile, so restart the search
+            pthread_cond_wait(&transfers_cond, &transfers_mutex);
+            t = transfers;
+            continue;
+        }
+        t = t->next;
+    }
+    pthread_mutex_unlock(&transfers_mutex);
+}
+
+void waitQueueTransfers(cl_command_queue command_queue)
+{
+    if(command_queue)
+        waitTransfers(command_queue, 0, NULL);
+}
+
+void waitEventsTransfers(cl_uint num_events, const cl_event *event_list)
+{
+    if(num_events && event_list)
+        waitTransfers(NULL, num_events, event_list);
+}
+
+cl_bool isTransferPending(cl_event event)
+{
+    pendingTransfer t;
+    cl_bool pending = CL_FALSE;
+    if(!event)
+        return CL_FALSE;
+    pthread_mutex_lock(&transfers_mutex);
+    for(t=transfers;t;t=t->next){
+        if(t->event == event){
+            pending = CL_TRUE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&transfers_mutex);
+    return pending;
+}
@@ -0,0 +1,277 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <ocland/client/shadowMap.h>
+
+#ifndef OCLAND_MAX_SHADOW_MAPS
+    #define OCLAND_MAX_SHADOW_MAPS 1024u
+#endif
+
+/// Number of released regions kept to be reused
+#define OCLAND_SHADOW_CACHE 4u
+
+/// Maximum size of the released regions kept to be reused
+#define OCLAND_SHADOW_CACHE_MAX_SIZE 67108864u
+
+/// Mapped regions, read by the page faults handler without the mutex
+static shadowMap volatile maps[OCLAND_MAX_SHADOW_MAPS];
+/// Number of page faults handlers reading the mapped regions
+static unsigned int faulting = 0;
+/// Released regions addresses
+static void *cache_ptr[OCLAND_SHADOW_CACHE];
+/// Released regions sizes
+static size_t cache_alloc[OCLAND_SHADOW_CACHE];
+/// System page size
+static size_t page_size = 4096;
+/// 1 if the writes can be tracked, 0 otherwise
+static int tracking = 0;
+/// Previous page faults handler
+static struct sigaction old_action;
+/// Initialization flag
+static pthread_once_t shadow_once = PTHREAD_ONCE_INIT;
+/// Mapped regions mutex
+static pthread_mutex_t shadow_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Page faults handler. The writes in the tracked regions mark the page
+ * as dirty and unprotect it, while the rest of faults are forwarded to
+ * the previous handler. The mutex can't be locked in a signal handler,
+ * so the regions are not released while some handler is reading them
+ * (see delShadowMap()).
+ * @param sig Signal.
+ * @param info Signal info.
+ * @param context Execution context.
+ */
+static void shadowFault(int sig, siginfo_t *info, void *context)
+{
+    unsigned int i;
+    char *addr = (char*)info->si_addr;
+    __atomic_add_fetch(&faulting, 1, __ATOMIC_SEQ_CST);
+    for(i=0;i<OCLAND_MAX_SHADOW_MAPS;i++){
+        shadowMap map = __atomic_load_n(&(maps[i]), __ATOMIC_SEQ_CST);
+        if(!map || !map->tracked)
+            continue;
+        if((addr < (char*)map->ptr) || (addr >= (char*)map->ptr + map->alloc))
+            continue;
+        size_t page = (addr - (char*)map->ptr) / page_size;
+        map->dirty[page] = 1;
+        mprotect((char*)map->ptr + page * page_size, page_size, PROT_READ | PROT_WRITE);
+        __atomic_sub_fetch(&faulting, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    __atomic_sub_fetch(&faulting, 1, __ATOMIC_SEQ_CST);
+    if(old_action.sa_flags & SA_SIGINFO){
+        old_action.sa_sigaction(sig, info, context);
+        return;
+    }
+    if((old_action.sa_handler != SIG_DFL) && (old_action.sa_handler != SIG_IGN)){
+        old_action.sa_handler(sig);
+        return;
+    }
+    // Restore the default action, which will be triggered again when
+    // the faulting instruction is executed
+    sigaction(sig, &old_action, NULL);
+}
+
+/** Get the page size, and install the page faults handler if the writes
+ * tracking has been requested.
+ */
+static void initShadowMaps()
+{
+    struct sigaction action;
+    const char *env = getenv("OCLAND_MAP_TRACKING");
+    long size = sysconf(_SC_PAGESIZE);
+    if(size > 0)
+        page_size = (size_t)size;
+    if(!env || !atoi(env))
+        return;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_sigaction = shadowFault;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGSEGV, &action, &old_action)){
+        printf("WARNING: Can't track the writes in the mapped memory\n");
+        return;
+    }
+    tracking = 1;
+}
+
+shadowMap addShadowMap(cl_mem mem, cl_map_flags flags, size_t size)
+{
+    unsigned int i, slot = OCLAND_MAX_SHADOW_MAPS;
+    shadowMap map;
+    pthread_once(&shadow_once, initShadowMaps);
+    map = (shadowMap)calloc(1, sizeof(struct shadowMap_st));
+    if(!map)
+        return NULL;
+    map->mem   = mem;
+    map->flags = flags;
+    map->size  = size;
+    map->alloc = ((size ? size : 1) + page_size - 1) / page_size * page_size;
+    // Reused regions may be up to twice larger
+    map->dirty = (unsigned char*)calloc(2 * map->alloc / page_size, sizeof(unsigned char));
+    if(!map->dirty){
+        free(map);
+        return NULL;
+    }
+    pthread_mutex_lock(&shadow_mutex);
+    for(i=0;i<OCLAND_MAX_SHADOW_MAPS;i++){
+        if(!maps[i]){
+            slot = i;
+            break;
+        }
+    }
+    if(slot == OCLAND_MAX_SHADOW_MAPS){
+        pthread_mutex_unlock(&shadow_mutex);
+        printf("ERROR: Too many mapped memory objects\n");
+        free(map->dirty);
+        free(map);
+        return NULL;
+    }
+    // Reuse a released region, if it is not too large
+    for(i=0;i<OCLAND_SHADOW_CACHE;i++){
+        if(cache_ptr[i] && (cache_alloc[i] >= map->alloc) && (cache_alloc[i] <= 2 * map->alloc)){
+            map->ptr     = cache_ptr[i];
+            map->alloc   = cache_alloc[i];
+            cache_ptr[i] = NULL;
+            break;
+        }
+    }
+    if(!map->ptr){
+        void *ptr = mmap(NULL, map->alloc, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED){
+            pthread_mutex_unlock(&shadow_mutex);
+            free(map->dirty);
+            free(map);
+            return NULL;
+        }
+        map->ptr = ptr;
+    }
+    maps[slot] = map;
+    pthread_mutex_unlock(&shadow_mutex);
+    return map;
+}
+
+shadowMap getShadowMap(cl_mem mem, void *ptr)
+{
+    unsigned int i;
+    shadowMap map = NULL;
+    pthread_mutex_lock(&shadow_mutex);
+    for(i=0;i<OCLAND_MAX_SHADOW_MAPS;i++){
+        if(maps[i] && (maps[i]->mem == mem) && (maps[i]->ptr == ptr)){
+            map = maps[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shadow_mutex);
+    return map;
+}
+
+cl_bool isShadowMapTracking()
+{
+    pthread_once(&shadow_once, initShadowMaps);
+    return tracking ? CL_TRUE : CL_FALSE;
+}
+
+void trackShadowMap(shadowMap map)
+{
+    if(!tracking){
+        memset(map->dirty, 1, map->alloc / page_size);
+        return;
+    }
+    memset(map->dirty, 0, map->alloc / page_size);
+    map->tracked = 1;
+    if(mprotect(map->ptr, map->alloc, PROT_READ)){
+        map->tracked = 0;
+        memset(map->dirty, 1, map->alloc / page_size);
+    }
+}
+
+cl_bool isShadowMapDirty(shadowMap map, size_t offset, size_t size)
+{
+    size_t page;
+    if(!size)
+        return CL_FALSE;
+    for(page=offset/page_size;page<=(offset+size-1)/page_size;page++){
+        if(map->dirty[page])
+            return CL_TRUE;
+    }
+    return CL_FALSE;
+}
+
+void delShadowMap(shadowMap map)
+{
+    unsigned int i;
+    pthread_mutex_lock(&shadow_mutex);
+    for(i=0;i<OCLAND_MAX_SHADOW_MAPS;i++){
+        if(maps[i] == map){
+            __atomic_store_n(&(maps[i]), NULL, __ATOMIC_SEQ_CST);
+            break;
+        }
+    }
+    // Wait for the page faults handlers which may still be reading it
+    while(__atomic_load_n(&faulting, __ATOMIC_SEQ_CST))
+        sched_yield();
+    if(map->tracked){
+        map->tracked = 0;
+        mprotect(map->ptr, map->alloc, PROT_READ | PROT_WRITE);
+    }
+    // Keep the region to be reused, replacing the smallest one
+    if(map->alloc > OCLAND_SHADOW_CACHE_MAX_SIZE){
+        munmap(map->ptr, map->alloc);
+        pthread_mutex_unlock(&shadow_mutex);
+        free(map->dirty);
+        free(map);
+        return;
+    }
+    for(i=0;i<OCLAND_SHADOW_CACHE;i++){
+        if(!cache_ptr[i])
+            break;
+    }
+    if(i == OCLAND_SHADOW_CACHE){
+        unsigned int j;
+        i = 0;
+        for(j=1;j<OCLAND_SHADOW_CACHE;j++){
+            if(cache_alloc[j] < cache_alloc[i])
+                i = j;
+        }
+        if(cache_alloc[i] < map->alloc){
+            munmap(cache_ptr[i], cache_alloc[i]);
+            cache_ptr[i] = NULL;
+        }
+    }
+    if(!cache_ptr[i]){
+        cache_ptr[i]   = map->ptr;
+        cache_alloc[i] = map->alloc;
+    }
+    else{
+        munmap(map->ptr, map->alloc);
+    }
+    pthread_mutex_unlock(&shadow_mutex);
+    free(map->dirty);
+    free(map);
+}
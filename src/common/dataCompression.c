@@ -0,0 +1,462 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ocland/common/dataExchange.h>
+#include <ocland/common/dataCompression.h>
+
+#ifndef OCLAND_COMPRESSION_BLOCK
+    #define OCLAND_COMPRESSION_BLOCK 262144u
+#endif
+
+/// Size of the sample used to decide if a block should be compressed
+#define OCLAND_COMPRESSION_SAMPLE 16384u
+/// Blocks smaller than this size are never compressed
+#define OCLAND_COMPRESSION_MIN 1024u
+/// log2 of the compressor hash table size
+#define OCLAND_HASH_LOG 14
+/// Minimum match length
+#define OCLAND_MIN_MATCH 4u
+/// Maximum match distance
+#define OCLAND_MAX_OFFSET 65535u
+
+struct _oclandStream{
+    /// Negotiated compression modes
+    unsigned int modes;
+    /// Compressor hash table
+    unsigned int *table;
+    /// Decoded block pending to be consumed by the receiver
+    unsigned char *raw;
+    /// Size of the decoded block
+    size_t raw_size;
+    /// Position of the next byte to be consumed in the decoded block
+    size_t raw_pos;
+    /// Compressed block
+    unsigned char *packed;
+    /// Shuffled block
+    unsigned char *shuffled;
+};
+
+/** @struct blockHeader Header sent before each block of data.
+ */
+struct blockHeader{
+    /// Size of the block once decoded
+    unsigned int raw_size;
+    /// Size of the block sent
+    unsigned int stored_size;
+    /// Combination of OCLAND_COMPRESSION_* flags applied to the block
+    unsigned int flags;
+};
+
+/** Maximum size of a compressed block.
+ * @param n Size of the block.
+ * @return Maximum size of the compressed data.
+ */
+static size_t compressBound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+/** Read 4 bytes from an unaligned memory address.
+ */
+static unsigned int read32(const unsigned char *p)
+{
+    unsigned int v;
+    memcpy(&v, p, sizeof(unsigned int));
+    return v;
+}
+
+/** Write a length extension (sequence of 255 terminated by a lower
+ * value byte).
+ * @return Number of bytes written, 0 if there is not enough space.
+ */
+static size_t writeLength(unsigned char *dst, size_t cap, size_t len)
+{
+    size_t n = 0;
+    while(len >= 255){
+        if(n >= cap)
+            return 0;
+        dst[n++] = 255;
+        len -= 255;
+    }
+    if(n >= cap)
+        return 0;
+    dst[n++] = (unsigned char)len;
+    return n;
+}
+
+/** LZ77 compression of a block. The compressed data is a sequence of
+ * tokens, each one composed by a number of literals, copied as is, and
+ * a match with the previous data (offset and length), except the last
+ * one which only contains literals.
+ * @param table Hash table of 1 << OCLAND_HASH_LOG entries.
+ * @param src Data to compress.
+ * @param n Size of the data.
+ * @param dst Compressed data.
+ * @param cap Maximum size of the compressed data.
+ * @return Size of the compressed data, 0 if it exceeds cap.
+ */
+static size_t lzCompress(unsigned int *table, const unsigned char *src, size_t n,
+                         unsigned char *dst, size_t cap)
+{
+    size_t ip = 0, anchor = 0, op = 0, ref, lit, len, w;
+    unsigned int seq, h;
+    memset(table, 0, (1u << OCLAND_HASH_LOG)*sizeof(unsigned int));
+    while(n >= OCLAND_MIN_MATCH && ip <= n - OCLAND_MIN_MATCH){
+        seq = read32(src + ip);
+        h   = (seq * 2654435761u) >> (32 - OCLAND_HASH_LOG);
+        ref = table[h];
+        table[h] = (unsigned int)(ip + 1);
+        if(    (!ref)
+            || (ip - (ref - 1) > OCLAND_MAX_OFFSET)
+            || (read32(src + ref - 1) != seq)){
+            // Skip faster along incompressible data
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        ref--;
+        len = OCLAND_MIN_MATCH;
+        while((ip + len < n) && (src[ref + len] == src[ip + len]))
+            len++;
+        // Token
+        lit = ip - anchor;
+        if(op + 1 + lit + 2 > cap)
+            return 0;
+        dst[op++] = (unsigned char)(((lit < 15 ? lit : 15) << 4)
+                                  | ((len - OCLAND_MIN_MATCH) < 15 ? (len - OCLAND_MIN_MATCH) : 15));
+        if(lit >= 15){
+            w = writeLength(dst + op, cap - op, lit - 15);
+            if(!w)
+                return 0;
+            op += w;
+        }
+        if(op + lit + 2 > cap)
+            return 0;
+        memcpy(dst + op, src + anchor, lit);
+        op += lit;
+        dst[op++] = (unsigned char)((ip - ref) & 0xFF);
+        dst[op++] = (unsigned char)((ip - ref) >> 8);
+        if(len - OCLAND_MIN_MATCH >= 15){
+            w = writeLength(dst + op, cap - op, len - OCLAND_MIN_MATCH - 15);
+            if(!w)
+                return 0;
+            op += w;
+        }
+        ip    += len;
+        anchor = ip;
+    }
+    // Last token, only literals
+    lit = n - anchor;
+    if(op + 1 > cap)
+        return 0;
+    dst[op++] = (unsigned char)((lit < 15 ? lit : 15) << 4);
+    if(lit >= 15){
+        w = writeLength(dst + op, cap - op, lit - 15);
+        if(!w)
+            return 0;
+        op += w;
+    }
+    if(op + lit > cap)
+        return 0;
+    memcpy(dst + op, src + anchor, lit);
+    op += lit;
+    return op;
+}
+
+/** Read a length extension.
+ * @return 0 if the extension is out of bounds, 1 otherwise.
+ */
+static int readLength(const unsigned char *src, size_t n, size_t *ip, size_t *len)
+{
+    unsigned char b;
+    do{
+        if(*ip >= n)
+            return 0;
+        b = src[(*ip)++];
+        *len += b;
+    }while(b == 255);
+    return 1;
+}
+
+/** LZ77 decompression of a block.
+ * @param src Compressed data.
+ * @param n Size of the compressed data.
+ * @param dst Decompressed data.
+ * @param out Expected size of the decompressed data.
+ * @return 1 if the data is successfully decompressed, 0 if the data is
+ * corrupted.
+ */
+static int lzDecompress(const unsigned char *src, size_t n, unsigned char *dst, size_t out)
+{
+    size_t ip = 0, op = 0, lit, len, offset, i;
+    unsigned char token;
+    while(ip < n){
+        token = src[ip++];
+        lit   = token >> 4;
+        if((lit == 15) && (!readLength(src, n, &ip, &lit)))
+            return 0;
+        if((ip + lit > n) || (op + lit > out))
+            return 0;
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+        // The last token has not match
+        if(ip >= n)
+            break;
+        if(ip + 2 > n)
+            return 0;
+        offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip    += 2;
+        len    = token & 15;
+        if((len == 15) && (!readLength(src, n, &ip, &len)))
+            return 0;
+        len += OCLAND_MIN_MATCH;
+        if((!offset) || (offset > op) || (op + len > out))
+            return 0;
+        // The match can overlap the data being written
+        if(offset >= len){
+            memcpy(dst + op, dst + op - offset, len);
+        }
+        else{
+            for(i=0;i<len;i++)
+                dst[op + i] = dst[op + i - offset];
+        }
+        op += len;
+    }
+    return op == out;
+}
+
+/** Byte shuffle filter. The bytes of each 32 bits element are grouped,
+ * such that the slowly varying bytes (exponents, high order bytes...)
+ * become consecutive. The trailing bytes are not shuffled.
+ */
+static void shuffle(const unsigned char *src, size_t n, unsigned char *dst)
+{
+    size_t i, b, elems = n / 4;
+    for(b=0;b<4;b++){
+        for(i=0;i<elems;i++)
+            dst[b*elems + i] = src[i*4 + b];
+    }
+    memcpy(dst + 4*elems, src + 4*elems, n - 4*elems);
+}
+
+/** Inverse of the byte shuffle filter.
+ */
+static void unshuffle(const unsigned char *src, size_t n, unsigned char *dst)
+{
+    size_t i, b, elems = n / 4;
+    for(b=0;b<4;b++){
+        for(i=0;i<elems;i++)
+            dst[i*4 + b] = src[b*elems + i];
+    }
+    memcpy(dst + 4*elems, src + 4*elems, n - 4*elems);
+}
+
+unsigned int CompressionModes()
+{
+    #ifdef OCLAND_COMPRESSION
+        const char *env = getenv("OCLAND_COMPRESSION");
+        if(env && !strcmp(env, "0"))
+            return OCLAND_COMPRESSION_NONE;
+        return OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE;
+    #else
+        return OCLAND_COMPRESSION_NONE;
+    #endif
+}
+
+unsigned int ConnectCompression(int *socket)
+{
+    unsigned int modes = CompressionModes();
+    if(Send(socket, &modes, sizeof(unsigned int), 0) <= 0)
+        return OCLAND_COMPRESSION_NONE;
+    if(Recv(socket, &modes, sizeof(unsigned int), MSG_WAITALL) <= 0)
+        return OCLAND_COMPRESSION_NONE;
+    return modes;
+}
+
+unsigned int AcceptCompression(int *socket)
+{
+    unsigned int modes = OCLAND_COMPRESSION_NONE;
+    if(Recv(socket, &modes, sizeof(unsigned int), MSG_WAITALL) <= 0)
+        modes = OCLAND_COMPRESSION_NONE;
+    modes &= CompressionModes();
+    Send(socket, &modes, sizeof(unsigned int), 0);
+    return modes;
+}
+
+oclandStream CreateStream(unsigned int modes)
+{
+    oclandStream stream;
+    if(!(modes & OCLAND_COMPRESSION_LZ))
+        return NULL;
+    stream = (oclandStream)malloc(sizeof(struct _oclandStream));
+    if(!stream)
+        return NULL;
+    stream->modes    = modes;
+    stream->raw_size = 0;
+    stream->raw_pos  = 0;
+    stream->table    = (unsigned int*)malloc((1u << OCLAND_HASH_LOG)*sizeof(unsigned int));
+    stream->raw      = (unsigned char*)malloc(OCLAND_COMPRESSION_BLOCK);
+    stream->packed   = (unsigned char*)malloc(compressBound(OCLAND_COMPRESSION_BLOCK));
+    stream->shuffled = (unsigned char*)malloc(OCLAND_COMPRESSION_BLOCK);
+    if(!stream->table || !stream->raw || !stream->packed || !stream->shuffled){
+        printf("WARNING: Can't allocate memory for the compression, raw data will be sent.\n"); fflush(stdout);
+        ReleaseStream(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+void ReleaseStream(oclandStream stream)
+{
+    if(!stream)
+        return;
+    free(stream->table);
+    free(stream->raw);
+    free(stream->packed);
+    free(stream->shuffled);
+    free(stream);
+}
+
+/** Choose the filters to apply to a block, compressing a sample of it.
+ * @return Combination of OCLAND_COMPRESSION_* flags to apply.
+ */
+static unsigned int sampleBlock(oclandStream stream, const unsigned char *block, size_t n)
+{
+    size_t sample = n < OCLAND_COMPRESSION_SAMPLE ? n : OCLAND_COMPRESSION_SAMPLE;
+    // The compression should save at least 1/8 of the data to pay off
+    size_t best = sample - sample / 8, size;
+    unsigned int flags = OCLAND_COMPRESSION_NONE;
+    size = lzCompress(stream->table, block, sample, stream->packed, best);
+    if(size){
+        flags = OCLAND_COMPRESSION_LZ;
+        best  = size;
+    }
+    if(stream->modes & OCLAND_COMPRESSION_SHUFFLE){
+        shuffle(block, sample, stream->shuffled);
+        size = lzCompress(stream->table, stream->shuffled, sample, stream->packed, best);
+        if(size)
+            flags = OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE;
+    }
+    return flags;
+}
+
+ssize_t SendStream(int *socket, oclandStream stream, const void *buffer, size_t length)
+{
+    const unsigned char *block;
+    struct blockHeader header;
+    struct iovec iov[2];
+    size_t n, done = 0;
+    if(!stream)
+        return Send(socket, buffer, length, 0);
+    while(done < length){
+        n     = length - done < OCLAND_COMPRESSION_BLOCK ? length - done : OCLAND_COMPRESSION_BLOCK;
+        block = (const unsigned char*)buffer + done;
+        header.raw_size    = (unsigned int)n;
+        header.stored_size = (unsigned int)n;
+        header.flags       = OCLAND_COMPRESSION_NONE;
+        iov[1].iov_base    = (void*)block;
+        if(n >= OCLAND_COMPRESSION_MIN)
+            header.flags = sampleBlock(stream, block, n);
+        if(header.flags){
+            const unsigned char *src = block;
+            if(header.flags & OCLAND_COMPRESSION_SHUFFLE){
+                shuffle(block, n, stream->shuffled);
+                src = stream->shuffled;
+            }
+            header.stored_size = (unsigned int)lzCompress(stream->table, src, n,
+                                                          stream->packed, n - n / 16);
+            if(header.stored_size){
+                iov[1].iov_base = stream->packed;
+            }
+            else{
+                // The sample was not representative
+                header.stored_size = (unsigned int)n;
+                header.flags       = OCLAND_COMPRESSION_NONE;
+            }
+        }
+        iov[0].iov_base = &header;
+        iov[0].iov_len  = sizeof(struct blockHeader);
+        iov[1].iov_len  = header.stored_size;
+        if(SendV(socket, iov, 2) <= 0)
+            return -1;
+        done += n;
+    }
+    return length;
+}
+
+ssize_t RecvStream(int *socket, oclandStream stream, void *buffer, size_t length)
+{
+    unsigned char *dst;
+    struct blockHeader header;
+    size_t n, done = 0;
+    if(!stream)
+        return Recv(socket, buffer, length, MSG_WAITALL);
+    while(done < length){
+        // Consume the block already decoded
+        if(stream->raw_pos < stream->raw_size){
+            n = stream->raw_size - stream->raw_pos;
+            if(n > length - done)
+                n = length - done;
+            memcpy((unsigned char*)buffer + done, stream->raw + stream->raw_pos, n);
+            stream->raw_pos += n;
+            done += n;
+            continue;
+        }
+        if(Recv(socket, &header, sizeof(struct blockHeader), MSG_WAITALL) <= 0)
+            return -1;
+        if(    (header.raw_size > OCLAND_COMPRESSION_BLOCK)
+            || (header.stored_size > compressBound(header.raw_size))
+            || (!header.flags && (header.stored_size != header.raw_size))){
+            printf("ERROR: Corrupted compression stream.\n"); fflush(stdout);
+            return -1;
+        }
+        // Decode the block straight in the destination if it fits
+        if(header.raw_size <= length - done){
+            dst = (unsigned char*)buffer + done;
+        }
+        else{
+            dst = stream->raw;
+            stream->raw_size = header.raw_size;
+            stream->raw_pos  = 0;
+        }
+        if(!header.flags){
+            if(Recv(socket, dst, header.raw_size, MSG_WAITALL) <= 0)
+                return -1;
+        }
+        else{
+            if(Recv(socket, stream->packed, header.stored_size, MSG_WAITALL) <= 0)
+                return -1;
+            if(!lzDecompress(stream->packed, header.stored_size,
+                             (header.flags & OCLAND_COMPRESSION_SHUFFLE) ? stream->shuffled : dst,
+                             header.raw_size)){
+                printf("ERROR: Corrupted compression stream.\n"); fflush(stdout);
+                return -1;
+            }
+            if(header.flags & OCLAND_COMPRESSION_SHUFFLE)
+                unshuffle(stream->shuffled, header.raw_size, dst);
+        }
+        if(dst != stream->raw)
+            done += header.raw_size;
+    }
+    return length;
+}
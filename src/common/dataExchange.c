@@ -25,6 +25,17 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    #include <poll.h>
+    #include <linux/errqueue.h>
+    #define OCLAND_HAVE_ZEROCOPY
+#endif
+
+#ifndef IOV_MAX
+    #define IOV_MAX 1024
+#endif
 
 #include <ocland/common/dataExchange.h>
 
@@ -397,3 +408,151 @@ ssize_t Send(int *socket, const void *buffer, size_t length, int flags)
     */
     return sent;
 }
+
+ssize_t SendV(int *socket, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    size_t sent = 0;
+    ssize_t flag;
+    if(*socket < 0)
+        return 0;
+    // Skip the empty entries
+    while((iovcnt > 0) && (!iov[0].iov_len)){
+        iov++;
+        iovcnt--;
+    }
+    while(iovcnt > 0){
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iovcnt < IOV_MAX ? iovcnt : IOV_MAX;
+        flag = sendmsg(*socket, &msg, 0);
+        if(flag < 0){
+            if(errno == EINTR)
+                continue;
+            return flag;
+        }
+        sent += flag;
+        // Advance along the entries already sent
+        while((iovcnt > 0) && ((size_t)flag >= iov[0].iov_len)){
+            flag -= iov[0].iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0){
+            iov[0].iov_base  = (char*)iov[0].iov_base + flag;
+            iov[0].iov_len  -= flag;
+        }
+    }
+    return sent;
+}
+
+int EnableZeroCopy(int *socket)
+{
+    #ifdef OCLAND_HAVE_ZEROCOPY
+        int enable = 1;
+        if(*socket < 0)
+            return 0;
+        if(setsockopt(*socket, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(int)))
+            return 0;
+        return 1;
+    #else
+        return 0;
+    #endif
+}
+
+int IsZeroCopyEnabled(int *socket)
+{
+    #ifdef OCLAND_HAVE_ZEROCOPY
+        int enabled = 0;
+        socklen_t len = sizeof(int);
+        if(*socket < 0)
+            return 0;
+        if(getsockopt(*socket, SOL_SOCKET, SO_ZEROCOPY, &enabled, &len))
+            return 0;
+        return enabled ? 1 : 0;
+    #else
+        return 0;
+    #endif
+}
+
+ssize_t SendZeroCopy(int *socket, const void *buffer, size_t length, unsigned int *calls)
+{
+    #ifdef OCLAND_HAVE_ZEROCOPY
+        size_t sent = 0;
+        ssize_t flag;
+        if(*socket < 0)
+            return 0;
+        while(sent < length){
+            flag = send(*socket, (const char*)buffer + sent, length - sent, MSG_ZEROCOPY);
+            if(flag < 0){
+                if(errno == EINTR)
+                    continue;
+                // ENOBUFS means that the pages can't be pinned anymore,
+                // fallback to a regular (copying) send
+                if(errno == ENOBUFS){
+                    flag = send(*socket, (const char*)buffer + sent, length - sent, 0);
+                    if(flag > 0){
+                        sent += flag;
+                        continue;
+                    }
+                }
+                return flag;
+            }
+            // Each successful call will report its own completion
+            (*calls)++;
+            sent += flag;
+        }
+        return sent;
+    #else
+        return send(*socket, buffer, length, 0);
+    #endif
+}
+
+int WaitZeroCopy(int *socket, unsigned int *completed, unsigned int calls)
+{
+    #ifdef OCLAND_HAVE_ZEROCOPY
+        char control[128];
+        struct msghdr msg;
+        struct cmsghdr *cm;
+        struct sock_extended_err *serr;
+        struct pollfd pfd;
+        while(*completed < calls){
+            if(*socket < 0)
+                return -1;
+            // Notifications are queued in the socket error queue
+            pfd.fd      = *socket;
+            pfd.events  = 0;
+            pfd.revents = 0;
+            if(poll(&pfd, 1, -1) < 0){
+                if(errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if(pfd.revents & POLLNVAL)
+                return -1;
+            memset(&msg, 0, sizeof(struct msghdr));
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+            if(recvmsg(*socket, &msg, MSG_ERRQUEUE) < 0){
+                if((errno == EAGAIN) || (errno == EINTR)){
+                    if(pfd.revents & POLLHUP)
+                        return -1;
+                    continue;
+                }
+                return -1;
+            }
+            for(cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)){
+                serr = (struct sock_extended_err*)CMSG_DATA(cm);
+                if(    (serr->ee_errno != 0)
+                    || (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+                    continue;
+                // [ee_info, ee_data] range of completed calls
+                *completed += serr->ee_data - serr->ee_info + 1;
+            }
+        }
+        return 0;
+    #else
+        *completed = calls;
+        return 0;
+    #endif
+}
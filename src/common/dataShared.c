@@ -0,0 +1,159 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ocland/common/dataShared.h>
+
+int IsLocalSocket(int *socket)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    if(getsockname(*socket, (struct sockaddr*)&addr, &addr_len))
+        return 0;
+    return addr.ss_family == AF_UNIX;
+}
+
+/** Map a memory file.
+ * @param fd Memory file descriptor.
+ * @param cb Size of the region in bytes.
+ * @return Mapped memory, NULL if the region can't be mapped or it is
+ * smaller than cb.
+ */
+static void* mapRegion(int fd, size_t cb)
+{
+    struct stat info;
+    void *ptr;
+    if(fstat(fd, &info) || (info.st_size < 0) || ((size_t)info.st_size < cb))
+        return NULL;
+    ptr = mmap(NULL, cb, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(ptr == MAP_FAILED)
+        return NULL;
+    return ptr;
+}
+
+int CreateSharedRegion(size_t cb, void **ptr)
+{
+    int fd = -1;
+    *ptr = NULL;
+    #if defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+        fd = memfd_create("ocland", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    #endif
+    if(fd < 0)
+        return -1;
+    if(ftruncate(fd, (off_t)cb)){
+        close(fd);
+        return -1;
+    }
+    // The size is sealed, such that the peer mapping can't be truncated
+    #if defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+        if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)){
+            close(fd);
+            return -1;
+        }
+    #endif
+    *ptr = mapRegion(fd, cb);
+    if(!*ptr){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void* MapSharedRegion(int fd, size_t cb)
+{
+    // Truncating the file while it is mapped would crash the process
+    // accessing the lost pages, so just sealed regions are accepted
+    #ifdef F_GET_SEALS
+        int seals = fcntl(fd, F_GET_SEALS);
+        if((seals < 0) || ((seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)))
+            return NULL;
+        return mapRegion(fd, cb);
+    #else
+        return NULL;
+    #endif
+}
+
+void ReleaseSharedRegion(int fd, void *ptr, size_t cb)
+{
+    if(ptr)
+        munmap(ptr, cb);
+    if(fd >= 0)
+        close(fd);
+}
+
+int SendSharedRegion(int *socket, int fd, size_t cb)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *cmsg;
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    // The region size travels along with the descriptor
+    iov.iov_base       = &cb;
+    iov.iov_len        = sizeof(size_t);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg               = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    if(sendmsg(*socket, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(size_t))
+        return -1;
+    return 0;
+}
+
+int RecvSharedRegion(int *socket, size_t *cb)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *cmsg;
+    int fd = -1;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base       = cb;
+    iov.iov_len        = sizeof(size_t);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+    if(recvmsg(*socket, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(size_t))
+        return -1;
+    for(cmsg=CMSG_FIRSTHDR(&msg);cmsg;cmsg=CMSG_NXTHDR(&msg, cmsg)){
+        if((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)){
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+            break;
+        }
+    }
+    return fd;
+}
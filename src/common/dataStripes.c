@@ -0,0 +1,168 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ocland/common/dataExchange.h>
+#include <ocland/common/dataStripes.h>
+
+#ifndef OCLAND_MAX_STREAMS
+    #define OCLAND_MAX_STREAMS 8u
+#endif
+
+#ifndef OCLAND_STRIPE_MIN_SIZE
+    #define OCLAND_STRIPE_MIN_SIZE 4194304u
+#endif
+
+/// Maximum number of local addresses to spread the streams
+#define OCLAND_MAX_STREAM_ADDRESSES 16u
+
+/// Measured throughput (bytes per second) for each number of streams
+static double rates[OCLAND_MAX_STREAMS + 1];
+/// Number of streams forced by the user, 0 if they should be tuned
+static unsigned int forced_streams = 0;
+/// Local addresses where the streams should be binded
+static struct in_addr addresses[OCLAND_MAX_STREAM_ADDRESSES];
+/// Number of local addresses
+static unsigned int num_addresses = 0;
+/// Environment variables parsing flag
+static pthread_once_t stripes_once = PTHREAD_ONCE_INIT;
+/// Throughput measures mutex
+static pthread_mutex_t stripes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Parse the OCLAND_STREAMS and OCLAND_STREAM_ADDRESSES environment
+ * variables.
+ */
+static void initStripes()
+{
+    const char *env = getenv("OCLAND_STREAMS");
+    if(env){
+        int streams = atoi(env);
+        if(streams > 0)
+            forced_streams = (unsigned int)streams < OCLAND_MAX_STREAMS ? (unsigned int)streams : OCLAND_MAX_STREAMS;
+    }
+    env = getenv("OCLAND_STREAM_ADDRESSES");
+    while(env && *env && (num_addresses < OCLAND_MAX_STREAM_ADDRESSES)){
+        char ip[64];
+        size_t len = strcspn(env, ",");
+        if(len && (len < sizeof(ip))){
+            memcpy(ip, env, len);
+            ip[len] = '\0';
+            if(inet_pton(AF_INET, ip, &(addresses[num_addresses])) > 0)
+                num_addresses++;
+            else
+                printf("WARNING: Invalid stream address \"%s\" ignored\n", ip);
+        }
+        env += len;
+        if(*env == ',')
+            env++;
+    }
+}
+
+unsigned int StripeStreams(size_t cb)
+{
+    unsigned int i, streams = 1;
+    size_t limit = cb / OCLAND_STRIPE_MIN_SIZE;
+    pthread_once(&stripes_once, initStripes);
+    if(limit <= 1)
+        return 1;
+    if(forced_streams){
+        streams = forced_streams;
+    }
+    else{
+        // Take the best measured number of streams, trying to double
+        // it while the throughput improves
+        pthread_mutex_lock(&stripes_mutex);
+        for(i=2;i<=OCLAND_MAX_STREAMS;i++){
+            if(rates[i] > rates[streams])
+                streams = i;
+        }
+        if((2 * streams <= OCLAND_MAX_STREAMS) && (rates[2 * streams] == 0.0))
+            streams *= 2;
+        pthread_mutex_unlock(&stripes_mutex);
+    }
+    return streams < limit ? streams : (unsigned int)limit;
+}
+
+void StripeReport(unsigned int streams, size_t cb, double seconds)
+{
+    double rate;
+    // Too small transfers are not representative
+    if((!streams) || (streams > OCLAND_MAX_STREAMS) || (seconds <= 0.0) || (cb < streams * OCLAND_STRIPE_MIN_SIZE))
+        return;
+    rate = (double)cb / seconds;
+    pthread_mutex_lock(&stripes_mutex);
+    if(rates[streams] == 0.0)
+        rates[streams] = rate;
+    else
+        rates[streams] = 0.75 * rates[streams] + 0.25 * rate;
+    pthread_mutex_unlock(&stripes_mutex);
+}
+
+unsigned int ConnectStripes(int *socket, unsigned int streams)
+{
+    if(Send(socket, &streams, sizeof(unsigned int), 0) <= 0)
+        return 1;
+    if(Recv(socket, &streams, sizeof(unsigned int), MSG_WAITALL) <= 0)
+        return 1;
+    return streams;
+}
+
+unsigned int AcceptStripes(int *socket, int shared)
+{
+    unsigned int streams = 1;
+    if(Recv(socket, &streams, sizeof(unsigned int), MSG_WAITALL) <= 0)
+        streams = 1;
+    if((!streams) && (!shared))
+        streams = 1;
+    if(streams > OCLAND_MAX_STREAMS)
+        streams = OCLAND_MAX_STREAMS;
+    Send(socket, &streams, sizeof(unsigned int), 0);
+    return streams;
+}
+
+void StripeSlice(size_t cb, unsigned int streams, unsigned int index, size_t *offset, size_t *size)
+{
+    size_t slice = cb / streams;
+    *offset = index * slice;
+    *size   = index == streams - 1 ? cb - *offset : slice;
+}
+
+int BindStripe(int *socket, unsigned int index)
+{
+    struct sockaddr_in local_addr;
+    pthread_once(&stripes_once, initStripes);
+    if(!num_addresses)
+        return 0;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_port   = 0;
+    local_addr.sin_addr   = addresses[index % num_addresses];
+    if(bind(*socket, (struct sockaddr*)&local_addr, sizeof(local_addr))){
+        printf("WARNING: Can't bind the stream %u to the local address %s\n",
+               index, inet_ntoa(addresses[index % num_addresses]));
+        return -1;
+    }
+    return 0;
+}
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include <ocland/common/dataExchange.h>
@@ -33,10 +34,14 @@
     #define BUFF_SIZE 1025u
 #endif
 
+#ifndef OCLAND_MAX_MESSAGE_SIZE
+    #define OCLAND_MAX_MESSAGE_SIZE 67108864u
+#endif
+
 typedef int(*func)(int* clientfd, char* buffer, validator v, void* data);
 
 /// List of functions to dispatch request from client
-static func dispatchFunctions[75] =
+static func dispatchFunctions[79] =
 {
     &ocland_clGetPlatformIDs,
     &ocland_clGetPlatformInfo,
@@ -91,9 +96,9 @@ static func dispatchFunctions[75] =
     &ocland_clCreateSubBuffer,
     &ocland_clCreateUserEvent,
     &ocland_clSetUserEventStatus,
-    NULL, // &ocland_clEnqueueReadBufferRect,
-    NULL, // &ocland_clEnqueueWriteBufferRect,
-    NULL, // &ocland_clEnqueueCopyBufferRect,
+    &ocland_clEnqueueReadBufferRect,
+    &ocland_clEnqueueWriteBufferRect,
+    &ocland_clEnqueueCopyBufferRect,
     &ocland_clEnqueueReadImage,
     &ocland_clEnqueueWriteImage,
     NULL, // &ocland_clCreateSubDevices,
@@ -106,15 +111,59 @@ static func dispatchFunctions[75] =
     NULL, // &ocland_clUnloadPlatformCompiler,
     &ocland_clGetProgramInfo,
     &ocland_clGetKernelArgInfo,
-    NULL, // &ocland_clEnqueueFillBuffer,
-    NULL, // &ocland_clEnqueueFillImage,
+    &ocland_clEnqueueFillBuffer,
+    &ocland_clEnqueueFillImage,
     NULL, // &ocland_clEnqueueMigrateMemObjects,
     NULL, // &ocland_clEnqueueMarkerWithWaitList,
     NULL, // &ocland_clEnqueueBarrierWithWaitList
     &ocland_clCreateImage2D,
     &ocland_clCreateImage3D,
+    &ocland_clEnqueueWriteBufferBlocks,
+    &ocland_clCreateBufferBlob,
+    &ocland_clEnqueueWriteBufferBlob,
+    &ocland_clEnqueueCopyBufferToPeer,
 };
 
+/// Number of commands that can be dispatched
+#define OCLAND_NUM_COMMANDS (sizeof(dispatchFunctions) / sizeof(func))
+
+/** Test if a command can stream the bulk data attached at the end of
+ * its message, such that messages larger than OCLAND_MAX_MESSAGE_SIZE
+ * can be accepted. The data not stored in memory remains in the socket,
+ * and its length is stored in the validator pending field.
+ * @param f Command function.
+ * @return 1 if the command is able to stream its data, 0 otherwise.
+ */
+static int isStreamable(func f)
+{
+    return (f == &ocland_clCreateBuffer)
+        || (f == &ocland_clEnqueueWriteBuffer)
+        || (f == &ocland_clEnqueueWriteImage)
+        || (f == &ocland_clEnqueueWriteBufferRect)
+        || (f == &ocland_clEnqueueWriteBufferBlocks)
+        || (f == &ocland_clCreateImage)
+        || (f == &ocland_clCreateImage2D)
+        || (f == &ocland_clCreateImage3D)
+        || (f == &ocland_clCreateProgramWithBinary);
+}
+
+/** Disconnect a client which is sending unacceptable packages.
+ * @param clientfd Client socket.
+ * @param reason Rejection reason to be printed.
+ * @param size Size of the package.
+ */
+static void rejectClient(int* clientfd, const char* reason, size_t size)
+{
+    struct sockaddr_in adr_inet;
+    socklen_t len_inet;
+    len_inet = sizeof(adr_inet);
+    getsockname(*clientfd, (struct sockaddr*)&adr_inet, &len_inet);
+    printf("%s from %s (%lu bytes)", reason, inet_ntoa(adr_inet.sin_addr), size);
+    printf(", disconnected for protection...\n"); fflush(stdout);
+    close(*clientfd);
+    *clientfd = -1;
+}
+
 void *client_thread(void *socket)
 {
     char buffer[BUFF_SIZE];
@@ -130,55 +179,93 @@ void *client_thread(void *socket)
     return NULL;
 }
 
-int dispatch(int* clientfd, char* buffer, validator v)
+/** Receive, without blocking, the bytes of the package still pending
+ * of the client. Partial packages are kept in the validator, such that
+ * a slow client can't stall the other ones.
+ * @param clientfd Client socket.
+ * @param ptr Memory where the data should be stored.
+ * @param size Size of the data which should be received.
+ * @param v Validator.
+ * @param msg Message printed if the client disconnects.
+ * @return 1 if the data has been fully received, 0 otherwise.
+ */
+static int recvPackage(int* clientfd, void* ptr, size_t size, validator v, const char* msg)
 {
-    size_t commSize = 0;
-    int flag = Recv(clientfd,&commSize,sizeof(size_t),MSG_DONTWAIT | MSG_PEEK);
-    if(flag < 0){
+    int flag = Recv(clientfd, (char*)ptr + v->received, size - v->received, MSG_DONTWAIT);
+    if((flag < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))){
         return 0;
     }
-    if(!flag){
+    if(flag <= 0){
         // Peer called to close connection
         struct sockaddr_in adr_inet;
         socklen_t len_inet;
         len_inet = sizeof(adr_inet);
         getsockname(*clientfd, (struct sockaddr*)&adr_inet, &len_inet);
-        printf("%s disconnected, goodbye ;-)\n", inet_ntoa(adr_inet.sin_addr)); fflush(stdout);
-        close(*clientfd);
-        *clientfd = -1;
-        return 1;
-    }
-    flag = Recv(clientfd,&commSize,sizeof(size_t),MSG_WAITALL);
-    void *msg = (void*)malloc(commSize);
-    if(!msg){
-        struct sockaddr_in adr_inet;
-        socklen_t len_inet;
-        len_inet = sizeof(adr_inet);
-        getsockname(*clientfd, (struct sockaddr*)&adr_inet, &len_inet);
-        printf("Can't allocate memory for the package from %s (%lu bytes requested)", inet_ntoa(adr_inet.sin_addr), commSize);
-        printf(", disconnected for protection...\n"); fflush(stdout);
+        printf("%s %s\n", inet_ntoa(adr_inet.sin_addr), msg); fflush(stdout);
         close(*clientfd);
         *clientfd = -1;
-        return 1;
+        return 0;
     }
-    flag = Recv(clientfd,msg,commSize,MSG_WAITALL);
-    if(!flag){
-        // Peer called to close connection
-        struct sockaddr_in adr_inet;
-        socklen_t len_inet;
-        len_inet = sizeof(adr_inet);
-        getsockname(*clientfd, (struct sockaddr*)&adr_inet, &len_inet);
-        printf("%s disconnected while operating\n", inet_ntoa(adr_inet.sin_addr)); fflush(stdout);
-        close(*clientfd);
-        *clientfd = -1;
-        return 1;
+    v->received += flag;
+    return v->received == size;
+}
+
+int dispatch(int* clientfd, char* buffer, validator v)
+{
+    int flag;
+    size_t commSize, msgSize;
+    if(!v->msg){
+        if(!recvPackage(clientfd, &(v->comm_size), sizeof(size_t), v, "disconnected, goodbye ;-)"))
+            return *clientfd < 0;
+        v->received = 0;
+        commSize = v->comm_size;
+        if(commSize < sizeof(unsigned int)){
+            rejectClient(clientfd, "Invalid package", commSize);
+            return 1;
+        }
+        // Only the first OCLAND_MAX_MESSAGE_SIZE bytes are stored in memory,
+        // the rest (if any) must be streamed by the command itself
+        msgSize = commSize;
+        if(msgSize > OCLAND_MAX_MESSAGE_SIZE)
+            msgSize = OCLAND_MAX_MESSAGE_SIZE;
+        v->msg = (void*)malloc(msgSize);
+        if(!v->msg){
+            rejectClient(clientfd, "Can't allocate memory for the package", commSize);
+            return 1;
+        }
     }
+    commSize = v->comm_size;
+    msgSize = commSize;
+    if(msgSize > OCLAND_MAX_MESSAGE_SIZE)
+        msgSize = OCLAND_MAX_MESSAGE_SIZE;
+    if(!recvPackage(clientfd, v->msg, msgSize, v, "disconnected while operating"))
+        return *clientfd < 0;
+    void *msg = v->msg;
+    v->msg = NULL;
+    v->received = 0;
     // Extract the command from the message
     unsigned int comm = ((unsigned int*)msg)[0];
     void *data = ((unsigned int*)msg) + 1;
+    if((comm >= OCLAND_NUM_COMMANDS) || (!dispatchFunctions[comm])){
+        free(msg);
+        rejectClient(clientfd, "Unknown command", commSize);
+        return 1;
+    }
+    if((commSize > msgSize) && (!isStreamable(dispatchFunctions[comm]))){
+        free(msg);
+        rejectClient(clientfd, "Package too large", commSize);
+        return 1;
+    }
     // Call the command
+    v->pending = commSize - msgSize;
     flag = dispatchFunctions[comm] (clientfd, buffer, v, data);
     free(msg);
     msg = NULL;
+    // Drop the data not consumed by the command to keep the stream sync
+    if(v->pending){
+        if(*clientfd >= 0)
+            oclandDiscard(clientfd, v->pending);
+        v->pending = 0;
+    }
     return flag;
 }
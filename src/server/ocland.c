@@ -42,6 +42,8 @@
  */
 
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -50,10 +52,14 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <string.h>
+#include <errno.h>
 
+#include <ocland/common/dataExchange.h>
 #include <ocland/server/log.h>
 #include <ocland/server/validator.h>
 #include <ocland/server/dispatcher.h>
+#include <ocland/server/ocland_poll.h>
+#include <ocland/server/ocland_mem.h>
 
 /** Maximum number of client connections
  * accepted by server. Variable must be
@@ -63,6 +69,13 @@
     #define OCLAND_PORT 51000u
 #endif
 
+/** Unix domain socket where the server listens for the clients
+ * running in the same host. Variable must be defined by autotools.
+ */
+#ifndef OCLAND_UNIX_SOCKET
+    #define OCLAND_UNIX_SOCKET "/run/ocland/ocland.sock"
+#endif
+
 /** Buffer size. Variable must be
  * defined by autotools.
  */
@@ -78,6 +91,13 @@
     #define MAX_CLIENTS 32u
 #endif
 
+/** Maximum number of commands of a client dispatched in a row, before
+ * serving the other clients.
+ */
+#ifndef OCLAND_DISPATCH_BATCH
+    #define OCLAND_DISPATCH_BATCH 16u
+#endif
+
 /** ocland name and version. Variable must be
  * defined by autotools.
  */
@@ -86,16 +106,20 @@
 #endif
 
 /// Valid command line sort options.
-static const char *opts = "l:vh?";
+static const char *opts = "l:u:p:vh?";
 /// Valid command line long options.
 static const struct option longOpts[] = {
     { "log-file", required_argument, NULL, 'l' },
+    { "unix-socket", required_argument, NULL, 'u' },
+    { "peers", required_argument, NULL, 'p' },
     { "version", no_argument, NULL, 'v' },
     { "help", no_argument, NULL, 'h' },
     { NULL, no_argument, NULL, 0 }
 };
 /// Option argument
 extern char *optarg;
+/// Unix domain socket path, empty if it should not be used
+static const char *unix_socket = OCLAND_UNIX_SOCKET;
 
 /** Show usage/help page and stops ocland server execution.
  */
@@ -107,6 +131,13 @@ void displayUsage()
     printf("Required arguments for long options are also required for the short ones.\n");
     printf("  -l, --log-file=LOG           Output log file. If unset /var/log/ocland.log\n");
     printf("                                 will used\n");
+    printf("  -u, --unix-socket=PATH       Unix domain socket for the local clients. If\n");
+    printf("                                 unset %s will be used, set it\n", OCLAND_UNIX_SOCKET);
+    printf("                                 empty to disable it\n");
+    printf("  -p, --peers=LIST             Comma separated addresses of the servers where\n");
+    printf("                                 the data can be sent straight from this one,\n");
+    printf("                                 as known by the clients. If unset any server\n");
+    printf("                                 listening on the transfer ports is allowed\n");
     printf("  -v, --version                Show ocland name and version\n");
     printf("  -h, --help                   Show this help page\n");
 }
@@ -129,6 +160,14 @@ void parseOptions(int argc, char *argv[])
                 }
                 break;
 
+            case 'u':
+                unix_socket = optarg;
+                break;
+
+            case 'p':
+                setAllowedPeers(optarg);
+                break;
+
             case 'v':
                 printf(PACKAGE_STRING);
                 printf("\n");
@@ -151,6 +190,110 @@ void parseOptions(int argc, char *argv[])
     }
 }
 
+/** Prepare the directory of the Unix domain socket, creating it if it
+ * does not exist. The other users must not be able to replace the socket,
+ * so directories writable by them are refused, unless they are sticky
+ * (like /tmp).
+ * @param path Socket path.
+ * @return 0 if the directory can hold the socket, -1 otherwise.
+ */
+static int prepareSocketDir(const char *path)
+{
+    struct stat st;
+    char dir[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+    char *sep;
+    strcpy(dir, path);
+    sep = strrchr(dir, '/');
+    if(!sep)
+        strcpy(dir, ".");
+    else if(sep == dir)
+        dir[1] = '\0';
+    else
+        *sep = '\0';
+    if(mkdir(dir, 0755) && (errno != EEXIST)){
+        printf("WARNING: Can't create the directory %s!\n", dir);
+        return -1;
+    }
+    if(stat(dir, &st) || !S_ISDIR(st.st_mode)){
+        printf("WARNING: %s is not a directory!\n", dir);
+        return -1;
+    }
+    if((st.st_mode & (S_IWGRP | S_IWOTH)) && !(st.st_mode & S_ISVTX)){
+        printf("WARNING: %s is writable by other users!\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+/** Test if a Unix domain socket file is not attached anymore to any
+ * server, i.e. nobody is listening on it.
+ * @param addr Socket address.
+ * @return 1 if the socket is stale, 0 otherwise.
+ */
+static int isStaleSocket(const struct sockaddr_un *addr)
+{
+    int stale = 0;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return 0;
+    if(connect(fd, (const struct sockaddr*)addr, sizeof(struct sockaddr_un)) && (errno == ECONNREFUSED))
+        stale = 1;
+    close(fd);
+    return stale;
+}
+
+/** Open the Unix domain socket where the local clients are accepted.
+ * A socket left by a previous execution is replaced, but never a
+ * socket where another server is still listening.
+ * @param path Socket path.
+ * @return Server socket, -1 if it can't be opened.
+ */
+int openUnixSocket(const char *path)
+{
+    struct sockaddr_un serv_addr;
+    struct stat st;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    if(strlen(path) >= sizeof(serv_addr.sun_path)){
+        printf("WARNING: Unix domain socket path too long (%s)!\n", path);
+        return -1;
+    }
+    serv_addr.sun_family = AF_UNIX;
+    strcpy(serv_addr.sun_path, path);
+    if(prepareSocketDir(path))
+        return -1;
+    if(!lstat(path, &st)){
+        if(!S_ISSOCK(st.st_mode)){
+            printf("WARNING: %s exists and it is not a socket!\n", path);
+            return -1;
+        }
+        if(!isStaleSocket(&serv_addr)){
+            printf("WARNING: Another server is listening on %s!\n", path);
+            return -1;
+        }
+        // Remove the socket left by a previous execution
+        unlink(path);
+    }
+    int serverfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(serverfd < 0){
+        printf("WARNING: Unix domain socket can't be registered!\n");
+        return -1;
+    }
+    if(bind(serverfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr))){
+        printf("WARNING: Can't bind on %s!\n", path);
+        close(serverfd);
+        return -1;
+    }
+    // Let the clients of any user connect, as they can through TCP
+    chmod(path, 0666);
+    if(listen(serverfd, MAX_CLIENTS)){
+        printf("WARNING: Can't listen on %s!\n", path);
+        close(serverfd);
+        unlink(path);
+        return -1;
+    }
+    return serverfd;
+}
+
 /** Server entry point. ocland-server is an executable called ocland
  * that runs on machines that must serve computing devices remotely.
  * @param argc Number of command line arguments.
@@ -169,9 +312,9 @@ int main(int argc, char *argv[])
     // ------------------------------
     int switch_on  = 1;
     int switch_off = 0;
-    int serverfd = 0, *clientfd = NULL;
+    int serverfd = 0, unixfd = -1, *clientfd = NULL;
     validator *v = NULL;
-    unsigned int n_clientfd = 0, i,j;
+    unsigned int n_clientfd = 0, i, k;
     struct sockaddr_in serv_addr;
 
     char buffer[BUFF_SIZE];
@@ -198,6 +341,14 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
     printf("Server ready on port %u.\n", OCLAND_PORT);
+    if(unix_socket[0]){
+        // The local clients can still connect through TCP
+        unixfd = openUnixSocket(unix_socket);
+        if(unixfd < 0)
+            printf("WARNING: Local clients will not be accepted on %s.\n", unix_socket);
+        else
+            printf("Server ready on %s.\n", unix_socket);
+    }
     printf("%u connections will be accepted...\n", MAX_CLIENTS);
     fflush(stdout);
     // ------------------------------
@@ -208,63 +359,90 @@ int main(int argc, char *argv[])
     for(i=0;i<MAX_CLIENTS;i++){
         clientfd[i] = -1;
     }
+    if(initPoller() || watchSocket(serverfd) || ((unixfd >= 0) && watchSocket(unixfd))){
+        printf("Can't poll the sockets!\n");
+        return EXIT_FAILURE;
+    }
+    printf("Sockets polled with %s.\n", pollerName());
+    fflush(stdout);
+    // The clients with commands left after a batch are served again in
+    // the next iteration, without waiting for new data
+    int ready[2*MAX_CLIENTS + 2], backlog[MAX_CLIENTS];
+    unsigned int n_backlog = 0, n;
     while(1)
     {
-        // Accepts new connection if possible
-        int fd = accept(serverfd, (struct sockaddr*)NULL, NULL);
-        if(fd >= 0){
-            clientfd[n_clientfd] = fd;
-            initValidator(&(v[n_clientfd]));
-            struct sockaddr_in adr_inet;
-            socklen_t len_inet;
-            len_inet = sizeof(adr_inet);
-            getsockname(fd, (struct sockaddr*)&adr_inet, &len_inet);
-            n_clientfd++;
-            printf("%s connected, hello!\n", inet_ntoa(adr_inet.sin_addr)); fflush(stdout);
-            printf("%u connection slots free.\n", MAX_CLIENTS - n_clientfd); fflush(stdout);
+        // Sleep until some client requests something
+        int n_ready = waitSockets(ready, MAX_CLIENTS + 2, n_backlog ? 0 : -1);
+        if(n_ready < 0){
+            printf("ERROR: Sockets polling failed (%s)\n", SocketsError()); fflush(stdout);
+            usleep(1000);
+            continue;
         }
-        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,  (char *) &switch_on, sizeof(int));
-        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, (char *) &switch_on, sizeof(int));
-        // Count new number of clients (to manage lost ones)
-        unsigned int n = n_clientfd;
-        n_clientfd = 0;
-        for(i=0;i<MAX_CLIENTS;i++){
-            if(clientfd[i] >= 0){
-                n_clientfd++;
+        for(i=0;i<n_backlog;i++){
+            for(n=0;n<(unsigned int)n_ready;n++){
+                if(ready[n] == backlog[i])
+                    break;
             }
+            if(n == (unsigned int)n_ready)
+                ready[n_ready++] = backlog[i];
         }
-        if(n != n_clientfd){
-            printf("%u connection slots free.\n", MAX_CLIENTS - n_clientfd); fflush(stdout);
-            if(!(MAX_CLIENTS - n_clientfd)){
-                printf("NO MORE CLIENTS WILL BE ACCEPTED\n"); fflush(stdout);
-            }
-            // Sort the clients at the start of the array
-            for(i=0;i<n_clientfd;i++){
-                if(clientfd[i] < 0){
-                    // Look for next non-negative
-                    j = i+1;
-                    while(clientfd[j] < 0)
-                        j++;
-                    // Swap them
-                    clientfd[i] = clientfd[j];
-                    clientfd[j] = -1;
-                    v[i]        = v[j];
+        n_backlog = 0;
+        for(k=0;k<(unsigned int)n_ready;k++){
+            // Accepts new connections if possible
+            if((ready[k] == serverfd) || (ready[k] == unixfd)){
+                int fd;
+                while((fd = accept(ready[k], (struct sockaddr*)NULL, NULL)) >= 0){
+                    for(i=0;i<MAX_CLIENTS;i++){
+                        if(clientfd[i] < 0)
+                            break;
+                    }
+                    if((i == MAX_CLIENTS) || watchSocket(fd)){
+                        printf("NO MORE CLIENTS WILL BE ACCEPTED\n"); fflush(stdout);
+                        close(fd);
+                        continue;
+                    }
+                    clientfd[i] = fd;
+                    initValidator(&(v[i]));
+                    n_clientfd++;
+                    if(ready[k] == serverfd){
+                        struct sockaddr_in adr_inet;
+                        socklen_t len_inet;
+                        len_inet = sizeof(adr_inet);
+                        getsockname(fd, (struct sockaddr*)&adr_inet, &len_inet);
+                        printf("%s connected, hello!\n", inet_ntoa(adr_inet.sin_addr)); fflush(stdout);
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,  (char *) &switch_on, sizeof(int));
+                        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, (char *) &switch_on, sizeof(int));
+                    }
+                    else{
+                        printf("Local client connected, hello!\n"); fflush(stdout);
+                    }
+                    printf("%u connection slots free.\n", MAX_CLIENTS - n_clientfd); fflush(stdout);
                 }
+                continue;
             }
-        }
-        // Serve to the clients
-        for(i=0;i<n_clientfd;i++){
-            dispatch(&(clientfd[i]), buffer, v[i]);
+            // Serve the client, until all its pending commands are
+            // dispatched or the batch is exhausted
+            for(i=0;i<MAX_CLIENTS;i++){
+                if(clientfd[i] == ready[k])
+                    break;
+            }
+            if(i == MAX_CLIENTS)
+                continue;
+            int fd = clientfd[i];
+            for(n=0;n<OCLAND_DISPATCH_BATCH;n++){
+                if(!dispatch(&(clientfd[i]), buffer, v[i]) || (clientfd[i] < 0))
+                    break;
+            }
+            if((n == OCLAND_DISPATCH_BATCH) && (clientfd[i] >= 0))
+                backlog[n_backlog++] = fd;
             if(clientfd[i] < 0){
                 // Client disconnected
+                unwatchSocket(fd);
                 closeValidator(&(v[i]));
+                n_clientfd--;
+                printf("%u connection slots free.\n", MAX_CLIENTS - n_clientfd); fflush(stdout);
             }
         }
-        if(!n_clientfd){
-            // We can wait a little bit more if not any
-            // client is connected.
-            usleep(1000);
-        }
     }
     free(clientfd); clientfd=0;
     free(v); v = NULL;
@@ -0,0 +1,185 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ocland/common/dataCompression.h>
+#include <ocland/server/ocland_mem.h>
+#include <ocland/server/ocland_blob.h>
+
+#ifndef OCLAND_BLOB_CACHE_SIZE
+    #define OCLAND_BLOB_CACHE_SIZE 536870912u
+#endif
+
+#ifndef OCLAND_MAX_MESSAGE_SIZE
+    #define OCLAND_MAX_MESSAGE_SIZE 67108864u
+#endif
+
+/// Cached blobs
+static ocland_blob blobs = NULL;
+/// Size of the cached blobs
+static size_t cache_size = 0;
+/// Time stamps counter
+static unsigned long clock_counter = 0;
+/// Cache access mutex
+static pthread_mutex_t blobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Destroy a blob.
+ * @param blob Blob to destroy.
+ */
+static void destroyBlob(ocland_blob blob)
+{
+    free(blob->data);
+    free(blob);
+}
+
+/** Drop the least recently used blobs not in use, until there is
+ * room enough for new data. The mutex must be locked.
+ * @param size Size of the new data.
+ * @return CL_TRUE if the data fits in the cache, CL_FALSE otherwise.
+ */
+static cl_bool makeRoom(size_t size)
+{
+    ocland_blob blob, prev, lru, lru_prev;
+    while(cache_size + size > OCLAND_BLOB_CACHE_SIZE){
+        lru = NULL; lru_prev = NULL; prev = NULL;
+        for(blob=blobs;blob;prev=blob,blob=blob->next){
+            if(blob->refs)
+                continue;
+            if((!lru) || (blob->last_use < lru->last_use)){
+                lru = blob; lru_prev = prev;
+            }
+        }
+        if(!lru)
+            return CL_FALSE;
+        if(lru_prev)
+            lru_prev->next = lru->next;
+        else
+            blobs = lru->next;
+        cache_size -= lru->size;
+        destroyBlob(lru);
+    }
+    return CL_TRUE;
+}
+
+/** Look for a blob in the cache, retaining it. The mutex must be locked.
+ * @param hash SHA-256 digest of the data.
+ * @param size Size of the data.
+ * @return The blob, NULL if it is not in the cache.
+ */
+static ocland_blob findBlob(const unsigned char *hash, size_t size)
+{
+    ocland_blob blob;
+    for(blob=blobs;blob;blob=blob->next){
+        if((blob->size == size) && !memcmp(blob->hash, hash, SHA256_DIGEST_SIZE)){
+            blob->refs++;
+            blob->last_use = ++clock_counter;
+            break;
+        }
+    }
+    return blob;
+}
+
+ocland_blob getBlob(const unsigned char *hash, size_t size)
+{
+    ocland_blob blob;
+    pthread_mutex_lock(&blobs_mutex);
+    blob = findBlob(hash, size);
+    pthread_mutex_unlock(&blobs_mutex);
+    return blob;
+}
+
+cl_bool isBlobCacheable(size_t size)
+{
+    // The blobs are received in memory before being verified, so they
+    // can't exceed the messages size limit
+    if((!size) || (size > OCLAND_BLOB_CACHE_SIZE) || (size > OCLAND_MAX_MESSAGE_SIZE))
+        return CL_FALSE;
+    return CL_TRUE;
+}
+
+cl_int recvBlob(int *fd, const unsigned char *hash, size_t size, ocland_blob *blob)
+{
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    ocland_blob b, cached;
+    *blob = NULL;
+    if(!isBlobCacheable(size)){
+        oclandDiscard(fd, size);
+        return CL_INVALID_VALUE;
+    }
+    b = (ocland_blob)malloc(sizeof(struct _ocland_blob));
+    if(b)
+        b->data = malloc(size);
+    if((!b) || (!b->data)){
+        free(b);
+        oclandDiscard(fd, size);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    if(RecvStream(fd, NULL, b->data, size) <= 0){
+        destroyBlob(b);
+        return CL_OUT_OF_RESOURCES;
+    }
+    // Never trust the client, since a wrong blob would be served to
+    // the other clients
+    SHA256(b->data, size, digest);
+    if(memcmp(digest, hash, SHA256_DIGEST_SIZE)){
+        printf("ERROR: Uploaded data does not match its hash\n"); fflush(stdout);
+        destroyBlob(b);
+        return CL_INVALID_VALUE;
+    }
+    memcpy(b->hash, hash, SHA256_DIGEST_SIZE);
+    b->size   = size;
+    b->refs   = 1;
+    b->cached = CL_FALSE;
+    b->next   = NULL;
+    pthread_mutex_lock(&blobs_mutex);
+    // Another client may have uploaded the same data meanwhile
+    cached = findBlob(hash, size);
+    if(cached){
+        pthread_mutex_unlock(&blobs_mutex);
+        destroyBlob(b);
+        *blob = cached;
+        return CL_SUCCESS;
+    }
+    b->last_use = ++clock_counter;
+    if(makeRoom(size)){
+        b->cached  = CL_TRUE;
+        b->next    = blobs;
+        blobs      = b;
+        cache_size += size;
+    }
+    pthread_mutex_unlock(&blobs_mutex);
+    *blob = b;
+    return CL_SUCCESS;
+}
+
+void releaseBlob(ocland_blob blob)
+{
+    cl_bool destroy;
+    if(!blob)
+        return;
+    pthread_mutex_lock(&blobs_mutex);
+    blob->refs--;
+    destroy = (!blob->refs) && (!blob->cached);
+    pthread_mutex_unlock(&blobs_mutex);
+    if(destroy)
+        destroyBlob(blob);
+}
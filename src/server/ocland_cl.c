@@ -783,6 +783,106 @@ int ocland_clGetCommandQueueInfo(int* clientfd, char* buffer, validator v, void*
     return 1;
 }
 
+/** Create a buffer whose host data is partially pending in the socket.
+ * The buffer is created without host pointer, and the data is written
+ * using a temporary command queue on the first device of the context.
+ * @param clientfd Client socket.
+ * @param v Validator, whose pending field is consumed.
+ * @param context Context where the buffer will be created.
+ * @param flags Buffer flags, CL_MEM_COPY_HOST_PTR is required.
+ * @param size Size of the buffer.
+ * @param host_ptr Host data already received.
+ * @param errcode_ret Returned error code.
+ * @return Memory object, NULL if errors are detected.
+ */
+static cl_mem createBufferStreamed(int* clientfd, validator v,
+                                   cl_context context, cl_mem_flags flags,
+                                   size_t size, void* host_ptr,
+                                   cl_int* errcode_ret)
+{
+    cl_mem memobj = NULL;
+    cl_command_queue queue = NULL;
+    cl_device_id device;
+    size_t pending = v->pending;
+    if((!(flags & CL_MEM_COPY_HOST_PTR)) || (pending >= size)){
+        *errcode_ret = CL_INVALID_VALUE;
+        return NULL;
+    }
+    *errcode_ret = clGetContextInfo(context, CL_CONTEXT_DEVICES, sizeof(cl_device_id), &device, NULL);
+    if(*errcode_ret != CL_SUCCESS)
+        return NULL;
+    memobj = clCreateBuffer(context, flags & ~CL_MEM_COPY_HOST_PTR, size, NULL, errcode_ret);
+    if(*errcode_ret != CL_SUCCESS)
+        return NULL;
+    queue = clCreateCommandQueue(context, device, 0, errcode_ret);
+    if(*errcode_ret != CL_SUCCESS){
+        clReleaseMemObject(memobj);
+        return NULL;
+    }
+    *errcode_ret = clEnqueueWriteBuffer(queue, memobj, CL_TRUE, 0, size - pending,
+                                        host_ptr, 0, NULL, NULL);
+    if(*errcode_ret == CL_SUCCESS){
+        *errcode_ret = oclandRecvBuffer(clientfd, NULL, queue, memobj, size - pending,
+                                        pending, NULL);
+        v->pending = 0;
+    }
+    clReleaseCommandQueue(queue);
+    if(*errcode_ret != CL_SUCCESS){
+        clReleaseMemObject(memobj);
+        return NULL;
+    }
+    return memobj;
+}
+
+/** Fill a new image with host data exceeding OCLAND_MAX_MESSAGE_SIZE,
+ * whose tail is still pending in the socket.
+ * @param clientfd Client socket.
+ * @param v Validator.
+ * @param context Context of the image.
+ * @param image Image, created without host data.
+ * @param region Image dimensions (in pixels).
+ * @param row_pitch Row pitch of the host data (0 if tightly packed).
+ * @param slice_pitch Slice pitch of the host data (0 if tightly packed).
+ * @param head Host data already received.
+ * @return CL_SUCCESS if the image is filled, an error code otherwise. In
+ * any case the pending data is consumed.
+ */
+static cl_int fillImageStreamed(int* clientfd, validator v,
+                                cl_context context, cl_mem image,
+                                const size_t* region,
+                                size_t row_pitch, size_t slice_pitch,
+                                void* head)
+{
+    cl_int flag;
+    cl_command_queue queue = NULL;
+    cl_device_id device;
+    size_t element_size, cb;
+    size_t origin[3] = {0, 0, 0};
+    flag = clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(size_t), &element_size, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    if(!row_pitch)
+        row_pitch = region[0]*element_size;
+    if(!slice_pitch)
+        slice_pitch = region[1]*row_pitch;
+    cb = region[2] > 1 ? region[2]*slice_pitch : region[1]*row_pitch;
+    if(v->pending >= cb)
+        return CL_INVALID_VALUE;
+    flag = clGetContextInfo(context, CL_CONTEXT_DEVICES, sizeof(cl_device_id), &device, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    queue = clCreateCommandQueue(context, device, 0, &flag);
+    if(flag != CL_SUCCESS)
+        return flag;
+    flag = oclandRecvImage(clientfd, NULL, queue, image, origin, region,
+                           row_pitch, slice_pitch,
+                           head, cb - v->pending, cb, NULL);
+    v->pending = 0;
+    clFinish(queue);
+    clReleaseCommandQueue(queue);
+    return flag;
+}
+
 int ocland_clCreateBuffer(int* clientfd, char* buffer, validator v, void* data)
 {
     VERBOSE_IN();
@@ -817,8 +917,15 @@ int ocland_clCreateBuffer(int* clientfd, char* buffer, validator v, void* data)
         VERBOSE_OUT(flag);
         return 1;
     }
-    // Create the command queue
-    memobj = clCreateBuffer(context, flags, size, host_ptr, &flag);
+    // Create the memory object
+    if(hasPtr && v->pending){
+        // The host data exceeds OCLAND_MAX_MESSAGE_SIZE, so the buffer
+        // is created empty and filled streaming the data from the socket
+        memobj = createBufferStreamed(clientfd, v, context, flags, size, host_ptr, &flag);
+    }
+    else{
+        memobj = clCreateBuffer(context, flags, size, host_ptr, &flag);
+    }
     if(flag == CL_SUCCESS){
         registerBuffer(v, memobj);
     }
@@ -1387,6 +1494,12 @@ int ocland_clCreateProgramWithBinary(int* clientfd, char* buffer, validator v, v
     data = (cl_device_id*)data + num_devices;
     memcpy(lengths, data, num_devices * sizeof(size_t));
     data = (size_t*)data + num_devices;
+    // The binaries exceeding OCLAND_MAX_MESSAGE_SIZE are still pending in
+    // the socket, so just the first avail bytes can be read from memory
+    size_t avail = 0, n;
+    for(i=0;i<num_devices;i++)
+        avail += lengths[i];
+    avail = avail > v->pending ? avail - v->pending : 0;
     for(i=0;i<num_devices;i++){
         binaries[i] = (char*)malloc(lengths[i]*sizeof(unsigned char));
         if(!binaries[i]){
@@ -1407,8 +1520,15 @@ int ocland_clCreateProgramWithBinary(int* clientfd, char* buffer, validator v, v
             VERBOSE_OUT(flag);
             return 1;
         }
-        memcpy(binaries[i], data, lengths[i]*sizeof(unsigned char));
-        data = (unsigned char*)data + lengths[i];
+        n = lengths[i] < avail ? lengths[i] : avail;
+        memcpy(binaries[i], data, n*sizeof(unsigned char));
+        data = (unsigned char*)data + n;
+        avail -= n;
+        if((n < lengths[i]) && v->pending){
+            n = lengths[i] - n < v->pending ? lengths[i] - n : v->pending;
+            Recv(clientfd, binaries[i] + lengths[i] - n, n, MSG_WAITALL);
+            v->pending -= n;
+        }
     }
     // Ensure that the context is valid
     flag = isContext(v, context);
@@ -2203,8 +2323,17 @@ int ocland_clGetEventInfo(int* clientfd, char* buffer, validator v, void* data)
     // Build the required param_value
     if(param_value_size)
         param_value = (void*)malloc(param_value_size);
-    // Get the data
-    flag = clGetEventInfo(event->event,param_name,param_value_size,param_value,&param_value_size_ret);
+    // Get the data. The failed ocland works report their error
+    if((param_name == CL_EVENT_COMMAND_EXECUTION_STATUS) && (event->status < 0)){
+        flag = CL_SUCCESS;
+        param_value_size_ret = sizeof(cl_int);
+        if(param_value && (param_value_size < sizeof(cl_int)))
+            flag = CL_INVALID_VALUE;
+        else if(param_value)
+            ((cl_int*)param_value)[0] = event->status;
+    }
+    else
+        flag = clGetEventInfo(event->event,param_name,param_value_size,param_value,&param_value_size_ret);
     // Return the package
     msgSize  = sizeof(cl_int);       // flag
     msgSize += sizeof(size_t);       // param_value_size_ret
@@ -2480,7 +2609,6 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
     ocland_event *event_wait_list = NULL;
     cl_bool want_event;
     cl_int flag;
-    void* ptr = NULL;
     ocland_event event = NULL;
     size_t msgSize = 0;
     void *msg = NULL, *mptr = NULL;
@@ -2564,9 +2692,8 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
         return 1;
     }
     // Build required objects
-    ptr   = malloc(cb);
     event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if( (!ptr) || (!event) ){
+    if(!event){
         flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
         msgSize  = sizeof(cl_int);
         msg      = (void*)malloc(msgSize);
@@ -2596,11 +2723,16 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
             oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
             free(event_wait_list); event_wait_list=NULL;
         }
-        // Read the data
-        flag = clEnqueueReadBuffer(command_queue,memobj,blocking_read,
-                                   offset,cb,ptr,
-                                   0,NULL,&(event->event));
-        if(flag != CL_SUCCESS){
+        // Build the package header, the data will be streamed
+        // from the device to the client just after it
+        size_t headerSize;
+        msgSize  = sizeof(cl_int);          // flag
+        msgSize += sizeof(ocland_event);    // event
+        msgSize += cb;                      // ptr
+        headerSize = sizeof(size_t) + msgSize - cb;
+        msg      = (void*)malloc(headerSize);
+        if(!msg){
+            flag     = CL_OUT_OF_HOST_MEMORY;
             msgSize  = sizeof(cl_int);
             msg      = (void*)malloc(msgSize);
             mptr     = msg;
@@ -2608,25 +2740,38 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
             Send(clientfd, &msgSize, sizeof(size_t), 0);
             Send(clientfd, msg, msgSize, 0);
             free(msg);msg=NULL;
-            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            free(ptr); ptr=NULL;
             free(event); event=NULL;
             VERBOSE_OUT(flag);
             return 1;
         }
-        // Return the package
-        msgSize  = sizeof(cl_int);          // flag
-        msgSize += sizeof(ocland_event);    // event
-        msgSize += cb;                      // ptr
-        msg      = (void*)malloc(msgSize);
         mptr     = msg;
-        ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
-        ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
-        memcpy(mptr, ptr, cb);
-        Send(clientfd, &msgSize, sizeof(size_t), 0);
-        Send(clientfd, msg, msgSize, 0);
+        ((size_t*)mptr)[0]       = msgSize;    mptr = (size_t*)mptr + 1;
+        ((cl_int*)mptr)[0]       = CL_SUCCESS; mptr = (cl_int*)mptr + 1;
+        ((ocland_event*)mptr)[0] = event;
+        // Read the data
+        flag = oclandSendBuffer(clientfd,NULL,command_queue,memobj,
+                                offset,cb,msg,headerSize,
+                                &(event->event));
         free(msg);msg=NULL;
-        free(ptr);ptr=NULL;
+        if(flag != CL_SUCCESS){
+            // If the data was being sent the client has been already
+            // disconnected
+            if(*clientfd < 0){
+                free(event); event=NULL;
+                VERBOSE_OUT(flag);
+                return 1;
+            }
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            free(event); event=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
         // Mark the work as done
         event->status = CL_COMPLETE;
         if(want_event != CL_TRUE){
@@ -2640,12 +2785,21 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
     }
     // ------------------------------------------------------------
     // Asynchronous read case:
-    // We relay the complexz work to a submethod.
+    // We relay the complexz work to a submethod, which sends the
+    // data inline for the small transfers.
     // ------------------------------------------------------------
-    flag = oclandEnqueueReadBuffer(clientfd,command_queue,memobj,
-                                   offset,cb,ptr,
-                                   num_events_in_wait_list,event_wait_list,
-                                   want_event, event);
+    if(blocking_read == OCLAND_INLINE_TRANSFER){
+        flag = oclandEnqueueReadInline(clientfd,command_queue,memobj,
+                                       offset,cb,
+                                       num_events_in_wait_list,event_wait_list,
+                                       want_event, event);
+    }
+    else{
+        flag = oclandEnqueueReadBuffer(clientfd,command_queue,memobj,
+                                       offset,cb,
+                                       num_events_in_wait_list,event_wait_list,
+                                       want_event, event);
+    }
     if(flag != CL_SUCCESS){
         msgSize  = sizeof(cl_int);
         msg      = (void*)malloc(msgSize);
@@ -2655,7 +2809,6 @@ int ocland_clEnqueueReadBuffer(int* clientfd, char* buffer, validator v, void* d
         Send(clientfd, msg, msgSize, 0);
         free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        free(ptr); ptr=NULL;
         free(event); event=NULL;
         VERBOSE_OUT(flag);
         return 1;
@@ -2683,7 +2836,6 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
     ocland_event *event_wait_list = NULL;
     cl_bool want_event;
     cl_int flag;
-    void* ptr = NULL;
     ocland_event event = NULL;
     size_t msgSize = 0;
     void *msg = NULL, *mptr = NULL;
@@ -2768,9 +2920,8 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
         return 1;
     }
     // Build required objects
-    ptr   = malloc(cb);
     event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if( (!ptr) || (!event) ){
+    if(!event){
         flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
         msgSize  = sizeof(cl_int);
         msg      = (void*)malloc(msgSize);
@@ -2788,6 +2939,47 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
     event->context       = context;
     event->command_queue = command_queue;
     // ------------------------------------------------------------
+    // Inline asynchronous write case:
+    // The data is already in the package, so we can enqueue the
+    // write without waiting for it.
+    // ------------------------------------------------------------
+    if((blocking_write == OCLAND_INLINE_TRANSFER) && (!v->pending)){
+        flag = oclandEnqueueWriteInline(command_queue,memobj,offset,cb,data,
+                                        num_events_in_wait_list,event_wait_list,
+                                        want_event,event);
+        if(flag != CL_SUCCESS){
+            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            free(event); event=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        // Return the package
+        msgSize  = sizeof(cl_int);          // flag
+        msgSize += sizeof(ocland_event);    // event
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+        ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        // The event status is set by oclandEnqueueWriteInline
+        if(want_event == CL_TRUE){
+            registerEvent(v,event);
+        }
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    if(blocking_write == OCLAND_INLINE_TRANSFER)
+        blocking_write = CL_TRUE;
+    // ------------------------------------------------------------
     // Blocking write case:
     // We simply decript the data from the package received, and
     // call OpenCL to transfer the data.
@@ -2800,12 +2992,26 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
             oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
             free(event_wait_list); event_wait_list=NULL;
         }
-        // Decript the data from the received package
-        memcpy(ptr, data, cb);
-        // Write the data
-        flag = clEnqueueWriteBuffer(command_queue,memobj,blocking_write,
-                                   offset,cb,ptr,
-                                   0,NULL,&(event->event));
+        // Write the data straight from the received package. The
+        // data exceeding OCLAND_MAX_MESSAGE_SIZE is still pending in
+        // the socket, and will be streamed to the buffer
+        size_t pending = v->pending;
+        if(pending >= cb)
+            flag = CL_INVALID_VALUE;
+        else
+            flag = clEnqueueWriteBuffer(command_queue,memobj,blocking_write,
+                                        offset,cb - pending,data,
+                                        0,NULL,&(event->event));
+        if((flag == CL_SUCCESS) && pending){
+            clReleaseEvent(event->event); event->event = NULL;
+            flag = oclandRecvBuffer(clientfd,NULL,command_queue,memobj,
+                                    offset + cb - pending,pending,
+                                    &(event->event));
+            v->pending = 0;
+            if((flag != CL_SUCCESS) && event->event){
+                clReleaseEvent(event->event); event->event = NULL;
+            }
+        }
         if(flag != CL_SUCCESS){
             msgSize  = sizeof(cl_int);
             msg      = (void*)malloc(msgSize);
@@ -2815,7 +3021,6 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
             Send(clientfd, msg, msgSize, 0);
             free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            free(ptr); ptr=NULL;
             free(event); event=NULL;
             VERBOSE_OUT(flag);
             return 1;
@@ -2831,7 +3036,6 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
         Send(clientfd, msg, msgSize, 0);
         free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        free(ptr); ptr=NULL;
         // Mark the work as done
         event->status = CL_COMPLETE;
         if(want_event != CL_TRUE){
@@ -2848,7 +3052,7 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
     // We relay the complex work to a submethod.
     // ------------------------------------------------------------
     flag = oclandEnqueueWriteBuffer(clientfd,command_queue,memobj,
-                                    offset,cb,ptr,
+                                    offset,cb,
                                     num_events_in_wait_list,event_wait_list,
                                     want_event, event);
     if(flag != CL_SUCCESS){
@@ -2860,7 +3064,6 @@ int ocland_clEnqueueWriteBuffer(int* clientfd, char* buffer, validator v, void*
         Send(clientfd, msg, msgSize, 0);
         free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        free(ptr); ptr=NULL;
         free(event); event=NULL;
         VERBOSE_OUT(flag);
         return 1;
@@ -3911,17 +4114,18 @@ int ocland_clEnqueueReadImage(int* clientfd, char* buffer, validator v, void* da
             VERBOSE_OUT(flag);
             return 1;
         }
-        // Return the package
+        // Return the package, sending the data after the header
+        // instead of copying it into the message
         msgSize  = sizeof(cl_int);          // flag
         msgSize += sizeof(ocland_event);    // event
         msgSize += cb;                      // ptr
-        msg      = (void*)malloc(msgSize);
+        msg      = (void*)malloc(msgSize - cb);
         mptr     = msg;
         ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
         ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
-        memcpy(mptr, ptr, cb);
         Send(clientfd, &msgSize, sizeof(size_t), 0);
-        Send(clientfd, msg, msgSize, 0);
+        Send(clientfd, msg, msgSize - cb, 0);
+        Send(clientfd, ptr, cb, 0);
         free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
         free(ptr); ptr=NULL;
@@ -4088,9 +4292,11 @@ int ocland_clEnqueueWriteImage(int* clientfd, char* buffer, validator v, void* d
         return 1;
     }
     size_t cb = region[2]*slice_pitch + region[1]*row_pitch + region[0]*element_size;
-    ptr       = malloc(cb);
+    // Only the asynchronous transfer needs a host copy of the data
+    if(blocking_write != CL_TRUE)
+        ptr   = malloc(cb);
     event     = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if( (!ptr) || (!event) ){
+    if( ((blocking_write != CL_TRUE) && (!ptr)) || (!event) ){
         flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
         msgSize  = sizeof(cl_int);
         msg      = (void*)malloc(msgSize);
@@ -4120,13 +4326,29 @@ int ocland_clEnqueueWriteImage(int* clientfd, char* buffer, validator v, void* d
             oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
             free(event_wait_list); event_wait_list=NULL;
         }
-        // Decript the data from the received package
-        memcpy(ptr, data, cb);
-        // Write the data
-        flag = clEnqueueWriteImage(command_queue,memobj,blocking_write,
+        // Write the data straight from the received package. The
+        // data exceeding OCLAND_MAX_MESSAGE_SIZE is still pending in
+        // the socket, and will be streamed to the image
+        if(v->pending >= cb){
+            flag = CL_INVALID_VALUE;
+        }
+        else if(v->pending){
+            flag = oclandRecvImage(clientfd,NULL,command_queue,memobj,
                                    origin,region,
-                                   row_pitch,slice_pitch,ptr,
-                                   0,NULL,&(event->event));
+                                   row_pitch,slice_pitch,
+                                   data,cb - v->pending,cb,
+                                   &(event->event));
+            v->pending = 0;
+            if((flag != CL_SUCCESS) && event->event){
+                clReleaseEvent(event->event); event->event = NULL;
+            }
+        }
+        else{
+            flag = clEnqueueWriteImage(command_queue,memobj,blocking_write,
+                                       origin,region,
+                                       row_pitch,slice_pitch,data,
+                                       0,NULL,&(event->event));
+        }
         if(flag != CL_SUCCESS){
             msgSize  = sizeof(cl_int);
             msg      = (void*)malloc(msgSize);
@@ -4237,11 +4459,32 @@ int ocland_clCreateImage2D(int* clientfd, char* buffer, validator v, void* data)
         VERBOSE_OUT(flag);
         return 1;
     }
-    // Create the command queue
-    memobj = clCreateImage2D(context, flags, &image_format,
-                             image_width, image_height,
-                             image_row_pitch,
-                             host_ptr, &flag);
+    // Create the memory object
+    if(hasPtr && v->pending){
+        // The host data exceeds OCLAND_MAX_MESSAGE_SIZE, so the image
+        // is created empty and filled streaming the data from the socket
+        size_t region[3] = {image_width, image_height, 1};
+        flag = CL_INVALID_VALUE;
+        if(flags & CL_MEM_COPY_HOST_PTR){
+            memobj = clCreateImage2D(context, flags & ~CL_MEM_COPY_HOST_PTR,
+                                     &image_format,
+                                     image_width, image_height, 0,
+                                     NULL, &flag);
+        }
+        if(flag == CL_SUCCESS){
+            flag = fillImageStreamed(clientfd, v, context, memobj, region,
+                                     image_row_pitch, 0, host_ptr);
+            if(flag != CL_SUCCESS){
+                clReleaseMemObject(memobj); memobj = NULL;
+            }
+        }
+    }
+    else{
+        memobj = clCreateImage2D(context, flags, &image_format,
+                                 image_width, image_height,
+                                 image_row_pitch,
+                                 host_ptr, &flag);
+    }
     if(flag == CL_SUCCESS){
         registerBuffer(v, memobj);
     }
@@ -4303,11 +4546,33 @@ int ocland_clCreateImage3D(int* clientfd, char* buffer, validator v, void* data)
         VERBOSE_OUT(flag);
         return 1;
     }
-    // Create the command queue
-    memobj = clCreateImage3D(context, flags, &image_format,
-                             image_width, image_height,image_depth,
-                             image_row_pitch,image_slice_pitch,
-                             host_ptr, &flag);
+    // Create the memory object
+    if(hasPtr && v->pending){
+        // The host data exceeds OCLAND_MAX_MESSAGE_SIZE, so the image
+        // is created empty and filled streaming the data from the socket
+        size_t region[3] = {image_width, image_height, image_depth};
+        flag = CL_INVALID_VALUE;
+        if(flags & CL_MEM_COPY_HOST_PTR){
+            memobj = clCreateImage3D(context, flags & ~CL_MEM_COPY_HOST_PTR,
+                                     &image_format,
+                                     image_width, image_height, image_depth,
+                                     0, 0, NULL, &flag);
+        }
+        if(flag == CL_SUCCESS){
+            flag = fillImageStreamed(clientfd, v, context, memobj, region,
+                                     image_row_pitch, image_slice_pitch,
+                                     host_ptr);
+            if(flag != CL_SUCCESS){
+                clReleaseMemObject(memobj); memobj = NULL;
+            }
+        }
+    }
+    else{
+        memobj = clCreateImage3D(context, flags, &image_format,
+                                 image_width, image_height,image_depth,
+                                 image_row_pitch,image_slice_pitch,
+                                 host_ptr, &flag);
+    }
     if(flag == CL_SUCCESS){
         registerBuffer(v, memobj);
     }
@@ -4540,14 +4805,12 @@ int ocland_clSetUserEventStatus(int* clientfd, char* buffer, validator v, void*
     return 1;
 }
 
-int ocland_clEnqueueReadBufferRect(int* clientfd, char* buffer, validator v)
+int ocland_clEnqueueReadBufferRect(int* clientfd, char* buffer, validator v, void* data)
 {
     VERBOSE_IN();
     unsigned int i;
-    cl_int flag;
-    // Get parameters.
-    cl_command_queue command_queue;
     cl_context context;
+    cl_command_queue command_queue;
     cl_mem mem;
     cl_bool blocking_read;
     size_t buffer_origin[3];
@@ -4555,200 +4818,226 @@ int ocland_clEnqueueReadBufferRect(int* clientfd, char* buffer, validator v)
     size_t region[3];
     size_t buffer_row_pitch;
     size_t buffer_slice_pitch;
-    size_t host_row_pitch;
-    size_t host_slice_pitch;
-    void *ptr = NULL;
     cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
     cl_bool want_event;
+    cl_int flag;
+    void* ptr = NULL;
     ocland_event event = NULL;
-    ocland_event *event_wait_list = NULL;
-    cl_event *cl_event_wait_list = NULL;
-    Recv(clientfd, &command_queue, sizeof(cl_command_queue), MSG_WAITALL);
-    Recv(clientfd, &mem, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, &blocking_read, sizeof(cl_bool), MSG_WAITALL);
-    Recv(clientfd, buffer_origin, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, region, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &buffer_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &buffer_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &host_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &host_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &num_events_in_wait_list, sizeof(cl_uint), MSG_WAITALL);
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue      = ((cl_command_queue*)data)[0];   data = (cl_command_queue*)data + 1;
+    mem                = ((cl_mem*)data)[0];             data = (cl_mem*)data + 1;
+    blocking_read      = ((cl_bool*)data)[0];            data = (cl_bool*)data + 1;
+    memcpy((void*)buffer_origin,data,3*sizeof(size_t)); data = (size_t*)data + 3;
+    memcpy((void*)region,data,3*sizeof(size_t));        data = (size_t*)data + 3;
+    buffer_row_pitch   = ((size_t*)data)[0];             data = (size_t*)data + 1;
+    buffer_slice_pitch = ((size_t*)data)[0];             data = (size_t*)data + 1;
+    want_event         = ((cl_bool*)data)[0];            data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0];      data = (cl_uint*)data + 1;
     if(num_events_in_wait_list){
-        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list*sizeof(ocland_event));
-        cl_event_wait_list = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
-        Recv(clientfd, &event_wait_list, num_events_in_wait_list*sizeof(ocland_event), MSG_WAITALL);
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
     }
-    Recv(clientfd, &want_event, sizeof(cl_bool), MSG_WAITALL);
-    // Ensure that objects are valid
+    // Ensure that the objects are valid
     flag = isQueue(v, command_queue);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     flag = isBuffer(v, mem);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     for(i=0;i<num_events_in_wait_list;i++){
         flag = isEvent(v, event_wait_list[i]);
         if(flag != CL_SUCCESS){
-            flag = CL_INVALID_EVENT_WAIT_LIST;
-            Send(clientfd, &flag, sizeof(cl_int), 0);
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+            VERBOSE_OUT(flag);
             return 1;
         }
     }
     flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    if(flag == CL_SUCCESS){
+        struct _cl_version version = clGetCommandQueueVersion(command_queue);
+        if(     (version.major <  1)
+            || ((version.major == 1) && (version.minor < 1))){
+            // OpenCL < 1.1, so this function does not exist
+            flag = CL_INVALID_COMMAND_QUEUE;
+        }
+    }
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Try to allocate memory for objects
-    ptr   = malloc(region[0] + region[1]*host_row_pitch + region[2]*host_slice_pitch);
-    event = (ocland_event)malloc(sizeof(struct _ocland_event));
+    // Build required objects. Only the region is transferred, packed
+    // in the host memory, such that the buffer pitches are never sent
+    // through the network
+    size_t cb = region[0]*region[1]*region[2];
+    ptr       = malloc(cb);
+    event     = (ocland_event)malloc(sizeof(struct _ocland_event));
     if( (!ptr) || (!event) ){
         flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Set the event as uncompleted
     event->event         = NULL;
     event->status        = 1;
     event->context       = context;
     event->command_queue = command_queue;
-    // In case of blocking simply send the data.
-    // In rect reading process the data will send in
-    // blocks of host_row_pitch size, along all the
-    // region specified.
+    // ------------------------------------------------------------
+    // Blocking read case:
+    // We simply call to the read method to get the packed data
+    // and send it to the client.
+    // ------------------------------------------------------------
     if(blocking_read == CL_TRUE){
-        // We may wait manually for the events provided because
-        // OpenCL can only waits their events, but ocalnd event
-        // can be relevant. We will not check for errors, OpenCL
-        // will do it later
+        // We may wait manually for the events generated in
+        // ocland, and then we can let OpenCL to wait their
+        // self generated events.
         if(num_events_in_wait_list){
             oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
-            // Some OpenCL events can be stored after this method
-            // has been called, due to ocland event must be
-            // performed before, so we must look for now for
-            // invalid events, and set the final ones.
-            for(i=0;i<num_events_in_wait_list;i++){
-                if(!event_wait_list[i]->event){
-                    flag = CL_INVALID_EVENT_WAIT_LIST;
-                    Send(clientfd, &flag, sizeof(cl_int), 0);
-                    if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-                    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-                    return 1;
-                }
-                cl_event_wait_list[i] = event_wait_list[i]->event;
-            }
-        }
-
-        struct _cl_version version = clGetCommandQueueVersion(command_queue);
-        if(     (version.major <  1)
-            || ((version.major == 1) && (version.minor < 1))){
-            // OpenCL < 1.1, so this function does not exist
-            flag = CL_INVALID_COMMAND_QUEUE;
-        }
-        else{
-            flag = clEnqueueReadBufferRect(command_queue, mem, blocking_read,
-                                           buffer_origin, host_origin, region,
-                                           buffer_row_pitch, buffer_slice_pitch,
-                                           host_row_pitch, host_slice_pitch,
-                                           ptr, num_events_in_wait_list,
-                                           cl_event_wait_list, &(event->event));
+            free(event_wait_list); event_wait_list=NULL;
         }
-
-        // Return the flag, and the event if requested
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        // Read the data
+        flag = clEnqueueReadBufferRect(command_queue,mem,blocking_read,
+                                       buffer_origin,host_origin,region,
+                                       buffer_row_pitch,buffer_slice_pitch,
+                                       region[0],region[0]*region[1],ptr,
+                                       0,NULL,&(event->event));
         if(flag != CL_SUCCESS){
-            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-            return 1;
-        }
-        if(want_event == CL_TRUE){
-            Send(clientfd, &event, sizeof(ocland_event), 0);
-            registerEvent(v, event);
-        }
-        unsigned int j, k, n;
-        size_t buffsize = BUFF_SIZE*sizeof(char);
-        Send(clientfd, &buffsize, sizeof(size_t), 0);
-        // Compute the number of packages needed
-        n = host_row_pitch / buffsize;
-        // Send the rows
-        size_t origin = 0;
-        for(j=0;j<region[1];j++){
-            for(k=0;k<region[2];k++){
-                // Send package by pieces
-                for(i=0;i<n;i++){
-                    Send(clientfd, ptr + i*buffsize + origin, buffsize, 0);
-                }
-                if(host_row_pitch % buffsize){
-                    // Remains some data to arrive
-                    Send(clientfd, ptr + n*buffsize + origin, host_row_pitch % buffsize, 0);
-                }
-                // Compute the new origin
-                origin += host_row_pitch;
-            }
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+            free(ptr); ptr=NULL;
+            free(event); event=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
         }
-        // Mark work as done
+        // Return the package, sending the data after the header
+        // instead of copying it into the message
+        msgSize  = sizeof(cl_int);          // flag
+        msgSize += sizeof(ocland_event);    // event
+        msgSize += cb;                      // ptr
+        msg      = (void*)malloc(msgSize - cb);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+        ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize - cb, 0);
+        Send(clientfd, ptr, cb, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        // Mark the work as done
         event->status = CL_COMPLETE;
-        // Clean up
         if(want_event != CL_TRUE){
             free(event); event = NULL;
         }
-        free(ptr); ptr = NULL;
-        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        else{
+            registerEvent(v,event);
+        }
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // In the non blocking case we will work in a parallel thread,
-    // including the calling to clEnqueueReadBufferRect method.
-    struct _cl_version version = clGetCommandQueueVersion(command_queue);
-    if(     (version.major <  1)
-        || ((version.major == 1) && (version.minor < 1))){
-        // OpenCL < 1.1, so this function does not exist
-        flag = CL_INVALID_COMMAND_QUEUE;
-    }
-    else{
-        flag = oclandEnqueueReadBufferRect(clientfd,command_queue,mem,
-                                           buffer_origin,region,
-                                           buffer_row_pitch,buffer_slice_pitch,
-                                           host_row_pitch,host_slice_pitch,
-                                           ptr,num_events_in_wait_list,event_wait_list,
-                                           want_event, event);
-    }
-
+    // ------------------------------------------------------------
+    // Asynchronous read case:
+    // We relay the complex work to a submethod.
+    // ------------------------------------------------------------
+    flag = oclandEnqueueReadBufferRect(clientfd,command_queue,mem,
+                                       buffer_origin,region,
+                                       buffer_row_pitch,buffer_slice_pitch,
+                                       ptr,
+                                       num_events_in_wait_list,event_wait_list,
+                                       want_event, event);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
     }
-    else{
-        if(want_event == CL_TRUE){
-            registerEvent(v, event);
-        }
+    // We can't mark the work as done, or destroy the event
+    // becuase oclandEnqueueReadBufferRect needs it
+    if(want_event == CL_TRUE){
+        registerEvent(v, event);
     }
-    // event and event_wait_list must be destroyed by thread
-    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+    VERBOSE_OUT(flag);
     return 1;
 }
 
-int ocland_clEnqueueWriteBufferRect(int* clientfd, char* buffer, validator v)
+int ocland_clEnqueueWriteBufferRect(int* clientfd, char* buffer, validator v, void* data)
 {
     VERBOSE_IN();
     unsigned int i;
-    cl_int flag;
-    // Get parameters.
-    cl_command_queue command_queue;
     cl_context context;
+    cl_command_queue command_queue;
     cl_mem mem;
     cl_bool blocking_write;
     size_t buffer_origin[3];
@@ -4756,322 +5045,413 @@ int ocland_clEnqueueWriteBufferRect(int* clientfd, char* buffer, validator v)
     size_t region[3];
     size_t buffer_row_pitch;
     size_t buffer_slice_pitch;
-    size_t host_row_pitch;
-    size_t host_slice_pitch;
-    void *ptr = NULL;
     cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
     cl_bool want_event;
+    cl_int flag;
+    void* ptr = NULL;
     ocland_event event = NULL;
-    ocland_event *event_wait_list = NULL;
-    cl_event *cl_event_wait_list = NULL;
-    Recv(clientfd, &command_queue, sizeof(cl_command_queue), MSG_WAITALL);
-    Recv(clientfd, &mem, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, &blocking_write, sizeof(cl_bool), MSG_WAITALL);
-    Recv(clientfd, buffer_origin, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, region, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &buffer_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &buffer_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &host_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &host_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &num_events_in_wait_list, sizeof(cl_uint), MSG_WAITALL);
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue      = ((cl_command_queue*)data)[0];   data = (cl_command_queue*)data + 1;
+    mem                = ((cl_mem*)data)[0];             data = (cl_mem*)data + 1;
+    blocking_write     = ((cl_bool*)data)[0];            data = (cl_bool*)data + 1;
+    memcpy((void*)buffer_origin,data,3*sizeof(size_t)); data = (size_t*)data + 3;
+    memcpy((void*)region,data,3*sizeof(size_t));        data = (size_t*)data + 3;
+    buffer_row_pitch   = ((size_t*)data)[0];             data = (size_t*)data + 1;
+    buffer_slice_pitch = ((size_t*)data)[0];             data = (size_t*)data + 1;
+    want_event         = ((cl_bool*)data)[0];            data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0];      data = (cl_uint*)data + 1;
     if(num_events_in_wait_list){
-        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list*sizeof(ocland_event));
-        cl_event_wait_list = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
-        Recv(clientfd, &event_wait_list, num_events_in_wait_list*sizeof(ocland_event), MSG_WAITALL);
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
+        data = (ocland_event*)data + num_events_in_wait_list;
     }
-    Recv(clientfd, &want_event, sizeof(cl_bool), MSG_WAITALL);
-    // Ensure that objects are valid
+    // Ensure that the objects are valid
     flag = isQueue(v, command_queue);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     flag = isBuffer(v, mem);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     for(i=0;i<num_events_in_wait_list;i++){
         flag = isEvent(v, event_wait_list[i]);
         if(flag != CL_SUCCESS){
-            flag = CL_INVALID_EVENT_WAIT_LIST;
-            Send(clientfd, &flag, sizeof(cl_int), 0);
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+            VERBOSE_OUT(flag);
             return 1;
         }
     }
     flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    if(flag == CL_SUCCESS){
+        struct _cl_version version = clGetCommandQueueVersion(command_queue);
+        if(     (version.major <  1)
+            || ((version.major == 1) && (version.minor < 1))){
+            // OpenCL < 1.1, so this function does not exist
+            flag = CL_INVALID_COMMAND_QUEUE;
+        }
+    }
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Try to allocate memory for objects
-    ptr   = malloc(region[0] + region[1]*host_row_pitch + region[2]*host_slice_pitch);
-    event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if( (!ptr) || (!event) ){
+    // Build required objects. The region is received packed, such
+    // that the buffer pitches are never sent through the network.
+    // The blocking write only needs a host copy of the data if part
+    // of it is still pending in the socket
+    size_t cb = region[0]*region[1]*region[2];
+    if((blocking_write != CL_TRUE) || v->pending)
+        ptr   = malloc(cb);
+    event     = (ocland_event)malloc(sizeof(struct _ocland_event));
+    if( (((blocking_write != CL_TRUE) || v->pending) && (!ptr)) || (!event) ){
         flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Set the event as uncompleted
     event->event         = NULL;
     event->status        = 1;
     event->context       = context;
     event->command_queue = command_queue;
-    // Send a first flag and the event before continue working
-    flag = CL_SUCCESS;
-    Send(clientfd, &flag, sizeof(cl_int), 0);
-    if(want_event == CL_TRUE){
-        Send(clientfd, &event, sizeof(ocland_event), 0);
-        registerEvent(v, event);
-    }
-    // In case of blocking simply proceed in the natural way
+    // ------------------------------------------------------------
+    // Blocking write case:
+    // We simply decript the data from the package received, and
+    // call OpenCL to transfer the data.
+    // ------------------------------------------------------------
     if(blocking_write == CL_TRUE){
-        unsigned int j, k, n;
-        size_t buffsize = BUFF_SIZE*sizeof(char);
-        Send(clientfd, &buffsize, sizeof(size_t), 0);
-        // Compute the number of packages needed
-        n = host_row_pitch / buffsize;
-        // Receive the rows
-        size_t origin = 0;
-        for(j=0;j<region[1];j++){
-            for(k=0;k<region[2];k++){
-                // Receive package by pieces
-                for(i=0;i<n;i++){
-                    Recv(clientfd, ptr + i*buffsize + origin, buffsize, MSG_WAITALL);
-                }
-                if(host_row_pitch % buffsize){
-                    // Remains some data to arrive
-                    Recv(clientfd, ptr + n*buffsize + origin, host_row_pitch % buffsize, MSG_WAITALL);
-                }
-                // Compute the new origin
-                origin += host_row_pitch;
-            }
+        // The data exceeding OCLAND_MAX_MESSAGE_SIZE is still pending
+        // in the socket, so it is gathered with the received one
+        if(v->pending >= cb){
+            flag = CL_INVALID_VALUE;
+        }
+        else if(v->pending){
+            memcpy(ptr, data, cb - v->pending);
+            if(RecvStream(clientfd, NULL, (char*)ptr + cb - v->pending, v->pending) <= 0)
+                flag = CL_OUT_OF_RESOURCES;
+            v->pending = 0;
+            data = ptr;
         }
-        // We may wait manually for the events provided because
-        // OpenCL can only waits their events, but ocalnd event
-        // can be relevant. We will not check for errors, OpenCL
-        // will do it later
+        // We may wait manually for the events generated in
+        // ocland, and then we can let OpenCL to wait their
+        // self generated events.
         if(num_events_in_wait_list){
             oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
-            // Some OpenCL events can be stored after this method
-            // has been called, due to ocland event must be
-            // performed before, so we must look for now for
-            // invalid events, and set the final ones.
-            for(i=0;i<num_events_in_wait_list;i++){
-                if(!event_wait_list[i]->event){
-                    flag = CL_INVALID_EVENT_WAIT_LIST;
-                    Send(clientfd, &flag, sizeof(cl_int), 0);
-                    if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-                    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-                    return 1;
-                }
-                cl_event_wait_list[i] = event_wait_list[i]->event;
-            }
+            free(event_wait_list); event_wait_list=NULL;
         }
-
-        struct _cl_version version = clGetCommandQueueVersion(command_queue);
-        if(     (version.major <  1)
-            || ((version.major == 1) && (version.minor < 1))){
-            // OpenCL < 1.1, so this function does not exist
-            flag = CL_INVALID_COMMAND_QUEUE;
+        if(flag == CL_SUCCESS){
+            flag = clEnqueueWriteBufferRect(command_queue,mem,blocking_write,
+                                            buffer_origin,host_origin,region,
+                                            buffer_row_pitch,buffer_slice_pitch,
+                                            region[0],region[0]*region[1],data,
+                                            0,NULL,&(event->event));
         }
-        else{
-            flag = clEnqueueWriteBufferRect(command_queue, mem, blocking_write,
-                                            buffer_origin, host_origin, region,
-                                            buffer_row_pitch, buffer_slice_pitch,
-                                            host_row_pitch, host_slice_pitch,
-                                            ptr, num_events_in_wait_list,
-                                            cl_event_wait_list, &(event->event));
+        if(flag != CL_SUCCESS){
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+            free(ptr); ptr=NULL;
+            free(event); event=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
         }
-
-        // Mark work as done
-        event->status = CL_COMPLETE;
-        free(ptr); ptr = NULL;
+        // Return the package
+        msgSize  = sizeof(cl_int);          // flag
+        msgSize += sizeof(ocland_event);    // event
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+        ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        // Mark the work as done
+        event->status = CL_COMPLETE;
         if(want_event != CL_TRUE){
             free(event); event = NULL;
         }
-        // Return the flag
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        else{
+            registerEvent(v,event);
+        }
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // In the non blocking case we will work in a parallel thread,
-    // including the calling to clEnqueueReadBuffer method.
-    struct _cl_version version = clGetCommandQueueVersion(command_queue);
-    if(     (version.major <  1)
-        || ((version.major == 1) && (version.minor < 1))){
-        // OpenCL < 1.1, so this function does not exist
-        flag = CL_INVALID_COMMAND_QUEUE;
-    }
-    else{
-        flag = oclandEnqueueWriteBufferRect(clientfd,command_queue,mem,
-                                            buffer_origin,region,
-                                            buffer_row_pitch,buffer_slice_pitch,
-                                            host_row_pitch,host_slice_pitch,
-                                            ptr,num_events_in_wait_list,event_wait_list,
-                                            want_event, event);
-    }
+    // ------------------------------------------------------------
+    // Asynchronous write case:
+    // We relay the complex work to a submethod.
+    // ------------------------------------------------------------
+    flag = oclandEnqueueWriteBufferRect(clientfd,command_queue,mem,
+                                        buffer_origin,region,
+                                        buffer_row_pitch,buffer_slice_pitch,
+                                        ptr,
+                                        num_events_in_wait_list,event_wait_list,
+                                        want_event, event);
     if(flag != CL_SUCCESS){
-        event->status = CL_COMPLETE;
-    }
-    // event and event_wait_list must be destroyed by thread
-    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-    return 1;
-}
-
-int ocland_clEnqueueCopyBufferRect(int* clientfd, char* buffer, validator v)
-{
-    VERBOSE_IN();
-    unsigned int i;
-    cl_int flag;
-    // Get parameters.
-    cl_command_queue command_queue;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(ptr); ptr=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // We can't mark the work as done, or destroy the event
+    // because oclandEnqueueWriteBufferRect needs it
+    if(want_event == CL_TRUE){
+        registerEvent(v, event);
+    }
+    VERBOSE_OUT(flag);
+    return 1;
+}
+
+int ocland_clEnqueueCopyBufferRect(int* clientfd, char* buffer, validator v, void* data)
+{
+    VERBOSE_IN();
+    unsigned int i;
     cl_context context;
+    cl_command_queue command_queue;
     cl_mem src_buffer;
     cl_mem dst_buffer;
     size_t src_origin[3];
-    size_t dst_origin[3] = {0, 0, 0};
+    size_t dst_origin[3];
     size_t region[3];
     size_t src_row_pitch;
     size_t src_slice_pitch;
     size_t dst_row_pitch;
     size_t dst_slice_pitch;
     cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
     cl_bool want_event;
+    cl_int flag;
     ocland_event event = NULL;
-    ocland_event *event_wait_list = NULL;
-    cl_event *cl_event_wait_list = NULL;
-    Recv(clientfd, &command_queue, sizeof(cl_command_queue), MSG_WAITALL);
-    Recv(clientfd, &src_buffer, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, &dst_buffer, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, src_origin, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, dst_origin, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, region, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &src_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &src_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &dst_row_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &dst_slice_pitch, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &num_events_in_wait_list, sizeof(cl_uint), MSG_WAITALL);
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue   = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    src_buffer      = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    dst_buffer      = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    memcpy((void*)src_origin,data,3*sizeof(size_t)); data = (size_t*)data + 3;
+    memcpy((void*)dst_origin,data,3*sizeof(size_t)); data = (size_t*)data + 3;
+    memcpy((void*)region,data,3*sizeof(size_t));     data = (size_t*)data + 3;
+    src_row_pitch   = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    src_slice_pitch = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    dst_row_pitch   = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    dst_slice_pitch = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    want_event      = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0];  data = (cl_uint*)data + 1;
     if(num_events_in_wait_list){
-        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list*sizeof(ocland_event));
-        cl_event_wait_list = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
-        Recv(clientfd, &event_wait_list, num_events_in_wait_list*sizeof(ocland_event), MSG_WAITALL);
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
     }
-    Recv(clientfd, &want_event, sizeof(cl_bool), MSG_WAITALL);
-    // Ensure that objects are valid
+    // Ensure that the objects are valid
     flag = isQueue(v, command_queue);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-        return 1;
-    }
-    flag = isBuffer(v, src_buffer);
-    if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    flag = isBuffer(v, dst_buffer);
+    flag  = isBuffer(v, src_buffer);
+    flag |= isBuffer(v, dst_buffer);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     for(i=0;i<num_events_in_wait_list;i++){
         flag = isEvent(v, event_wait_list[i]);
         if(flag != CL_SUCCESS){
-            flag = CL_INVALID_EVENT_WAIT_LIST;
-            Send(clientfd, &flag, sizeof(cl_int), 0);
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+            VERBOSE_OUT(flag);
             return 1;
         }
     }
     flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    if(flag == CL_SUCCESS){
+        struct _cl_version version = clGetCommandQueueVersion(command_queue);
+        if(     (version.major <  1)
+            || ((version.major == 1) && (version.minor < 1))){
+            // OpenCL < 1.1, so this function does not exist
+            flag = CL_INVALID_COMMAND_QUEUE;
+        }
+    }
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Try to allocate memory for objects
+    // Build required objects
     event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if(!event){
-        flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-        Send(clientfd, &flag, sizeof(cl_int), 0);
+    if( !event ){
+        flag     = CL_OUT_OF_HOST_MEMORY;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Set the event as uncompleted
     event->event         = NULL;
     event->status        = 1;
     event->context       = context;
     event->command_queue = command_queue;
-    // We may wait manually for the events provided because
-    // OpenCL can only waits their events, but ocalnd event
-    // can be relevant. We will not check for errors, OpenCL
-    // will do it later
+    // We may wait manually for the events generated in
+    // ocland, and then we can let OpenCL to wait their
+    // self generated events.
     if(num_events_in_wait_list){
         oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
-        // Some OpenCL events can be stored after this method
-        // has been called, due to ocland event must be
-        // performed before, so we must look for now for
-        // invalid events, and set the final ones.
-        for(i=0;i<num_events_in_wait_list;i++){
-            if(!event_wait_list[i]->event){
-                flag = CL_INVALID_EVENT_WAIT_LIST;
-                Send(clientfd, &flag, sizeof(cl_int), 0);
-                if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-                if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-                return 1;
-            }
-            cl_event_wait_list[i] = event_wait_list[i]->event;
-        }
-    }
-
-    struct _cl_version version = clGetEventVersion(event->event);
-    if(     (version.major <  1)
-        || ((version.major == 1) && (version.minor < 1))){
-        // OpenCL < 1.1, so this function does not exist
-        flag = CL_INVALID_EVENT;
+        free(event_wait_list); event_wait_list=NULL;
     }
-    else{
-        flag = clEnqueueCopyBufferRect(command_queue, src_buffer, dst_buffer,
-                                        src_origin, dst_origin, region,
-                                        src_row_pitch, src_slice_pitch,
-                                        dst_row_pitch, dst_slice_pitch,
-                                        num_events_in_wait_list,
-                                        cl_event_wait_list, &(event->event));
+    // Copy the data
+    flag = clEnqueueCopyBufferRect(command_queue,src_buffer,dst_buffer,
+                                   src_origin,dst_origin,region,
+                                   src_row_pitch,src_slice_pitch,
+                                   dst_row_pitch,dst_slice_pitch,
+                                   0,NULL,&(event->event));
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
     }
-
-    // Mark work as done
-    event->status = CL_COMPLETE;
+    // Return the package
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
     if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+    // Mark the work as done
+    event->status = CL_COMPLETE;
     if(want_event != CL_TRUE){
         free(event); event = NULL;
     }
-    // Return the flag
-    Send(clientfd, &flag, sizeof(cl_int), 0);
-    if((flag== CL_SUCCESS) && (want_event == CL_TRUE)){
-        Send(clientfd, &event, sizeof(ocland_event), 0);
-        registerEvent(v, event);
+    else{
+        registerEvent(v,event);
     }
+    VERBOSE_OUT(flag);
     return 1;
 }
 
@@ -5222,9 +5602,49 @@ int ocland_clCreateImage(int* clientfd, char* buffer, validator v, void* data)
         VERBOSE_OUT(flag);
         return 1;
     }
-    // Create the command queue
-    memobj = clCreateImage(context, flags, &image_format,
-                           &image_desc, host_ptr, &flag);
+    // Create the memory object
+    if(hasPtr && v->pending){
+        // The host data exceeds OCLAND_MAX_MESSAGE_SIZE, so the image
+        // is created empty and filled streaming the data from the socket
+        cl_image_desc desc = image_desc;
+        size_t region[3] = {image_desc.image_width, 1, 1};
+        switch(image_desc.image_type){
+        case CL_MEM_OBJECT_IMAGE1D_ARRAY:
+            region[1] = image_desc.image_array_size;
+            break;
+        case CL_MEM_OBJECT_IMAGE2D:
+            region[1] = image_desc.image_height;
+            break;
+        case CL_MEM_OBJECT_IMAGE2D_ARRAY:
+            region[1] = image_desc.image_height;
+            region[2] = image_desc.image_array_size;
+            break;
+        case CL_MEM_OBJECT_IMAGE3D:
+            region[1] = image_desc.image_height;
+            region[2] = image_desc.image_depth;
+            break;
+        }
+        desc.image_row_pitch   = 0;
+        desc.image_slice_pitch = 0;
+        flag = CL_INVALID_VALUE;
+        if(flags & CL_MEM_COPY_HOST_PTR){
+            memobj = clCreateImage(context, flags & ~CL_MEM_COPY_HOST_PTR,
+                                   &image_format, &desc, NULL, &flag);
+        }
+        if(flag == CL_SUCCESS){
+            flag = fillImageStreamed(clientfd, v, context, memobj, region,
+                                     image_desc.image_row_pitch,
+                                     image_desc.image_slice_pitch,
+                                     host_ptr);
+            if(flag != CL_SUCCESS){
+                clReleaseMemObject(memobj); memobj = NULL;
+            }
+        }
+    }
+    else{
+        memobj = clCreateImage(context, flags, &image_format,
+                               &image_desc, host_ptr, &flag);
+    }
     if(flag == CL_SUCCESS){
         registerBuffer(v, memobj);
     }
@@ -5756,279 +6176,356 @@ int ocland_clGetKernelArgInfo(int* clientfd, char* buffer, validator v, void* da
     return 1;
 }
 
-int ocland_clEnqueueFillBuffer(int* clientfd, char* buffer, validator v)
+int ocland_clEnqueueFillBuffer(int* clientfd, char* buffer, validator v, void* data)
 {
     VERBOSE_IN();
     unsigned int i;
-    cl_int flag;
-    // Get parameters.
-    cl_command_queue command_queue;
     cl_context context;
+    cl_command_queue command_queue;
     cl_mem mem;
     size_t pattern_size;
-    void * pattern = NULL;
+    void *pattern = NULL;
     size_t offset;
     size_t cb;
     cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
     cl_bool want_event;
+    cl_int flag;
     ocland_event event = NULL;
-    ocland_event *event_wait_list = NULL;
-    cl_event *cl_event_wait_list = NULL;
-    Recv(clientfd, &command_queue, sizeof(cl_command_queue), MSG_WAITALL);
-    Recv(clientfd, &mem, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, &pattern_size, sizeof(size_t), MSG_WAITALL);
-    pattern = (void*)malloc(pattern_size);
-    Recv(clientfd, &pattern, pattern_size, MSG_WAITALL);
-    Recv(clientfd, &offset, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &cb, sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &num_events_in_wait_list, sizeof(cl_uint), MSG_WAITALL);
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    mem           = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    pattern_size  = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    pattern       = data;                          data = (char*)data + pattern_size;
+    offset        = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    cb            = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    want_event    = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0]; data = (cl_uint*)data + 1;
     if(num_events_in_wait_list){
-        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list*sizeof(ocland_event));
-        cl_event_wait_list = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
-        Recv(clientfd, &event_wait_list, num_events_in_wait_list*sizeof(ocland_event), MSG_WAITALL);
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
     }
-    Recv(clientfd, &want_event, sizeof(cl_bool), MSG_WAITALL);
-    // Ensure that objects are valid
+    // Ensure that the objects are valid
     flag = isQueue(v, command_queue);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(pattern) free(pattern); pattern=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     flag = isBuffer(v, mem);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(pattern) free(pattern); pattern=NULL;
-        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     for(i=0;i<num_events_in_wait_list;i++){
         flag = isEvent(v, event_wait_list[i]);
         if(flag != CL_SUCCESS){
-            flag = CL_INVALID_EVENT_WAIT_LIST;
-            Send(clientfd, &flag, sizeof(cl_int), 0);
-            if(pattern) free(pattern); pattern=NULL;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+            VERBOSE_OUT(flag);
             return 1;
         }
     }
     flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(pattern) free(pattern); pattern=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Try to allocate memory for objects
+    // Build required objects
     event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if(!event){
-        flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(pattern) free(pattern); pattern=NULL;
+    if( !event ){
+        flag     = CL_OUT_OF_HOST_MEMORY;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Set the event as uncompleted
     event->event         = NULL;
     event->status        = 1;
     event->context       = context;
     event->command_queue = command_queue;
-    // We may wait manually for the events provided because
-    // OpenCL can only waits their events, but ocalnd event
-    // can be relevant. We will not check for errors, OpenCL
-    // will do it later
+    // We may wait manually for the events generated in
+    // ocland, and then we can let OpenCL to wait their
+    // self generated events.
     if(num_events_in_wait_list){
         oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
-        // Some OpenCL events can be stored after this method
-        // has been called, due to ocland event must be
-        // performed before, so we must look now for
-        // invalid events, and set the final ones.
-        for(i=0;i<num_events_in_wait_list;i++){
-            if(!event_wait_list[i]->event){
-                flag = CL_INVALID_EVENT_WAIT_LIST;
-                Send(clientfd, &flag, sizeof(cl_int), 0);
-                if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-                if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-                return 1;
-            }
-            cl_event_wait_list[i] = event_wait_list[i]->event;
-        }
+        free(event_wait_list); event_wait_list=NULL;
     }
-
+    // Fill the buffer. The platforms lacking clEnqueueFillBuffer
+    // (OpenCL < 1.2) are filled from a staging memory in the server,
+    // such that only the pattern is sent through the network anyway
     struct _cl_version version = clGetCommandQueueVersion(command_queue);
     if(     (version.major <  1)
         || ((version.major == 1) && (version.minor < 2))){
-        // OpenCL < 1.2, so this function does not exist
-        flag = CL_INVALID_COMMAND_QUEUE;
+        flag = oclandEmulateFillBuffer(command_queue,mem,
+                                       pattern,pattern_size,
+                                       offset,cb,&(event->event));
     }
     else{
         flag = clEnqueueFillBuffer(command_queue,mem,
                                    pattern,pattern_size,
                                    offset,cb,
-                                   num_events_in_wait_list,
-                                   cl_event_wait_list,&(event->event));
+                                   0,NULL,&(event->event));
     }
-
-    // Mark work as done
-    event->status = CL_COMPLETE;
-    if(pattern) free(pattern); pattern=NULL;
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // Return the package
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
     if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+    // Mark the work as done
+    event->status = CL_COMPLETE;
     if(want_event != CL_TRUE){
         free(event); event = NULL;
     }
-    // Return the flag
-    Send(clientfd, &flag, sizeof(cl_int), 0);
-    // Return the event
-    if((flag == CL_SUCCESS) && (want_event == CL_TRUE)){
-        Send(clientfd, &event, sizeof(ocland_event), 0);
-        registerEvent(v, event);
+    else{
+        registerEvent(v,event);
     }
+    VERBOSE_OUT(flag);
     return 1;
 }
 
-int ocland_clEnqueueFillImage(int* clientfd, char* buffer, validator v)
+int ocland_clEnqueueFillImage(int* clientfd, char* buffer, validator v, void* data)
 {
     VERBOSE_IN();
     unsigned int i;
-    cl_int flag;
-    // Get parameters.
-    cl_command_queue command_queue;
     cl_context context;
+    cl_command_queue command_queue;
     cl_mem image;
     size_t fill_color_size;
-    void * fill_color = NULL;
+    cl_uint fill_color[4] = {0, 0, 0, 0};
     size_t origin[3];
     size_t region[3];
     cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
     cl_bool want_event;
+    cl_int flag;
     ocland_event event = NULL;
-    ocland_event *event_wait_list = NULL;
-    cl_event *cl_event_wait_list = NULL;
-    Recv(clientfd, &command_queue, sizeof(cl_command_queue), MSG_WAITALL);
-    Recv(clientfd, &image, sizeof(cl_mem), MSG_WAITALL);
-    Recv(clientfd, &fill_color_size, sizeof(size_t), MSG_WAITALL);
-    fill_color = (void*)malloc(fill_color_size);
-    Recv(clientfd, &fill_color, fill_color_size, MSG_WAITALL);
-    Recv(clientfd, origin, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, region, 3*sizeof(size_t), MSG_WAITALL);
-    Recv(clientfd, &num_events_in_wait_list, sizeof(cl_uint), MSG_WAITALL);
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue   = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    image           = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    fill_color_size = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    memcpy(fill_color, data, fill_color_size < sizeof(fill_color) ? fill_color_size : sizeof(fill_color));
+    data = (char*)data + fill_color_size;
+    memcpy((void*)origin,data,3*sizeof(size_t));     data = (size_t*)data + 3;
+    memcpy((void*)region,data,3*sizeof(size_t));     data = (size_t*)data + 3;
+    want_event      = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0];  data = (cl_uint*)data + 1;
     if(num_events_in_wait_list){
-        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list*sizeof(ocland_event));
-        cl_event_wait_list = (cl_event*)malloc(num_events_in_wait_list*sizeof(cl_event));
-        Recv(clientfd, &event_wait_list, num_events_in_wait_list*sizeof(ocland_event), MSG_WAITALL);
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
     }
-    Recv(clientfd, &want_event, sizeof(cl_bool), MSG_WAITALL);
-    // Ensure that objects are valid
+    // Ensure that the objects are valid
     flag = isQueue(v, command_queue);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(fill_color) free(fill_color); fill_color=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     flag = isBuffer(v, image);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(fill_color) free(fill_color); fill_color=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
     for(i=0;i<num_events_in_wait_list;i++){
         flag = isEvent(v, event_wait_list[i]);
         if(flag != CL_SUCCESS){
-            flag = CL_INVALID_EVENT_WAIT_LIST;
-            Send(clientfd, &flag, sizeof(cl_int), 0);
-            if(fill_color) free(fill_color); fill_color=NULL;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
             if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-            if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+            VERBOSE_OUT(flag);
             return 1;
         }
     }
     flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
     if(flag != CL_SUCCESS){
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(fill_color) free(fill_color); fill_color=NULL;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Try to allocate memory for objects
+    // Build required objects
     event = (ocland_event)malloc(sizeof(struct _ocland_event));
-    if(!event){
-        flag = CL_MEM_OBJECT_ALLOCATION_FAILURE;
-        Send(clientfd, &flag, sizeof(cl_int), 0);
-        if(fill_color) free(fill_color); fill_color=NULL;
+    if( !event ){
+        flag     = CL_OUT_OF_HOST_MEMORY;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
         if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-        if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
+        VERBOSE_OUT(flag);
         return 1;
     }
-    // Set the event as uncompleted
     event->event         = NULL;
     event->status        = 1;
     event->context       = context;
     event->command_queue = command_queue;
-    // We may wait manually for the events provided because
-    // OpenCL can only waits their events, but ocalnd event
-    // can be relevant. We will not check for errors, OpenCL
-    // will do it later
+    // We may wait manually for the events generated in
+    // ocland, and then we can let OpenCL to wait their
+    // self generated events.
     if(num_events_in_wait_list){
         oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
-        // Some OpenCL events can be stored after this method
-        // has been called, due to ocland event must be
-        // performed before, so we must look now for
-        // invalid events, and set the final ones.
-        for(i=0;i<num_events_in_wait_list;i++){
-            if(!event_wait_list[i]->event){
-                flag = CL_INVALID_EVENT_WAIT_LIST;
-                Send(clientfd, &flag, sizeof(cl_int), 0);
-                if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-                if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-                return 1;
-            }
-            cl_event_wait_list[i] = event_wait_list[i]->event;
-        }
+        free(event_wait_list); event_wait_list=NULL;
     }
-
+    // Fill the image. The platforms lacking clEnqueueFillImage
+    // (OpenCL < 1.2) are filled from a staging memory in the server
     struct _cl_version version = clGetCommandQueueVersion(command_queue);
     if(     (version.major <  1)
         || ((version.major == 1) && (version.minor < 2))){
-        // OpenCL < 1.2, so this function does not exist
-        flag = CL_INVALID_COMMAND_QUEUE;
+        flag = oclandEmulateFillImage(command_queue,image,
+                                      fill_color,origin,region,
+                                      &(event->event));
     }
     else{
         flag = clEnqueueFillImage(command_queue,image,
-                                  fill_color,
-                                  origin,region,
-                                  num_events_in_wait_list,
-                                  cl_event_wait_list,&(event->event));
-    }
-
-    // Mark work as done
-    event->status = CL_COMPLETE;
-    if(fill_color) free(fill_color); fill_color=NULL;
-    if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
-    if(cl_event_wait_list) free(cl_event_wait_list); cl_event_wait_list=NULL;
-    if(want_event != CL_TRUE){
-        free(event); event = NULL;
+                                  fill_color,origin,region,
+                                  0,NULL,&(event->event));
     }
-    // Return the flag
-    Send(clientfd, &flag, sizeof(cl_int), 0);
-    // Return the event
-    if((flag == CL_SUCCESS) && (want_event == CL_TRUE)){
-        Send(clientfd, &event, sizeof(ocland_event), 0);
-        registerEvent(v, event);
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
     }
-    return 1;
-}
+    // Return the package
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+    // Mark the work as done
+    event->status = CL_COMPLETE;
+    if(want_event != CL_TRUE){
+        free(event); event = NULL;
+    }
+    else{
+        registerEvent(v,event);
+    }
+    VERBOSE_OUT(flag);
+    return 1;
+}
 
 int ocland_clEnqueueMigrateMemObjects(int* clientfd, char* buffer, validator v)
 {
@@ -6385,3 +6882,509 @@ int ocland_clEnqueueBarrierWithWaitList(int* clientfd, char* buffer, validator v
     }
     return 1;
 }
+
+// ----------------------------------
+// ocland extensions
+// ----------------------------------
+/** Write the blocks of a delta upload, taking the data from the received
+ * package, and from the socket for the data exceeding
+ * OCLAND_MAX_MESSAGE_SIZE.
+ * @param clientfd Client connection socket.
+ * @param v Validator.
+ * @param command_queue Command queue.
+ * @param memobj Buffer to write.
+ * @param num_blocks Number of blocks.
+ * @param blocks Blocks, as pairs of offset and size.
+ * @param data Blocks data.
+ * @param event Returned event of the last write.
+ * @return CL_SUCCESS if the blocks are written, an error code otherwise.
+ */
+static cl_int writeBufferBlocks(int* clientfd, validator v,
+                                cl_command_queue command_queue, cl_mem memobj,
+                                cl_uint num_blocks, const size_t* blocks,
+                                void* data, cl_event* event)
+{
+    cl_uint i;
+    cl_int flag;
+    size_t mem_size, total = 0, avail, n;
+    flag = clGetMemObjectInfo(memobj, CL_MEM_SIZE, sizeof(size_t), &mem_size, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    for(i=0;i<num_blocks;i++){
+        if(    (!blocks[2*i + 1])
+            || (blocks[2*i] > mem_size)
+            || (blocks[2*i + 1] > mem_size - blocks[2*i])
+            || (blocks[2*i + 1] > (size_t)-1 - total))
+            return CL_INVALID_VALUE;
+        total += blocks[2*i + 1];
+    }
+    if(v->pending > total)
+        return CL_INVALID_VALUE;
+    avail = total - v->pending;
+    *event = NULL;
+    for(i=0;i<num_blocks;i++){
+        if(*event){
+            clReleaseEvent(*event); *event = NULL;
+        }
+        // Write the part of the block already received
+        n = blocks[2*i + 1] < avail ? blocks[2*i + 1] : avail;
+        if(n){
+            flag = clEnqueueWriteBuffer(command_queue, memobj, CL_FALSE,
+                                        blocks[2*i], n, data,
+                                        0, NULL, event);
+            if(flag != CL_SUCCESS)
+                break;
+            data   = (char*)data + n;
+            avail -= n;
+        }
+        // And stream the rest
+        if(n < blocks[2*i + 1]){
+            if(*event){
+                clReleaseEvent(*event); *event = NULL;
+            }
+            flag = oclandRecvBuffer(clientfd, NULL, command_queue, memobj,
+                                    blocks[2*i] + n, blocks[2*i + 1] - n,
+                                    event);
+            v->pending -= blocks[2*i + 1] - n;
+            if(flag != CL_SUCCESS)
+                break;
+        }
+    }
+    // The package data can't be released until the writes are done
+    if(flag == CL_SUCCESS)
+        flag = clFinish(command_queue);
+    if((flag != CL_SUCCESS) && *event){
+        clReleaseEvent(*event); *event = NULL;
+    }
+    return flag;
+}
+
+int ocland_clEnqueueWriteBufferBlocks(int* clientfd, char* buffer, validator v, void* data)
+{
+    VERBOSE_IN();
+    unsigned int i;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_mem memobj;
+    cl_bool want_event;
+    cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
+    cl_uint num_blocks;
+    size_t *blocks = NULL;
+    cl_int flag;
+    ocland_event event = NULL;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    memobj        = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    want_event    = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0]; data = (cl_uint*)data + 1;
+    event_wait_list = (ocland_event*)data;         data = (ocland_event*)data + num_events_in_wait_list;
+    num_blocks    = ((cl_uint*)data)[0];           data = (cl_uint*)data + 1;
+    blocks        = (size_t*)data;                 data = (size_t*)data + 2*num_blocks;
+    // Ensure that the objects are valid
+    flag = isQueue(v, command_queue);
+    if(flag == CL_SUCCESS)
+        flag = isBuffer(v, memobj);
+    for(i=0;(flag == CL_SUCCESS) && (i<num_events_in_wait_list);i++)
+        flag = isEvent(v, event_wait_list[i]);
+    if((flag == CL_SUCCESS) && (!num_blocks))
+        flag = CL_INVALID_VALUE;
+    if(flag == CL_SUCCESS)
+        flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    // Build required objects
+    if(flag == CL_SUCCESS){
+        event = (ocland_event)malloc(sizeof(struct _ocland_event));
+        if(!event)
+            flag = CL_OUT_OF_HOST_MEMORY;
+    }
+    if(flag == CL_SUCCESS){
+        event->event         = NULL;
+        event->status        = 1;
+        event->context       = context;
+        event->command_queue = command_queue;
+        // We may wait manually for the events generated in ocland
+        if(num_events_in_wait_list)
+            oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
+        flag = writeBufferBlocks(clientfd, v, command_queue, memobj,
+                                 num_blocks, blocks, data, &(event->event));
+    }
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event) free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // Return the package
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    // Mark the work as done
+    event->status = CL_COMPLETE;
+    if(want_event != CL_TRUE){
+        if(event->event) clReleaseEvent(event->event);
+        free(event); event = NULL;
+    }
+    else{
+        registerEvent(v,event);
+    }
+    VERBOSE_OUT(flag);
+    return 1;
+}
+
+/** Send the cache status of a deduplicated upload.
+ * @param clientfd Client connection socket.
+ * @param flag Error code.
+ * @param status Cache status.
+ */
+static void sendBlobStatus(int* clientfd, cl_int flag, cl_uint status)
+{
+    size_t msgSize = sizeof(cl_int) + sizeof(cl_uint);
+    char msg[sizeof(cl_int) + sizeof(cl_uint)];
+    void *mptr = msg;
+    ((cl_int*)mptr)[0]  = flag;   mptr = (cl_int*)mptr + 1;
+    ((cl_uint*)mptr)[0] = status;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+}
+
+/** Get the cache status of a deduplicated upload.
+ * @param hash SHA-256 digest of the data.
+ * @param size Size of the data.
+ * @param blob Returned blob if it is in the cache, NULL otherwise.
+ * @return Cache status.
+ */
+static cl_uint blobStatus(const unsigned char* hash, size_t size, ocland_blob* blob)
+{
+    *blob = getBlob(hash, size);
+    if(*blob)
+        return OCLAND_BLOB_HIT;
+    if(isBlobCacheable(size))
+        return OCLAND_BLOB_MISS;
+    return OCLAND_BLOB_UNCACHED;
+}
+
+int ocland_clCreateBufferBlob(int* clientfd, char* buffer, validator v, void* data)
+{
+    VERBOSE_IN();
+    cl_context context;
+    cl_mem_flags flags;
+    size_t size;
+    unsigned char *hash;
+    cl_int flag;
+    cl_uint status = OCLAND_BLOB_UNCACHED;
+    ocland_blob blob = NULL;
+    cl_mem memobj = NULL;
+    size_t msgSize = 0;
+    void *msg = NULL, *ptr = NULL;
+    // Decript the received data
+    context = ((cl_context*)data)[0];     data = (cl_context*)data + 1;
+    flags   = ((cl_mem_flags*)data)[0];   data = (cl_mem_flags*)data + 1;
+    size    = ((size_t*)data)[0];         data = (size_t*)data + 1;
+    hash    = (unsigned char*)data;
+    // Ensure that the context is valid, and look for the data
+    flag = isContext(v, context);
+    if((flag == CL_SUCCESS) && !(flags & CL_MEM_COPY_HOST_PTR))
+        flag = CL_INVALID_VALUE;
+    if(flag == CL_SUCCESS)
+        status = blobStatus(hash, size, &blob);
+    sendBlobStatus(clientfd, flag, status);
+    if((flag != CL_SUCCESS) || (status == OCLAND_BLOB_UNCACHED)){
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    if(status == OCLAND_BLOB_MISS)
+        flag = recvBlob(clientfd, hash, size, &blob);
+    // Create the memory object
+    if(flag == CL_SUCCESS)
+        memobj = clCreateBuffer(context, flags, size, blob->data, &flag);
+    releaseBlob(blob); blob = NULL;
+    if(flag == CL_SUCCESS){
+        registerBuffer(v, memobj);
+    }
+    // Return the package
+    msgSize  = sizeof(cl_int);  // flag
+    msgSize += sizeof(cl_mem);  // memobj
+    msg      = (void*)malloc(msgSize);
+    ptr      = msg;
+    ((cl_int*)ptr)[0] = flag; ptr = (cl_int*)ptr  + 1;
+    ((cl_mem*)ptr)[0] = memobj;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    VERBOSE_OUT(flag);
+    return 1;
+}
+
+int ocland_clEnqueueWriteBufferBlob(int* clientfd, char* buffer, validator v, void* data)
+{
+    VERBOSE_IN();
+    unsigned int i;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_mem memobj;
+    size_t offset;
+    size_t cb;
+    cl_bool want_event;
+    cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
+    unsigned char *hash;
+    cl_int flag;
+    cl_uint status = OCLAND_BLOB_UNCACHED;
+    ocland_blob blob = NULL;
+    ocland_event event = NULL;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    memobj        = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    offset        = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    cb            = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    want_event    = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0]; data = (cl_uint*)data + 1;
+    event_wait_list = (ocland_event*)data;         data = (ocland_event*)data + num_events_in_wait_list;
+    hash          = (unsigned char*)data;
+    // Ensure that the objects are valid
+    flag = isQueue(v, command_queue);
+    if(flag == CL_SUCCESS)
+        flag = isBuffer(v, memobj);
+    for(i=0;(flag == CL_SUCCESS) && (i<num_events_in_wait_list);i++)
+        flag = isEvent(v, event_wait_list[i]);
+    if(flag == CL_SUCCESS)
+        flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    // Build required objects
+    if(flag == CL_SUCCESS){
+        event = (ocland_event)malloc(sizeof(struct _ocland_event));
+        if(!event)
+            flag = CL_OUT_OF_HOST_MEMORY;
+    }
+    // Look for the data
+    if(flag == CL_SUCCESS)
+        status = blobStatus(hash, cb, &blob);
+    sendBlobStatus(clientfd, flag, status);
+    if((flag != CL_SUCCESS) || (status == OCLAND_BLOB_UNCACHED)){
+        if(event) free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    if(status == OCLAND_BLOB_MISS)
+        flag = recvBlob(clientfd, hash, cb, &blob);
+    if(flag == CL_SUCCESS){
+        event->event         = NULL;
+        event->status        = 1;
+        event->context       = context;
+        event->command_queue = command_queue;
+        // We may wait manually for the events generated in ocland
+        if(num_events_in_wait_list)
+            oclandWaitForEvents(num_events_in_wait_list, event_wait_list);
+        flag = clEnqueueWriteBuffer(command_queue, memobj, CL_TRUE,
+                                    offset, cb, blob->data,
+                                    0, NULL, &(event->event));
+    }
+    releaseBlob(blob); blob = NULL;
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event) free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // Return the package
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    // Mark the work as done
+    event->status = CL_COMPLETE;
+    if(want_event != CL_TRUE){
+        if(event->event) clReleaseEvent(event->event);
+        free(event); event = NULL;
+    }
+    else{
+        registerEvent(v,event);
+    }
+    VERBOSE_OUT(flag);
+    return 1;
+}
+
+int ocland_clEnqueueCopyBufferToPeer(int* clientfd, char* buffer, validator v, void* data)
+{
+    VERBOSE_IN();
+    unsigned int i;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_mem memobj;
+    size_t offset;
+    size_t cb;
+    unsigned int peer_port;
+    size_t peer_size;
+    const char *peer;
+    cl_uint num_events_in_wait_list;
+    ocland_event *event_wait_list = NULL;
+    cl_bool want_event;
+    cl_int flag;
+    ocland_event event = NULL;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Decript the received data
+    command_queue = ((cl_command_queue*)data)[0];  data = (cl_command_queue*)data + 1;
+    memobj        = ((cl_mem*)data)[0];            data = (cl_mem*)data + 1;
+    offset        = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    cb            = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    peer_port     = ((unsigned int*)data)[0];      data = (unsigned int*)data + 1;
+    peer_size     = ((size_t*)data)[0];            data = (size_t*)data + 1;
+    peer          = (const char*)data;             data = (char*)data + peer_size;
+    want_event    = ((cl_bool*)data)[0];           data = (cl_bool*)data + 1;
+    num_events_in_wait_list = ((cl_uint*)data)[0]; data = (cl_uint*)data + 1;
+    // The peer address must be a null terminated string
+    if((!peer_size) || (peer[peer_size - 1] != '\0')){
+        flag     = CL_INVALID_VALUE;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    if(num_events_in_wait_list){
+        event_wait_list = (ocland_event*)malloc(num_events_in_wait_list * sizeof(ocland_event));
+        if(!event_wait_list){
+            flag     = CL_OUT_OF_HOST_MEMORY;
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr      = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+        memcpy(event_wait_list, data, num_events_in_wait_list * sizeof(ocland_event));
+    }
+    // Ensure that the objects are valid
+    flag = isQueue(v, command_queue);
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    flag = isBuffer(v, memobj);
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    for(i=0;i<num_events_in_wait_list;i++){
+        flag = isEvent(v, event_wait_list[i]);
+        if(flag != CL_SUCCESS){
+            msgSize  = sizeof(cl_int);
+            msg      = (void*)malloc(msgSize);
+            mptr     = msg;
+            ((cl_int*)mptr)[0]  = flag;
+            Send(clientfd, &msgSize, sizeof(size_t), 0);
+            Send(clientfd, msg, msgSize, 0);
+            free(msg);msg=NULL;
+            if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+            VERBOSE_OUT(flag);
+            return 1;
+        }
+    }
+    flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_CONTEXT, sizeof(cl_context), &context, NULL);
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // Build required objects
+    event = (ocland_event)malloc(sizeof(struct _ocland_event));
+    if( !event ){
+        flag     = CL_OUT_OF_HOST_MEMORY;
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    event->event         = NULL;
+    event->status        = 1;
+    event->context       = context;
+    event->command_queue = command_queue;
+    // The data is streamed to the peer server in a parallel thread
+    flag = oclandEnqueueSendBufferToPeer(clientfd,command_queue,memobj,
+                                         offset,cb,peer,peer_port,
+                                         num_events_in_wait_list,event_wait_list,
+                                         want_event,event);
+    if(flag != CL_SUCCESS){
+        msgSize  = sizeof(cl_int);
+        msg      = (void*)malloc(msgSize);
+        mptr     = msg;
+        ((cl_int*)mptr)[0]  = flag;
+        Send(clientfd, &msgSize, sizeof(size_t), 0);
+        Send(clientfd, msg, msgSize, 0);
+        free(msg);msg=NULL;
+        if(event_wait_list) free(event_wait_list); event_wait_list=NULL;
+        free(event); event=NULL;
+        VERBOSE_OUT(flag);
+        return 1;
+    }
+    // We can't mark the work as done, or destroy the event
+    // becuase oclandEnqueueSendBufferToPeer needs it
+    if(want_event == CL_TRUE){
+        registerEvent(v, event);
+    }
+    VERBOSE_OUT(flag);
+    return 1;
+}
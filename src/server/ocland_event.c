@@ -29,18 +29,24 @@ cl_int oclandWaitForEvents(cl_uint num_events, const ocland_event *event_list)
     cl_int flag = CL_SUCCESS;
     cl_uint  cl_num_events=0;
     cl_event cl_event_list[num_events];
-    // Wait until ocland ends the work, and set OpenCL events
+    cl_bool failed = CL_FALSE;
+    // Wait until ocland ends the work, and set OpenCL events. Negative
+    // status means that the ocland work has failed
     for(i=0;i<num_events;i++){
-        while(event_list[i]->status != CL_COMPLETE)
+        while(event_list[i]->status > CL_COMPLETE)
             usleep(1000);
+        if(event_list[i]->status < 0)
+            failed = CL_TRUE;
         if(event_list[i]->event){
+            cl_event_list[cl_num_events] = event_list[i]->event;
             cl_num_events++;
-            cl_event_list[i] = event_list[i]->event;
         }
     }
     // Wait for OpenCL events
     if(cl_num_events)
-        flag = clWaitForEvents(num_events, cl_event_list);
+        flag = clWaitForEvents(cl_num_events, cl_event_list);
+    if(failed)
+        return CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
     return flag;
 
 }
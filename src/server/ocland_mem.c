@@ -17,16 +17,24 @@
  */
 
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
 #include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
 
 #include <ocland/common/dataExchange.h>
+#include <ocland/common/dataCompression.h>
+#include <ocland/common/dataStripes.h>
+#include <ocland/common/dataShared.h>
 #include <ocland/server/ocland_mem.h>
 
 #ifndef OCLAND_ASYNC_FIRST_PORT
@@ -41,12 +49,35 @@
     #define BUFF_SIZE 1025u
 #endif
 
-/** Create a port for a parallel data transfer.
+#ifndef OCLAND_TRANSFER_CHUNK
+    #define OCLAND_TRANSFER_CHUNK 8388608u
+#endif
+
+/// Prefix of the peer servers reached through an Unix domain socket
+#define OCLAND_UNIX_PREFIX "unix:"
+
+#ifndef OCLAND_MAX_STREAMS
+    #define OCLAND_MAX_STREAMS 8u
+#endif
+
+#ifndef OCLAND_TRANSFER_NBUFFERS
+    #define OCLAND_TRANSFER_NBUFFERS 3u
+#endif
+
+#ifndef OCLAND_ZEROCOPY_MIN_SIZE
+    #define OCLAND_ZEROCOPY_MIN_SIZE 1048576u
+#endif
+
+#ifndef OCLAND_CONNECT_TIMEOUT
+    #define OCLAND_CONNECT_TIMEOUT 3000u
+#endif
+
+/** Create a TCP port for a parallel data transfer.
  * @param async_port Returned resulting port. Can be NULL, then
  * port data will not be returned.
  * @return Server identifier, lower than 0 if couldn't be created.
  */
-int openPort(unsigned int *async_port)
+static int openInetPort(unsigned int *async_port)
 {
     unsigned int port = OCLAND_ASYNC_FIRST_PORT;
     int serverfd = -1;
@@ -76,7 +107,7 @@ int openPort(unsigned int *async_port)
     }
     if(async_port)
         *async_port = port;
-    if(listen(serverfd, 1)){
+    if(listen(serverfd, OCLAND_MAX_STREAMS)){
         // we can't work, disconnect the client
         printf("ERROR: Can't listen on port %u binded.\n", port); fflush(stdout);
         shutdown(serverfd, 2);
@@ -86,6 +117,90 @@ int openPort(unsigned int *async_port)
     return serverfd;
 }
 
+/** Test if an Unix domain socket file is not attached anymore to any
+ * server, i.e. nobody is listening on it.
+ * @param addr Socket address.
+ * @return CL_TRUE if the socket is stale, CL_FALSE otherwise.
+ */
+static cl_bool isStaleSocket(const struct sockaddr_un *addr)
+{
+    cl_bool stale = CL_FALSE;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return CL_FALSE;
+    if(connect(fd, (const struct sockaddr*)addr, sizeof(struct sockaddr_un)) && (errno == ECONNREFUSED))
+        stale = CL_TRUE;
+    close(fd);
+    return stale;
+}
+
+int openPort(int *clientfd, unsigned int *async_port)
+{
+    unsigned int port = OCLAND_ASYNC_FIRST_PORT;
+    int serverfd = -1;
+    struct sockaddr_un local_addr;
+    socklen_t local_addr_len = sizeof(local_addr);
+    memset(&local_addr, 0, sizeof(local_addr));
+    if(getsockname(*clientfd, (struct sockaddr*)&local_addr, &local_addr_len) ||
+       (local_addr.sun_family != AF_UNIX)){
+        return openInetPort(async_port);
+    }
+    char path[sizeof(local_addr.sun_path)];
+    strncpy(path, local_addr.sun_path, sizeof(path));
+    path[sizeof(path) - 1] = '\0';
+    serverfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(serverfd < 0){
+        // we can't work, disconnect the client
+        printf("ERROR: New socket can't be registered for asynchronous data transfer (%s).\n", SocketsError()); fflush(stdout);
+        return serverfd;
+    }
+    while(1){
+        int len = snprintf(local_addr.sun_path, sizeof(local_addr.sun_path), "%s.%u", path, port);
+        if((len <= 0) || ((size_t)len >= sizeof(local_addr.sun_path))){
+            printf("ERROR: Unix domain socket path too long (%s).\n", path); fflush(stdout);
+            close(serverfd);
+            return -1;
+        }
+        if(!bind(serverfd, (struct sockaddr*)&local_addr, sizeof(local_addr)))
+            break;
+        if((errno == EADDRINUSE) && isStaleSocket(&local_addr)){
+            // Left behind by a crashed transfer, recycle it
+            unlink(local_addr.sun_path);
+            continue;
+        }
+        port++;
+        if(port > OCLAND_ASYNC_LAST_PORT){
+            printf("WARNING: Can't find an available socket for asynchronous data transfer.\n"); fflush(stdout);
+            printf("\tWaiting for an available one...\n"); fflush(stdout);
+            port = OCLAND_ASYNC_FIRST_PORT;
+            usleep(1000);
+        }
+    }
+    // Same permissions than the main socket
+    chmod(local_addr.sun_path, 0666);
+    if(async_port)
+        *async_port = port;
+    if(listen(serverfd, OCLAND_MAX_STREAMS)){
+        // we can't work, disconnect the client
+        printf("ERROR: Can't listen on socket %s.\n", local_addr.sun_path); fflush(stdout);
+        closePort(serverfd);
+        return -1;
+    }
+    return serverfd;
+}
+
+void closePort(int serverfd)
+{
+    struct sockaddr_un local_addr;
+    socklen_t local_addr_len = sizeof(local_addr);
+    memset(&local_addr, 0, sizeof(local_addr));
+    if(!getsockname(serverfd, (struct sockaddr*)&local_addr, &local_addr_len) &&
+       (local_addr.sun_family == AF_UNIX) && local_addr.sun_path[0]){
+        unlink(local_addr.sun_path);
+    }
+    close(serverfd);
+}
+
 /** @struct dataTransfer Data needed for
  * an asynchronously transfer to client.
  */
@@ -122,6 +237,15 @@ struct dataSend{
     cl_bool want_event;
     /// Event associated to the transmission (can be NULL)
     ocland_event event;
+    /// Peer server address (for server to server transfers)
+    char *peer;
+    /// Peer server transfer port (for server to server transfers)
+    unsigned int peer_port;
+    /// Number of streams accepted by the peer server
+    unsigned int peer_streams;
+    /// Client socket, duplicated to reply once the peer server is
+    /// connected (for server to server transfers)
+    int clientfd;
 };
 
 /** Test if all the objects exist on the same command queue.
@@ -214,46 +338,768 @@ cl_int testWriteable(cl_mem mem)
     return CL_SUCCESS;
 }
 
-/** Thread that sends data from server to client.
- * @param data struct dataTransfer casted variable.
+/** Allocate the staging chunks used by the pipelined transfers.
+ * @param chunk Size of each staging chunk.
+ * @param staging Array of OCLAND_TRANSFER_NBUFFERS pointers to fill.
+ * @param events Array of OCLAND_TRANSFER_NBUFFERS events to reset.
+ * @return Size of each staging chunk, 0 if memory can't be allocated.
+ */
+static size_t allocStaging(size_t chunk, void **staging, cl_event *events)
+{
+    unsigned int i;
+    for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+        staging[i] = NULL;
+        events[i]  = NULL;
+    }
+    for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+        staging[i] = malloc(chunk);
+        if(!staging[i]){
+            for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+                free(staging[i]); staging[i] = NULL;
+            }
+            return 0;
+        }
+    }
+    return chunk;
+}
+
+/** Wait for the staging chunks still in flight, and release them.
+ * @param staging Array of OCLAND_TRANSFER_NBUFFERS staging chunks.
+ * @param events Array of OCLAND_TRANSFER_NBUFFERS events.
+ */
+static void freeStaging(void **staging, cl_event *events)
+{
+    unsigned int i;
+    for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+        if(events[i]){
+            clWaitForEvents(1, &(events[i]));
+            clReleaseEvent(events[i]);
+            events[i] = NULL;
+        }
+        free(staging[i]); staging[i] = NULL;
+    }
+}
+
+/** Keep a reference to the last OpenCL event generated by a
+ * pipelined transfer.
+ * @param last Last event stored, it will be released.
+ * @param event New event to store.
+ * @param want_event CL_TRUE if the event should be stored,
+ * CL_FALSE otherwise.
+ */
+static void storeEvent(cl_event *last, cl_event event, cl_bool want_event)
+{
+    if(want_event != CL_TRUE)
+        return;
+    if(*last)
+        clReleaseEvent(*last);
+    *last = event;
+    if(event)
+        clRetainEvent(event);
+}
+
+/** Abort a data transfer whose data is already being sent, closing the
+ * connection such that the peer detects the failure, instead of receiving
+ * corrupted data.
+ * @param fd Socket, set to -1.
+ * @param flag Error detected.
+ */
+static void abortTransfer(int *fd, cl_int flag)
+{
+    printf("ERROR: Data transfer aborted (error %d).\n", flag); fflush(stdout);
+    if(*fd < 0)
+        return;
+    shutdown(*fd, SHUT_RDWR);
+    close(*fd);
+    *fd = -1;
+}
+
+/** Receive and drop data from a compression stream.
+ * @param fd Socket where the data will be received.
+ * @param stream Compression stream. NULL for raw data.
+ * @param cb Size in bytes of the data to discard.
+ * @return CL_SUCCESS if the data has been consumed,
+ * CL_OUT_OF_RESOURCES if the connection has been lost.
+ */
+static cl_int discardStream(int *fd, oclandStream stream, size_t cb)
+{
+    char buffer[BUFF_SIZE];
+    size_t size, done = 0;
+    while(done < cb){
+        size = cb - done < BUFF_SIZE ? cb - done : BUFF_SIZE;
+        if(RecvStream(fd, stream, buffer, size) <= 0)
+            return CL_OUT_OF_RESOURCES;
+        done += size;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int oclandDiscard(int *fd, size_t cb)
+{
+    return discardStream(fd, NULL, cb);
+}
+
+/** Test if the device of a command queue shares the memory with the
+ * host, such that mapping a memory object don't require any copy.
+ * @param command_queue Command queue.
+ * @return CL_TRUE if the memory is shared, CL_FALSE otherwise.
+ */
+static cl_bool hostUnifiedMemory(cl_command_queue command_queue)
+{
+    cl_bool unified = CL_FALSE;
+    #ifdef CL_API_SUFFIX__VERSION_1_1
+        cl_device_id device;
+        cl_int flag;
+        flag = clGetCommandQueueInfo(command_queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+        if(flag != CL_SUCCESS)
+            return CL_FALSE;
+        flag = clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+        if(flag != CL_SUCCESS)
+            return CL_FALSE;
+    #endif
+    return unified;
+}
+
+/** Receive data from a socket straight into the mapped memory object.
+ * Each chunk of OCLAND_TRANSFER_CHUNK bytes is mapped, received and
+ * unmapped, such that no intermediate copy is required on devices
+ * sharing the memory with the host.
+ * @see oclandRecvBuffer
+ */
+static cl_int recvBufferMapped(int *                fd ,
+                               oclandStream         stream ,
+                               cl_command_queue     command_queue ,
+                               cl_mem               mem ,
+                               size_t               offset ,
+                               size_t               cb ,
+                               cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_event last = NULL, unmap = NULL;
+    size_t size, done = 0;
+    void *ptr;
+    #ifdef CL_API_SUFFIX__VERSION_1_2
+        cl_map_flags map_flags = CL_MAP_WRITE_INVALIDATE_REGION;
+    #else
+        cl_map_flags map_flags = CL_MAP_WRITE;
+    #endif
+    while(done < cb){
+        size = cb - done < OCLAND_TRANSFER_CHUNK ? cb - done : OCLAND_TRANSFER_CHUNK;
+        ptr  = clEnqueueMapBuffer(command_queue,mem,CL_TRUE,map_flags,
+                                  offset + done,size,
+                                  0,NULL,NULL,&flag);
+        if(flag != CL_SUCCESS){
+            // Consume the rest of the data to keep the stream sync
+            discardStream(fd, stream, cb - done);
+            break;
+        }
+        if(RecvStream(fd, stream, ptr, size) <= 0)
+            flag = CL_OUT_OF_RESOURCES;
+        if(clEnqueueUnmapMemObject(command_queue,mem,ptr,0,NULL,&unmap) == CL_SUCCESS){
+            clFlush(command_queue);
+            storeEvent(&last, unmap, event != NULL);
+            clReleaseEvent(unmap); unmap = NULL;
+        }
+        if(flag != CL_SUCCESS)
+            break;
+        done += size;
+    }
+    clFinish(command_queue);
+    if(event)
+        *event = last;
+    else if(last)
+        clReleaseEvent(last);
+    return flag;
+}
+
+cl_int oclandRecvBuffer(int *                fd ,
+                        oclandStream         stream ,
+                        cl_command_queue     command_queue ,
+                        cl_mem               mem ,
+                        size_t               offset ,
+                        size_t               cb ,
+                        cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_event last = NULL;
+    void *staging[OCLAND_TRANSFER_NBUFFERS];
+    cl_event events[OCLAND_TRANSFER_NBUFFERS];
+    size_t chunk, size, done = 0;
+    unsigned int slot = 0;
+    if(!cb)
+        return CL_SUCCESS;
+    // On devices sharing the memory with the host we can receive the
+    // data directly in the memory object
+    if(hostUnifiedMemory(command_queue) == CL_TRUE)
+        return recvBufferMapped(fd, stream, command_queue, mem, offset, cb, event);
+    chunk = allocStaging(cb < OCLAND_TRANSFER_CHUNK ? cb : OCLAND_TRANSFER_CHUNK,
+                         staging, events);
+    if(!chunk){
+        // We must consume the data anyway to keep the stream sync
+        discardStream(fd, stream, cb);
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+    while(done < cb){
+        size = cb - done < chunk ? cb - done : chunk;
+        // Wait until the staging chunk has been consumed by the device
+        if(events[slot]){
+            clWaitForEvents(1, &(events[slot]));
+            clReleaseEvent(events[slot]);
+            events[slot] = NULL;
+        }
+        if(RecvStream(fd, stream, staging[slot], size) <= 0){
+            flag = CL_OUT_OF_RESOURCES;
+            break;
+        }
+        // Once an error has been detected we keep receiving the
+        // data, but we don't write it anymore
+        if(flag == CL_SUCCESS){
+            flag = clEnqueueWriteBuffer(command_queue,mem,CL_FALSE,
+                                        offset + done,size,staging[slot],
+                                        0,NULL,&(events[slot]));
+            if(flag == CL_SUCCESS){
+                clFlush(command_queue);
+                storeEvent(&last, events[slot], event != NULL);
+            }
+            else
+                events[slot] = NULL;
+        }
+        done += size;
+        slot  = (slot + 1) % OCLAND_TRANSFER_NBUFFERS;
+    }
+    freeStaging(staging, events);
+    if(event)
+        *event = last;
+    return flag;
+}
+
+/** Receive the next piece of a stream whose first bytes have been
+ * already received.
+ * @param fd Socket where the data will be received.
+ * @param stream Compression stream. NULL for raw data.
+ * @param head Data already received.
+ * @param head_size Size of head.
+ * @param pos Position of the piece in the stream.
+ * @param dst Memory where the piece will be stored.
+ * @param size Size of the piece.
+ * @return Size of the piece, 0 or lower than 0 if the connection
+ * failed.
+ */
+static ssize_t recvStream(int *fd, oclandStream stream,
+                          const void *head, size_t head_size,
+                          size_t pos, void *dst, size_t size)
+{
+    size_t n = 0;
+    if(pos < head_size){
+        n = head_size - pos < size ? head_size - pos : size;
+        memcpy(dst, (const char*)head + pos, n);
+    }
+    if(n < size)
+        return RecvStream(fd, stream, (char*)dst + n, size - n);
+    return n;
+}
+
+cl_int oclandRecvImage(int *                fd ,
+                       oclandStream         stream ,
+                       cl_command_queue     command_queue ,
+                       cl_mem               image ,
+                       const size_t *       origin ,
+                       const size_t *       region ,
+                       size_t               row_pitch ,
+                       size_t               slice_pitch ,
+                       const void *         head ,
+                       size_t               head_size ,
+                       size_t               cb ,
+                       cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_event last = NULL;
+    void *staging[OCLAND_TRANSFER_NBUFFERS];
+    cl_event events[OCLAND_TRANSFER_NBUFFERS];
+    size_t element_size, unit, units, per_chunk, chunk, n, size, done = 0;
+    size_t chunk_origin[3], chunk_region[3];
+    unsigned int slot = 0, axis;
+    if(head_size > cb)
+        head_size = cb;
+    if(!cb)
+        return CL_SUCCESS;
+    flag = clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(size_t), &element_size, NULL);
+    if(flag != CL_SUCCESS){
+        discardStream(fd, stream, cb - head_size);
+        return flag;
+    }
+    if(!row_pitch)
+        row_pitch = region[0]*element_size;
+    if(!slice_pitch)
+        slice_pitch = region[1]*row_pitch;
+    // The host data is split in whole slices (3D regions) or whole
+    // rows (2D regions), such that each piece can be written by a
+    // single command using the same pitches than the full region
+    axis  = region[2] > 1 ? 2 : 1;
+    unit  = axis == 2 ? slice_pitch : row_pitch;
+    units = region[axis];
+    if(!unit || (units*unit > cb)){
+        discardStream(fd, stream, cb - head_size);
+        return CL_INVALID_VALUE;
+    }
+    per_chunk = OCLAND_TRANSFER_CHUNK / unit;
+    if(!per_chunk)
+        per_chunk = 1;
+    if(per_chunk > units)
+        per_chunk = units;
+    chunk = allocStaging(per_chunk*unit, staging, events);
+    if(!chunk){
+        discardStream(fd, stream, cb - head_size);
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+    memcpy(chunk_origin, origin, 3*sizeof(size_t));
+    memcpy(chunk_region, region, 3*sizeof(size_t));
+    while(done < units*unit){
+        n    = units - done/unit < per_chunk ? units - done/unit : per_chunk;
+        size = n*unit;
+        if(events[slot]){
+            clWaitForEvents(1, &(events[slot]));
+            clReleaseEvent(events[slot]);
+            events[slot] = NULL;
+        }
+        if(recvStream(fd, stream, head, head_size, done, staging[slot], size) <= 0){
+            flag = CL_OUT_OF_RESOURCES;
+            break;
+        }
+        if(flag == CL_SUCCESS){
+            chunk_origin[axis] = origin[axis] + done/unit;
+            chunk_region[axis] = n;
+            flag = clEnqueueWriteImage(command_queue,image,CL_FALSE,
+                                       chunk_origin,chunk_region,
+                                       row_pitch,slice_pitch,staging[slot],
+                                       0,NULL,&(events[slot]));
+            if(flag == CL_SUCCESS){
+                clFlush(command_queue);
+                storeEvent(&last, events[slot], event != NULL);
+            }
+            else
+                events[slot] = NULL;
+        }
+        done += size;
+        slot  = (slot + 1) % OCLAND_TRANSFER_NBUFFERS;
+    }
+    freeStaging(staging, events);
+    // Consume the padding sent after the last slice/row
+    if(done < head_size)
+        done = head_size;
+    if(done < cb)
+        discardStream(fd, stream, cb - done);
+    if(event)
+        *event = last;
+    return flag;
+}
+
+/** Send a memory object content straight from its mapped memory.
+ * Up to OCLAND_TRANSFER_NBUFFERS chunks of OCLAND_TRANSFER_CHUNK bytes
+ * are simultaneously mapped, and sent using MSG_ZEROCOPY if it has been
+ * enabled in the socket, such that each chunk is unmapped once the
+ * kernel reports that its transmission has been completed.
+ * @see oclandSendBuffer
+ */
+static cl_int sendBufferMapped(int *                fd ,
+                               oclandStream         stream ,
+                               cl_command_queue     command_queue ,
+                               cl_mem               mem ,
+                               size_t               offset ,
+                               size_t               cb ,
+                               const void *         header ,
+                               size_t               header_size ,
+                               cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_event last = NULL, unmap = NULL;
+    void *mapped[OCLAND_TRANSFER_NBUFFERS];
+    unsigned int ids[OCLAND_TRANSFER_NBUFFERS];
+    unsigned int i, slot = 0, calls = 0, completed = 0;
+    size_t size, done = 0;
+    // Compressed data is not sent from the mapped memory
+    int zerocopy = stream ? 0 : IsZeroCopyEnabled(fd);
+    for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+        mapped[i] = NULL;
+        ids[i]    = 0;
+    }
+    // If the first chunk can't be mapped nothing has been sent yet,
+    // so the error can be reported to the caller
+    size = cb < OCLAND_TRANSFER_CHUNK ? cb : OCLAND_TRANSFER_CHUNK;
+    mapped[0] = clEnqueueMapBuffer(command_queue,mem,CL_TRUE,CL_MAP_READ,
+                                   offset,size,0,NULL,NULL,&flag);
+    if(flag != CL_SUCCESS)
+        return flag;
+    if(header_size)
+        Send(fd, header, header_size, 0);
+    while(done < cb){
+        size = cb - done < OCLAND_TRANSFER_CHUNK ? cb - done : OCLAND_TRANSFER_CHUNK;
+        if(!mapped[slot]){
+            mapped[slot] = clEnqueueMapBuffer(command_queue,mem,CL_TRUE,CL_MAP_READ,
+                                              offset + done,size,
+                                              0,NULL,NULL,&flag);
+            if(flag != CL_SUCCESS){
+                mapped[slot] = NULL;
+                break;
+            }
+        }
+        if(zerocopy){
+            if(SendZeroCopy(fd, mapped[slot], size, &calls) <= 0){
+                flag = CL_OUT_OF_RESOURCES;
+                break;
+            }
+            ids[slot] = calls;
+        }
+        else if(SendStream(fd, stream, mapped[slot], size) <= 0){
+            flag = CL_OUT_OF_RESOURCES;
+            break;
+        }
+        done += size;
+        slot  = (slot + 1) % OCLAND_TRANSFER_NBUFFERS;
+        // Release the oldest chunk before reusing its slot
+        if(mapped[slot]){
+            WaitZeroCopy(fd, &completed, ids[slot]);
+            if(clEnqueueUnmapMemObject(command_queue,mem,mapped[slot],0,NULL,&unmap) == CL_SUCCESS){
+                storeEvent(&last, unmap, event != NULL);
+                clReleaseEvent(unmap); unmap = NULL;
+            }
+            mapped[slot] = NULL;
+        }
+    }
+    // The peer is already receiving the data, so it must be
+    // disconnected to don't take the missing data as valid
+    if(flag != CL_SUCCESS)
+        abortTransfer(fd, flag);
+    WaitZeroCopy(fd, &completed, calls);
+    for(i=0;i<OCLAND_TRANSFER_NBUFFERS;i++){
+        if(!mapped[i])
+            continue;
+        if(clEnqueueUnmapMemObject(command_queue,mem,mapped[i],0,NULL,&unmap) == CL_SUCCESS){
+            storeEvent(&last, unmap, event != NULL);
+            clReleaseEvent(unmap); unmap = NULL;
+        }
+    }
+    clFinish(command_queue);
+    if(flag != CL_SUCCESS){
+        if(last) clReleaseEvent(last);
+        last = NULL;
+    }
+    if(event)
+        *event = last;
+    return flag;
+}
+
+cl_int oclandSendBuffer(int *                fd ,
+                        oclandStream         stream ,
+                        cl_command_queue     command_queue ,
+                        cl_mem               mem ,
+                        size_t               offset ,
+                        size_t               cb ,
+                        const void *         header ,
+                        size_t               header_size ,
+                        cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    cl_event last = NULL;
+    void *staging[OCLAND_TRANSFER_NBUFFERS];
+    cl_event events[OCLAND_TRANSFER_NBUFFERS];
+    size_t chunk, size, done = 0, queued = 0;
+    unsigned int i, slot = 0;
+    if(!cb){
+        if(header_size)
+            Send(fd, header, header_size, 0);
+        return CL_SUCCESS;
+    }
+    // On devices sharing the memory with the host we can send the
+    // data directly from the memory object
+    if(hostUnifiedMemory(command_queue) == CL_TRUE)
+        return sendBufferMapped(fd, stream, command_queue, mem, offset, cb,
+                                header, header_size, event);
+    chunk = allocStaging(cb < OCLAND_TRANSFER_CHUNK ? cb : OCLAND_TRANSFER_CHUNK,
+                         staging, events);
+    if(!chunk)
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    // Fill the pipeline. Nothing has been sent yet, so the errors can
+    // be reported to the caller
+    for(i=0;(i<OCLAND_TRANSFER_NBUFFERS) && (queued < cb);i++){
+        size = cb - queued < chunk ? cb - queued : chunk;
+        flag = clEnqueueReadBuffer(command_queue,mem,CL_FALSE,
+                                   offset + queued,size,staging[i],
+                                   0,NULL,&(events[i]));
+        if(flag != CL_SUCCESS){
+            events[i] = NULL;
+            freeStaging(staging, events);
+            if(last) clReleaseEvent(last);
+            return flag;
+        }
+        storeEvent(&last, events[i], event != NULL);
+        queued += size;
+    }
+    clFlush(command_queue);
+    if(header_size)
+        Send(fd, header, header_size, 0);
+    // Stream the chunks, refilling each staging chunk with the next
+    // piece of the buffer as soon as it has been sent
+    while(done < cb){
+        size = cb - done < chunk ? cb - done : chunk;
+        if(events[slot]){
+            clWaitForEvents(1, &(events[slot]));
+            clReleaseEvent(events[slot]);
+            events[slot] = NULL;
+        }
+        if(SendStream(fd, stream, staging[slot], size) <= 0){
+            flag = CL_OUT_OF_RESOURCES;
+            break;
+        }
+        done += size;
+        if(queued < cb){
+            size = cb - queued < chunk ? cb - queued : chunk;
+            flag = clEnqueueReadBuffer(command_queue,mem,CL_FALSE,
+                                       offset + queued,size,staging[slot],
+                                       0,NULL,&(events[slot]));
+            if(flag != CL_SUCCESS){
+                events[slot] = NULL;
+                break;
+            }
+            clFlush(command_queue);
+            storeEvent(&last, events[slot], event != NULL);
+            queued += size;
+        }
+        slot = (slot + 1) % OCLAND_TRANSFER_NBUFFERS;
+    }
+    freeStaging(staging, events);
+    if(flag != CL_SUCCESS){
+        // The peer is already receiving the data, so the error can only
+        // be reported breaking the connection
+        abortTransfer(fd, flag);
+        if(last) clReleaseEvent(last);
+        last = NULL;
+    }
+    if(event)
+        *event = last;
+    return flag;
+}
+
+/** @struct dataStripe Slice of a striped data transfer.
+ */
+struct dataStripe{
+    /// Stream socket
+    int fd;
+    /// Transfer data
+    struct dataSend *data;
+    /// Offset of the slice
+    size_t offset;
+    /// Size of the slice
+    size_t cb;
+    /// CL_TRUE if the data is sent, CL_FALSE if it is received
+    cl_bool send;
+    /// Last OpenCL event of the slice
+    cl_event event;
+    /// Result of the slice transfer
+    cl_int flag;
+};
+
+/** Thread that transfers a slice of the data.
+ * @param data struct dataStripe casted variable.
  * @return NULL
  */
-void *asyncDataSend_thread(void *data)
+static void *dataStripe_thread(void *data)
 {
-    struct dataSend* _data = (struct dataSend*)data;
+    struct dataStripe* _data = (struct dataStripe*)data;
+    _data->event = NULL;
+    _data->flag  = CL_OUT_OF_RESOURCES;
+    if(_data->fd < 0)
+        return NULL;
+    oclandStream stream = CreateStream(AcceptCompression(&(_data->fd)));
+    if(_data->send){
+        // Avoid copying the large slices into the kernel, the data
+        // connection is closed after the transfer
+        if(!stream && (_data->cb >= OCLAND_ZEROCOPY_MIN_SIZE))
+            EnableZeroCopy(&(_data->fd));
+        _data->flag = oclandSendBuffer(&(_data->fd), stream, _data->data->command_queue,
+                                       _data->data->mem, _data->data->offset + _data->offset,
+                                       _data->cb, NULL, 0, &(_data->event));
+    }
+    else{
+        _data->flag = oclandRecvBuffer(&(_data->fd), stream, _data->data->command_queue,
+                                       _data->data->mem, _data->data->offset + _data->offset,
+                                       _data->cb, &(_data->event));
+    }
+    ReleaseStream(stream);
+    return NULL;
+}
+
+/** Accept a stream of a transfer, whose connection is expected right
+ * after the first stream negotiation. Hence the connection is waited for
+ * OCLAND_CONNECT_TIMEOUT milliseconds at most.
+ * @param fd Transfer port socket.
+ * @return Stream socket, -1 if the connection has not been accepted.
+ */
+static int acceptStream(int fd)
+{
+    struct pollfd pfd;
+    int rc;
+    pfd.fd      = fd;
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    do{
+        rc = poll(&pfd, 1, OCLAND_CONNECT_TIMEOUT);
+    }while((rc < 0) && (errno == EINTR));
+    if(rc <= 0)
+        return -1;
+    return accept(fd, (struct sockaddr*)NULL, NULL);
+}
+
+/** Exchange the data through a shared memory region passed by the client,
+ * which is used straight as the source/destination memory of the OpenCL
+ * transfer. The result is reported to the client when the transfer has
+ * finished.
+ * @param data Transfer data.
+ * @param fd Data connection socket, closed by this method.
+ * @param send CL_TRUE if the data is sent, CL_FALSE if it is received.
+ * @return CL_SUCCESS if the data has been transferred, an error code
+ * otherwise.
+ */
+static cl_int sharedTransfer(struct dataSend *data, int *fd, cl_bool send)
+{
+    size_t cb = 0;
+    void *ptr = NULL;
+    cl_event event = NULL;
+    cl_int flag = CL_OUT_OF_RESOURCES;
+    int mfd = RecvSharedRegion(fd, &cb);
+    if((mfd >= 0) && (cb == data->cb))
+        ptr = MapSharedRegion(mfd, cb);
+    // We may wait manually for the events generated by ocland,
+    // and then we can wait for the OpenCL generated ones.
+    if(data->num_events_in_wait_list){
+        oclandWaitForEvents(data->num_events_in_wait_list, data->event_wait_list);
+    }
+    if(ptr && send){
+        flag = clEnqueueReadBuffer(data->command_queue, data->mem, CL_TRUE,
+                                   data->offset, cb, ptr, 0, NULL, &event);
+    }
+    else if(ptr){
+        flag = clEnqueueWriteBuffer(data->command_queue, data->mem, CL_TRUE,
+                                    data->offset, cb, ptr, 0, NULL, &event);
+    }
+    else{
+        printf("ERROR: Can't map the shared memory region.\n"); fflush(stdout);
+    }
+    ReleaseSharedRegion(mfd, ptr, cb);
+    Send(fd, &flag, sizeof(cl_int), 0);
+    close(*fd);
+    if(flag != CL_SUCCESS)
+        event = NULL;
+    if(data->event)
+        data->event->event = event;
+    else if(event)
+        clReleaseEvent(event);
+    return flag;
+}
+
+/** Accept the streams of a transfer, which number is negotiated with
+ * the client, transferring a slice of the buffer along each one. Local
+ * clients may pass a shared memory region instead.
+ * @param data Transfer data.
+ * @param send CL_TRUE if the data is sent, CL_FALSE if it is received.
+ * @return CL_SUCCESS if the data has been transferred, the error of the
+ * first failed slice otherwise.
+ */
+static cl_int stripedTransfer(struct dataSend *data, cl_bool send)
+{
+    unsigned int i, streams;
+    size_t offset;
+    cl_int flag = CL_SUCCESS;
+    cl_event event = NULL;
+    pthread_t threads[OCLAND_MAX_STREAMS];
+    int joinable[OCLAND_MAX_STREAMS];
+    struct dataStripe stripes[OCLAND_MAX_STREAMS];
     // Provide a server for the data transfer
-    int fd = accept(_data->fd, (struct sockaddr*)NULL, NULL);
+    int fd = accept(data->fd, (struct sockaddr*)NULL, NULL);
     if(fd < 0){
         // we can't work, disconnect the client
         printf("ERROR: Can't listen on binded port.\n"); fflush(stdout);
-        shutdown(_data->fd, 2);
-        return CL_SUCCESS;
+        shutdown(data->fd, 2);
+        return CL_OUT_OF_RESOURCES;
+    }
+    // Local clients may pass the data in a shared memory region instead
+    streams = AcceptStripes(&fd, IsLocalSocket(&fd));
+    if(!streams)
+        return sharedTransfer(data, &fd, send);
+    for(i=0;i<streams;i++){
+        stripes[i].fd = i ? acceptStream(data->fd) : fd;
+        if(stripes[i].fd < 0){
+            printf("ERROR: Can't accept the stream %u.\n", i); fflush(stdout);
+            flag = CL_OUT_OF_RESOURCES;
+        }
+        stripes[i].data = data;
+        StripeSlice(data->cb, streams, i, &offset, &(stripes[i].cb));
+        stripes[i].offset = offset;
+        stripes[i].send   = send;
+    }
+    // A missing slice can't be transferred, so the whole transfer is
+    // aborted, disconnecting the streams already accepted
+    if(flag != CL_SUCCESS){
+        for(i=0;i<streams;i++){
+            if(stripes[i].fd >= 0)
+                abortTransfer(&(stripes[i].fd), flag);
+        }
+        return flag;
     }
     // We may wait manually for the events generated by ocland,
     // and then we can wait for the OpenCL generated ones.
-    if(_data->num_events_in_wait_list){
-        oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
+    if(data->num_events_in_wait_list){
+        oclandWaitForEvents(data->num_events_in_wait_list, data->event_wait_list);
     }
-    // Read the buffer
-    clEnqueueReadBuffer(_data->command_queue,_data->mem,CL_FALSE,
-                        _data->offset,_data->cb,_data->ptr,
-                        0,NULL,&(_data->event->event));
-    // Return the data to the client
-    clWaitForEvents(1,&(_data->event->event));
-    Send(&fd, _data->ptr, _data->cb, 0);
+    // Transfer the slices, the first one in this thread
+    for(i=1;i<streams;i++){
+        joinable[i] = !pthread_create(&(threads[i]), NULL, dataStripe_thread, (void *)&(stripes[i]));
+        if(!joinable[i])
+            dataStripe_thread(&(stripes[i]));
+    }
+    dataStripe_thread(&(stripes[0]));
+    for(i=1;i<streams;i++){
+        if(joinable[i])
+            pthread_join(threads[i], NULL);
+    }
+    // Keep just the last event, waiting for the other ones
+    for(i=0;i<streams;i++){
+        if(stripes[i].fd >= 0)
+            close(stripes[i].fd);
+        if((flag == CL_SUCCESS) && (stripes[i].flag != CL_SUCCESS))
+            flag = stripes[i].flag;
+        if(!stripes[i].event)
+            continue;
+        if(event){
+            clWaitForEvents(1, &event);
+            clReleaseEvent(event);
+        }
+        event = stripes[i].event;
+    }
+    if(data->event)
+        data->event->event = event;
+    else if(event)
+        clReleaseEvent(event);
+    return flag;
+}
+
+/** Thread that sends data from server to client.
+ * @param data struct dataTransfer casted variable.
+ * @return NULL
+ */
+void *asyncDataSend_thread(void *data)
+{
+    struct dataSend* _data = (struct dataSend*)data;
+    cl_int flag = stripedTransfer(_data, CL_TRUE);
     // Clean up
-    free(_data->ptr); _data->ptr = NULL;
     if(_data->event){
-        _data->event->status = CL_COMPLETE;
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
     }
     if(_data->want_event != CL_TRUE){
         free(_data->event); _data->event = NULL;
     }
     if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
-    // shutdown(fd, 2);
-    // shutdown(_data->fd, 2);
-    close(fd);
-    close(_data->fd);
+    closePort(_data->fd);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -264,7 +1110,6 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
                                cl_mem               mem ,
                                size_t               offset ,
                                size_t               cb ,
-                               void *               ptr ,
                                cl_uint              num_events_in_wait_list ,
                                ocland_event *       event_wait_list ,
                                cl_bool              want_event ,
@@ -288,7 +1133,7 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
     // packets exchanged with the client (for instance
     // to call new commands).
     unsigned int port;
-    int serverfd = openPort(&port);
+    int serverfd = openPort(clientfd, &port);
     if(serverfd < 0)
         return CL_OUT_OF_HOST_MEMORY;
     // Here in after we assume that the works gone fine,
@@ -315,7 +1160,7 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
     _data->mem                     = mem;
     _data->offset                  = offset;
     _data->cb                      = cb;
-    _data->ptr                     = ptr;
+    _data->ptr                     = NULL;
     _data->num_events_in_wait_list = num_events_in_wait_list;
     _data->event_wait_list         = event_wait_list;
     _data->want_event              = want_event;
@@ -329,6 +1174,100 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
     return CL_SUCCESS;
 }
 
+/** Thread that carries out an asynchronous read carried inline, replying
+ * the flag, the event and the data to the client once it has finished.
+ * @param data struct dataSend casted variable.
+ * @return NULL
+ */
+static void *asyncInlineSend_thread(void *data)
+{
+    struct dataSend* _data = (struct dataSend*)data;
+    cl_int flag;
+    size_t msgSize;
+    char header[sizeof(size_t) + sizeof(cl_int) + sizeof(ocland_event)];
+    if(_data->num_events_in_wait_list){
+        oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
+    }
+    msgSize = sizeof(cl_int) + sizeof(ocland_event) + _data->cb;
+    flag = CL_SUCCESS;
+    memcpy(header, &msgSize, sizeof(size_t));
+    memcpy(header + sizeof(size_t), &flag, sizeof(cl_int));
+    memcpy(header + sizeof(size_t) + sizeof(cl_int), &(_data->event), sizeof(ocland_event));
+    flag = oclandSendBuffer(&(_data->fd),NULL,_data->command_queue,_data->mem,
+                            _data->offset,_data->cb,header,sizeof(header),NULL);
+    // Nothing has been sent yet, so the error can be reported
+    if((flag != CL_SUCCESS) && (_data->fd >= 0)){
+        msgSize = sizeof(cl_int);
+        Send(&(_data->fd), &msgSize, sizeof(size_t), 0);
+        Send(&(_data->fd), &flag, sizeof(cl_int), 0);
+    }
+    // Clean up
+    if(_data->event){
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
+    }
+    if(_data->want_event != CL_TRUE){
+        free(_data->event); _data->event = NULL;
+    }
+    if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
+    if(_data->fd >= 0) close(_data->fd);
+    free(_data); _data=NULL;
+    pthread_exit(NULL);
+    return NULL;
+}
+
+cl_int oclandEnqueueReadInline(int *                clientfd ,
+                               cl_command_queue     command_queue ,
+                               cl_mem               mem ,
+                               size_t               offset ,
+                               size_t               cb ,
+                               cl_uint              num_events_in_wait_list ,
+                               ocland_event *       event_wait_list ,
+                               cl_bool              want_event ,
+                               ocland_event         event)
+{
+    // Test that the objects command queue matchs
+    if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
+        return CL_INVALID_CONTEXT;
+    // Test if the size is not out of bounds
+    if(testSize(mem, offset+cb) != CL_SUCCESS)
+        return CL_INVALID_VALUE;
+    // Test if the memory can be accessed
+    if(testReadable(mem) != CL_SUCCESS)
+        return CL_INVALID_OPERATION;
+    // The data is sent by a parallel thread, through its own descriptor
+    // of the client socket, such that it can't be reused by a new client
+    // if this one is disconnected meanwhile
+    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+    if(!_data)
+        return CL_OUT_OF_HOST_MEMORY;
+    _data->fd = dup(*clientfd);
+    if(_data->fd < 0){
+        free(_data); _data=NULL;
+        return CL_OUT_OF_RESOURCES;
+    }
+    _data->command_queue           = command_queue;
+    _data->mem                     = mem;
+    _data->offset                  = offset;
+    _data->cb                      = cb;
+    _data->ptr                     = NULL;
+    _data->num_events_in_wait_list = num_events_in_wait_list;
+    _data->event_wait_list         = event_wait_list;
+    _data->want_event              = want_event;
+    _data->event                   = event;
+    // The client does not send new commands until it has received the
+    // reply, so nothing else can be sent along the connection meanwhile
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, asyncInlineSend_thread, (void *)(_data));
+    if(rc){
+        printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
+        close(_data->fd);
+        free(_data); _data=NULL;
+        return CL_OUT_OF_RESOURCES;
+    }
+    pthread_detach(thread);
+    return CL_SUCCESS;
+}
+
 /** Thread that receives data from client.
  * @param data struct dataTransfer casted variable.
  * @return NULL
@@ -336,59 +1275,525 @@ cl_int oclandEnqueueReadBuffer(int *                clientfd ,
 void *asyncDataRecv_thread(void *data)
 {
     struct dataSend* _data = (struct dataSend*)data;
-    // Provide a server for the data transfer
-    int fd = accept(_data->fd, (struct sockaddr*)NULL, NULL);
-    if(fd < 0){
+    cl_int flag = stripedTransfer(_data, CL_FALSE);
+    // Clean up
+    if(_data->event){
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
+    }
+    if(_data->want_event != CL_TRUE){
+        free(_data->event); _data->event = NULL;
+    }
+    if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
+    closePort(_data->fd);
+    free(_data); _data=NULL;
+    pthread_exit(NULL);
+    return NULL;
+}
+
+cl_int oclandEnqueueWriteBuffer(int *                clientfd ,
+                                cl_command_queue     command_queue ,
+                                cl_mem               mem ,
+                                size_t               offset ,
+                                size_t               cb ,
+                                cl_uint              num_events_in_wait_list ,
+                                ocland_event *       event_wait_list ,
+                                cl_bool              want_event ,
+                                ocland_event         event)
+{
+    cl_int flag;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
+    // Test that the objects command queue matchs
+    if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
+        return CL_INVALID_CONTEXT;
+    // Test if the size is not out of bounds
+    if(testSize(mem, offset+cb) != CL_SUCCESS)
+        return CL_INVALID_VALUE;
+    // Test if the memory can be accessed
+    if(testReadable(mem) != CL_SUCCESS)
+        return CL_INVALID_OPERATION;
+    // Seems that data is correct, so we can proceed.
+    // We need to create a new connection socket in a
+    // new port in order to don't intercept the next
+    // packets exchanged with the client (for instance
+    // to call new commands).
+    unsigned int port;
+    int serverfd = openPort(clientfd, &port);
+    if(serverfd < 0)
+        return CL_OUT_OF_HOST_MEMORY;
+    // Here in after we assume that the works gone fine,
+    // returning CL_SUCCESS. Therefore we will package
+    // the flag, the event and the port to stablish the
+    // connection for the asynchronous data transfer.
+    flag = CL_SUCCESS;
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msgSize += sizeof(unsigned int);    // port
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    ((unsigned int*)mptr)[0] = port;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    // We are ready to trasfer the control to a parallel thread
+    pthread_t thread;
+    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+    _data->fd                      = serverfd;
+    _data->command_queue           = command_queue;
+    _data->mem                     = mem;
+    _data->offset                  = offset;
+    _data->cb                      = cb;
+    _data->ptr                     = NULL;
+    _data->num_events_in_wait_list = num_events_in_wait_list;
+    _data->event_wait_list         = event_wait_list;
+    _data->want_event              = want_event;
+    _data->event                   = event;
+    int rc = pthread_create(&thread, NULL, asyncDataRecv_thread, (void *)(_data));
+    if(rc){
         // we can't work, disconnect the client
-        printf("ERROR: Can't listen on binded port.\n"); fflush(stdout);
-        shutdown(_data->fd, 2);
+        printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
+        shutdown(serverfd, 2);
+    }
+    return CL_SUCCESS;
+}
+
+/** Release the copy of the data of an inline write.
+ * @param event Write event.
+ * @param status Event status.
+ * @param data Data copy.
+ */
+static void CL_CALLBACK releaseInlineData(cl_event event, cl_int status, void *data)
+{
+    free(data);
+}
+
+/** Enqueue the write of a copy of the inline data, released when the
+ * write has finished. The ocland events of the wait list must be already
+ * completed.
+ * @param command_queue Command queue.
+ * @param mem Buffer to write.
+ * @param offset Offset of the write in the buffer.
+ * @param cb Size of the data.
+ * @param copy Data copy, released by this method.
+ * @param num_events_in_wait_list Number of events to wait for.
+ * @param event_wait_list Events to wait for.
+ * @param event Returned OpenCL event.
+ * @return CL_SUCCESS if the write is enqueued, an error code otherwise.
+ */
+static cl_int enqueueWriteInline(cl_command_queue     command_queue ,
+                                 cl_mem               mem ,
+                                 size_t               offset ,
+                                 size_t               cb ,
+                                 void *               copy ,
+                                 cl_uint              num_events_in_wait_list ,
+                                 ocland_event *       event_wait_list ,
+                                 cl_event *           event)
+{
+    cl_uint i, n = 0;
+    cl_int flag;
+    cl_event *events = NULL;
+    if(num_events_in_wait_list){
+        events = (cl_event*)malloc(num_events_in_wait_list * sizeof(cl_event));
+        if(!events){
+            free(copy);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        for(i=0;i<num_events_in_wait_list;i++){
+            if(event_wait_list[i]->event)
+                events[n++] = event_wait_list[i]->event;
+        }
+    }
+    flag = clEnqueueWriteBuffer(command_queue, mem, CL_FALSE, offset, cb, copy,
+                                n, n ? events : NULL, event);
+    free(events);
+    if(flag != CL_SUCCESS){
+        free(copy);
+        return flag;
+    }
+    clFlush(command_queue);
+    if(clSetEventCallback(*event, CL_COMPLETE, releaseInlineData, copy) != CL_SUCCESS){
+        clWaitForEvents(1, event);
+        free(copy);
+    }
+    return CL_SUCCESS;
+}
+
+/** Set the result of an inline write, releasing the event if the client
+ * does not want it.
+ * @param want_event CL_TRUE if the event must be preserved.
+ * @param event Write event.
+ * @param flag Result of the write.
+ */
+static void endWriteInline(cl_bool want_event, ocland_event event, cl_int flag)
+{
+    // The ocland work is done, OpenCL will report the rest
+    event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
+    if(want_event != CL_TRUE){
+        if(event->event) clReleaseEvent(event->event);
+        free(event);
+    }
+}
+
+/** Thread that waits for the ocland events of an inline write, and then
+ * enqueues it.
+ * @param data struct dataSend casted variable.
+ * @return NULL
+ */
+static void *asyncInlineWrite_thread(void *data)
+{
+    struct dataSend* _data = (struct dataSend*)data;
+    cl_int flag;
+    flag = oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
+    if(flag == CL_SUCCESS){
+        flag = enqueueWriteInline(_data->command_queue, _data->mem, _data->offset,
+                                  _data->cb, _data->ptr,
+                                  _data->num_events_in_wait_list,
+                                  _data->event_wait_list,
+                                  &(_data->event->event));
+    }
+    else{
+        free(_data->ptr);
+    }
+    endWriteInline(_data->want_event, _data->event, flag);
+    free(_data->event_wait_list); _data->event_wait_list=NULL;
+    free(_data); _data=NULL;
+    pthread_exit(NULL);
+    return NULL;
+}
+
+cl_int oclandEnqueueWriteInline(cl_command_queue     command_queue ,
+                                cl_mem               mem ,
+                                size_t               offset ,
+                                size_t               cb ,
+                                const void *         ptr ,
+                                cl_uint              num_events_in_wait_list ,
+                                ocland_event *       event_wait_list ,
+                                cl_bool              want_event ,
+                                ocland_event         event)
+{
+    cl_uint i;
+    cl_int flag;
+    void *copy;
+    // Test that the objects command queue matchs
+    if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
+        return CL_INVALID_CONTEXT;
+    // Test if the size is not out of bounds
+    if(testSize(mem, offset+cb) != CL_SUCCESS)
+        return CL_INVALID_VALUE;
+    copy = malloc(cb);
+    if(!copy)
+        return CL_OUT_OF_HOST_MEMORY;
+    memcpy(copy, ptr, cb);
+    // The events of the ocland transfers still in progress can't be
+    // waited by OpenCL, so a parallel thread waits for them
+    for(i=0;i<num_events_in_wait_list;i++){
+        if(event_wait_list[i]->status != CL_COMPLETE)
+            break;
+    }
+    if(i < num_events_in_wait_list){
+        struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+        if(!_data){
+            free(copy);
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        _data->command_queue           = command_queue;
+        _data->mem                     = mem;
+        _data->offset                  = offset;
+        _data->cb                      = cb;
+        _data->ptr                     = copy;
+        _data->num_events_in_wait_list = num_events_in_wait_list;
+        _data->event_wait_list         = event_wait_list;
+        _data->want_event              = want_event;
+        _data->event                   = event;
+        pthread_t thread;
+        int rc = pthread_create(&thread, NULL, asyncInlineWrite_thread, (void *)(_data));
+        if(rc){
+            printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
+            free(copy);
+            free(_data); _data=NULL;
+            return CL_OUT_OF_RESOURCES;
+        }
+        pthread_detach(thread);
         return CL_SUCCESS;
     }
+    flag = enqueueWriteInline(command_queue, mem, offset, cb, copy,
+                              num_events_in_wait_list, event_wait_list,
+                              &(event->event));
+    if(flag != CL_SUCCESS)
+        return flag;
+    endWriteInline(want_event, event, flag);
+    free(event_wait_list);
+    return CL_SUCCESS;
+}
+
+/// Peer servers allowed, separated by commas. NULL if any server is
+/// allowed
+static char *peers_allowed = NULL;
+
+void setAllowedPeers(const char *peers)
+{
+    free(peers_allowed);
+    peers_allowed = (peers && peers[0]) ? strdup(peers) : NULL;
+}
+
+/** Test if the data can be sent to a peer server, such that the clients
+ * can't use this server to connect to arbitrary hosts and ports. The
+ * port must be in the transfer ports range, and the address in the
+ * allowed peers list if it has been set.
+ * @param address Peer server address.
+ * @param port Port where the peer server is listening.
+ * @return 1 if the peer server is allowed, 0 otherwise.
+ * @see setAllowedPeers
+ */
+static int isPeerAllowed(const char *address, unsigned int port)
+{
+    const char *item, *end;
+    size_t len = strlen(address);
+    if((port < OCLAND_ASYNC_FIRST_PORT) || (port > OCLAND_ASYNC_LAST_PORT))
+        return 0;
+    if(!peers_allowed)
+        return 1;
+    for(item=peers_allowed;item;item=end ? end + 1 : NULL){
+        end = strchr(item, ',');
+        if(((end ? (size_t)(end - item) : strlen(item)) == len) && !strncmp(item, address, len))
+            return 1;
+    }
+    return 0;
+}
+
+/** Connect a socket, giving up after OCLAND_CONNECT_TIMEOUT
+ * milliseconds.
+ * @param fd Socket.
+ * @param addr Address to connect.
+ * @param len Size of the address.
+ * @return 0 if the socket is connected, -1 otherwise.
+ */
+static int connectDeadline(int fd, const struct sockaddr *addr, socklen_t len)
+{
+    struct pollfd pfd;
+    int rc, error = 0;
+    socklen_t error_len = sizeof(error);
+    int flags = fcntl(fd, F_GETFL, 0);
+    if((flags < 0) || fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+        return -1;
+    if(connect(fd, addr, len)){
+        if(errno != EINPROGRESS)
+            return -1;
+        pfd.fd      = fd;
+        pfd.events  = POLLOUT;
+        pfd.revents = 0;
+        do{
+            rc = poll(&pfd, 1, OCLAND_CONNECT_TIMEOUT);
+        }while((rc < 0) && (errno == EINTR));
+        if(rc <= 0)
+            return -1;
+        if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) || error)
+            return -1;
+    }
+    return fcntl(fd, F_SETFL, flags) ? -1 : 0;
+}
+
+/** Connect a stream to the data transfer port opened by another ocland
+ * server, which will receive the data as if it was sent by a client.
+ * @param address Peer server address, either an IP address or an Unix
+ * domain socket in "unix:/path/to/socket" form.
+ * @param port Port where the peer server is listening.
+ * @param index Stream index.
+ * @return Stream socket, -1 if the connection has failed.
+ */
+static int connectPeer(const char *address, unsigned int port, unsigned int index)
+{
+    int fd;
+    if(!strncmp(address, OCLAND_UNIX_PREFIX, strlen(OCLAND_UNIX_PREFIX))){
+        struct sockaddr_un peer_addr;
+        const char *path = address + strlen(OCLAND_UNIX_PREFIX);
+        memset(&peer_addr, 0, sizeof(peer_addr));
+        peer_addr.sun_family = AF_UNIX;
+        int len = snprintf(peer_addr.sun_path, sizeof(peer_addr.sun_path), "%s.%u", path, port);
+        if((len <= 0) || ((size_t)len >= sizeof(peer_addr.sun_path)))
+            return -1;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+            return -1;
+        if(connectDeadline(fd, (struct sockaddr*)&peer_addr, sizeof(peer_addr))){
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    struct sockaddr_in peer_addr;
+    memset(&peer_addr, 0, sizeof(peer_addr));
+    peer_addr.sin_family = AF_INET;
+    peer_addr.sin_port   = htons(port);
+    if(inet_pton(AF_INET, address, &peer_addr.sin_addr) <= 0)
+        return -1;
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    BindStripe(&fd, index);
+    if(connectDeadline(fd, (struct sockaddr*)&peer_addr, sizeof(peer_addr))){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Thread that sends a slice of the data to a peer server.
+ * @param data struct dataStripe casted variable.
+ * @return NULL
+ */
+static void *peerStripe_thread(void *data)
+{
+    struct dataStripe* _data = (struct dataStripe*)data;
+    _data->event = NULL;
+    _data->flag  = CL_OUT_OF_RESOURCES;
+    if(_data->fd < 0)
+        return NULL;
+    // We are the client side of the channel
+    oclandStream stream = CreateStream(ConnectCompression(&(_data->fd)));
+    if(!stream && (_data->cb >= OCLAND_ZEROCOPY_MIN_SIZE))
+        EnableZeroCopy(&(_data->fd));
+    _data->flag = oclandSendBuffer(&(_data->fd), stream, _data->data->command_queue,
+                                   _data->data->mem, _data->data->offset + _data->offset,
+                                   _data->cb, NULL, 0, &(_data->event));
+    ReleaseStream(stream);
+    return NULL;
+}
+
+/** Connect the first stream with the peer server, negotiating the rest,
+ * and reply the client.
+ * @param data Transfer data.
+ * @return CL_SUCCESS if the peer server is connected, an error code
+ * otherwise, in which case the client may relay the data by itself.
+ */
+static cl_int connectPeerTransfer(struct dataSend *data)
+{
+    cl_int flag = CL_SUCCESS;
+    size_t msgSize;
+    char msg[sizeof(cl_int) + sizeof(ocland_event)];
+    data->fd = connectPeer(data->peer, data->peer_port, 0);
+    if(data->fd < 0){
+        printf("WARNING: Can't connect with the peer server %s.\n", data->peer); fflush(stdout);
+        flag = CL_OUT_OF_RESOURCES;
+    }
+    else{
+        data->peer_streams = ConnectStripes(&(data->fd), StripeStreams(data->cb));
+        if((!data->peer_streams) || (data->peer_streams > OCLAND_MAX_STREAMS)){
+            printf("ERROR: Invalid number of streams accepted by the peer server (%u).\n", data->peer_streams); fflush(stdout);
+            close(data->fd); data->fd = -1;
+            flag = CL_OUT_OF_RESOURCES;
+        }
+    }
+    msgSize = flag == CL_SUCCESS ? sizeof(msg) : sizeof(cl_int);
+    memcpy(msg, &flag, sizeof(cl_int));
+    memcpy(msg + sizeof(cl_int), &(data->event), sizeof(ocland_event));
+    Send(&(data->clientfd), &msgSize, sizeof(size_t), 0);
+    Send(&(data->clientfd), msg, msgSize, 0);
+    if(data->clientfd >= 0)
+        close(data->clientfd);
+    data->clientfd = -1;
+    return flag;
+}
+
+/** Thread that sends data from server to a peer server, connecting it
+ * and replying the client first.
+ * @param data struct dataSend casted variable.
+ * @return NULL
+ */
+void *peerDataSend_thread(void *data)
+{
+    struct dataSend* _data = (struct dataSend*)data;
+    unsigned int i;
+    size_t offset;
+    cl_int flag = CL_SUCCESS;
+    cl_event event = NULL;
+    pthread_t threads[OCLAND_MAX_STREAMS];
+    int joinable[OCLAND_MAX_STREAMS];
+    struct dataStripe stripes[OCLAND_MAX_STREAMS];
+    flag = connectPeerTransfer(_data);
+    if(flag != CL_SUCCESS){
+        if(_data->want_event == CL_TRUE){
+            _data->event->status = flag;
+        }
+        else{
+            free(_data->event); _data->event = NULL;
+        }
+        if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
+        free(_data->peer); _data->peer=NULL;
+        free(_data); _data=NULL;
+        pthread_exit(NULL);
+        return NULL;
+    }
+    for(i=0;i<_data->peer_streams;i++){
+        stripes[i].fd = i ? connectPeer(_data->peer, _data->peer_port, i) : _data->fd;
+        if(stripes[i].fd < 0){
+            printf("ERROR: Can't connect the stream %u with the peer server %s.\n", i, _data->peer); fflush(stdout);
+        }
+        stripes[i].data = _data;
+        StripeSlice(_data->cb, _data->peer_streams, i, &offset, &(stripes[i].cb));
+        stripes[i].offset = offset;
+        stripes[i].send   = CL_TRUE;
+    }
     // We may wait manually for the events generated by ocland,
     // and then we can wait for the OpenCL generated ones.
     if(_data->num_events_in_wait_list){
         oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
     }
-    // Receive the data
-    Recv(&fd, _data->ptr, _data->cb, MSG_WAITALL);
-    // Writre it into the buffer
-    clEnqueueWriteBuffer(_data->command_queue,_data->mem,CL_FALSE,
-                        _data->offset,_data->cb,_data->ptr,
-                        0,NULL,&(_data->event->event));
-    // Wait until the data is copied before start cleaning up
-    clWaitForEvents(1,&(_data->event->event));
+    // Transfer the slices, the first one in this thread
+    for(i=1;i<_data->peer_streams;i++){
+        joinable[i] = !pthread_create(&(threads[i]), NULL, peerStripe_thread, (void *)&(stripes[i]));
+        if(!joinable[i])
+            peerStripe_thread(&(stripes[i]));
+    }
+    peerStripe_thread(&(stripes[0]));
+    for(i=1;i<_data->peer_streams;i++){
+        if(joinable[i])
+            pthread_join(threads[i], NULL);
+    }
+    // Keep just the last event, waiting for the other ones
+    for(i=0;i<_data->peer_streams;i++){
+        if(stripes[i].fd >= 0)
+            close(stripes[i].fd);
+        if((flag == CL_SUCCESS) && (stripes[i].flag != CL_SUCCESS))
+            flag = stripes[i].flag;
+        if(!stripes[i].event)
+            continue;
+        if(event){
+            clWaitForEvents(1, &event);
+            clReleaseEvent(event);
+        }
+        event = stripes[i].event;
+    }
     // Clean up
-    free(_data->ptr); _data->ptr = NULL;
-    if(_data->event){
-        _data->event->status = CL_COMPLETE;
+    if(_data->want_event == CL_TRUE){
+        _data->event->event  = event;
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
     }
-    if(_data->want_event != CL_TRUE){
+    else{
+        if(event) clReleaseEvent(event);
         free(_data->event); _data->event = NULL;
     }
     if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
-    // shutdown(fd, 2);
-    // shutdown(_data->fd, 2); // Destroy the server to free the port
-    close(fd);
-    close(_data->fd);
+    free(_data->peer); _data->peer=NULL;
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
 }
 
-cl_int oclandEnqueueWriteBuffer(int *                clientfd ,
-                                cl_command_queue     command_queue ,
-                                cl_mem               mem ,
-                                size_t               offset ,
-                                size_t               cb ,
-                                void *               ptr ,
-                                cl_uint              num_events_in_wait_list ,
-                                ocland_event *       event_wait_list ,
-                                cl_bool              want_event ,
-                                ocland_event         event)
+cl_int oclandEnqueueSendBufferToPeer(int *                clientfd ,
+                                     cl_command_queue     command_queue ,
+                                     cl_mem               mem ,
+                                     size_t               offset ,
+                                     size_t               cb ,
+                                     const char *         peer ,
+                                     unsigned int         peer_port ,
+                                     cl_uint              num_events_in_wait_list ,
+                                     ocland_event *       event_wait_list ,
+                                     cl_bool              want_event ,
+                                     ocland_event         event)
 {
-    cl_int flag;
-    size_t msgSize = 0;
-    void *msg = NULL, *mptr = NULL;
     // Test that the objects command queue matchs
     if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
         return CL_INVALID_CONTEXT;
@@ -398,50 +1803,52 @@ cl_int oclandEnqueueWriteBuffer(int *                clientfd ,
     // Test if the memory can be accessed
     if(testReadable(mem) != CL_SUCCESS)
         return CL_INVALID_OPERATION;
-    // Seems that data is correct, so we can proceed.
-    // We need to create a new connection socket in a
-    // new port in order to don't intercept the next
-    // packets exchanged with the client (for instance
-    // to call new commands).
-    unsigned int port;
-    int serverfd = openPort(&port);
-    if(serverfd < 0)
+    // Just the ocland servers can be reached, the client will relay
+    // the data otherwise
+    if(!isPeerAllowed(peer, peer_port)){
+        printf("WARNING: The peer server %s:%u is not allowed.\n", peer, peer_port); fflush(stdout);
+        return CL_OUT_OF_RESOURCES;
+    }
+    // The peer server is connected by a parallel thread, which replies
+    // the client once it is connected (the client does not send new
+    // commands meanwhile). If the peer is not reachable the client will
+    // be informed, relaying the data by itself
+    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+    if(!_data)
         return CL_OUT_OF_HOST_MEMORY;
-    // Here in after we assume that the works gone fine,
-    // returning CL_SUCCESS. Therefore we will package
-    // the flag, the event and the port to stablish the
-    // connection for the asynchronous data transfer.
-    flag = CL_SUCCESS;
-    msgSize  = sizeof(cl_int);          // flag
-    msgSize += sizeof(ocland_event);    // event
-    msgSize += sizeof(unsigned int);    // port
-    msg      = (void*)malloc(msgSize);
-    mptr     = msg;
-    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
-    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
-    ((unsigned int*)mptr)[0] = port;
-    Send(clientfd, &msgSize, sizeof(size_t), 0);
-    Send(clientfd, msg, msgSize, 0);
-    free(msg);msg=NULL;
-    // We are ready to trasfer the control to a parallel thread
+    _data->peer = strdup(peer);
+    if(!_data->peer){
+        free(_data);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    _data->clientfd = dup(*clientfd);
+    if(_data->clientfd < 0){
+        free(_data->peer);
+        free(_data);
+        return CL_OUT_OF_RESOURCES;
+    }
     pthread_t thread;
-    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
-    _data->fd                      = serverfd;
+    _data->fd                      = -1;
+    _data->peer_streams            = 0;
     _data->command_queue           = command_queue;
     _data->mem                     = mem;
     _data->offset                  = offset;
     _data->cb                      = cb;
-    _data->ptr                     = ptr;
+    _data->ptr                     = NULL;
+    _data->peer_port               = peer_port;
     _data->num_events_in_wait_list = num_events_in_wait_list;
     _data->event_wait_list         = event_wait_list;
     _data->want_event              = want_event;
     _data->event                   = event;
-    int rc = pthread_create(&thread, NULL, asyncDataRecv_thread, (void *)(_data));
+    int rc = pthread_create(&thread, NULL, peerDataSend_thread, (void *)(_data));
     if(rc){
-        // we can't work, disconnect the client
         printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
-        shutdown(serverfd, 2);
+        close(_data->clientfd);
+        free(_data->peer);
+        free(_data);
+        return CL_OUT_OF_RESOURCES;
     }
+    pthread_detach(thread);
     return CL_SUCCESS;
 }
 
@@ -472,7 +1879,9 @@ void *asyncDataSendImage_thread(void *data)
                        _data->ptr,0,NULL,&(_data->event->event));
     // Return the data to the client
     clWaitForEvents(1,&(_data->event->event));
-    Send(&fd, _data->ptr, _data->cb, 0);
+    oclandStream stream = CreateStream(AcceptCompression(&fd));
+    SendStream(&fd, stream, _data->ptr, _data->cb);
+    ReleaseStream(stream);
     // Clean up
     free(_data->ptr); _data->ptr = NULL;
     if(_data->event){
@@ -485,7 +1894,7 @@ void *asyncDataSendImage_thread(void *data)
     // shutdown(fd, 2);
     // shutdown(_data->fd, 2); // Destroy the server to free the port
     close(fd);
-    close(_data->fd);
+    closePort(_data->fd);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -525,7 +1934,7 @@ cl_int oclandEnqueueReadImage(int *                clientfd ,
     // packets exchanged with the client (for instance
     // to call new commands).
     unsigned int port;
-    int serverfd = openPort(&port);
+    int serverfd = openPort(clientfd, &port);
     if(serverfd < 0)
         return CL_OUT_OF_HOST_MEMORY;
     // Here in after we assume that the works gone fine,
@@ -587,7 +1996,9 @@ void *asyncDataRecvImage_thread(void *data)
         oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
     }
     // Receive the data
-    Recv(&fd, _data->ptr, _data->cb, MSG_WAITALL);
+    oclandStream stream = CreateStream(AcceptCompression(&fd));
+    RecvStream(&fd, stream, _data->ptr, _data->cb);
+    ReleaseStream(stream);
     // Writre it into the buffer
     clEnqueueWriteImage(_data->command_queue,_data->mem,CL_FALSE,
                         _data->buffer_origin,_data->region,
@@ -607,7 +2018,7 @@ void *asyncDataRecvImage_thread(void *data)
     // shutdown(fd, 2);
     // shutdown(_data->fd, 2); // Destroy the server to free the port
     close(fd);
-    close(_data->fd);
+    closePort(_data->fd);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -647,7 +2058,7 @@ cl_int oclandEnqueueWriteImage(int *                clientfd ,
     // packets exchanged with the client (for instance
     // to call new commands).
     unsigned int port;
-    int serverfd = openPort(&port);
+    int serverfd = openPort(clientfd, &port);
     if(serverfd < 0)
         return CL_OUT_OF_HOST_MEMORY;
     // Here in after we assume that the works gone fine,
@@ -690,69 +2101,117 @@ cl_int oclandEnqueueWriteImage(int *                clientfd ,
 
 #ifdef CL_API_SUFFIX__VERSION_1_1
 
-/** Thread that sends data from server to client in
- * 2D or 3D mode.
- * @param data struct dataTransfer casted variable.
+/** Test if a rectangular region is not out of the bounds of a buffer.
+ * @param mem Buffer.
+ * @param buffer_origin Origin of the region in the buffer.
+ * @param region Region size.
+ * @param buffer_row_pitch Size of a buffer row.
+ * @param buffer_slice_pitch Size of a buffer 2D slice.
+ * @return CL_SUCCESS if the region fits in the buffer, CL_INVALID_VALUE
+ * otherwise.
+ */
+static cl_int testRect(cl_mem               mem ,
+                       const size_t *       buffer_origin ,
+                       const size_t *       region ,
+                       size_t               buffer_row_pitch ,
+                       size_t               buffer_slice_pitch)
+{
+    if((!region[0]) || (!region[1]) || (!region[2]))
+        return CL_INVALID_VALUE;
+    size_t cb =   buffer_origin[0]
+                + buffer_origin[1]*buffer_row_pitch
+                + buffer_origin[2]*buffer_slice_pitch
+                + region[0]
+                + (region[1] - 1)*buffer_row_pitch
+                + (region[2] - 1)*buffer_slice_pitch;
+    return testSize(mem, cb);
+}
+
+/** Store the rectangular region of a transfer, which data is packed in
+ * the host memory.
+ * @param data Transfer data.
+ * @param buffer_origin Origin of the region in the buffer.
+ * @param region Region size.
+ * @return CL_SUCCESS if the region has been stored, CL_OUT_OF_HOST_MEMORY
+ * otherwise.
+ */
+static cl_int setRect(struct dataSend *     data ,
+                      const size_t *        buffer_origin ,
+                      const size_t *        region)
+{
+    data->buffer_origin = (size_t*)malloc(3*sizeof(size_t));
+    data->region        = (size_t*)malloc(3*sizeof(size_t));
+    if((!data->buffer_origin) || (!data->region)){
+        free(data->buffer_origin); data->buffer_origin = NULL;
+        free(data->region); data->region = NULL;
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    memcpy(data->buffer_origin, buffer_origin, 3*sizeof(size_t));
+    memcpy(data->region, region, 3*sizeof(size_t));
+    data->host_row_pitch   = region[0];
+    data->host_slice_pitch = region[0]*region[1];
+    data->cb               = region[0]*region[1]*region[2];
+    return CL_SUCCESS;
+}
+
+/** Thread that sends a packed rectangular region of a buffer from server
+ * to client.
+ * @param data struct dataSend casted variable.
  * @return NULL
  */
 void *asyncDataSendRect_thread(void *data)
 {
-    unsigned int i,j,k,n;
-    size_t buffsize = BUFF_SIZE*sizeof(char);
+    size_t host_origin[3] = {0, 0, 0};
     struct dataSend* _data = (struct dataSend*)data;
-    // We may wait manually for the events provided because
-    // OpenCL can only waits their events, but ocalnd event
-    // can be relevant. We will not check for errors,
-    // assuming than events can be wrong, but is to late to
-    // try to report a fail.
+    // Provide a server for the data transfer
+    int fd = accept(_data->fd, (struct sockaddr*)NULL, NULL);
+    if(fd < 0){
+        // we can't work, disconnect the client
+        printf("ERROR: Can't listen on binded port.\n"); fflush(stdout);
+        shutdown(_data->fd, 2);
+        return NULL;
+    }
+    cl_int flag = CL_SUCCESS;
+    // We may wait manually for the events generated by ocland,
+    // and then we can wait for the OpenCL generated ones.
     if(_data->num_events_in_wait_list){
-        oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
+        flag = oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
     }
-    // Call to OpenCL
-    size_t host_origin[3] = {0, 0, 0};
-    clEnqueueReadBufferRect(_data->command_queue,_data->mem,CL_FALSE,
-                            _data->buffer_origin,host_origin,_data->region,
-                            _data->buffer_row_pitch,_data->buffer_slice_pitch,
-                            _data->host_row_pitch,_data->host_slice_pitch,
-                            _data->ptr,0,NULL,&(_data->event->event));
-    // Start sending data to client
-    int *fd = &(_data->fd);
-    Send(fd, &buffsize, sizeof(size_t), 0);
-    // Compute the number of packages needed
-    n = _data->host_row_pitch / buffsize;
-    // Wait until data is copied here. We will not test
-    // for errors, user can do it later
-    clWaitForEvents(1,&(_data->event->event));
-    // Send the rows
-    size_t origin = 0;
-    for(j=0;j<_data->region[1];j++){
-        for(k=0;k<_data->region[2];k++){
-            // Send package by pieces
-            for(i=0;i<n;i++){
-                Send(fd, _data->ptr + i*buffsize + origin, buffsize, 0);
-            }
-            if(_data->host_row_pitch % buffsize){
-                // Remains some data to arrive
-                Send(fd, _data->ptr + n*buffsize + origin, _data->host_row_pitch % buffsize, 0);
-            }
-            // Compute the new origin
-            origin += _data->host_row_pitch;
-        }
+    // Read the region, letting OpenCL pack it
+    if(flag == CL_SUCCESS){
+        flag = clEnqueueReadBufferRect(_data->command_queue,_data->mem,CL_FALSE,
+                                       _data->buffer_origin,host_origin,_data->region,
+                                       _data->buffer_row_pitch,_data->buffer_slice_pitch,
+                                       _data->host_row_pitch,_data->host_slice_pitch,
+                                       _data->ptr,0,NULL,&(_data->event->event));
+    }
+    if(flag == CL_SUCCESS){
+        flag = clWaitForEvents(1,&(_data->event->event));
+    }
+    // Return the data to the client, or abort the transfer, such that
+    // the client is not receiving an uninitialized region
+    if(flag == CL_SUCCESS){
+        oclandStream stream = CreateStream(AcceptCompression(&fd));
+        if(SendStream(&fd, stream, _data->ptr, _data->cb) != (ssize_t)_data->cb)
+            flag = CL_OUT_OF_RESOURCES;
+        ReleaseStream(stream);
     }
+    if(flag != CL_SUCCESS){
+        abortTransfer(&fd, flag);
+    }
+    // Clean up
     free(_data->buffer_origin); _data->buffer_origin = NULL;
     free(_data->region); _data->region = NULL;
     free(_data->ptr); _data->ptr = NULL;
     if(_data->event){
-        _data->event->status = CL_COMPLETE;
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
     }
     if(_data->want_event != CL_TRUE){
         free(_data->event); _data->event = NULL;
     }
     if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
-    // shutdown(fd, 2);
-    // shutdown(_data->fd, 2); // Destroy the server to free the port
-    close(fd);
-    close(_data->fd);
+    if(fd >= 0) close(fd);
+    closePort(_data->fd);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -765,8 +2224,6 @@ cl_int oclandEnqueueReadBufferRect(int *                clientfd ,
                                    const size_t *       region ,
                                    size_t               buffer_row_pitch ,
                                    size_t               buffer_slice_pitch ,
-                                   size_t               host_row_pitch ,
-                                   size_t               host_slice_pitch ,
                                    void *               ptr ,
                                    cl_uint              num_events_in_wait_list ,
                                    ocland_event *       event_wait_list ,
@@ -774,74 +2231,61 @@ cl_int oclandEnqueueReadBufferRect(int *                clientfd ,
                                    ocland_event         event)
 {
     cl_int flag;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
     // Test that the objects command queue matchs
     if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
-        return flag;
-    // Test if the size is not out of bounds
-    size_t cb =   buffer_origin[0]
-                + buffer_origin[1]*buffer_row_pitch
-                + buffer_origin[2]*buffer_slice_pitch
-                + region[0]
-                + region[1]*buffer_row_pitch
-                + region[2]*buffer_slice_pitch;
-    if(testSize(mem, cb) != CL_SUCCESS)
-        return flag;
+        return CL_INVALID_CONTEXT;
+    // Test if the region is not out of bounds
+    if(testRect(mem,buffer_origin,region,buffer_row_pitch,buffer_slice_pitch) != CL_SUCCESS)
+        return CL_INVALID_VALUE;
     // Test if the memory can be accessed
     if(testReadable(mem) != CL_SUCCESS)
-        return flag;
+        return CL_INVALID_OPERATION;
+    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+    if(!_data)
+        return CL_OUT_OF_HOST_MEMORY;
+    if(setRect(_data, buffer_origin, region) != CL_SUCCESS){
+        free(_data);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
     // Seems that data is correct, so we can proceed.
     // We need to create a new connection socket in a
-    // new port in order to don't interfiere the next
+    // new port in order to don't intercept the next
     // packets exchanged with the client (for instance
     // to call new commands).
     unsigned int port;
-    int serverfd = openPort(&port);
+    int serverfd = openPort(clientfd, &port);
     if(serverfd < 0){
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
+        free(_data->buffer_origin);
+        free(_data->region);
+        free(_data);
         return CL_OUT_OF_HOST_MEMORY;
     }
     // Here in after we assume that the works gone fine,
-    // returning CL_SUCCESS. We need to do it in order to
-    // avoid sending the port before the flag.
+    // returning CL_SUCCESS. Therefore we will package
+    // the flag, the event and the port to stablish the
+    // connection for the asynchronous data transfer.
     flag = CL_SUCCESS;
-    Send(clientfd, &flag, sizeof(cl_int), 0);
-    if(want_event == CL_TRUE){
-        Send(clientfd, &event, sizeof(ocland_event), 0);
-    }
-    // We have a new connection socket ready, reports it to
-    // the client and wait until he connects with us.
-    Send(clientfd, &port, sizeof(unsigned int), 0);
-    int fd = accept(serverfd, (struct sockaddr*)NULL, NULL);
-    if(fd < 0){
-        // we can't work, disconnect the client
-        printf("ERROR: Can't listen on port %u binded.\n", port); fflush(stdout);
-        shutdown(serverfd, 2);
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
-        return CL_SUCCESS;
-    }
-    // Now we have a new socket connected to client, so
-    // hereinafter we rely the work to a new thread, that
-    // will call to clEnqueueReadBuffer and will send the
-    // data to the client.
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msgSize += sizeof(unsigned int);    // port
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    ((unsigned int*)mptr)[0] = port;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    // We are ready to trasfer the control to a parallel thread
     pthread_t thread;
-    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
-    _data->fd                      = fd;
+    _data->fd                      = serverfd;
     _data->command_queue           = command_queue;
     _data->mem                     = mem;
-    _data->buffer_origin           = (size_t*)malloc(3*sizeof(size_t));
-    _data->buffer_origin[0]        = buffer_origin[0];
-    _data->buffer_origin[1]        = buffer_origin[1];
-    _data->buffer_origin[2]        = buffer_origin[2];
-    _data->region                  = (size_t*)malloc(3*sizeof(size_t));
-    _data->region[0]               = region[0];
-    _data->region[1]               = region[1];
-    _data->region[2]               = region[2];
+    _data->offset                  = 0;
     _data->buffer_row_pitch        = buffer_row_pitch;
     _data->buffer_slice_pitch      = buffer_slice_pitch;
-    _data->host_row_pitch          = host_row_pitch;
-    _data->host_slice_pitch        = host_slice_pitch;
     _data->ptr                     = ptr;
     _data->num_events_in_wait_list = num_events_in_wait_list;
     _data->event_wait_list         = event_wait_list;
@@ -852,74 +2296,66 @@ cl_int oclandEnqueueReadBufferRect(int *                clientfd ,
         // we can't work, disconnect the client
         printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
         shutdown(serverfd, 2);
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
     }
     return CL_SUCCESS;
 }
 
-/** Thread that receives data from client.
- * @param data struct dataTransfer casted variable.
+/** Thread that receives a packed rectangular region of a buffer from
+ * client.
+ * @param data struct dataSend casted variable.
  * @return NULL
  */
 void *asyncDataRecvRect_thread(void *data)
 {
-    unsigned int i,j,k,n;
-    size_t buffsize = BUFF_SIZE*sizeof(char);
-    struct dataSend* _data = (struct dataSend*)data;
     size_t host_origin[3] = {0, 0, 0};
+    struct dataSend* _data = (struct dataSend*)data;
+    // Provide a server for the data transfer
+    int fd = accept(_data->fd, (struct sockaddr*)NULL, NULL);
+    if(fd < 0){
+        // we can't work, disconnect the client
+        printf("ERROR: Can't listen on binded port.\n"); fflush(stdout);
+        shutdown(_data->fd, 2);
+        return NULL;
+    }
+    cl_int flag = CL_SUCCESS;
     // Receive the data
-    int *fd = &(_data->fd);
-    Send(fd, &buffsize, sizeof(size_t), 0);
-    // Compute the number of packages needed
-    n = _data->host_row_pitch / buffsize;
-    // Receive the rows
-    size_t origin = 0;
-    for(j=0;j<_data->region[1];j++){
-        for(k=0;k<_data->region[2];k++){
-            // Receive package by pieces
-            for(i=0;i<n;i++){
-                Recv(fd, _data->ptr + i*buffsize + origin, buffsize, MSG_WAITALL);
-            }
-            if(_data->host_row_pitch % buffsize){
-                // Remains some data to arrive
-                Recv(fd, _data->ptr + n*buffsize + origin, _data->host_row_pitch % buffsize, MSG_WAITALL);
-            }
-            // Compute the new origin
-            origin += _data->host_row_pitch;
-        }
+    oclandStream stream = CreateStream(AcceptCompression(&fd));
+    if(RecvStream(&fd, stream, _data->ptr, _data->cb) != (ssize_t)_data->cb)
+        flag = CL_OUT_OF_RESOURCES;
+    ReleaseStream(stream);
+    // We may wait manually for the events generated by ocland,
+    // and then we can wait for the OpenCL generated ones.
+    if((flag == CL_SUCCESS) && _data->num_events_in_wait_list){
+        flag = oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
     }
-    // We may wait manually for the events provided because
-    // OpenCL can only waits their events, but ocland event
-    // can be relevant. We will not check for errors,
-    // assuming than events can be wrong, but is to late to
-    // try to report a fail.
-    if(_data->num_events_in_wait_list){
-        oclandWaitForEvents(_data->num_events_in_wait_list, _data->event_wait_list);
+    // Write the region, letting OpenCL unpack it
+    if(flag == CL_SUCCESS){
+        flag = clEnqueueWriteBufferRect(_data->command_queue,_data->mem,CL_FALSE,
+                                        _data->buffer_origin,host_origin,_data->region,
+                                        _data->buffer_row_pitch,_data->buffer_slice_pitch,
+                                        _data->host_row_pitch,_data->host_slice_pitch,
+                                        _data->ptr,0,NULL,&(_data->event->event));
     }
-    // Call to OpenCL
-    clEnqueueWriteBufferRect(_data->command_queue,_data->mem,CL_FALSE,
-                             _data->buffer_origin,host_origin,_data->region,
-                             _data->buffer_row_pitch,_data->buffer_slice_pitch,
-                             _data->host_row_pitch,_data->host_slice_pitch,
-                             _data->ptr,0,NULL,&(_data->event->event));
-    // Wait until data is copied here. We will not test
-    // for errors, user can do it later
-    clWaitForEvents(1,&(_data->event->event));
+    // Wait until the data is copied before start cleaning up
+    if(flag == CL_SUCCESS){
+        flag = clWaitForEvents(1,&(_data->event->event));
+    }
+    if(flag != CL_SUCCESS){
+        abortTransfer(&fd, flag);
+    }
+    // Clean up
     free(_data->buffer_origin); _data->buffer_origin = NULL;
     free(_data->region); _data->region = NULL;
     free(_data->ptr); _data->ptr = NULL;
     if(_data->event){
-        _data->event->status = CL_COMPLETE;
+        _data->event->status = flag == CL_SUCCESS ? CL_COMPLETE : flag;
     }
     if(_data->want_event != CL_TRUE){
         free(_data->event); _data->event = NULL;
     }
     if(_data->event_wait_list) free(_data->event_wait_list); _data->event_wait_list=NULL;
-    // shutdown(fd, 2);
-    // shutdown(_data->fd, 2); // Destroy the server to free the port
-    close(fd);
-    close(_data->fd);
+    if(fd >= 0) close(fd);
+    closePort(_data->fd);
     free(_data); _data=NULL;
     pthread_exit(NULL);
     return NULL;
@@ -932,74 +2368,68 @@ cl_int oclandEnqueueWriteBufferRect(int *                clientfd ,
                                     const size_t *       region ,
                                     size_t               buffer_row_pitch ,
                                     size_t               buffer_slice_pitch ,
-                                    size_t               host_row_pitch ,
-                                    size_t               host_slice_pitch ,
                                     void *               ptr ,
                                     cl_uint              num_events_in_wait_list ,
                                     ocland_event *       event_wait_list ,
                                     cl_bool              want_event ,
                                     ocland_event         event)
 {
+    cl_int flag;
+    size_t msgSize = 0;
+    void *msg = NULL, *mptr = NULL;
     // Test that the objects command queue matchs
     if(testCommandQueue(command_queue,mem,num_events_in_wait_list,event_wait_list) != CL_SUCCESS)
         return CL_INVALID_CONTEXT;
-    // Test if the size is not out of bounds
-    size_t cb =   buffer_origin[0]
-                + buffer_origin[1]*buffer_row_pitch
-                + buffer_origin[2]*buffer_slice_pitch
-                + region[0]
-                + region[1]*buffer_row_pitch
-                + region[2]*buffer_slice_pitch;
-    if(testSize(mem, cb) != CL_SUCCESS)
+    // Test if the region is not out of bounds
+    if(testRect(mem,buffer_origin,region,buffer_row_pitch,buffer_slice_pitch) != CL_SUCCESS)
         return CL_INVALID_VALUE;
     // Test if the memory can be accessed
     if(testWriteable(mem) != CL_SUCCESS)
         return CL_INVALID_OPERATION;
+    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
+    if(!_data)
+        return CL_OUT_OF_HOST_MEMORY;
+    if(setRect(_data, buffer_origin, region) != CL_SUCCESS){
+        free(_data);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
     // Seems that data is correct, so we can proceed.
     // We need to create a new connection socket in a
-    // new port in order to don't interfiere the next
+    // new port in order to don't intercept the next
     // packets exchanged with the client (for instance
     // to call new commands).
     unsigned int port;
-    int serverfd = openPort(&port);
+    int serverfd = openPort(clientfd, &port);
     if(serverfd < 0){
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
-        return CL_OUT_OF_HOST_MEMORY;
-    }
-    // We have a new connection socket ready, reports it to
-    // the client and wait until he connects with us.
-    Send(clientfd, &port, sizeof(unsigned int), 0);
-    int fd = accept(serverfd, (struct sockaddr*)NULL, NULL);
-    if(fd < 0){
-        // we can't work, disconnect the client
-        printf("ERROR: Can't listen on port %u binded.\n", port); fflush(stdout);
-        shutdown(serverfd, 2);
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
+        free(_data->buffer_origin);
+        free(_data->region);
+        free(_data);
         return CL_OUT_OF_HOST_MEMORY;
     }
-    // Now we have a new socket connected to client, so
-    // hereinafter we rely the work to a new thread, that
-    // will call to clEnqueueReadBuffer and will send the
-    // data to the client.
+    // Here in after we assume that the works gone fine,
+    // returning CL_SUCCESS. Therefore we will package
+    // the flag, the event and the port to stablish the
+    // connection for the asynchronous data transfer.
+    flag = CL_SUCCESS;
+    msgSize  = sizeof(cl_int);          // flag
+    msgSize += sizeof(ocland_event);    // event
+    msgSize += sizeof(unsigned int);    // port
+    msg      = (void*)malloc(msgSize);
+    mptr     = msg;
+    ((cl_int*)mptr)[0]       = flag;  mptr = (cl_int*)mptr + 1;
+    ((ocland_event*)mptr)[0] = event; mptr = (ocland_event*)mptr + 1;
+    ((unsigned int*)mptr)[0] = port;
+    Send(clientfd, &msgSize, sizeof(size_t), 0);
+    Send(clientfd, msg, msgSize, 0);
+    free(msg);msg=NULL;
+    // We are ready to trasfer the control to a parallel thread
     pthread_t thread;
-    struct dataSend* _data = (struct dataSend*)malloc(sizeof(struct dataSend));
-    _data->fd                      = fd;
+    _data->fd                      = serverfd;
     _data->command_queue           = command_queue;
     _data->mem                     = mem;
-    _data->buffer_origin           = (size_t*)malloc(3*sizeof(size_t));
-    _data->buffer_origin[0]        = buffer_origin[0];
-    _data->buffer_origin[1]        = buffer_origin[1];
-    _data->buffer_origin[2]        = buffer_origin[2];
-    _data->region                  = (size_t*)malloc(3*sizeof(size_t));
-    _data->region[0]               = region[0];
-    _data->region[1]               = region[1];
-    _data->region[2]               = region[2];
+    _data->offset                  = 0;
     _data->buffer_row_pitch        = buffer_row_pitch;
     _data->buffer_slice_pitch      = buffer_slice_pitch;
-    _data->host_row_pitch          = host_row_pitch;
-    _data->host_slice_pitch        = host_slice_pitch;
     _data->ptr                     = ptr;
     _data->num_events_in_wait_list = num_events_in_wait_list;
     _data->event_wait_list         = event_wait_list;
@@ -1010,10 +2440,231 @@ cl_int oclandEnqueueWriteBufferRect(int *                clientfd ,
         // we can't work, disconnect the client
         printf("ERROR: Thread creation has failed with the return code %d\n", rc); fflush(stdout);
         shutdown(serverfd, 2);
-        shutdown(*clientfd, 2);
-        *clientfd = -1;
-        return CL_OUT_OF_HOST_MEMORY;
     }
     return CL_SUCCESS;
 }
 #endif // CL_API_SUFFIX__VERSION_1_1
+
+/** Fill a staging memory replicating a pattern, doubling the copied
+ * data on each step.
+ * @param staging Staging memory.
+ * @param size Size of the staging memory, multiple of the pattern size.
+ * @param pattern Pattern.
+ * @param pattern_size Pattern size.
+ */
+static void fillStaging(void *staging, size_t size, const void *pattern, size_t pattern_size)
+{
+    size_t filled = pattern_size;
+    memcpy(staging, pattern, pattern_size);
+    while(filled < size){
+        size_t n = filled < size - filled ? filled : size - filled;
+        memcpy((char*)staging + filled, staging, n);
+        filled += n;
+    }
+}
+
+cl_int oclandEmulateFillBuffer(cl_command_queue     command_queue ,
+                               cl_mem               mem ,
+                               const void *         pattern ,
+                               size_t               pattern_size ,
+                               size_t               offset ,
+                               size_t               cb ,
+                               cl_event *           event)
+{
+    cl_int flag = CL_SUCCESS;
+    void *staging = NULL;
+    *event = NULL;
+    if((!pattern_size) || (cb % pattern_size))
+        return CL_INVALID_VALUE;
+    if(!cb)
+        return CL_SUCCESS;
+    // The pattern is replicated in a staging memory, which is written
+    // as many times as needed
+    size_t chunk = OCLAND_TRANSFER_CHUNK - OCLAND_TRANSFER_CHUNK % pattern_size;
+    if(!chunk)
+        chunk = pattern_size;
+    if(chunk > cb)
+        chunk = cb;
+    staging = malloc(chunk);
+    if(!staging)
+        return CL_OUT_OF_HOST_MEMORY;
+    fillStaging(staging, chunk, pattern, pattern_size);
+    while(cb){
+        size_t size = cb < chunk ? cb : chunk;
+        if(*event){
+            clReleaseEvent(*event); *event = NULL;
+        }
+        flag = clEnqueueWriteBuffer(command_queue, mem, CL_TRUE, offset, size,
+                                    staging, 0, NULL, event);
+        if(flag != CL_SUCCESS){
+            *event = NULL;
+            break;
+        }
+        offset += size;
+        cb     -= size;
+    }
+    free(staging);
+    return flag;
+}
+
+/** Convert a normalized color component.
+ * @param value Color component.
+ * @param min Minimum normalized value.
+ * @param scale Maximum integer value.
+ * @return Integer value.
+ */
+static long normalizeComponent(float value, float min, float scale)
+{
+    if(!(value >= min))
+        value = min;
+    if(value > 1.f)
+        value = 1.f;
+    value *= scale;
+    return (long)(value < 0.f ? value - 0.5f : value + 0.5f);
+}
+
+/** Saturate an integer color component.
+ * @param value Color component.
+ * @param min Minimum value.
+ * @param max Maximum value.
+ * @return Saturated value.
+ */
+static long long saturateComponent(long long value, long long min, long long max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+/** Convert a fill color, provided as 4 RGBA components, into the
+ * pixel representation of an image format.
+ * @param format Image format.
+ * @param fill_color Fill color.
+ * @param pixel Returned pixel, of 16 bytes at most.
+ * @param pixel_size Returned pixel size.
+ * @return CL_SUCCESS if the color has been converted,
+ * CL_IMAGE_FORMAT_NOT_SUPPORTED if the format can't be emulated.
+ */
+static cl_int fillColorPixel(const cl_image_format *  format ,
+                             const void *             fill_color ,
+                             unsigned char *          pixel ,
+                             size_t *                 pixel_size)
+{
+    unsigned int i, n;
+    const unsigned int *channels;
+    static const unsigned int r[] = {0}, a[] = {3}, rg[] = {0, 1}, ra[] = {0, 3};
+    static const unsigned int rgba[] = {0, 1, 2, 3}, bgra[] = {2, 1, 0, 3}, argb[] = {3, 0, 1, 2};
+    const float *f = (const float*)fill_color;
+    const cl_int *si = (const cl_int*)fill_color;
+    const cl_uint *ui = (const cl_uint*)fill_color;
+    switch(format->image_channel_order){
+        case CL_R: case CL_INTENSITY: case CL_LUMINANCE:
+            channels = r; n = 1; break;
+        case CL_A:
+            channels = a; n = 1; break;
+        case CL_RG:
+            channels = rg; n = 2; break;
+        case CL_RA:
+            channels = ra; n = 2; break;
+        case CL_RGBA:
+            channels = rgba; n = 4; break;
+        case CL_BGRA:
+            channels = bgra; n = 4; break;
+        case CL_ARGB:
+            channels = argb; n = 4; break;
+        default:
+            return CL_IMAGE_FORMAT_NOT_SUPPORTED;
+    }
+    for(i=0;i<n;i++){
+        unsigned int c = channels[i];
+        switch(format->image_channel_data_type){
+            case CL_UNORM_INT8:
+                ((cl_uchar*)pixel)[i] = (cl_uchar)normalizeComponent(f[c], 0.f, 255.f);
+                *pixel_size = n * sizeof(cl_uchar); break;
+            case CL_UNORM_INT16:
+                ((cl_ushort*)pixel)[i] = (cl_ushort)normalizeComponent(f[c], 0.f, 65535.f);
+                *pixel_size = n * sizeof(cl_ushort); break;
+            case CL_SNORM_INT8:
+                ((cl_char*)pixel)[i] = (cl_char)normalizeComponent(f[c], -1.f, 127.f);
+                *pixel_size = n * sizeof(cl_char); break;
+            case CL_SNORM_INT16:
+                ((cl_short*)pixel)[i] = (cl_short)normalizeComponent(f[c], -1.f, 32767.f);
+                *pixel_size = n * sizeof(cl_short); break;
+            case CL_SIGNED_INT8:
+                ((cl_char*)pixel)[i] = (cl_char)saturateComponent(si[c], CL_SCHAR_MIN, CL_SCHAR_MAX);
+                *pixel_size = n * sizeof(cl_char); break;
+            case CL_SIGNED_INT16:
+                ((cl_short*)pixel)[i] = (cl_short)saturateComponent(si[c], CL_SHRT_MIN, CL_SHRT_MAX);
+                *pixel_size = n * sizeof(cl_short); break;
+            case CL_SIGNED_INT32:
+                ((cl_int*)pixel)[i] = si[c];
+                *pixel_size = n * sizeof(cl_int); break;
+            case CL_UNSIGNED_INT8:
+                ((cl_uchar*)pixel)[i] = (cl_uchar)saturateComponent(ui[c], 0, CL_UCHAR_MAX);
+                *pixel_size = n * sizeof(cl_uchar); break;
+            case CL_UNSIGNED_INT16:
+                ((cl_ushort*)pixel)[i] = (cl_ushort)saturateComponent(ui[c], 0, CL_USHRT_MAX);
+                *pixel_size = n * sizeof(cl_ushort); break;
+            case CL_UNSIGNED_INT32:
+                ((cl_uint*)pixel)[i] = ui[c];
+                *pixel_size = n * sizeof(cl_uint); break;
+            case CL_FLOAT:
+                ((cl_float*)pixel)[i] = f[c];
+                *pixel_size = n * sizeof(cl_float); break;
+            default:
+                return CL_IMAGE_FORMAT_NOT_SUPPORTED;
+        }
+    }
+    return CL_SUCCESS;
+}
+
+cl_int oclandEmulateFillImage(cl_command_queue     command_queue ,
+                              cl_mem               image ,
+                              const void *         fill_color ,
+                              const size_t *       origin ,
+                              const size_t *       region ,
+                              cl_event *           event)
+{
+    unsigned int k;
+    unsigned char pixel[16];
+    size_t pixel_size = 0, j;
+    cl_image_format format;
+    cl_int flag;
+    *event = NULL;
+    flag = clGetImageInfo(image, CL_IMAGE_FORMAT, sizeof(cl_image_format), &format, NULL);
+    if(flag != CL_SUCCESS)
+        return flag;
+    flag = fillColorPixel(&format, fill_color, pixel, &pixel_size);
+    if(flag != CL_SUCCESS)
+        return flag;
+    if((!region[0]) || (!region[1]) || (!region[2]))
+        return CL_INVALID_VALUE;
+    // The staging memory covers as many full rows as possible, and is
+    // written slice by slice
+    size_t row = region[0] * pixel_size;
+    size_t rows = OCLAND_TRANSFER_CHUNK / row;
+    if(!rows)
+        rows = 1;
+    if(rows > region[1])
+        rows = region[1];
+    void *staging = malloc(rows * row);
+    if(!staging)
+        return CL_OUT_OF_HOST_MEMORY;
+    fillStaging(staging, rows * row, pixel, pixel_size);
+    for(k=0;k<region[2];k++){
+        for(j=0;j<region[1];j+=rows){
+            size_t o[3] = {origin[0], origin[1] + j, origin[2] + k};
+            size_t r[3] = {region[0], region[1] - j < rows ? region[1] - j : rows, 1};
+            if(*event){
+                clReleaseEvent(*event); *event = NULL;
+            }
+            flag = clEnqueueWriteImage(command_queue, image, CL_TRUE, o, r,
+                                       row, 0, staging, 0, NULL, event);
+            if(flag != CL_SUCCESS){
+                *event = NULL;
+                free(staging);
+                return flag;
+            }
+        }
+    }
+    free(staging);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,319 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/epoll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef OCLAND_IO_URING
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <poll.h>
+    #include <stdint.h>
+    #include <linux/io_uring.h>
+#endif
+
+#include <ocland/server/ocland_poll.h>
+
+/// epoll instance, -1 if io_uring is used instead
+static int epollfd = -1;
+
+#ifdef OCLAND_IO_URING
+
+#ifndef OCLAND_IO_URING_ENTRIES
+    #define OCLAND_IO_URING_ENTRIES 256u
+#endif
+
+/// io_uring instance, -1 if it is not used
+static int ringfd = -1;
+/// Submission queue head, tail, mask and indexes array
+static unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+/// Submission queue entries
+static struct io_uring_sqe *sqes;
+/// Completion queue head, tail and mask
+static unsigned int *cq_head, *cq_tail, *cq_mask;
+/// Completion queue entries
+static struct io_uring_cqe *cqes;
+/// Number of submission queue entries queued but not submitted yet
+static unsigned int sq_pending = 0;
+/** @struct watched_st Watched socket. The polls are tagged with the
+ * socket and its generation, such that the completions of a closed socket
+ * are not reported if its descriptor is reused.
+ */
+struct watched_st
+{
+    /// Socket
+    int fd;
+    /// Generation, never 0
+    unsigned int gen;
+};
+
+/// Last generation assigned to a watched socket
+static unsigned int generation = 0;
+/// Watched sockets, needed to rearm the terminated multishot polls
+static struct watched_st *watched = NULL;
+/// Length of the watched sockets array
+static unsigned int n_watched = 0;
+
+/** Setup the io_uring instance and map its rings.
+ * @return 0 if io_uring can be used, -1 otherwise.
+ */
+static int initRing()
+{
+    struct io_uring_params p;
+    void *sq, *cq;
+    size_t sq_size, cq_size;
+    memset(&p, 0, sizeof(p));
+    ringfd = (int)syscall(__NR_io_uring_setup, OCLAND_IO_URING_ENTRIES, &p);
+    if(ringfd < 0)
+        return -1;
+    // Timed waits are required
+    if(!(p.features & IORING_FEAT_EXT_ARG)){
+        close(ringfd); ringfd = -1;
+        return -1;
+    }
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(cq_size > sq_size)
+            sq_size = cq_size;
+        cq_size = sq_size;
+    }
+    sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              ringfd, IORING_OFF_SQ_RING);
+    cq = sq;
+    if((sq != MAP_FAILED) && !(p.features & IORING_FEAT_SINGLE_MMAP)){
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringfd, IORING_OFF_CQ_RING);
+    }
+    sqes = (struct io_uring_sqe*)mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      ringfd, IORING_OFF_SQES);
+    if((sq == MAP_FAILED) || (cq == MAP_FAILED) || (sqes == MAP_FAILED)){
+        close(ringfd); ringfd = -1;
+        return -1;
+    }
+    sq_head  = (unsigned int*)((char*)sq + p.sq_off.head);
+    sq_tail  = (unsigned int*)((char*)sq + p.sq_off.tail);
+    sq_mask  = (unsigned int*)((char*)sq + p.sq_off.ring_mask);
+    sq_array = (unsigned int*)((char*)sq + p.sq_off.array);
+    cq_head  = (unsigned int*)((char*)cq + p.cq_off.head);
+    cq_tail  = (unsigned int*)((char*)cq + p.cq_off.tail);
+    cq_mask  = (unsigned int*)((char*)cq + p.cq_off.ring_mask);
+    cqes     = (struct io_uring_cqe*)((char*)cq + p.cq_off.cqes);
+    return 0;
+}
+
+/** Submit the queued entries, optionally waiting for completions.
+ * @param wait Minimum number of completions to wait for.
+ * @param timeout Maximum waiting time in milliseconds, -1 to wait forever.
+ * @return 0 if the entries are submitted, -1 otherwise.
+ */
+static int enterRing(unsigned int wait, int timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int flags = IORING_ENTER_EXT_ARG;
+    int ret;
+    memset(&arg, 0, sizeof(arg));
+    if(wait){
+        flags |= IORING_ENTER_GETEVENTS;
+        if(timeout >= 0){
+            ts.tv_sec  = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+            arg.ts     = (unsigned long long)(uintptr_t)&ts;
+        }
+    }
+    ret = (int)syscall(__NR_io_uring_enter, ringfd, sq_pending, wait, flags,
+                       &arg, sizeof(arg));
+    if(ret >= 0){
+        sq_pending -= (unsigned int)ret < sq_pending ? (unsigned int)ret : sq_pending;
+        return 0;
+    }
+    if((errno == ETIME) || (errno == EINTR))
+        return 0;
+    return -1;
+}
+
+/** Tag of the polls of a watched socket.
+ * @param w Watched socket.
+ * @return Poll tag, with the generation in the upper 32 bits and the
+ * socket in the lower ones.
+ */
+static unsigned long long pollTag(const struct watched_st *w)
+{
+    return ((unsigned long long)w->gen << 32) | (unsigned int)w->fd;
+}
+
+/** Queue a submission queue entry, submitting the queued ones if the
+ * queue is full.
+ * @param opcode Operation.
+ * @param w Watched socket.
+ * @return 0 if the entry is queued, -1 otherwise.
+ */
+static int queueRing(unsigned char opcode, const struct watched_st *w)
+{
+    unsigned int tail = *sq_tail, index;
+    if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask){
+        if(enterRing(0, 0))
+            return -1;
+        if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask)
+            return -1;
+    }
+    index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &(sqes[index]);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode    = opcode;
+    if(opcode == IORING_OP_POLL_ADD){
+        sqe->user_data     = pollTag(w);
+        sqe->fd            = w->fd;
+        sqe->poll32_events = POLLIN;
+        sqe->len           = IORING_POLL_ADD_MULTI;
+    }
+    else{
+        // Generation 0 tag, the removal confirmation is discarded
+        sqe->user_data = 0;
+        sqe->fd        = -1;
+        sqe->addr      = pollTag(w);
+    }
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    sq_pending++;
+    return 0;
+}
+
+/** Test if a socket is watched.
+ * @param fd Socket.
+ * @return Index in the watched array, -1 if it is not watched.
+ */
+static int isWatched(int fd)
+{
+    unsigned int i;
+    for(i=0;i<n_watched;i++){
+        if(watched[i].fd == fd)
+            return (int)i;
+    }
+    return -1;
+}
+
+#endif // OCLAND_IO_URING
+
+int initPoller()
+{
+    #ifdef OCLAND_IO_URING
+        if(!initRing())
+            return 0;
+        printf("WARNING: io_uring is not available, epoll will be used.\n"); fflush(stdout);
+    #endif
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    return epollfd < 0 ? -1 : 0;
+}
+
+const char* pollerName()
+{
+    return epollfd < 0 ? "io_uring" : "epoll";
+}
+
+int watchSocket(int fd)
+{
+    #ifdef OCLAND_IO_URING
+        if(ringfd >= 0){
+            struct watched_st *new_watched = (struct watched_st*)realloc(
+                watched, (n_watched + 1) * sizeof(struct watched_st));
+            if(!new_watched)
+                return -1;
+            watched = new_watched;
+            if(!++generation)
+                generation++;
+            watched[n_watched].fd  = fd;
+            watched[n_watched].gen = generation;
+            return queueRing(IORING_OP_POLL_ADD, &(watched[n_watched++]));
+        }
+    #endif
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev) ? -1 : 0;
+}
+
+void unwatchSocket(int fd)
+{
+    #ifdef OCLAND_IO_URING
+        if(ringfd >= 0){
+            struct watched_st w;
+            int i = isWatched(fd);
+            if(i < 0)
+                return;
+            w = watched[i];
+            watched[i] = watched[--n_watched];
+            queueRing(IORING_OP_POLL_REMOVE, &w);
+            return;
+        }
+    #endif
+    // Closed sockets are automatically removed
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int waitSockets(int *fds, unsigned int max_fds, int timeout)
+{
+    #ifdef OCLAND_IO_URING
+        if(ringfd >= 0){
+            unsigned int n = 0, head;
+            // Submit the queued polls and wait in the same system call
+            if(enterRing(1, timeout))
+                return -1;
+            head = *cq_head;
+            while((n < max_fds) && (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))){
+                struct io_uring_cqe *cqe = &(cqes[head & *cq_mask]);
+                int fd = (int)(unsigned int)cqe->user_data;
+                unsigned int gen = (unsigned int)(cqe->user_data >> 32);
+                int res = cqe->res;
+                unsigned int flags = cqe->flags;
+                int i = isWatched(fd);
+                head++;
+                // Removal confirmations, or polls of closed sockets,
+                // even if the descriptor has been reused
+                if((i < 0) || (watched[i].gen != gen))
+                    continue;
+                // The multishot poll has been terminated, rearm it
+                if(!(flags & IORING_CQE_F_MORE))
+                    queueRing(IORING_OP_POLL_ADD, &(watched[i]));
+                // Errors are reported as well, such that the dispatcher
+                // detects the broken connection
+                if(res)
+                    fds[n++] = fd;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            return (int)n;
+        }
+    #endif
+    struct epoll_event events[64];
+    int i, n;
+    if(max_fds > 64)
+        max_fds = 64;
+    n = epoll_wait(epollfd, events, (int)max_fds, timeout);
+    if(n < 0)
+        return errno == EINTR ? 0 : -1;
+    for(i=0;i<n;i++)
+        fds[i] = events[i].data.fd;
+    return n;
+}
@@ -42,6 +42,10 @@ void initValidator(validator* v)
     (*v)->kernels = NULL;
     (*v)->num_events = 0;
     (*v)->events = NULL;
+    (*v)->pending = 0;
+    (*v)->comm_size = 0;
+    (*v)->received = 0;
+    (*v)->msg = NULL;
 }
 
 void closeValidator(validator* v)
@@ -62,6 +66,7 @@ void closeValidator(validator* v)
     if((*v)->kernels) free((*v)->kernels); (*v)->kernels = NULL;
     (*v)->num_events = 0;
     if((*v)->events) free((*v)->events); (*v)->events = NULL;
+    if((*v)->msg) free((*v)->msg); (*v)->msg = NULL;
     if(*v) free(*v); *v = NULL;
 }
 
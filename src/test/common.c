@@ -0,0 +1,334 @@
+/*
+ *  This file is part of ocland, a free cloud OpenCL interface.
+ *  Copyright (C) 2012  Jose Luis Cercos Pita <jl.cercos@upm.es>
+ *
+ *  ocland is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ocland is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with ocland.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file
+ * Unit tests of the common code shared by the client and the server,
+ * which can be run without any OpenCL platform.
+ */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <ocland/common/dataExchange.h>
+#include <ocland/common/dataCompression.h>
+#include <ocland/common/dataStripes.h>
+#include <ocland/common/dataShared.h>
+#include <ocland/common/sha256.h>
+
+/// Number of failed checks
+static unsigned int failures = 0;
+
+/** Report a failed check.
+ * @param test Test name.
+ * @param msg Failure description.
+ */
+static void fail(const char *test, const char *msg)
+{
+    printf("FAILED: %s: %s\n", test, msg); fflush(stdout);
+    failures++;
+}
+
+/** @struct writer_st Data to be written in a socket by a thread.
+ */
+struct writer_st
+{
+    /// Socket, closed once the data has been written
+    int fd;
+    /// Compression stream. NULL for raw data
+    oclandStream stream;
+    /// Data to write
+    const void *data;
+    /// Size of the data
+    size_t size;
+    /// Result of the writing
+    ssize_t result;
+};
+
+/** Thread that writes some data in a socket, closing it afterwards.
+ * @param data struct writer_st casted variable.
+ * @return NULL
+ */
+static void *writer_thread(void *data)
+{
+    struct writer_st *w = (struct writer_st*)data;
+    w->result = SendStream(&(w->fd), w->stream, w->data, w->size);
+    close(w->fd);
+    return NULL;
+}
+
+/** Send some data along a compression stream, and receive it back.
+ * @param modes Compression modes.
+ * @param data Data to transfer.
+ * @param size Size of the data.
+ * @param chunk Size of the pieces in which the data is received.
+ * @param out Returned data, of size bytes.
+ * @return Bytes transmitted along the connection, 0 if the transfer
+ * failed.
+ */
+static size_t roundTrip(unsigned int modes, const void *data, size_t size,
+                        size_t chunk, void *out)
+{
+    int fds[2];
+    pthread_t thread;
+    struct writer_st w;
+    oclandStream stream;
+    unsigned char *wire = NULL, *tmp;
+    size_t wire_size = 0, capacity = 0, done = 0, n;
+    ssize_t flag;
+    // Capture the stream sent
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        return 0;
+    w.fd     = fds[0];
+    w.stream = CreateStream(modes);
+    w.data   = data;
+    w.size   = size;
+    if(pthread_create(&thread, NULL, writer_thread, (void*)&w)){
+        close(fds[0]); close(fds[1]);
+        ReleaseStream(w.stream);
+        return 0;
+    }
+    for(;;){
+        if(capacity - wire_size < 65536){
+            capacity = 2*capacity + 65536;
+            tmp = (unsigned char*)realloc(wire, capacity);
+            if(!tmp)
+                break;
+            wire = tmp;
+        }
+        flag = recv(fds[1], wire + wire_size, capacity - wire_size, 0);
+        if(flag <= 0)
+            break;
+        wire_size += flag;
+    }
+    pthread_join(thread, NULL);
+    close(fds[1]);
+    ReleaseStream(w.stream);
+    if(w.result != (ssize_t)size){
+        free(wire);
+        return 0;
+    }
+    // Decode the captured stream
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds)){
+        free(wire);
+        return 0;
+    }
+    w.fd     = fds[0];
+    w.stream = NULL;
+    w.data   = wire;
+    w.size   = wire_size;
+    if(pthread_create(&thread, NULL, writer_thread, (void*)&w)){
+        close(fds[0]); close(fds[1]);
+        free(wire);
+        return 0;
+    }
+    stream = CreateStream(modes);
+    while(done < size){
+        n = size - done < chunk ? size - done : chunk;
+        if(RecvStream(&(fds[1]), stream, (unsigned char*)out + done, n) != (ssize_t)n)
+            break;
+        done += n;
+    }
+    ReleaseStream(stream);
+    pthread_join(thread, NULL);
+    if(fds[1] >= 0)
+        close(fds[1]);
+    free(wire);
+    return done == size ? wire_size : 0;
+}
+
+/** Test the compression streams round trip.
+ */
+static void testCompression()
+{
+    const char *test = "compression";
+    size_t i, size = 3*1048576 + 1001, lz, shuffled;
+    float *smooth = (float*)malloc(size);
+    unsigned char *noise = (unsigned char*)malloc(size);
+    unsigned char *out = (unsigned char*)malloc(size);
+    if(!smooth || !noise || !out){
+        fail(test, "can't allocate memory");
+        free(smooth); free(noise); free(out);
+        return;
+    }
+    for(i=0;i<size/sizeof(float);i++)
+        smooth[i] = 1000.f + 0.001f*i;
+    srand(1);
+    for(i=0;i<size;i++)
+        noise[i] = (unsigned char)(rand() >> 7);
+
+    // Raw transfer
+    memset(out, 0, size);
+    if(roundTrip(OCLAND_COMPRESSION_NONE, noise, size, size, out) != size)
+        fail(test, "raw transfer size mismatch");
+    if(memcmp(noise, out, size))
+        fail(test, "raw transfer data mismatch");
+
+    // Floats, whose bytes just compress once they are shuffled
+    memset(out, 0, size);
+    lz = roundTrip(OCLAND_COMPRESSION_LZ, smooth, size, size, out);
+    if(!lz || memcmp(smooth, out, size))
+        fail(test, "LZ transfer data mismatch");
+    memset(out, 0, size);
+    shuffled = roundTrip(OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE,
+                         smooth, size, size, out);
+    if(!shuffled || memcmp(smooth, out, size))
+        fail(test, "shuffled transfer data mismatch");
+    if(shuffled >= lz)
+        fail(test, "the shuffle filter is not applied");
+    if(shuffled >= size / 2)
+        fail(test, "the shuffled floats are not compressed");
+
+    // Received in pieces not matching the compression blocks
+    memset(out, 0, size);
+    if(!roundTrip(OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE,
+                  smooth, size, 1000, out))
+        fail(test, "chunked transfer has failed");
+    if(memcmp(smooth, out, size))
+        fail(test, "chunked transfer data mismatch");
+
+    // Incompressible data should be sent raw, with just the blocks headers
+    memset(out, 0, size);
+    shuffled = roundTrip(OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE,
+                         noise, size, 4096, out);
+    if(!shuffled || memcmp(noise, out, size))
+        fail(test, "incompressible transfer data mismatch");
+    if(shuffled > size + size / 1024)
+        fail(test, "incompressible data is expanded");
+
+    // Small transfers, below the compression threshold
+    memset(out, 0, size);
+    if(!roundTrip(OCLAND_COMPRESSION_LZ | OCLAND_COMPRESSION_SHUFFLE,
+                  noise, 7, 7, out) || memcmp(noise, out, 7))
+        fail(test, "small transfer data mismatch");
+
+    free(smooth); free(noise); free(out);
+}
+
+/** Compare a digest with its hexadecimal representation.
+ * @param digest Digest.
+ * @param hex Expected digest.
+ * @return 1 if they match, 0 otherwise.
+ */
+static int digestMatches(const unsigned char *digest, const char *hex)
+{
+    char str[2*SHA256_DIGEST_SIZE + 1];
+    unsigned int i;
+    for(i=0;i<SHA256_DIGEST_SIZE;i++)
+        sprintf(str + 2*i, "%02x", digest[i]);
+    return !strcmp(str, hex);
+}
+
+/** Test the SHA-256 implementation against the FIPS 180-2 vectors.
+ */
+static void testSHA256()
+{
+    const char *test = "sha256";
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char *million = (char*)malloc(1000000);
+    SHA256("", 0, digest);
+    if(!digestMatches(digest, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"))
+        fail(test, "empty message");
+    SHA256("abc", 3, digest);
+    if(!digestMatches(digest, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"))
+        fail(test, "one block message");
+    SHA256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, digest);
+    if(!digestMatches(digest, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"))
+        fail(test, "two blocks message");
+    if(!million){
+        fail(test, "can't allocate memory");
+        return;
+    }
+    memset(million, 'a', 1000000);
+    SHA256(million, 1000000, digest);
+    if(!digestMatches(digest, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"))
+        fail(test, "long message");
+    free(million);
+}
+
+/** Test that the stripes slices cover the whole transfer.
+ */
+static void testStripes()
+{
+    const char *test = "stripes";
+    const size_t sizes[] = {0, 1, 7, 4096, 4194304, 33554433};
+    size_t offset, size, end;
+    unsigned int i, streams, index;
+    for(i=0;i<sizeof(sizes)/sizeof(size_t);i++){
+        for(streams=1;streams<=8;streams++){
+            end = 0;
+            for(index=0;index<streams;index++){
+                StripeSlice(sizes[i], streams, index, &offset, &size);
+                if(offset != end)
+                    fail(test, "the slices are not contiguous");
+                end = offset + size;
+            }
+            if(end != sizes[i])
+                fail(test, "the slices do not cover the transfer");
+        }
+    }
+}
+
+/** Test that just the sealed shared memory regions are mapped.
+ */
+static void testShared()
+{
+    const char *test = "shared";
+    size_t cb = 65536;
+    void *ptr = NULL, *peer;
+    int fd, unsealed;
+    fd = CreateSharedRegion(cb, &ptr);
+    if(fd < 0){
+        printf("Shared memory regions are not supported, skipping\n");
+        return;
+    }
+    memset(ptr, 1, cb);
+    peer = MapSharedRegion(fd, cb);
+    if(!peer)
+        fail(test, "the sealed region can't be mapped");
+    else if(memcmp(ptr, peer, cb))
+        fail(test, "the region is not shared");
+    if(!ftruncate(fd, 0))
+        fail(test, "the region can be truncated");
+    ReleaseSharedRegion(-1, peer, cb);
+    if(MapSharedRegion(fd, 2*cb))
+        fail(test, "a region smaller than requested is mapped");
+    ReleaseSharedRegion(fd, ptr, cb);
+    // A plain memory file can be truncated by its owner at any time
+    unsealed = fileno(tmpfile());
+    if((unsealed >= 0) && !ftruncate(unsealed, cb) && MapSharedRegion(unsealed, cb))
+        fail(test, "an unsealed region is mapped");
+}
+
+int main(int argc, char *argv[])
+{
+    testCompression();
+    testSHA256();
+    testStripes();
+    testShared();
+    if(failures){
+        printf("%u checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All the checks passed\n");
+    return EXIT_SUCCESS;
+}